@@ -8,6 +8,109 @@
 	subdirectory of the ROOT file that is given to it.
 2014-06-29
 	Just now noting this: Program now (as of like easrly March) uses the CSVtoStruct.h/cxx
+2015-05-14
+	Chi-square fits (fit options without I or L) now go through BatchFit(), which hands
+	Minuit an FCN that evaluates the model on all bins at once with yAllBatch() instead
+	of having TH1::Fit call yAll() bin by bin. Other options still use TH1::Fit.
+2015-05-18
+	Option I (without L) also goes through BatchFit() now: the model in each bin is the
+	exact bin average of yAll from yAllBatchIntegral() (BFit2Integrals.cxx) rather than
+	TH1::Fit's numerical integral, so integral fits cost about the same as plain ones.
+2015-05-21
+	BatchFit() now uses Minuit2 and hands it the gradient of the chi-square as well,
+	from the exact parameter derivatives in BFit2Gradient.cxx, instead of letting
+	Minuit difference the chi-square in every free parameter. As with TH1::Fit, options M
+	and E have Hesse redo the errors and covariance after Migrad, M then runs Migrad once
+	more from the minimum (Minuit2's stand-in for IMPROVE), E runs MINOS, and Q keeps
+	the fit quiet.
+2015-05-25
+	The model's state (cycle times, lifetimes, sigma arrays, ...) now lives in a
+	ModelContext_t made in BFit() rather than in globals here; the TF1s, BatchFit()
+	and intErr() are handed that context.
+2015-05-27
+	Batch mode: './BFit2 --batch [--threads=<n>] <BFit case code or pattern> ...' fits
+	every matching BFit case, on a pool of threads (ROOT >= 6.06), against the BDN case
+	whose code starts its code. Each case writes BFit_<BFit case code>.root and one line
+	of BFitSummary.txt. The fit bins now belong to each BatchFit() call and the integrals
+	to each BFit() call, so nothing a fit writes is shared between cases.
+2015-05-30
+	Option L (and LL) now goes through BatchFit() too. Instead of TH1::Fit's likelihood,
+	BatchFit() minimizes the Baker-Cousins likelihood chi-square
+		chi2_L = 2 sum_i [ mu_i - n_i + n_i ln(n_i/mu_i) ]
+	over every bin in the range, empty ones included, which is right for the low-count
+	background and late-cycle bins and is still a goodness-of-fit statistic (UP = 1).
+	On long histograms the bins are split into blocks over iFitThreads threads (ROOT >= 6.06),
+	each block evaluating the model (and its gradient) and its share of the sum; the threads
+	are started once per fit and wait between FCN calls.
+	Options BatchFit() doesn't do (W, WL, B, ...; see BatchFitOptions()) still go through
+	TH1::Fit.
+2015-06-01
+	Global mode: './BFit2 --global [--threads=<n>] [--shared=<par>,<par>...] <BFit case code
+	or pattern> ...' fits the histograms of all the matching BFit cases at once. The pars
+	named in --shared (default r1,r2,r3,p,rho) are one parameter for every case; the rest
+	are each case's own. Each FCN call evaluates the cases' models on up to n threads and
+	adds up their chi-squares. Results go to BFitGlobal.txt. Collecting the fit bins from
+	a histogram is now FillFitBins(), shared by BatchFit() and BFitGlobal().
+2015-06-03
+	Profile likelihood: '--profile=<par or integral>,... [--points=<n>]' after the case
+	codes (single case or --batch) scans the chi-square (chi2_L with option L) after the
+	fit. Each quantity -- a free parameter, or a cycle integral T1 ... U3, DC, All -- is
+	stepped away from the best fit in both directions, refitting the other parameters at
+	every grid point (from the neighbouring point's result); integrals are held with a
+	tight penalty term. The scans run in parallel, one model context each, and the points
+	where the chi-square has risen by 1 give asymmetric errors. Points go to
+	BFitProfile_<BFit case code>.txt.
+2015-06-04
+	The integrals T1_integral ... All_integral and the trap empty/full splits are the exact
+	cycle integrals from rIntegral() (BFit2Integrals.cxx) instead of TF1::Integral, and their
+	errors come from IntegralError(): the exact gradient of the integral (rIntegralGradient()
+	in BFit2Gradient.cxx) with the fit covariance. intErr() and its finite differences (two
+	more adaptive integrals per free parameter) are gone. The profile scans use the same
+	gradient for the integral constraint.
+2015-06-06
+	Warm starts: a converged fit (status 0) saves its parameters and covariance in
+	BFitWarmStart.txt, keyed by BDN case, BFit case, the toggled parameters and the bin
+	width. The next fit with the same key (single, --batch or --global) starts the free
+	parameters there, with the errors as step sizes, instead of at the CSV seeds. Fixed
+	parameters always come from the CSV. '--cold' after the case codes ignores the store.
+2015-06-08
+	Benchmark: './BFit2 --bench [--threads=<n>] [--reference=<file>] [--tolerance=<x>]
+	[<B_fit case code or pattern> ...]' fits the Monte Carlo cases (default BMC_*) cold,
+	whatever their do_fit flag, and compares each fit with the values the histogram was
+	generated with, read from BMC_runDescriptions.txt. BFitBench.txt gets, per case, the
+	Minuit calls, model evaluations (with and without gradient), fit and total wall time,
+	and fit, error, truth and pull of DC, r1, r2, r3, p and rho. With --reference=<file>
+	(an earlier BFitBench.txt) every parameter is checked against that run as well, and
+	the benchmark fails if one has moved by more than <x> (default 0.05) of its error.
+	'make bench' runs it. BatchFit() counts the model evaluations of each fit.
+2015-06-10
+	Before a fit, SetActiveExponentials() (BFit2Batch.cxx) works out which of the six
+	exponentials of the model the free parameters can make nonzero: a rate r1, r2, r3 or an
+	efficiency fixed at zero switches off the populations it feeds. yAllBatch() and
+	yAllBatchGradient() then run a kernel compiled for just those exponentials, so one- and
+	two-species cases don't pay for the third species' Exp's. The fit results are the same.
+2015-06-12
+	Toy studies: '--toys=<n> [--bootstrap] [--seed=<n>]' after the case codes (single case
+	or --batch) refits the histogram n times after the fit, with every bin redrawn from a
+	Poisson distribution about the best-fit model (toy Monte Carlo) or, with --bootstrap,
+	about the data. The toys are made and fit in memory on up to iFitThreads threads, each
+	starting from the best fit; toy i always uses seed + i, so a study is reproducible
+	whatever the threads. The mean, bias, spread, mean error and pull distribution of every
+	free parameter and cycle integral are printed, and each toy goes to
+	BFitToys_<BFit case code>.txt.
+2015-06-13
+	Binning scans: './BFit2 --binscan [--threads=<n>] [--widths=<ms>,...] <B_fit case code>'
+	fits one case at each bin width in a single run, with no need to edit BFitCases.csv and
+	rerun for every width. The raw histogram is read once and its cumulative sums give the
+	fit bins at each width directly, with no TH1::Rebin per width. The widths are fit at the
+	same time on up to --threads threads. Each thread keeps one model context for all the
+	widths it fits, so the sigma arrays carry over from fit to fit. Each width warm-starts
+	from the store when it can, and otherwise from the case seeds. The table of parameters
+	vs bin width goes to BFitBinScan_<BFit case code>.txt, with each fit's start (warm or
+	cold) and Minuit calls, so scanning twice shows what the warm starts save.
+2015-06-14
+	The fit bins, their chi-square and BatchFit() moved to BFit2Fit.cxx (BFit2Fit.h), so that
+	BFitModelCompare --fit can check BatchFit() against TH1::Fit on the same histogram.
 */
 
 #include <unistd.h>
@@ -15,8 +118,17 @@
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <cctype>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <fnmatch.h>
 #include "time.h"
 #include "TROOT.h"
+#include "RVersion.h"
+#include "TStopwatch.h"
+#include "TRandom3.h"
 #include "TString.h"
 #include "TStyle.h"
 #include "TMath.h"
@@ -29,12 +141,15 @@
 #include "TLegend.h"
 #include "TPaveStats.h"
 #include "Fit/FitConfig.h"
+#include "Fit/Fitter.h"
+#include "Math/IFunction.h"
 //#include "include/bdn.h"
 //#include "include/sb135.h"
 //#include "bdn_cases.h"
 #include "bdnHistograms.h"
 #include "CSVtoStruct.h"
 #include "BFit2Model.h"
+#include "BFit2Fit.h"
 using namespace std;
 
 //#include "TVirtualFitter.h"
@@ -42,68 +157,110 @@ using namespace std;
 /////////////////////////////////////////////////////////////////////////////
 // Global variables
 /////////////////////////////////////////////////////////////////////////////
-char parNames[30][5] = {"nCyc", "dt", "DC", "r1", "r2", "r3", "p", "rho", "epsT", "epsU", "epsV", "epsW", "epsX", "epsY", "epsZ", "gT1", "gT2", "gT3", "gU1", "gU2", "gU3"};
-
 // Structs
 BDNCase_t	stBDNCases[FILE_ROWS_BDN];
 BFitCase_t	stBFitCases[FILE_ROWS_BFit];
 Int_t		iBDNCaseIndex, iBFitCaseIndex; // global index to identify case
 Int_t		iNumStructs_BDN, iNumStructs_BFit;
-// These never change during fitting and are set in BFit()
-Int_t		nPars; // number of model parameters
-Double_t	iota; // tiny number for avoiding divide-by-0
-Double_t	tCap, tBac, tCyc; // cycle times
-Double_t	t1, t2, t3; // radioactive half-lives
-//Double_t	tZeroArg[1], tCycArg[1]; // specifc time values 1-element array for passing by reference
-Int_t		nCycles; // number of cycles in dataset -- don't confuse with parameter indec nCyc
-Int_t		nCapMax; // number of injections per cycle
-bool		b134sbFlag = 0; // flag for 134sb cases which get special treatment
-// These change only when the parameters change during fitting and are set in yAll()
-Int_t 		nParChanges; // counts # of times pars have changed
-Double_t	*lastPar; // holds most recent paramter values for comparison
-Double_t	tT1, tT2, tT3, tU1, tU2, tU3; // modified lifetimes
-Double_t	aT1, aT2, aT3, aU1, aU2, aU3; // Decay factors for one capture interval tCap
-Double_t	eU1tCyc, eU2tCyc, eU3tCyc; // background decay at end of cycle: exp(-tCyc/tU1), ...
-Double_t	tT1U2, tT1U3, tU1U2, tU1U3, tT2U3, tU2U3; // Coefficients used in Y2 and Y3
-Double_t	cT1, cU1, cU2, cZT2, cZU2, cZU3, cXT1, cXU2, cXU3, cYU1, cYU2, cYU3, ThetaU, ThetaY; // various products of lifetimes
-//Double_t	ST1_1cap, SW11_1cap, SZ11_1cap, ST2_1cap, SW22_1cap, SZ12_1cap, SZ22_1cap; // specific values of the SigmaT, SigmaW, and SigmaZ functions
-Double_t	*sigmaT1, *sigmaT2, *sigmaT3;
-Double_t	*sigmaV1, *sigmaV2, *sigmaV3;
-Double_t	*sigmaW1, *sigmaW2, *sigmaW3;
-Double_t	*sigmaZ1, *sigmaZ2, *sigmaZ3;
-Double_t			  *sigmaX2, *sigmaX3;
-Double_t			  *sigmaY2, *sigmaY3;
-Double_t	*sY2v1, *sY2w1, *sY2z1;
-Double_t	*sY3v2, *sY3w2, *sY3z2, *sY3x2, *sY3v1, *sY3w1, *sY3z1;
-Double_t	*timeOfCapt; 
-Double_t	Gamma_T1_U2, Gamma_T2_U3;
-Double_t	Gamma_U1_U2, Gamma_U2_U3;
-Double_t	*I_V1_Y2, *I_V2_Y3;
-Double_t	*I_W1_Y2, *I_W2_Y3;
-Double_t	*I_Z1_Y2, *I_Z2_Y3;
-Double_t	*I_X1_Y2, *I_X2_Y3;
-Double_t			  *I_Y2_Y3;
-Double_t	*Y2InitialValues, *Y3InitialValues;
-Double_t	ampT1, ampT2, ampT3; // amplitudes of the T pops
-Double_t	ampV1, ampV2, ampV3; // amplitudes of the V pops
-Double_t	ampW1, ampW2, ampW3; // amplitudes of the W pops
-Double_t	ampZ1, ampZ2, ampZ3; // amplitudes of the Z pops
-Double_t		   ampX2, ampX3;  // amplitudes of the X pops
-Double_t		ampY2ptA, ampY2ptB; // amplitudes for Y2
-Double_t	ampY3fromV2, ampY3fromW2, ampY3fromZ2, ampY3fromX2, ampY3fromY2_ST1, ampY3fromY2_SW11, ampY3fromY2_SZ11; // amplitudes for Y3
-Double_t	V10, V20, V30, W10, W20, W30, Z10, Z20, Z30, X20, X30, Y20, Y30, U10, U20, U30; // initial value (t=0) for each pop
-// These change for every function call and are set in yAll()
-Int_t		nCap; // current injection number
-Double_t	eU10, eU20, eU30; // decay from t=0 for background parts: exp(-t/tT1), ...
-Double_t	eT1nCap, eT2nCap, eT3nCap, eU1nCap, eU2nCap, eU3nCap; // decay from last injection for capture parts: exp(-(t-tB-(nCap-1)*tA)/tT1), ...
-Double_t	T1val, T2val, T3val, U1val, U2val, U3val, V1val, V2val, V3val, W1val, W2val, W3val, Z1val, Z2val, Z3val, X2val, X3val, Y2val, Y3val; // value of each pop
 /////////////////////////////////////////////////////////////////////////////
 
+// Several FitBins_t fit together by BFitGlobal(): parameter j of case k is entry
+// slot[k*nParIndex+j] of the global parameter vector, shared or the case's own.
+struct GlobalFit_t {
+	Int_t		nCases, nThreads;
+	FitPool_t	*pool; // the nThreads threads the cases are shared out over (0 for one thread)
+	Int_t		nPars; // number of global parameters
+	FitBins_t	*fb; // fit bins and model of each case
+	Int_t		*slot;
+	Double_t	*casePar, *caseGrad, *caseChi2; // per case: nParIndex, nParIndex, 1
+};
+
+// Results of one BFit() call, for the batch summary table
+const Int_t nIntegrals = 8; // T1, T2, T3, U1, U2, U3, DC, All
+const char pcsIntegralNames[nIntegrals][4] = {"T1", "T2", "T3", "U1", "U2", "U3", "DC", "All"};
+const Int_t piIntegralPops[nIntegrals] = {BFitNamespace::popT1, BFitNamespace::popT2, BFitNamespace::popT3,
+	BFitNamespace::popU1, BFitNamespace::popU2, BFitNamespace::popU3, BFitNamespace::popDC, BFitNamespace::popAll};
+struct BFitResult_t {
+	Int_t		iBDNCase, iBFitCase; // indices into stBDNCases and stBFitCases
+	int			iReturn; // return status of BFit()
+	Bool_t		bFitDone; // kFALSE if the BFit case doesn't fit (bDoFit = 0)
+	Int_t		iFitStatus, iCovStatus;
+	Double_t	dChi2;
+	Int_t		iNDF;
+	Double_t	dPar[BFitNamespace::nParIndex], dErr[BFitNamespace::nParIndex];
+	Double_t	dIntegral[nIntegrals], dIntegralError[nIntegrals];
+	Double_t	dRealTime; // seconds spent in BFit()
+	Double_t	dFitTime; // seconds spent in the fit itself
+	Int_t		iNCalls; // FCN calls reported by Minuit
+	Long64_t	nEval, nEvalGrad; // model evaluations without and with gradient (BatchFit() only)
+};
+
+// One bin width of a binning scan, and its fit
+struct BinScanWidth_t {
+	Double_t	dWidth; // ms
+	Int_t		nRebin, nFitBins, iStatus, iCovStatus, iNDF, iNCalls;
+	Bool_t		bWarm; // started from the warm-start store
+	Double_t	dChi2, dPar[BFitNamespace::nParIndex], dErr[BFitNamespace::nParIndex];
+	Double_t	dInt[nIntegrals], dIntErr[nIntegrals];
+};
+
+// Several BFit() calls can run at once in batch mode. Drawing and writing canvases
+// (gStyle, gPad) and TH1::Fit (one global TVirtualFitter) are not thread safe, so
+// those parts hold BFIT_LOCK; the batch fits, integrals and errors run concurrently.
+#ifdef BFIT_THREADS
+std::mutex	mtxBFit;
+#define BFIT_LOCK	std::lock_guard<std::mutex> lockBFit(mtxBFit)
+#else
+#define BFIT_LOCK
+#endif
+// Warm-start store: converged fits, read before each fit unless --cold
+Bool_t		bWarmStart = kTRUE;
+const char	pcsWarmStartFile[] = "BFitWarmStart.txt";
+// Profile-likelihood scans after the fit: quantities from --profile=, grid points per side
+char		pcsProfile[STRING_SIZE] = "";
+Int_t		nProfilePoints = 12;
+const Int_t	nMaxProfilePoints = 64;
+// Toy studies after the fit: number of toys (none if 0), bootstrap the data instead of the
+// best-fit model, seed of the first toy
+Int_t		nToys = 0;
+Bool_t		bBootstrap = kFALSE;
+UInt_t		iToySeed = 1;
+
+// One profile-likelihood scan: quantity jPar (a parameter), or the cycle integral of pops
+// if jPar is -1, stepped by step*iDir from the best fit, each point refit with its own
+// model context and fit bins so the scans can run at once
+struct ProfileScan_t {
+	Int_t		jPar, pops, iDir;
+	Double_t	step, width; // grid spacing; width of the penalty that holds an integral
+	BFitNamespace::ModelContext_t ctx;
+	FitBins_t	fb;
+	Int_t		nPoints; // grid points done
+	Double_t	q[nMaxProfilePoints], dChi2[nMaxProfilePoints]; // quantity and rise of the chi-square at each point
+	Int_t		status[nMaxProfilePoints]; // Minuit status of each refit
+};
+
 // Functions
-Double_t intErr (TF1*, Double_t*, Double_t, Double_t);
-void HistPrep (TH1*, Int_t, Int_t, char*);
+Double_t IntegralError (BFitNamespace::ModelContext_t*, Int_t, Double_t*, Double_t*, Double_t, Double_t);
+void HistPrep (TH1*, Int_t, Int_t, char*, Double_t);
 void FuncPrep (TF1*, Double_t*, Int_t, Int_t, Int_t);
-int BFit ();
+Double_t GlobalChi2 (GlobalFit_t*, const Double_t*, Double_t*);
+int BFitGlobal (int, char**);
+Bool_t OptionArg (const char*);
+TString WarmStartKey (const BDNCase_t*, const BFitCase_t*);
+Bool_t ReadWarmStart (const BDNCase_t*, const BFitCase_t*, Double_t*, Double_t*);
+void SaveWarmStart (const BDNCase_t*, const BFitCase_t*, const Double_t*, const Double_t*);
+Double_t CycleIntegral (BFitNamespace::ModelContext_t*, Int_t, Double_t*);
+Double_t ProfileChi2 (FitBins_t*, Int_t, Double_t, Double_t, const Double_t*, Double_t*);
+void ProfileScan (BDNCase_t*, TH1*, TF1*, BFitCase_t*, Double_t*, const char*);
+void ToyStudy (BDNCase_t*, TH1*, TF1*, BFitCase_t*, const char*);
+int BFit (Int_t, Int_t, const char*, BFitResult_t*);
+int BFitBatch (int, char**);
+int BFitBench (int, char**);
+int BFitBinScan (int, char**);
+void AddMatchingCases (const char*, Bool_t*, std::vector<BFitResult_t>&);
+void RunBatch (std::vector<BFitResult_t>&, Int_t);
+Bool_t ReadBMCTruth (const char*, const char*, Double_t*);
+void WriteSummary (std::vector<BFitResult_t>&, const char*);
 
 // MAIN FUNCTION
 int main (int argc, char *argv[]) {
@@ -115,93 +272,91 @@ int main (int argc, char *argv[]) {
 	cout << "Imported " << iNumStructs_BDN << " BDN cases" << endl;
 	iNumStructs_BFit = CSVtoStruct_BFit (csvBFitCases, stBFitCases);
 	cout << "Imported " << iNumStructs_BFit << " BFit cases" << endl;
+// TH1::Fit takes its options in either case; BatchFit() and the rest of BFit2 look for upper case
+	for (Int_t i = 0; i < iNumStructs_BFit; i++)
+		for (char *c = stBFitCases[i].pcsOptions; *c; c++) *c = toupper(*c);
+#ifdef BFIT_THREADS
+	iFitThreads = TMath::Max(1, (Int_t)std::thread::hardware_concurrency());
+#endif
+	if (argc > 1 && !strcmp(argv[1],"--batch")) return BFitBatch(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1],"--global")) return BFitGlobal(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1],"--bench")) return BFitBench(argc-2, argv+2);
+	if (argc > 1 && !strcmp(argv[1],"--binscan")) return BFitBinScan(argc-2, argv+2);
+	if (argc < 3) {
+		cout << "How to run this program:" << endl;
+		cout << "'./BFit2 <BDN case code> <B_fit case code> [--cold] [--profile=<par or integral>,... [--points=<n>]] [--toys=<n> [--bootstrap] [--seed=<n>]]'" << endl;
+		cout << "'./BFit2 --batch [--threads=<n>] <B_fit case code or pattern> ... [--cold] [--profile=...] [--toys=...]'" << endl;
+		cout << "'./BFit2 --global [--threads=<n>] [--shared=<par>,...] <B_fit case code or pattern> ... [--cold]'" << endl;
+		cout << "'./BFit2 --bench [--threads=<n>] [--reference=<file>] [--tolerance=<x>] [<B_fit case code or pattern> ...]'" << endl;
+		cout << "'./BFit2 --binscan [--threads=<n>] [--widths=<ms>,...] <B_fit case code> [--cold]'" << endl << endl;
+		return -1;
+	}
 	iBDNCaseIndex  = FindStructIndex ( stBDNCases,  sizeof(BDNCase_t),  iNumStructs_BDN,  argv[1] );
 	iBFitCaseIndex = FindStructIndex ( stBFitCases, sizeof(BFitCase_t), iNumStructs_BFit, argv[2] );
 	if ( iBDNCaseIndex == -1 || iBFitCaseIndex == -1 )
 	{ // One of the read-ins failed and already printed a message about it
 		cout << "How to run this program:" << endl;
-		cout << "'./BFit <BDN case code> <B_fit case code>'" << endl;
+		cout << "'./BFit2 <BDN case code> <B_fit case code>'" << endl;
+		cout << "'./BFit2 --batch [--threads=<n>] <B_fit case code or pattern> ...'" << endl;
+		cout << "'./BFit2 --global [--threads=<n>] [--shared=<par>,...] <B_fit case code or pattern> ...'" << endl;
 		cout << "where valid case codes are listed in the CSV files." << endl << endl;
 		return -1; // error return
 	}
+	for (Int_t iArg = 3; iArg < argc; iArg++)
+		if (!OptionArg(argv[iArg])) cout << "Ignoring argument " << argv[iArg] << endl;
 	cout << "Performing BFit with BDN case " << stBDNCases[iBDNCaseIndex].pcsCaseCode << " and BFit case " << stBFitCases[iBFitCaseIndex].pcsCaseCode << endl << endl;
-	return BFit(); // return status of BFit
+	return BFit(iBDNCaseIndex, iBFitCaseIndex, "BFit.root", 0); // return status of BFit
 }
 
-int BFit () {
+// Fit one BDN case with one BFit case and write the plots to pcsOutFile.
+// If pstResult is given, the fit results are copied into it for the batch summary.
+int BFit (Int_t iBDN, Int_t iBFit, const char *pcsOutFile, BFitResult_t *pstResult) {
 	
 // Timer for debugging code
 	clock_t timer, timerStart, timerStop;
+	TStopwatch stopwatch;
 	timerStart = clock();
 	cout << "BFit started. Timer = "<< (Float_t)timerStart/CLOCKS_PER_SEC << " sec." << endl;
 	int iReturn = SUCCESS;
 	using namespace BFitNamespace;
 	using namespace TMath;
-	TFile *outfile = new TFile("BFit.root","recreate");
+	TFile *outfile = new TFile(pcsOutFile,"recreate");
 	
 // Local copies of the relevant metadata structs
-	BDNCase_t  stBDNCase = stBDNCases[iBDNCaseIndex];
-	BFitCase_t stBFitCase = stBFitCases[iBFitCaseIndex];
+	BDNCase_t  stBDNCase = stBDNCases[iBDN];
+	BFitCase_t stBFitCase = stBFitCases[iBFit];
 	//printf("Bdn Case index = %d, BFit case index = %d\n", iBDNCaseIndex, iBFitCaseIndex);
 	
-// Assign global variables
-	nPars	= stBFitCase.iNPars;
-	tCap	= 1000.0 * stBDNCase.dCaptureTime;	// Time between BPT captures (ms)
-	tBac	= 1000.0 * stBDNCase.dBackgroundTime; // Time spent in background measurment, per cycle (ms)
-	tCyc	= 1000.0 * stBDNCase.dCycleTime;	// Time between BPT ejections (ms)
-	t1		= 1000.0 * stBDNCase.dLifetime1[0]; // radioactive lifetime (1/e) in ms
-	t2		= 1000.0 * stBDNCase.dLifetime2[0]; // radioactive lifetime (1/e) in ms
-	t3		= 1000.0 * stBDNCase.dLifetime3[0]; // radioactive lifetime (1/e) in ms
-	nCycles	= stBDNCase.nCycles; // Number of cycles in dataset
-	iota	= 1e-9;
-//	printf("          iota = %.4e\n",iota);
-//	printf("          iota = %32.16f\n",iota);
-//	printf("1000000 + iota = %32.16f\n",1000000+iota);
-//	return 0;
-	nCapMax	= Ceil((tCyc-tBac)/tCap);
-	//printf("nCapMax=%d\n",nCapMax);
-// Array to hold injection times
-	timeOfCapt	= new Double_t [nCapMax+1];
-	Int_t k;
-	for (k=0; k<nCapMax+1; k++)
-		timeOfCapt[k] = tBac + k*tCap;
-// Arrays to hold the sigma values in each [index] tooth:
-// Zero index not used (+1 element), for notational consistency
-	sigmaT1	= new Double_t [nCapMax+1];
-	sigmaT2	= new Double_t [nCapMax+1];
-	sigmaT3	= new Double_t [nCapMax+1];
-	sigmaV1	= new Double_t [nCapMax+1];
-	sigmaV2	= new Double_t [nCapMax+1];
-	sigmaV3	= new Double_t [nCapMax+1];
-	sigmaW1	= new Double_t [nCapMax+1];
-	sigmaW2	= new Double_t [nCapMax+1];
-	sigmaW3	= new Double_t [nCapMax+1];
-	sigmaZ1	= new Double_t [nCapMax+1];
-	sigmaZ2	= new Double_t [nCapMax+1];
-	sigmaZ3	= new Double_t [nCapMax+1];
-	sigmaX2	= new Double_t [nCapMax+1];
-	sigmaX3	= new Double_t [nCapMax+1];
-	sigmaY2	= new Double_t [nCapMax+1];
-	sigmaY3	= new Double_t [nCapMax+1];
-	sY2v1	= new Double_t [nCapMax+1];
-	sY2w1	= new Double_t [nCapMax+1];
-	sY2z1	= new Double_t [nCapMax+1];
-	sY3v2	= new Double_t [nCapMax+1];
-	sY3w2	= new Double_t [nCapMax+1];
-	sY3z2	= new Double_t [nCapMax+1];
-	sY3x2	= new Double_t [nCapMax+1];
-	sY3v1	= new Double_t [nCapMax+1];
-	sY3w1	= new Double_t [nCapMax+1];
-	sY3z1	= new Double_t [nCapMax+1];
-	sigmaT1[0] = sigmaT2[0] = sigmaT3[0] = 0.0; // zero index not used -- set to zero for definiteness
-	sigmaV1[0] = sigmaV2[0] = sigmaV3[0] = 0.0; // zero index not used -- set to zero for definiteness
-	sigmaW1[0] = sigmaW2[0] = sigmaW3[0] = 0.0; // zero index not used -- set to zero for definiteness
-	sigmaZ1[0] = sigmaZ2[0] = sigmaZ3[0] = 0.0; // zero index not used -- set to zero for definiteness
-				sigmaX2[0] = sigmaX3[0] = 0.0; // zero index not used -- set to zero for definiteness
-				sigmaY2[0] = sigmaY3[0] = 0.0; // zero index not used -- set to zero for definiteness
-	sY2v1[0]  = sY2w1[0]  = sY2z1[0]  = 0.0; // zero index not used -- set to zero for definiteness
-	sY3v2[0]  = sY3w2[0]  = sY3z2[0]  = sY3x2[0] = 0.0; // zero index not used -- set to zero for definiteness
-	sY3v1[0]  = sY3w1[0]  = sY3z1[0]  = 0.0; // zero index not used -- set to zero for definiteness
+// Integrals of the rates over the cycle, and their errors
+	Double_t T1_integral = 0.0, T2_integral = 0.0, T3_integral = 0.0;
+	Double_t U1_integral = 0.0, U2_integral = 0.0, U3_integral = 0.0;
+	Double_t DC_integral = 0.0, All_integral = 0.0, Integral_sum = 0.0;
+	Double_t U1_integral_trap_empty = 0.0, U2_integral_trap_empty = 0.0, U3_integral_trap_empty = 0.0;
+	Double_t U1_integral_trap_full  = 0.0, U2_integral_trap_full  = 0.0, U3_integral_trap_full  = 0.0;
+	Double_t T1_integral_error = 0.0, T2_integral_error = 0.0, T3_integral_error = 0.0;
+	Double_t U1_integral_error = 0.0, U2_integral_error = 0.0, U3_integral_error = 0.0;
+	Double_t DC_integral_error = 0.0, All_integral_error = 0.0, Integral_sum_error = 0.0;
+	
+// Initial parameter values and initial step sizes
+// err contains initial step sizes now, will contain error estimates later.
+	Int_t		nPars	= stBFitCase.iNPars; // number of model parameters
+	Int_t		nCycles	= stBDNCase.nCycles; // number of cycles in dataset -- don't confuse with parameter index nCyc
+	Int_t		*tog	= stBFitCase.pbToggle;
+	Double_t	*par	= stBFitCase.pdSeed;
+	Double_t	*err	= stBFitCase.pdStep;
+	par[nCyc] = nCycles;
+// Free parameters from the last converged fit like this one, if there was one
+	if (bWarmStart && stBFitCase.bDoFit && ReadWarmStart(&stBDNCase, &stBFitCase, par, err))
+		cout << "Warm start: free parameters from " << pcsWarmStartFile << endl;
+// Model context: cycle times, lifetimes and sigma arrays for this case, and the
+// parameter-dependent variables. InitModelContext() also handles the 134sb special
+// case (gammaT3 = gammaT2), so it has to come right after the param import.
+	ModelContext_t ctx;
+	InitModelContext(&ctx, &stBDNCase, nPars, par);
+	ctx.pbToggle = tog;
+// Model kernels with only the exponentials the free parameters can reach
+	if (stBFitCase.bDoFit) SetActiveExponentials(&ctx, par, tog);
+	Double_t	tCap = ctx.tCap, tBac = ctx.tBac, tCyc = ctx.tCyc; // cycle times (ms)
 // Arrays to hold partial integrals of functions through [index] teeth:
 // Zero index used only as an initializer (+1 element),
 // but don't need an element for the last tooth (-1 element)
@@ -243,6 +398,13 @@ int BFit () {
 // Get histogram from ROOT file
 	TFile *f = new TFile(stBDNCase.pcsFilePath);
 	TH1D *h	= (TH1D*)f->Get(stBFitCase.pcsHistName);
+	if (!h) {
+		cout << "Histogram " << stBFitCase.pcsHistName << " not found in " << stBDNCase.pcsFilePath << endl;
+		FreeModelContext(&ctx);
+		outfile->Close();
+		if (pstResult) pstResult->iReturn = -1;
+		return -1; // error return
+	}
 	Double_t dBinWidth		= stBFitCase.pdSeed[dt];
 	Double_t dNBins			= tCyc/dBinWidth;// # of bins covered by funtion  //h->GetNbinsX();
 	Double_t pointsPerBin	= 20;
@@ -267,33 +429,33 @@ int BFit () {
 // Define functions
 //	Double_t tMax	= 1000.0 * stBDNCase.dCycleTime;
 // Species populations
-	TF1 *fyDC	= new TF1("fyDC", yDC, 0.0, tCyc, nPars);
-	TF1 *fyT1	= new TF1("fyT1", yT1, 0.0, tCyc, nPars);
-	TF1 *fyT2	= new TF1("fyT2", yT2, 0.0, tCyc, nPars);
-	TF1 *fyT3	= new TF1("fyT3", yT3, 0.0, tCyc, nPars);
-	TF1 *fyU1	= new TF1("fyU1", yU1, 0.0, tCyc, nPars);
-	TF1 *fyU2	= new TF1("fyU2", yU2, 0.0, tCyc, nPars);
-	TF1 *fyU3	= new TF1("fyU3", yU3, 0.0, tCyc, nPars);
+	TF1 *fyDC	= new TF1("fyDC", ModelFunctor(&ctx, yDC), 0.0, tCyc, nPars);
+	TF1 *fyT1	= new TF1("fyT1", ModelFunctor(&ctx, yT1), 0.0, tCyc, nPars);
+	TF1 *fyT2	= new TF1("fyT2", ModelFunctor(&ctx, yT2), 0.0, tCyc, nPars);
+	TF1 *fyT3	= new TF1("fyT3", ModelFunctor(&ctx, yT3), 0.0, tCyc, nPars);
+	TF1 *fyU1	= new TF1("fyU1", ModelFunctor(&ctx, yU1), 0.0, tCyc, nPars);
+	TF1 *fyU2	= new TF1("fyU2", ModelFunctor(&ctx, yU2), 0.0, tCyc, nPars);
+	TF1 *fyU3	= new TF1("fyU3", ModelFunctor(&ctx, yU3), 0.0, tCyc, nPars);
 //**************************************************************************
 // This one fits the data:
-	TF1 *fyAll	= new TF1("fyAll",yAll, 0.0, tCyc, nPars);
+	TF1 *fyAll	= new TF1("fyAll", ModelFunctor(&ctx, yAll), 0.0, tCyc, nPars);
 //**************************************************************************
 // Beta rates to be used by TF1::Integral() and TF1::IntegralError()
-	TF1 *frDC	= new TF1("frDC", rDC, 0.0, tCyc, nPars);
-	TF1 *frT1	= new TF1("frT1", rT1, 0.0, tCyc, nPars);
-	TF1 *frT2	= new TF1("frT2", rT2, 0.0, tCyc, nPars);
-	TF1 *frT3	= new TF1("frT3", rT3, 0.0, tCyc, nPars);
-	TF1 *frU1	= new TF1("frU1", rU1, 0.0, tCyc, nPars);
-	TF1 *frU2	= new TF1("frU2", rU2, 0.0, tCyc, nPars);
-	TF1 *frU3	= new TF1("frU3", rU3, 0.0, tCyc, nPars);
-	TF1 *frAll	= new TF1("frAll",rAll, 0.0, tCyc, nPars);
+	TF1 *frDC	= new TF1("frDC", ModelFunctor(&ctx, rDC), 0.0, tCyc, nPars);
+	TF1 *frT1	= new TF1("frT1", ModelFunctor(&ctx, rT1), 0.0, tCyc, nPars);
+	TF1 *frT2	= new TF1("frT2", ModelFunctor(&ctx, rT2), 0.0, tCyc, nPars);
+	TF1 *frT3	= new TF1("frT3", ModelFunctor(&ctx, rT3), 0.0, tCyc, nPars);
+	TF1 *frU1	= new TF1("frU1", ModelFunctor(&ctx, rU1), 0.0, tCyc, nPars);
+	TF1 *frU2	= new TF1("frU2", ModelFunctor(&ctx, rU2), 0.0, tCyc, nPars);
+	TF1 *frU3	= new TF1("frU3", ModelFunctor(&ctx, rU3), 0.0, tCyc, nPars);
+	TF1 *frAll	= new TF1("frAll", ModelFunctor(&ctx, rAll), 0.0, tCyc, nPars);
 // Offset functions for plotting
-	TF1 *foT1	= new TF1("foT1", oT1, 0.0, tCyc, nPars);
-	TF1 *foT2	= new TF1("foT2", oT2, 0.0, tCyc, nPars);
-	TF1 *foT3	= new TF1("foT3", oT3, 0.0, tCyc, nPars);
-	TF1 *foU1	= new TF1("foU1", oU1, 0.0, tCyc, nPars);
-	TF1 *foU2	= new TF1("foU2", oU2, 0.0, tCyc, nPars);
-	TF1 *foU3	= new TF1("foU3", oU3, 0.0, tCyc, nPars);
+	TF1 *foT1	= new TF1("foT1", ModelFunctor(&ctx, oT1), 0.0, tCyc, nPars);
+	TF1 *foT2	= new TF1("foT2", ModelFunctor(&ctx, oT2), 0.0, tCyc, nPars);
+	TF1 *foT3	= new TF1("foT3", ModelFunctor(&ctx, oT3), 0.0, tCyc, nPars);
+	TF1 *foU1	= new TF1("foU1", ModelFunctor(&ctx, oU1), 0.0, tCyc, nPars);
+	TF1 *foU2	= new TF1("foU2", ModelFunctor(&ctx, oU2), 0.0, tCyc, nPars);
+	TF1 *foU3	= new TF1("foU3", ModelFunctor(&ctx, oU3), 0.0, tCyc, nPars);
 // Initiailize function to fit the data
 	char pcsLifetime1ParName[100]; sprintf(pcsLifetime1ParName,"%s radioactive lifetime (1/e)", stBDNCase.pcsSpecies1Name);
 	char pcsLifetime2ParName[100]; sprintf(pcsLifetime2ParName,"%s radioactive lifetime (1/e)", stBDNCase.pcsSpecies2Name);
@@ -323,32 +485,7 @@ int BFit () {
 	fyAll->SetParName(gammaU3,"U3 loss");
 	fyAll->SetParName(dt,"Bin width");
 	
-// Initial parameter values and initial step sizes
-// err contains initial step sizes now, will contain error estimates later.
-	Int_t		*tog;
-	Double_t	*par;
-	Double_t	*err;
-	tog	= stBFitCase.pbToggle;
-	par = stBFitCase.pdSeed;
-	err = stBFitCase.pdStep;
 	Int_t index;
-	par[nCyc] = nCycles;
-// Special cases -- modifications to parameters -- catch right after param import
-	if (!strcmp(stBDNCases[iBDNCaseIndex].pcsCaseCode,"134sb01") ||
-		!strcmp(stBDNCases[iBDNCaseIndex].pcsCaseCode,"134sb02") ||
-		!strcmp(stBDNCases[iBDNCaseIndex].pcsCaseCode,"134sb03") ||
-		!strcmp(stBDNCases[iBDNCaseIndex].pcsCaseCode,"134sb0103"))
-	{
-		b134sbFlag = 1;
-		par[gammaT3] = par[gammaT2];
-	}
-// Initialize global lastPar to values that guarantee computation of parameter-dependent variables in first eval of yAll
-	lastPar	= new Double_t [nPars];
-	memcpy(lastPar,par,nPars*sizeof(Double_t));
-//	printf("\n\n[lastPar = %f, %f, %f, ...]\n\n",lastPar[0],lastPar[1],lastPar[2]);
-//	for (index = 0; index < nPars; index++) lastPar[index] = -1.0;
-// Initialize parameter-dependent variables
-	BFitNamespace::ComputeParameterDependentVars(par);
 // Place initial par values into fitting function
 	fyAll->SetParameters(par);
 	fyAll->SetParErrors(err);
@@ -370,7 +507,7 @@ int BFit () {
 //		par
 //		cout << "134-Sb data detected. Forcing gammaT3 = gammaT2. YOU SHOULD GUARANTEE THAT X3 = Y3 = 0. You can set epsX = epsY = 0." << endl << endl;
 //	}
-	if (b134sbFlag) cout << "134-Sb data detected. Forcing gammaT3 = gammaT2. YOU SHOULD GUARANTEE THAT X3 = Y3 = 0. You can set epsX = epsY = 0." << endl << endl;
+	if (ctx.b134sbFlag) cout << "134-Sb data detected. Forcing gammaT3 = gammaT2. YOU SHOULD GUARANTEE THAT X3 = Y3 = 0. You can set epsX = epsY = 0." << endl << endl;
 	else cout << endl;
 // Initialize all functions to parameter seed values
 	fyDC	-> SetParameters(par);
@@ -400,12 +537,12 @@ int BFit () {
 		for (index = 0; index < nPars; index++) {
 			if (tog[index] == 0) fyAll->FixParameter(index, stBFitCase.pdSeed[index]);
 		}
-		if (b134sbFlag && tog[gammaT2]==0) fyAll->FixParameter(gammaT3, stBFitCase.pdSeed[gammaT2]);
+		if (ctx.b134sbFlag && tog[gammaT2]==0) fyAll->FixParameter(gammaT3, stBFitCase.pdSeed[gammaT2]);
 	// Print initial parameters: (see similar code in yAll() in BFit2Model.cxx)
-		if (nParChanges == 0) {
-			printf("Ini pars (   0): ",nParChanges);
+		if (ctx.nParChanges == 0) {
+			printf("Ini pars (   0): ",ctx.nParChanges);
 			for (index = 0; index < nPars; index++) {
-				if (stBFitCases[iBFitCaseIndex].pbToggle[index]) printf("%s=%.4e ",parNames[index],par[index]);
+				if (tog[index]) printf("%s=%.4e ",parNames[index],par[index]);
 			}
 			printf("\n");
 		}
@@ -414,7 +551,15 @@ int BFit () {
 	//	TVirtualFitter::SetDefaultFitter("Minuit2");
 	//	TVirtualFitter *fitter;
 	//	
-		TFitResultPtr fit = h1->Fit(fyAll,stBFitCase.pcsOptions);
+		TFitResultPtr fit;
+		TStopwatch fitwatch;
+		if (!BatchFitOptions(stBFitCase.pcsOptions)) {
+			BFIT_LOCK;
+			fit = h1->Fit(fyAll,stBFitCase.pcsOptions);
+		}
+		else
+			fit = BatchFit(&ctx,h1,fyAll,&stBFitCase,pstResult ? &pstResult->nEval : 0,pstResult ? &pstResult->nEvalGrad : 0);
+		fitwatch.Stop();
 		timer = clock() - timer;
 		printf("\nFitting done in %d clicks (%f seconds).\n", timer, (Float_t)timer/CLOCKS_PER_SEC);
 		printf("Fit status = %d\n",fit->Status());
@@ -441,8 +586,9 @@ int BFit () {
 		//	printf("%12s err = %f\n", fyAll->GetParName(index), err[index]);
 		}
 	// par is now up to date...
+		if (fit->Status() == 0) SaveWarmStart(&stBDNCase, &stBFitCase, par, covArray);
 	// Set other functions to parameter values from fit
-		BFitNamespace::ComputeParameterDependentVars(par);
+		BFitNamespace::ComputeParameterDependentVars(&ctx, par);
 		fyDC	-> SetParameters(par);
 		fyT1	-> SetParameters(par);
 		fyT2	-> SetParameters(par);
@@ -497,7 +643,7 @@ int BFit () {
 			//	grads[iPar] = frT2->GradientPar(iPar,par,0.0001);
 				printf("%12s val = %f, err = %f\n", fyAll->GetParName(iPar), par[iPar], err[iPar]);
 			}
-			TF1 *fInt	= new TF1("frT2", rT2, 0.0, tCyc, nPars);
+			TF1 *fInt	= new TF1("frT2", ModelFunctor(&ctx, rT2), 0.0, tCyc, nPars);
 			sleep(1.5);
 			Double_t grads[nPars];
 			printf("\n");
@@ -523,26 +669,26 @@ int BFit () {
 		}
 		
 	// Estimate # of betas detected and error
-		T1_integral = frT1->Integral( 0.0, tCyc);
-		T2_integral = frT2->Integral( 0.0, tCyc);
-		T3_integral = frT3->Integral( 0.0, tCyc);
-		U1_integral = frU1->Integral( 0.0, tCyc);
-		U2_integral = frU2->Integral( 0.0, tCyc);
-		U3_integral = frU3->Integral( 0.0, tCyc);
-		DC_integral = frDC->Integral( 0.0, tCyc);
-		All_integral = frAll->Integral( 0.0, tCyc);
+		T1_integral = rIntegral(&ctx, popT1, par, 0.0, tCyc);
+		T2_integral = rIntegral(&ctx, popT2, par, 0.0, tCyc);
+		T3_integral = rIntegral(&ctx, popT3, par, 0.0, tCyc);
+		U1_integral = rIntegral(&ctx, popU1, par, 0.0, tCyc);
+		U2_integral = rIntegral(&ctx, popU2, par, 0.0, tCyc);
+		U3_integral = rIntegral(&ctx, popU3, par, 0.0, tCyc);
+		DC_integral = rIntegral(&ctx, popDC, par, 0.0, tCyc);
+		All_integral = rIntegral(&ctx, popAll, par, 0.0, tCyc);
 		Integral_sum = DC_integral + T1_integral + T2_integral + T3_integral + U1_integral + U2_integral + U3_integral;
 		
 		timer = clock() - timer;
 		printf("\nIntegrals computed in %d clicks (%f seconds).\n", timer, (Float_t)timer/CLOCKS_PER_SEC);
 		
 		if (stBFitCase.bComputeOtherIntegrals) {
-			U1_integral_trap_empty = frU1->Integral( 0.0, tBac);
-			U2_integral_trap_empty = frU2->Integral( 0.0, tBac);
-			U3_integral_trap_empty = frU3->Integral( 0.0, tBac);
-			U1_integral_trap_full  = frU1->Integral( tBac, tCyc);
-			U2_integral_trap_full  = frU2->Integral( tBac, tCyc);
-			U3_integral_trap_full  = frU3->Integral( tBac, tCyc);
+			U1_integral_trap_empty = rIntegral(&ctx, popU1, par, 0.0, tBac);
+			U2_integral_trap_empty = rIntegral(&ctx, popU2, par, 0.0, tBac);
+			U3_integral_trap_empty = rIntegral(&ctx, popU3, par, 0.0, tBac);
+			U1_integral_trap_full  = rIntegral(&ctx, popU1, par, tBac, tCyc);
+			U2_integral_trap_full  = rIntegral(&ctx, popU2, par, tBac, tCyc);
+			U3_integral_trap_full  = rIntegral(&ctx, popU3, par, tBac, tCyc);
 			
 			timer = clock() - timer;
 			printf("Other integrals computed in %d clicks (%f seconds).\n", timer, (Float_t)timer/CLOCKS_PER_SEC);
@@ -557,14 +703,14 @@ int BFit () {
 		
 	//	T2_integral_error = frT2->IntegralError( 0.0, tCyc, par, cov.GetMatrixArray() );
 	//	T1_integral_error = intErr( frT1, covArray, 0.0, tCyc );
-		T1_integral_error = intErr( frT1, covArray, 0.0, tCyc );
-		T2_integral_error = intErr( frT2, covArray, 0.0, tCyc );
-		T3_integral_error = intErr( frT3, covArray, 0.0, tCyc );
-		U1_integral_error = intErr( frU1, covArray, 0.0, tCyc );
-		U2_integral_error = intErr( frU2, covArray, 0.0, tCyc );
-		U3_integral_error = intErr( frU3, covArray, 0.0, tCyc );
-		DC_integral_error = intErr( frDC, covArray, 0.0, tCyc );
-		All_integral_error = intErr( frAll, covArray, 0.0, tCyc );
+		T1_integral_error = IntegralError( &ctx, popT1, par, covArray, 0.0, tCyc );
+		T2_integral_error = IntegralError( &ctx, popT2, par, covArray, 0.0, tCyc );
+		T3_integral_error = IntegralError( &ctx, popT3, par, covArray, 0.0, tCyc );
+		U1_integral_error = IntegralError( &ctx, popU1, par, covArray, 0.0, tCyc );
+		U2_integral_error = IntegralError( &ctx, popU2, par, covArray, 0.0, tCyc );
+		U3_integral_error = IntegralError( &ctx, popU3, par, covArray, 0.0, tCyc );
+		DC_integral_error = IntegralError( &ctx, popDC, par, covArray, 0.0, tCyc );
+		All_integral_error = IntegralError( &ctx, popAll, par, covArray, 0.0, tCyc );
 //		All_integral_error = frAll->IntegralError( 0.0, tCyc, par, cov.GetMatrixArray() );
 //		T3_integral_error = frT3->IntegralError( 0.0, tCyc, par, cov.GetMatrixArray() );
 //		U1_integral_error = frU1->IntegralError( 0.0, tCyc, par, cov.GetMatrixArray() );
@@ -612,9 +758,34 @@ int BFit () {
 		}
 		cout << separator << endl << endl;
 		
+	// Profile-likelihood errors of the chosen parameters and integrals
+		if (pcsProfile[0] && BatchFitOptions(stBFitCase.pcsOptions))
+			ProfileScan(&stBDNCase, h1, fyAll, &stBFitCase, covArray, TString::Format("BFitProfile_%s.txt", stBFitCase.pcsCaseCode));
+	// Toy Monte Carlo or bootstrap refits
+		if (nToys > 0 && BatchFitOptions(stBFitCase.pcsOptions))
+			ToyStudy(&stBDNCase, h1, fyAll, &stBFitCase, TString::Format("BFitToys_%s.txt", stBFitCase.pcsCaseCode));
+		
+		if (pstResult) {
+			Double_t dIntegrals[nIntegrals]      = {T1_integral, T2_integral, T3_integral, U1_integral, U2_integral, U3_integral, DC_integral, All_integral};
+			Double_t dIntegralErrors[nIntegrals] = {T1_integral_error, T2_integral_error, T3_integral_error, U1_integral_error, U2_integral_error, U3_integral_error, DC_integral_error, All_integral_error};
+			pstResult->bFitDone		= kTRUE;
+			pstResult->iFitStatus	= fit->Status();
+			pstResult->iCovStatus	= fit->CovMatrixStatus();
+			pstResult->dChi2		= fit->Chi2();
+			pstResult->iNDF			= fit->Ndf();
+			pstResult->iNCalls		= fit->NCalls();
+			pstResult->dFitTime		= fitwatch.RealTime();
+			memcpy(pstResult->dIntegral,      dIntegrals,      nIntegrals*sizeof(Double_t));
+			memcpy(pstResult->dIntegralError, dIntegralErrors, nIntegrals*sizeof(Double_t));
+		}
 	} // end if (stBFitCase.bDoFit)
+	if (pstResult) {
+		memcpy(pstResult->dPar, par, Min(nPars,nParIndex)*sizeof(Double_t));
+		memcpy(pstResult->dErr, err, Min(nPars,nParIndex)*sizeof(Double_t));
+	}
 	
 // Draw
+	BFIT_LOCK; // held to the end of BFit()
 	Double_t yMin, yMax, yRange;
 	
 	fyAll->SetLineColor(kBlack);
@@ -881,22 +1052,22 @@ int BFit () {
 			TH1D *h_DY2	= (TH1D*)f->Get("h_DY2_cyctime");
 			TH1D *h_DY3	= (TH1D*)f->Get("h_DY3_cyctime");
 			
-			HistPrep(h_DT1,dRebinFactor,dBinWidth,"T");
-			HistPrep(h_DT2,dRebinFactor,dBinWidth,"T");
-			HistPrep(h_DT3,dRebinFactor,dBinWidth,"T");
-			HistPrep(h_DV1,dRebinFactor,dBinWidth,"V");
-			HistPrep(h_DV2,dRebinFactor,dBinWidth,"V");
-			HistPrep(h_DV3,dRebinFactor,dBinWidth,"V");
-			HistPrep(h_DW1,dRebinFactor,dBinWidth,"W");
-			HistPrep(h_DW2,dRebinFactor,dBinWidth,"W");
-			HistPrep(h_DW3,dRebinFactor,dBinWidth,"W");
-			HistPrep(h_DZ1,dRebinFactor,dBinWidth,"Z");
-			HistPrep(h_DZ2,dRebinFactor,dBinWidth,"Z");
-			HistPrep(h_DZ3,dRebinFactor,dBinWidth,"Z");
-			HistPrep(h_DX2,dRebinFactor,dBinWidth,"X");
-			HistPrep(h_DX3,dRebinFactor,dBinWidth,"X");
-			HistPrep(h_DY2,dRebinFactor,dBinWidth,"Y");
-			HistPrep(h_DY3,dRebinFactor,dBinWidth,"Y");
+			HistPrep(h_DT1,dRebinFactor,dBinWidth,"T",tCyc);
+			HistPrep(h_DT2,dRebinFactor,dBinWidth,"T",tCyc);
+			HistPrep(h_DT3,dRebinFactor,dBinWidth,"T",tCyc);
+			HistPrep(h_DV1,dRebinFactor,dBinWidth,"V",tCyc);
+			HistPrep(h_DV2,dRebinFactor,dBinWidth,"V",tCyc);
+			HistPrep(h_DV3,dRebinFactor,dBinWidth,"V",tCyc);
+			HistPrep(h_DW1,dRebinFactor,dBinWidth,"W",tCyc);
+			HistPrep(h_DW2,dRebinFactor,dBinWidth,"W",tCyc);
+			HistPrep(h_DW3,dRebinFactor,dBinWidth,"W",tCyc);
+			HistPrep(h_DZ1,dRebinFactor,dBinWidth,"Z",tCyc);
+			HistPrep(h_DZ2,dRebinFactor,dBinWidth,"Z",tCyc);
+			HistPrep(h_DZ3,dRebinFactor,dBinWidth,"Z",tCyc);
+			HistPrep(h_DX2,dRebinFactor,dBinWidth,"X",tCyc);
+			HistPrep(h_DX3,dRebinFactor,dBinWidth,"X",tCyc);
+			HistPrep(h_DY2,dRebinFactor,dBinWidth,"Y",tCyc);
+			HistPrep(h_DY3,dRebinFactor,dBinWidth,"Y",tCyc);
 			
 /*			h_DV1 ->Rebin(dRebinFactor);
 			h_DV2 ->Rebin(dRebinFactor);
@@ -933,19 +1104,19 @@ int BFit () {
 			h_DU2_1->SetLineColor(kBlack);
 			h_DU3_1->SetLineColor(kBlack);
 			
-			TF1 *fyV1	= new TF1("fyV1", yV1, 0.0, tCyc, nPars);
-			TF1 *fyV2	= new TF1("fyV2", yV2, 0.0, tCyc, nPars);
-			TF1 *fyV3	= new TF1("fyV3", yV3, 0.0, tCyc, nPars);
-			TF1 *fyW1	= new TF1("fyW1", yW1, 0.0, tCyc, nPars);
-			TF1 *fyW2	= new TF1("fyW2", yW2, 0.0, tCyc, nPars);
-			TF1 *fyW3	= new TF1("fyW3", yW3, 0.0, tCyc, nPars);
-			TF1 *fyZ1	= new TF1("fyZ1", yZ1, 0.0, tCyc, nPars);
-			TF1 *fyZ2	= new TF1("fyZ2", yZ2, 0.0, tCyc, nPars);
-			TF1 *fyZ3	= new TF1("fyZ3", yZ3, 0.0, tCyc, nPars);
-			TF1 *fyX2	= new TF1("fyX2", yX2, 0.0, tCyc, nPars);
-			TF1 *fyX3	= new TF1("fyX3", yX3, 0.0, tCyc, nPars);
-			TF1 *fyY2	= new TF1("fyY2", yY2, 0.0, tCyc, nPars);
-			TF1 *fyY3	= new TF1("fyY3", yY3, 0.0, tCyc, nPars);
+			TF1 *fyV1	= new TF1("fyV1", ModelFunctor(&ctx, yV1), 0.0, tCyc, nPars);
+			TF1 *fyV2	= new TF1("fyV2", ModelFunctor(&ctx, yV2), 0.0, tCyc, nPars);
+			TF1 *fyV3	= new TF1("fyV3", ModelFunctor(&ctx, yV3), 0.0, tCyc, nPars);
+			TF1 *fyW1	= new TF1("fyW1", ModelFunctor(&ctx, yW1), 0.0, tCyc, nPars);
+			TF1 *fyW2	= new TF1("fyW2", ModelFunctor(&ctx, yW2), 0.0, tCyc, nPars);
+			TF1 *fyW3	= new TF1("fyW3", ModelFunctor(&ctx, yW3), 0.0, tCyc, nPars);
+			TF1 *fyZ1	= new TF1("fyZ1", ModelFunctor(&ctx, yZ1), 0.0, tCyc, nPars);
+			TF1 *fyZ2	= new TF1("fyZ2", ModelFunctor(&ctx, yZ2), 0.0, tCyc, nPars);
+			TF1 *fyZ3	= new TF1("fyZ3", ModelFunctor(&ctx, yZ3), 0.0, tCyc, nPars);
+			TF1 *fyX2	= new TF1("fyX2", ModelFunctor(&ctx, yX2), 0.0, tCyc, nPars);
+			TF1 *fyX3	= new TF1("fyX3", ModelFunctor(&ctx, yX3), 0.0, tCyc, nPars);
+			TF1 *fyY2	= new TF1("fyY2", ModelFunctor(&ctx, yY2), 0.0, tCyc, nPars);
+			TF1 *fyY3	= new TF1("fyY3", ModelFunctor(&ctx, yY3), 0.0, tCyc, nPars);
 			
 			FuncPrep(fyT1,par,nPoints,kGreen,2);//9);
 			FuncPrep(fyT2,par,nPoints,kBlue,2);//9);
@@ -1190,7 +1361,7 @@ int BFit () {
 			
 			Double_t tval1 = tCyc;
 			Double_t tvaln[1] = {tval1};
-			printf("f(%f) = %f\n", tval1, Ycap(3,par,tval1));
+			printf("f(%f) = %f\n", tval1, Ycap(&ctx,3,par,tval1));
 			//printf("f(%f) = %f\n", tval1, yAll(tvaln,par));
 			
 			// Print Reduced Chi-Square
@@ -1220,11 +1391,544 @@ int BFit () {
 	cout << "BFit2 done. Timer = " << (Float_t)timerStop/CLOCKS_PER_SEC << " sec." << endl;
 	cout << "Elapsed time = " << (Float_t)(timerStop-timerStart)/CLOCKS_PER_SEC << " sec." << endl << endl;
 	
-	delete [] lastPar;
+	FreeModelContext(&ctx);
+	if (pstResult) {
+		pstResult->iReturn		= iReturn;
+		pstResult->dRealTime	= stopwatch.RealTime();
+	}
+	return iReturn;
+}
+
+// Batch mode: fit every BFit case that matches one of the codes or shell patterns
+// in args (eg. 137i* or '*_13'), several at once with --threads=<n>.
+int BFitBatch (int nArgs, char **args) {
+	using namespace std;
+	vector<BFitResult_t> vResults;
+	Int_t nThreads = 1, i, iArg;
+	Bool_t *bChosen = new Bool_t [iNumStructs_BFit];
+	for (i = 0; i < iNumStructs_BFit; i++) bChosen[i] = kFALSE;
+	for (iArg = 0; iArg < nArgs; iArg++) {
+		if (sscanf(args[iArg], "--threads=%d", &nThreads) == 1) continue;
+		if (OptionArg(args[iArg])) continue;
+		AddMatchingCases(args[iArg], bChosen, vResults);
+	}
+	delete [] bChosen;
+	if (vResults.empty()) {
+		cout << "How to run this program:" << endl;
+		cout << "'./BFit2 --batch [--threads=<n>] <B_fit case code or pattern> ...'" << endl;
+		cout << "No BFit case matches; valid case codes are listed in the CSV files." << endl << endl;
+		return -1; // error return
+	}
+	RunBatch(vResults, nThreads);
+	
+	WriteSummary(vResults, "BFitSummary.txt");
+	for (i = 0; i < (Int_t)vResults.size(); i++)
+		if (vResults[i].iReturn != SUCCESS) return -1;
+	return SUCCESS;
+}
+
+// Add every BFit case matching the code or shell pattern, and not chosen yet, to vResults
+// (with its BDN case from FindBDNCaseIndex()), marking it in bChosen[iNumStructs_BFit].
+void AddMatchingCases (const char *pcsPattern, Bool_t *bChosen, std::vector<BFitResult_t> &vResults) {
+	BFitResult_t stResult;
+	Int_t i, iBDN;
+	for (i = 0; i < iNumStructs_BFit; i++) {
+		if (bChosen[i] || fnmatch(pcsPattern, stBFitCases[i].pcsCaseCode, 0)) continue;
+		bChosen[i] = kTRUE;
+		iBDN = FindBDNCaseIndex(stBDNCases, iNumStructs_BDN, stBFitCases[i].pcsCaseCode);
+		if (iBDN == -1) {
+			cout << "No BDN case for BFit case " << stBFitCases[i].pcsCaseCode << "; skipping it." << endl;
+			continue;
+		}
+		memset(&stResult, 0, sizeof(stResult));
+		stResult.iBDNCase	= iBDN;
+		stResult.iBFitCase	= i;
+		stResult.iReturn	= -1;
+		vResults.push_back(stResult);
+	}
+}
+
+// Run BFit() on every case in vResults, nThreads at a time, each writing BFit_<case>.root.
+// iFitThreads is shared out among the fits.
+void RunBatch (std::vector<BFitResult_t> &vResults, Int_t nThreads) {
+	Int_t i, nCases = vResults.size();
+	if (nThreads < 1) nThreads = 1;
+	if (nThreads > nCases) nThreads = nCases;
+	cout << "Fitting " << nCases << " BFit cases on " << nThreads << " thread(s)" << endl << endl;
+	iFitThreads = TMath::Max(1, iFitThreads/nThreads);
+	
+	gROOT->SetBatch(kTRUE);
+#ifdef BFIT_THREADS
+	ROOT::EnableThreadSafety();
+	std::atomic<Int_t> next(0);
+	auto worker = [&] () {
+		Int_t k;
+		while ((k = next++) < nCases) {
+			TString out = TString::Format("BFit_%s.root", stBFitCases[vResults[k].iBFitCase].pcsCaseCode);
+			BFit(vResults[k].iBDNCase, vResults[k].iBFitCase, out.Data(), &vResults[k]);
+		}
+	};
+	vector<std::thread> vPool;
+	for (i = 0; i < nThreads; i++) vPool.push_back(std::thread(worker));
+	for (i = 0; i < nThreads; i++) vPool[i].join();
+#else
+	if (nThreads > 1) printf("ROOT %s can't fit on several threads; fitting one case at a time.\n", ROOT_RELEASE);
+	for (i = 0; i < nCases; i++) {
+		TString out = TString::Format("BFit_%s.root", stBFitCases[vResults[i].iBFitCase].pcsCaseCode);
+		BFit(vResults[i].iBDNCase, vResults[i].iBFitCase, out.Data(), &vResults[i]);
+	}
+#endif
+}
+
+// Parameters the BMC Monte Carlo cases were generated with, as named in BMC_runDescriptions.txt
+const Int_t nTruthPars = 6;
+const char pcsTruthNames[nTruthPars][4] = {"rDC", "r1", "r2", "r3", "p", "rho"};
+const Int_t piTruthPars[nTruthPars] = {BFitNamespace::DC, BFitNamespace::r1, BFitNamespace::r2,
+	BFitNamespace::r3, BFitNamespace::p, BFitNamespace::rho};
+
+// Truth values of pcsCaseCode's generated parameters (DC ... rho, in the fit's units) from
+// the '// BMC_xxxx' block of pcsFileName, to truth[nParIndex]. Returns kFALSE if the block
+// or one of its parameters is missing.
+Bool_t ReadBMCTruth (const char *pcsFileName, const char *pcsCaseCode, Double_t *truth) {
+	ifstream file(pcsFileName);
+	string line;
+	char name[32], block[STRING_SIZE];
+	Double_t value;
+	Bool_t bInBlock = kFALSE, bFound[nTruthPars] = {kFALSE};
+	Int_t j, nFound = 0;
+	while (getline(file, line)) {
+		if (sscanf(line.c_str(), "// %s", block) == 1 && !strncmp(block, "BMC_", 4)) {
+			if (strchr(block, '.')) *strchr(block, '.') = '\0'; // "// BMC_0025.root"
+			bInBlock = !strcmp(block, pcsCaseCode);
+			continue;
+		}
+		if (!bInBlock || sscanf(line.c_str(), " const Double_t %31s = %lf", name, &value) != 2) continue;
+		for (j = 0; j < nTruthPars; j++) {
+			if (strcmp(name, pcsTruthNames[j]) || bFound[j]) continue;
+			truth[piTruthPars[j]] = value;
+			bFound[j] = kTRUE;
+			nFound++;
+		}
+	}
+	return nFound == nTruthPars;
+}
+
+// Benchmark: fit the Monte Carlo cases matching the codes or patterns in args (all BMC_*
+// cases by default) cold, and report the cost of each fit and its pulls from the truth.
+// With --reference=<file>, fail if a parameter moved by more than --tolerance (in errors)
+// from the same case in that earlier BFitBench.txt.
+int BFitBench (int nArgs, char **args) {
+	using namespace std;
+	using namespace BFitNamespace;
+	TString separator = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+	const char pcsTruthFile[] = "BMC_runDescriptions.txt", pcsBenchFile[] = "BFitBench.txt";
+	vector<BFitResult_t> vResults;
+	char pcsReference[STRING_SIZE] = "";
+	Double_t dTolerance = 0.05;
+	Int_t nThreads = 1, nPatterns = 0, i, j, k, iArg;
+	Bool_t *bChosen = new Bool_t [iNumStructs_BFit];
+	for (i = 0; i < iNumStructs_BFit; i++) bChosen[i] = kFALSE;
+	for (iArg = 0; iArg < nArgs; iArg++) {
+		if (sscanf(args[iArg], "--threads=%d", &nThreads) == 1) continue;
+		if (sscanf(args[iArg], "--reference=%s", pcsReference) == 1) continue;
+		if (sscanf(args[iArg], "--tolerance=%lf", &dTolerance) == 1) continue;
+		AddMatchingCases(args[iArg], bChosen, vResults);
+		nPatterns++;
+	}
+	if (!nPatterns) AddMatchingCases("BMC_*", bChosen, vResults);
+	delete [] bChosen;
+	
+// Only cases with a truth block, all fit from the CSV seeds
+	vector<Double_t> vTruth;
+	vector<BFitResult_t> vBench;
+	Double_t truth[nParIndex];
+	for (k = 0; k < (Int_t)vResults.size(); k++) {
+		if (!ReadBMCTruth(pcsTruthFile, stBDNCases[vResults[k].iBDNCase].pcsCaseCode, truth)) {
+			cout << "No truth for BDN case " << stBDNCases[vResults[k].iBDNCase].pcsCaseCode << " in " << pcsTruthFile << "; skipping BFit case " << stBFitCases[vResults[k].iBFitCase].pcsCaseCode << endl;
+			continue;
+		}
+		stBFitCases[vResults[k].iBFitCase].bDoFit = 1;
+		vBench.push_back(vResults[k]);
+		vTruth.insert(vTruth.end(), truth, truth+nParIndex);
+	}
+	if (vBench.empty()) {
+		cout << "How to run this program:" << endl;
+		cout << "'./BFit2 --bench [--threads=<n>] [--reference=<file>] [--tolerance=<x>] [<B_fit case code or pattern> ...]'" << endl;
+		cout << "No Monte Carlo case with truth values in " << pcsTruthFile << " matches." << endl << endl;
+		return -1; // error return
+	}
+	bWarmStart = kFALSE;
+	TStopwatch stopwatch;
+	RunBatch(vBench, nThreads);
+	stopwatch.Stop();
+	
+// Table on screen and in pcsBenchFile
+	Int_t nBench = vBench.size(), iReturn = SUCCESS;
+	Long64_t nEvalTotal = 0, nEvalGradTotal = 0, nCallsTotal = 0;
+	Double_t dFitTimeTotal = 0.0, pull, pullMax;
+	FILE *file = fopen(pcsBenchFile, "w");
+	if (!file) cout << "Can't open " << pcsBenchFile << "; benchmark goes to the screen only." << endl;
+	else {
+		fprintf(file, "BFitCase\tBDNCase\treturn\tfitStatus\tcovStatus\tchi2\tndf\tminuitCalls\tmodelEvals\tgradEvals\tfitTime\trealTime");
+		for (j = 0; j < nTruthPars; j++)
+			fprintf(file, "\t%s\t%s_err\t%s_truth\t%s_pull", parNames[piTruthPars[j]], parNames[piTruthPars[j]], parNames[piTruthPars[j]], parNames[piTruthPars[j]]);
+		fprintf(file, "\n");
+	}
+	cout << endl << separator << endl << "BENCHMARK (" << ROOT_RELEASE << ", " << iFitThreads << " thread(s) per fit)" << endl << separator << endl;
+	printf("%-12s %6s %4s %10s %8s %8s %9s %9s %10s\n", "BFit case", "return", "fit", "chi2/ndf", "calls", "evals", "gradEvals", "fit (s)", "max |pull|");
+	for (k = 0; k < nBench; k++) {
+		BFitResult_t &r = vBench[k];
+		Int_t *tog = stBFitCases[r.iBFitCase].pbToggle;
+		pullMax = 0.0;
+		for (j = 0; j < nTruthPars; j++) {
+			i = piTruthPars[j];
+			if (tog[i] && r.dErr[i] > 0) pullMax = TMath::Max(pullMax, TMath::Abs(r.dPar[i] - vTruth[k*nParIndex+i])/r.dErr[i]);
+		}
+		printf("%-12s %6d %4d %10.4f %8d %8lld %9lld %9.2f %10.2f\n", stBFitCases[r.iBFitCase].pcsCaseCode, r.iReturn, r.iFitStatus,
+			r.iNDF ? r.dChi2/r.iNDF : 0.0, r.iNCalls, r.nEval, r.nEvalGrad, r.dFitTime, pullMax);
+		if (r.iReturn != SUCCESS) iReturn = -1;
+		nCallsTotal += r.iNCalls; nEvalTotal += r.nEval; nEvalGradTotal += r.nEvalGrad; dFitTimeTotal += r.dFitTime;
+		if (!file) continue;
+		fprintf(file, "%s\t%s\t%d\t%d\t%d\t%.8e\t%d\t%d\t%lld\t%lld\t%.3f\t%.3f", stBFitCases[r.iBFitCase].pcsCaseCode, stBDNCases[r.iBDNCase].pcsCaseCode,
+			r.iReturn, r.iFitStatus, r.iCovStatus, r.dChi2, r.iNDF, r.iNCalls, r.nEval, r.nEvalGrad, r.dFitTime, r.dRealTime);
+		for (j = 0; j < nTruthPars; j++) {
+			i = piTruthPars[j];
+			pull = (tog[i] && r.dErr[i] > 0) ? (r.dPar[i] - vTruth[k*nParIndex+i])/r.dErr[i] : 0.0;
+			fprintf(file, "\t%.10e\t%.10e\t%.10e\t%.4f", r.dPar[i], tog[i] ? r.dErr[i] : 0.0, vTruth[k*nParIndex+i], pull);
+		}
+		fprintf(file, "\n");
+	}
+	cout << separator << endl;
+	printf("%d fits: %lld Minuit calls, %lld + %lld model evaluations, %.2f s fitting, %.2f s in all\n",
+		nBench, nCallsTotal, nEvalTotal, nEvalGradTotal, dFitTimeTotal, stopwatch.RealTime());
+	if (file) {
+		fclose(file);
+		cout << "Benchmark written to " << pcsBenchFile << endl;
+	}
+	
+// Compare with an earlier run: every parameter within dTolerance of its error
+	if (!pcsReference[0]) return iReturn;
+	ifstream ref(pcsReference);
+	if (!ref) {
+		cout << "Can't open reference " << pcsReference << endl;
+		return -1;
+	}
+	string line, code;
+	Double_t dRef[nTruthPars][4], shift, shiftMax = 0.0;
+	Int_t nCompared = 0;
+	getline(ref, line); // header
+	while (getline(ref, line)) {
+		istringstream iss(line);
+		string field[12];
+		for (j = 0; j < 12; j++) iss >> field[j];
+		for (j = 0; j < nTruthPars; j++) iss >> dRef[j][0] >> dRef[j][1] >> dRef[j][2] >> dRef[j][3];
+		if (!iss) continue;
+		for (k = 0; k < nBench; k++) if (field[0] == stBFitCases[vBench[k].iBFitCase].pcsCaseCode) break;
+		if (k == nBench) continue;
+		for (j = 0; j < nTruthPars; j++) {
+			i = piTruthPars[j];
+			if (!stBFitCases[vBench[k].iBFitCase].pbToggle[i] || dRef[j][1] <= 0) continue;
+			shift = TMath::Abs(vBench[k].dPar[i] - dRef[j][0])/dRef[j][1];
+			shiftMax = TMath::Max(shiftMax, shift);
+			if (shift > dTolerance) {
+				printf("%s: %s = %.6e moved by %.3f errors from %.6e in %s\n", field[0].c_str(), parNames[i], vBench[k].dPar[i], shift, dRef[j][0], pcsReference);
+				iReturn = -1;
+			}
+		}
+		nCompared++;
+	}
+	printf("Compared %d case(s) with %s: largest shift %.4f errors (tolerance %.4f) -- %s\n",
+		nCompared, pcsReference, shiftMax, dTolerance, iReturn == SUCCESS ? "same results" : "RESULTS CHANGED");
+	return iReturn;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// GlobalChi2Function -- sum of the cases' chi-squares (or chi2_L's) in a global fit, for Minuit2
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class GlobalChi2Function : public ROOT::Math::IMultiGradFunction {
+public:
+	GlobalChi2Function (GlobalFit_t *g) : gf(g) {}
+	ROOT::Math::IMultiGenFunction* Clone () const { return new GlobalChi2Function(gf); }
+	unsigned int NDim () const { return gf->nPars; }
+	void Gradient (const Double_t *par, Double_t *grad) const { GlobalChi2(gf, par, grad); }
+	void FdF (const Double_t *par, Double_t &f, Double_t *grad) const { f = GlobalChi2(gf, par, grad); }
+private:
+	GlobalFit_t *gf;
+	Double_t DoEval (const Double_t *par) const { return GlobalChi2(gf, par, 0); }
+	Double_t DoDerivative (const Double_t *par, unsigned int i) const {
+		vector<Double_t> grad(gf->nPars);
+		GlobalChi2(gf, par, &grad[0]);
+		return grad[i];
+	}
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// GlobalChi2 -- sum over the cases of BatchChi2 (BatchChi2Grad if grad is given) at each
+// case's pars from the global ones. The cases are shared out over the gf->nThreads threads
+// of gf->pool, each case with its own model context; their chi-squares and gradients are
+// added in case order.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void GlobalCaseChi2 (GlobalFit_t *gf, Int_t k, const Double_t *par, Bool_t bGrad) {
+	using namespace BFitNamespace;
+	Int_t j, nPars = gf->fb[k].ctx->nPars;
+	Double_t *casePar = &gf->casePar[k*nParIndex];
+	for (j = 0; j < nPars; j++) casePar[j] = par[gf->slot[k*nParIndex+j]];
+	if (bGrad) gf->caseChi2[k] = BatchChi2Grad(&gf->fb[k], casePar, &gf->caseGrad[k*nParIndex]);
+	else       gf->caseChi2[k] = BatchChi2(&gf->fb[k], casePar);
+}
+
+Double_t GlobalChi2 (GlobalFit_t *gf, const Double_t *par, Double_t *grad) {
+	using namespace BFitNamespace;
+	Double_t chi2 = 0.0;
+	Int_t k, j;
+#ifdef BFIT_THREADS
+	if (gf->pool) gf->pool->Run(gf->nCases, [=] (Int_t kk) { GlobalCaseChi2(gf, kk, par, grad != 0); });
+	else
+#endif
+	for (k = 0; k < gf->nCases; k++) GlobalCaseChi2(gf, k, par, grad != 0);
+	if (grad) for (j = 0; j < gf->nPars; j++) grad[j] = 0.0;
+	for (k = 0; k < gf->nCases; k++) {
+		chi2 += gf->caseChi2[k];
+		if (grad) for (j = 0; j < gf->fb[k].ctx->nPars; j++) grad[gf->slot[k*nParIndex+j]] += gf->caseGrad[k*nParIndex+j];
+	}
+	return chi2;
+}
+
+// Global mode: one fit to the histograms of every BFit case that matches one of the
+// codes or shell patterns in args. The pars named in --shared=<par>,<par>,... are tied
+// across all the cases; the others (and always nCyc and dt) belong to each case.
+// Seeds, steps and toggles of a shared par come from the first case that has it; options
+// I, L and R are each case's own, and E (MINOS) is taken from the first case. Each case's
+// dt must be a whole number of its histogram's bins.
+int BFitGlobal (int nArgs, char **args) {
+	using namespace std;
+	using namespace BFitNamespace;
+	TString separator = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+	vector<Int_t> vBFit, vBDN;
+	Bool_t bShared[nParIndex];
+	Int_t sharedSlot[nParIndex]; // global slot of each shared par, -1 until a case has it
+	Int_t nThreads = iFitThreads, i, j, k, iArg, iBDN, nRebin;
+	char pcsShared[STRING_SIZE] = "r1,r2,r3,p,rho", *pcsPar;
+	Bool_t *bChosen = new Bool_t [iNumStructs_BFit];
+	for (i = 0; i < iNumStructs_BFit; i++) bChosen[i] = kFALSE;
+	for (iArg = 0; iArg < nArgs; iArg++) {
+		if (sscanf(args[iArg], "--threads=%d", &nThreads) == 1) continue;
+		if (!strncmp(args[iArg], "--shared=", 9)) { strncpy(pcsShared, args[iArg]+9, STRING_SIZE-1); continue; }
+		if (OptionArg(args[iArg])) continue;
+		for (i = 0; i < iNumStructs_BFit; i++) {
+			if (bChosen[i] || fnmatch(args[iArg], stBFitCases[i].pcsCaseCode, 0)) continue;
+			bChosen[i] = kTRUE;
+			iBDN = FindBDNCaseIndex(stBDNCases, iNumStructs_BDN, stBFitCases[i].pcsCaseCode);
+			if (iBDN == -1) {
+				cout << "No BDN case for BFit case " << stBFitCases[i].pcsCaseCode << "; skipping it." << endl;
+				continue;
+			}
+			vBFit.push_back(i);
+			vBDN.push_back(iBDN);
+		}
+	}
+	delete [] bChosen;
+	if (vBFit.empty()) {
+		cout << "How to run this program:" << endl;
+		cout << "'./BFit2 --global [--threads=<n>] [--shared=<par>,...] <B_fit case code or pattern> ...'" << endl;
+		cout << "No BFit case matches; valid case codes are listed in the CSV files." << endl << endl;
+		return -1; // error return
+	}
+	for (j = 0; j < nParIndex; j++) {
+		bShared[j] = kFALSE;
+		sharedSlot[j] = -1;
+	}
+	for (pcsPar = strtok(pcsShared, ","); pcsPar; pcsPar = strtok(0, ",")) {
+		for (j = 0; j < nParIndex; j++) if (!strcmp(pcsPar, parNames[j])) break;
+		if (j == nParIndex) cout << "No parameter " << pcsPar << "; not sharing it." << endl;
+		else if (j == nCyc || j == dt) cout << parNames[j] << " belongs to each histogram; not sharing it." << endl;
+		else bShared[j] = kTRUE;
+	}
+	
+// Fit bins and model of each case
+	GlobalFit_t gf;
+	gf.nCases	= vBFit.size();
+	gf.nThreads	= TMath::Max(1, TMath::Min(nThreads, gf.nCases));
+	gf.pool		= 0;
+#ifdef BFIT_THREADS
+	if (gf.nThreads > 1) gf.pool = new FitPool_t(gf.nThreads - 1);
+#endif
+	gf.fb		= new FitBins_t [gf.nCases];
+	gf.slot		= new Int_t [gf.nCases*nParIndex];
+	gf.casePar	= new Double_t [gf.nCases*nParIndex];
+	gf.caseGrad	= new Double_t [gf.nCases*nParIndex];
+	gf.caseChi2	= new Double_t [gf.nCases];
+	ModelContext_t *ctx = new ModelContext_t [gf.nCases];
+	vector<Double_t> vPar, vStep;
+	vector<TString> vName;
+	vector<Bool_t> vFix;
+	Int_t nBins = 0, nCasesRead = 0, iReturn = SUCCESS;
+	iFitThreads = TMath::Max(1, iFitThreads/gf.nThreads);
+	for (k = 0; k < gf.nCases; k++) {
+		BDNCase_t  &stBDNCase  = stBDNCases[vBDN[k]];
+		BFitCase_t &stBFitCase = stBFitCases[vBFit[k]];
+		Int_t nPars = stBFitCase.iNPars, *tog = stBFitCase.pbToggle;
+		Double_t *par = &gf.casePar[k*nParIndex], step[nParIndex];
+		memcpy(par, stBFitCase.pdSeed, nPars*sizeof(Double_t));
+		memcpy(step, stBFitCase.pdStep, nPars*sizeof(Double_t));
+		par[nCyc] = stBDNCase.nCycles;
+		if (bWarmStart && ReadWarmStart(&stBDNCase, &stBFitCase, par, step))
+			cout << "Warm start for " << stBFitCase.pcsCaseCode << " from " << pcsWarmStartFile << endl;
+		InitModelContext(&ctx[k], &stBDNCase, nPars, par);
+		ctx[k].pbToggle = tog;
+		TFile *f = new TFile(stBDNCase.pcsFilePath);
+		TH1D *h = (TH1D*)f->Get(stBFitCase.pcsHistName);
+		if (!h) {
+			cout << "Histogram " << stBFitCase.pcsHistName << " not found in " << stBDNCase.pcsFilePath << endl;
+			delete f;
+			FreeModelContext(&ctx[k]);
+			iReturn = -1;
+			break;
+		}
+		nRebin = TMath::Nint(par[dt]/h->GetBinWidth(1));
+		if (nRebin < 1 || TMath::Abs(nRebin*h->GetBinWidth(1) - par[dt]) > 1e-6*h->GetBinWidth(1)) {
+			cout << "dt = " << par[dt] << " ms for " << stBFitCase.pcsCaseCode << " isn't a whole number of " << h->GetBinWidth(1) << " ms bins" << endl;
+			delete f;
+			FreeModelContext(&ctx[k]);
+			iReturn = -1;
+			break;
+		}
+		Double_t xMin = h->GetXaxis()->GetXmin(), xMax = h->GetXaxis()->GetXmax();
+		if (strchr(stBFitCase.pcsOptions,'R')) { xMin = 0.0; xMax = ctx[k].tCyc; }
+		TH1D *h1 = (TH1D*)h->Rebin(nRebin, TString::Format("%s_%d", stBFitCase.pcsHistName, k));
+		nBins += FillFitBins(&gf.fb[k], &ctx[k], h1, xMin, xMax, stBFitCase.pcsOptions);
+		f->Close();
+		delete f;
+		nCasesRead++;
+	// Global parameters: a shared par gets its slot from the first case that has it
+		for (j = 0; j < nPars; j++) {
+			if (bShared[j] && sharedSlot[j] >= 0) { gf.slot[k*nParIndex+j] = sharedSlot[j]; continue; }
+			gf.slot[k*nParIndex+j] = vPar.size();
+			if (bShared[j]) sharedSlot[j] = vPar.size();
+			vPar.push_back(par[j]);
+			vStep.push_back(step[j]);
+			vFix.push_back(tog[j] == 0 || (j == gammaT3 && ctx[k].b134sbFlag && tog[gammaT2] == 0));
+			if (bShared[j]) vName.push_back(parNames[j]);
+			else vName.push_back(TString::Format("%s_%s", parNames[j], stBFitCase.pcsCaseCode));
+		}
+	// Model kernels for the case's pars as the global fit sets them (shared ones from the first case)
+		Double_t globalPar[nParIndex];
+		Int_t globalTog[nParIndex];
+		for (j = 0; j < nPars; j++) {
+			globalPar[j] = vPar[gf.slot[k*nParIndex+j]];
+			globalTog[j] = !vFix[gf.slot[k*nParIndex+j]];
+		}
+		SetActiveExponentials(&ctx[k], globalPar, globalTog);
+	}
+	
+	Int_t nGlobalPars = gf.nPars = vPar.size();
+	if (iReturn == SUCCESS) {
+		cout << "Fitting " << gf.nCases << " BFit cases together (" << nBins << " bins, " << nGlobalPars << " parameters) on " << gf.nThreads << " thread(s)" << endl;
+		cout << "Shared:";
+		for (j = 0; j < nParIndex; j++) if (bShared[j]) cout << " " << parNames[j];
+		cout << endl << separator << endl;
+		TStopwatch stopwatch;
+		GlobalChi2Function fcn(&gf);
+		ROOT::Fit::Fitter fitter;
+		fitter.Config().SetMinimizer("Minuit2");
+		fitter.Config().SetParamsSettings(nGlobalPars, &vPar[0], &vStep[0]);
+		for (i = 0; i < nGlobalPars; i++) {
+			fitter.Config().ParSettings(i).SetName(vName[i].Data());
+			if (vFix[i]) fitter.Config().ParSettings(i).Fix();
+			else if (vStep[i] <= 0) fitter.Config().ParSettings(i).SetStepSize(vPar[i] ? 0.3*TMath::Abs(vPar[i]) : 0.3);
+		}
+		fitter.Config().SetMinosErrors(strchr(stBFitCases[vBFit[0]].pcsOptions,'E') != 0);
+		fitter.FitFCN(fcn, 0, nBins, true); // no parameter array, so the steps in vStep are kept
+		const ROOT::Fit::FitResult &result = fitter.Result();
+		result.Print(cout, kTRUE);
+		printf("Global fit done in %.1f s: status %d, cov status %d, chi2/ndf = %.2f/%d\n",
+			stopwatch.RealTime(), result.Status(), result.CovMatrixStatus(), result.Chi2(), result.Ndf());
+	// Each case's share of the chi-square at the minimum
+		for (i = 0; i < nGlobalPars; i++) vPar[i] = result.Parameter(i);
+		GlobalChi2(&gf, &vPar[0], 0);
+		
+		FILE *file = fopen("BFitGlobal.txt", "w");
+		if (!file) cout << "Can't open BFitGlobal.txt; results go to the screen only." << endl;
+		else {
+			fprintf(file, "# chi2 = %.6e, ndf = %d, fitStatus = %d, covStatus = %d, shared:", result.Chi2(), result.Ndf(), result.Status(), result.CovMatrixStatus());
+			for (j = 0; j < nParIndex; j++) if (bShared[j]) fprintf(file, " %s", parNames[j]);
+			fprintf(file, "\nBFitCase\tBDNCase\tchi2\tnBins");
+			for (j = 0; j < nParIndex; j++) fprintf(file, "\t%s\t%s_err", parNames[j], parNames[j]);
+			fprintf(file, "\n");
+		}
+		cout << separator << endl;
+		printf("%-16s %-12s %10s %8s\n", "BFit case", "BDN case", "chi2", "bins");
+		for (k = 0; k < gf.nCases; k++) {
+			printf("%-16s %-12s %10.2f %8d\n", stBFitCases[vBFit[k]].pcsCaseCode, stBDNCases[vBDN[k]].pcsCaseCode, gf.caseChi2[k], gf.fb[k].nFitBins);
+			if (!file) continue;
+			fprintf(file, "%s\t%s\t%.6e\t%d", stBFitCases[vBFit[k]].pcsCaseCode, stBDNCases[vBDN[k]].pcsCaseCode, gf.caseChi2[k], gf.fb[k].nFitBins);
+			for (j = 0; j < nParIndex; j++) {
+				if (j < ctx[k].nPars) fprintf(file, "\t%.8e\t%.8e", result.Parameter(gf.slot[k*nParIndex+j]), result.ParError(gf.slot[k*nParIndex+j]));
+				else fprintf(file, "\t0\t0");
+			}
+			fprintf(file, "\n");
+		}
+		cout << separator << endl;
+		if (file) {
+			fclose(file);
+			cout << "Results written to BFitGlobal.txt" << endl;
+		}
+	}
+	
+	for (k = 0; k < nCasesRead; k++) {
+		FreeFitBins(&gf.fb[k]);
+		FreeModelContext(&ctx[k]);
+	}
+	delete [] ctx;
+#ifdef BFIT_THREADS
+	delete gf.pool;
+#endif
+	delete [] gf.fb;
+	delete [] gf.slot;
+	delete [] gf.casePar;
+	delete [] gf.caseGrad;
+	delete [] gf.caseChi2;
 	return iReturn;
 }
 
-void HistPrep (TH1 *h, Int_t rebin, Int_t binWidth, char* pop) {
+// Summary of the batch: a short table on screen, and every parameter, error and integral
+// in pcsFileName (tab separated, one line per case, header first).
+void WriteSummary (std::vector<BFitResult_t> &vResults, const char *pcsFileName) {
+	using namespace BFitNamespace;
+	TString separator = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+	Int_t i, j;
+	FILE *file = fopen(pcsFileName, "w");
+	if (!file) cout << "Can't open " << pcsFileName << "; summary goes to the screen only." << endl;
+	
+	cout << endl << separator << endl << "BATCH SUMMARY" << endl << separator << endl;
+	printf("%-16s %-12s %6s %6s %6s %10s %6s %24s %8s\n", "BFit case", "BDN case", "return", "fit", "cov", "chi2", "ndf", "All integral", "time (s)");
+	for (i = 0; i < (Int_t)vResults.size(); i++) {
+		BFitResult_t &r = vResults[i];
+		printf("%-16s %-12s %6d ", stBFitCases[r.iBFitCase].pcsCaseCode, stBDNCases[r.iBDNCase].pcsCaseCode, r.iReturn);
+		if (r.bFitDone) printf("%6d %6d %10.2f %6d %12.1f +/- %7.1f", r.iFitStatus, r.iCovStatus, r.dChi2, r.iNDF, r.dIntegral[nIntegrals-1], r.dIntegralError[nIntegrals-1]);
+		else            printf("%6s %6s %10s %6s %24s", "-", "-", "-", "-", "not fit");
+		printf(" %8.1f\n", r.dRealTime);
+	}
+	cout << separator << endl;
+	if (!file) return;
+	
+	fprintf(file, "BFitCase\tBDNCase\treturn\tfitStatus\tcovStatus\tchi2\tndf\trealTime");
+	for (j = 0; j < nParIndex; j++) fprintf(file, "\t%s\t%s_err", parNames[j], parNames[j]);
+	for (j = 0; j < nIntegrals; j++) fprintf(file, "\t%s_integral\t%s_integral_err", pcsIntegralNames[j], pcsIntegralNames[j]);
+	fprintf(file, "\n");
+	for (i = 0; i < (Int_t)vResults.size(); i++) {
+		BFitResult_t &r = vResults[i];
+		fprintf(file, "%s\t%s\t%d\t%d\t%d\t%.6e\t%d\t%.2f", stBFitCases[r.iBFitCase].pcsCaseCode, stBDNCases[r.iBDNCase].pcsCaseCode,
+			r.iReturn, r.iFitStatus, r.iCovStatus, r.dChi2, r.iNDF, r.dRealTime);
+		for (j = 0; j < nParIndex; j++) fprintf(file, "\t%.8e\t%.8e", r.dPar[j], r.dErr[j]);
+		for (j = 0; j < nIntegrals; j++) fprintf(file, "\t%.8e\t%.8e", r.dIntegral[j], r.dIntegralError[j]);
+		fprintf(file, "\n");
+	}
+	fclose(file);
+	cout << "Summary written to " << pcsFileName << endl;
+}
+
+void HistPrep (TH1 *h, Int_t rebin, Int_t binWidth, char* pop, Double_t tCyc) {
 	h->Rebin(rebin);
 	h->SetLineColor(kBlack);
 	
@@ -1247,53 +1951,692 @@ void FuncPrep (TF1 *f, Double_t *pars, Int_t nPoints, Int_t color, Int_t style)
 	f->SetLineStyle(style);
 }
 
-Double_t intErr (TF1 *fn, Double_t *cov, Double_t t1, Double_t t2) {
-	using namespace TMath;
-//	extern BFitCase_t stBFitCase;
-	Double_t dp, I0 = 0, I1 = 0, I2 = 0, variance = 0;
-	Double_t *p0, *p1, *p2;
-	Int_t i, j; // param indices
-	Int_t		nPar	= fn->GetNpar();
-				p0		= fn->GetParameters(); // This won't be changed; should be best-fit values
-				p1		= new Double_t [nPar];
-				p2		= new Double_t [nPar];
-	Double_t	step = 1; // Fraction of 1-sigma in parameter to use as parameter step size
-	Double_t	dIdp[nPar]; // to hold gradient of integral wrt each param
-	for (i=0; i<nPar; i++) dIdp[i] = 0; // initialize so we can skip some
-	// Three lines: Update PDV's; Ensure fn params are right; Get integral at best-fit values
-//	BFitNamespace::ComputeParameterDependentVars(p0);
-	I0=fn->Integral(t1,t2,p0);
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// BinScanFit -- fit of one case with the histogram in sums rebinned to sw->dWidth, in the
+// model context of the thread doing it. Starts from the warm-start store's fit at this
+// width if there is one, else from the case seeds. The case itself is not touched: the
+// width goes into a copy of its seeds, which is what the warm-start key is made from.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void BinScanFit (BDNCase_t *pstBDNCase, const BFitCase_t *pstBFitCase, const BinSums_t *sums, BFitNamespace::ModelContext_t *ctx, Int_t nThreads, BinScanWidth_t *sw) {
+	using namespace BFitNamespace;
+	BFitCase_t stBFitCase = *pstBFitCase;
+	Int_t nPars = stBFitCase.iNPars, *tog = stBFitCase.pbToggle, i, j, k;
+	Double_t seed[nParIndex], par[nParIndex], step[nParIndex], cov[nParIndex*nParIndex], xMin, xMax;
+	FitBins_t fb;
+	
+	memcpy(seed, pstBFitCase->pdSeed, nPars*sizeof(Double_t));
+	seed[dt] = sw->dWidth;
+	stBFitCase.pdSeed = seed;
+	memcpy(par, seed, nPars*sizeof(Double_t));
+	memcpy(step, stBFitCase.pdStep, nPars*sizeof(Double_t));
+	par[nCyc] = pstBDNCase->nCycles;
+	sw->bWarm = bWarmStart && ReadWarmStart(pstBDNCase, &stBFitCase, par, step);
+	if (ctx->b134sbFlag) par[gammaT3] = par[gammaT2];
+	SetActiveExponentials(ctx, par, tog);
+	if (strchr(stBFitCase.pcsOptions,'R')) { xMin = 0.0; xMax = ctx->tCyc; }
+	else { xMin = sums->xLow; xMax = sums->xLow + sums->nRaw*sums->width; }
+	sw->nFitBins = FillFitBinsFromSums(&fb, ctx, sums, sw->nRebin, xMin, xMax, stBFitCase.pcsOptions);
+	fb.nThreads = nThreads;
+	
+	BatchChi2Function fcn(&fb);
+	ROOT::Fit::Fitter fitter;
+	fitter.Config().SetMinimizer("Minuit2");
+	fitter.Config().MinimizerOptions().SetPrintLevel(0);
+	fitter.Config().SetParamsSettings(nPars, par, step);
+	for (j = 0; j < nPars; j++) {
+		fitter.Config().ParSettings(j).SetName(parNames[j]);
+		if (tog[j] == 0) fitter.Config().ParSettings(j).Fix();
+		else if (step[j] <= 0) fitter.Config().ParSettings(j).SetStepSize(par[j] ? 0.3*TMath::Abs(par[j]) : 0.3);
+	}
+	if (ctx->b134sbFlag && tog[gammaT2] == 0) fitter.Config().ParSettings(gammaT3).Fix();
+	fitter.FitFCN(fcn, 0, fb.nFitBins, true); // no parameter array, so the steps (the stored errors on a warm start) are kept
+	const ROOT::Fit::FitResult &result = fitter.Result();
+	sw->iNCalls		= result.NCalls();
+	sw->iStatus		= result.Status();
+	sw->iCovStatus	= result.CovMatrixStatus();
+	sw->dChi2		= result.Chi2();
+	sw->iNDF		= result.Ndf();
+	for (j = 0; j < nPars; j++) {
+		sw->dPar[j] = par[j] = result.Parameter(j);
+		sw->dErr[j] = result.ParError(j);
+		for (i = 0; i < nPars; i++) cov[i+j*nPars] = result.CovMatrix(i,j);
+	}
+	for (k = 0; k < nIntegrals; k++) {
+		sw->dInt[k]		= CycleIntegral(ctx, piIntegralPops[k], par);
+		sw->dIntErr[k]	= IntegralError(ctx, piIntegralPops[k], par, cov, 0.0, ctx->tCyc);
+	}
+	if (sw->iStatus == 0) SaveWarmStart(pstBDNCase, &stBFitCase, par, cov);
+	FreeFitBins(&fb);
+}
+
+// Binning-scan mode: one BFit case fit at each bin width in --widths=<ms>,<ms>,... (whole
+// multiples of the raw bin width), the widths shared out among --threads threads. The raw
+// histogram is read once; the fit bins at each width come from its cumulative sums.
+int BFitBinScan (int nArgs, char **args) {
+	using namespace std;
+	using namespace BFitNamespace;
+	TString separator = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+	char pcsWidths[STRING_SIZE] = "1,2,5,10,20,50,100", *pcsWidth, pcsScanFile[STRING_SIZE];
+	Int_t nThreads = iFitThreads, iBFit = -1, iBDN, i, j, k, iArg;
+	for (iArg = 0; iArg < nArgs; iArg++) {
+		if (sscanf(args[iArg], "--threads=%d", &nThreads) == 1) continue;
+		if (!strncmp(args[iArg], "--widths=", 9)) { strncpy(pcsWidths, args[iArg]+9, STRING_SIZE-1); continue; }
+		if (OptionArg(args[iArg])) continue;
+		if (iBFit == -1) iBFit = FindStructIndex(stBFitCases, sizeof(BFitCase_t), iNumStructs_BFit, args[iArg]);
+		else cout << "Ignoring argument " << args[iArg] << endl;
+	}
+	if (iBFit == -1) {
+		cout << "How to run this program:" << endl;
+		cout << "'./BFit2 --binscan [--threads=<n>] [--widths=<ms>,...] <B_fit case code> [--cold]'" << endl << endl;
+		return -1; // error return
+	}
+	iBDN = FindBDNCaseIndex(stBDNCases, iNumStructs_BDN, stBFitCases[iBFit].pcsCaseCode);
+	if (iBDN == -1) {
+		cout << "No BDN case for BFit case " << stBFitCases[iBFit].pcsCaseCode << endl;
+		return -1;
+	}
+	BDNCase_t  &stBDNCase  = stBDNCases[iBDN];
+	BFitCase_t &stBFitCase = stBFitCases[iBFit];
+	Int_t nPars = stBFitCase.iNPars, *tog = stBFitCase.pbToggle;
+	
+// Raw histogram, once, as cumulative sums
+	TFile *f = new TFile(stBDNCase.pcsFilePath);
+	TH1D *h = (TH1D*)f->Get(stBFitCase.pcsHistName);
+	if (!h) {
+		cout << "Histogram " << stBFitCase.pcsHistName << " not found in " << stBDNCase.pcsFilePath << endl;
+		delete f;
+		return -1;
+	}
+	BinSums_t sums;
+	sums.nRaw	= h->GetNbinsX();
+	sums.xLow	= h->GetXaxis()->GetXmin();
+	sums.width	= h->GetBinWidth(1);
+	sums.sumY.assign(sums.nRaw+1, 0.0);
+	sums.sumE2.assign(sums.nRaw+1, 0.0);
+	for (i = 1; i <= sums.nRaw; i++) {
+		sums.sumY[i]	= sums.sumY[i-1]  + h->GetBinContent(i);
+		sums.sumE2[i]	= sums.sumE2[i-1] + h->GetBinError(i)*h->GetBinError(i);
+	}
+	f->Close();
+	delete f;
 	
-	// Loop over params and get derivative of integral wrt each param
-	for (i=0; i<nPar; i++) {
-		if (cov[i+i*nPar]>0) {// skip fixed params, which have cov(i,i) = 0
-			dp = step * Sqrt(cov[i+i*nPar]); // Parameter step size = step * (sigma of i^th param)
-			memcpy(p1,p0,nPar*sizeof(Double_t)); // Initialize p1
-			memcpy(p2,p0,nPar*sizeof(Double_t)); // Initialize p2
-			p1[i] = p0[i] - 0.5*dp; // p1: change i^th param by -dp/2
-			p2[i] = p0[i] + 0.5*dp; // p2: change i^th param by +dp/2
-			// Get integrals for + and - changes:
-			BFitNamespace::ComputeParameterDependentVars(p1);
-			I1 = fn->Integral(t1,t2,p1);
-			BFitNamespace::ComputeParameterDependentVars(p2);
-			I2 = fn->Integral(t1,t2,p2);
-			// Get derivative from finite difference about central value
-			dIdp[i] = (I2-I1) / dp;
-		//	printf("par %2d:  dp=%.4e, p0=%+.4e, p1=%+.4e, p2=%+.4e, I0=%.6e, I1=%.6e, I2=%.6e, dIdp=%+.6e\n", i, dp, p0[i], p1[i], p2[i], I0, I1, I2, dIdp[i]);
-		//	for (j=0; j<nPar; j++)
-		//		printf("p0[%d]=%+.4e, p1[%d]=%+.4e, p2[%d]=%+.4e\n", j, p0[j], j, p1[j], j, p2[j]);
+// Widths to fit: whole multiples of the raw bin width, no coarser than the histogram
+	vector<BinScanWidth_t> vWidths;
+	for (pcsWidth = strtok(pcsWidths, ","); pcsWidth; pcsWidth = strtok(0, ",")) {
+		BinScanWidth_t sw;
+		sw.dWidth = atof(pcsWidth);
+		sw.nRebin = TMath::Nint(sw.dWidth/sums.width);
+		if (sw.nRebin < 1 || sw.nRebin > sums.nRaw || TMath::Abs(sw.nRebin*sums.width - sw.dWidth) > 1e-6*sums.width) {
+			cout << "Bin width " << pcsWidth << " ms isn't a whole number of " << sums.width << " ms bins; skipping it." << endl;
+			continue;
 		}
+		vWidths.push_back(sw);
 	}
-	// Now get variances:
-	for (i=0; i<nPar; i++) {
-		if (cov[i+i*nPar]>0) { // skip fixed params, which have cov(i,i) = 0
-			for (j=i; j<nPar; j++) {
-				if (i==j)	variance +=     dIdp[i] * dIdp[j] * cov[i+j*nPar]; // Update variance --     diagonal elements
-				else		variance += 2 * dIdp[i] * dIdp[j] * cov[i+j*nPar]; // Update variance -- off-diagonal elements
-			}
+	Int_t nWidths = vWidths.size();
+	if (nWidths == 0) {
+		cout << "No bin widths to fit." << endl;
+		return -1;
+	}
+	
+// Each thread fits its share of the widths in one model context of its own, so the
+// parameter-dependent vars of one fit are the starting point of the next
+	Int_t nWorkers = TMath::Max(1, TMath::Min(nThreads, nWidths));
+	Int_t nBinThreads = TMath::Max(1, nThreads/nWorkers);
+	vector<ModelContext_t*> vCtx;
+	for (i = 0; i < nWorkers; i++) {
+		Double_t par[nParIndex];
+		memcpy(par, stBFitCase.pdSeed, nPars*sizeof(Double_t));
+		par[nCyc] = stBDNCase.nCycles;
+		ModelContext_t *ctx = new ModelContext_t;
+		InitModelContext(ctx, &stBDNCase, nPars, par);
+		ctx->pbToggle = tog;
+		vCtx.push_back(ctx);
+	}
+	cout << "Fitting " << stBFitCase.pcsCaseCode << " (" << stBDNCase.pcsCaseCode << ") at " << nWidths << " bin widths on "
+		<< nWorkers << " thread(s)" << endl << separator << endl;
+	TStopwatch stopwatch;
+#ifdef BFIT_THREADS
+	ROOT::EnableThreadSafety();
+	std::atomic<Int_t> next(0);
+	auto worker = [&] (ModelContext_t *ctx) {
+		Int_t w;
+		while ((w = next++) < nWidths) BinScanFit(&stBDNCase, &stBFitCase, &sums, ctx, nBinThreads, &vWidths[w]);
+	};
+	vector<std::thread> vPool;
+	for (i = 0; i < nWorkers; i++) vPool.push_back(std::thread(worker, vCtx[i]));
+	for (i = 0; i < nWorkers; i++) vPool[i].join();
+#else
+	for (i = 0; i < nWidths; i++) BinScanFit(&stBDNCase, &stBFitCase, &sums, vCtx[0], nBinThreads, &vWidths[i]);
+#endif
+	stopwatch.Stop();
+	
+// Parameters vs bin width
+	cout << separator << endl << "BINNING SCAN: " << stBFitCase.pcsCaseCode << ", " << nWidths << " widths in " << stopwatch.RealTime() << " s" << endl << separator << endl;
+	printf("%8s %6s %4s %5s %6s %10s", "dt (ms)", "bins", "fit", "start", "calls", "chi2/ndf");
+	for (j = 0; j < nPars; j++) if (tog[j]) printf(" %24s", parNames[j]);
+	printf("\n");
+	for (i = 0; i < nWidths; i++) {
+		BinScanWidth_t &sw = vWidths[i];
+		printf("%8g %6d %4d %5s %6d %10.4f", sw.dWidth, sw.nFitBins, sw.iStatus, sw.bWarm ? "warm" : "cold", sw.iNCalls, sw.iNDF ? sw.dChi2/sw.iNDF : 0.0);
+		for (j = 0; j < nPars; j++) if (tog[j]) printf(" %11.4e +/- %9.2e", sw.dPar[j], sw.dErr[j]);
+		printf("\n");
+	}
+	cout << separator << endl;
+	snprintf(pcsScanFile, STRING_SIZE, "BFitBinScan_%s.txt", stBFitCase.pcsCaseCode);
+	FILE *file = fopen(pcsScanFile, "w");
+	if (!file) cout << "Can't open " << pcsScanFile << "; results go to the screen only." << endl;
+	else {
+		fprintf(file, "dt\tnRebin\tnBins\tfitStatus\tcovStatus\twarm\tnCalls\tchi2\tndf");
+		for (j = 0; j < nPars; j++) fprintf(file, "\t%s\t%s_err", parNames[j], parNames[j]);
+		for (k = 0; k < nIntegrals; k++) fprintf(file, "\t%s_integral\t%s_integral_err", pcsIntegralNames[k], pcsIntegralNames[k]);
+		fprintf(file, "\n");
+		for (i = 0; i < nWidths; i++) {
+			BinScanWidth_t &sw = vWidths[i];
+			fprintf(file, "%g\t%d\t%d\t%d\t%d\t%d\t%d\t%.8e\t%d", sw.dWidth, sw.nRebin, sw.nFitBins, sw.iStatus, sw.iCovStatus, sw.bWarm ? 1 : 0, sw.iNCalls, sw.dChi2, sw.iNDF);
+			for (j = 0; j < nPars; j++) fprintf(file, "\t%.8e\t%.8e", sw.dPar[j], tog[j] ? sw.dErr[j] : 0.0);
+			for (k = 0; k < nIntegrals; k++) fprintf(file, "\t%.8e\t%.8e", sw.dInt[k], sw.dIntErr[k]);
+			fprintf(file, "\n");
+		}
+		fclose(file);
+		cout << "Results written to " << pcsScanFile << endl;
+	}
+	for (i = 0; i < nWorkers; i++) {
+		FreeModelContext(vCtx[i]);
+		delete vCtx[i];
+	}
+	return SUCCESS;
+}
+
+// Options after the case codes: --cold, --profile=<par or integral>,..., --points=<n>,
+// --toys=<n>, --bootstrap and --seed=<n>.
+// Returns kFALSE if arg is none of them.
+Bool_t OptionArg (const char *arg) {
+	if (!strcmp(arg, "--cold")) {
+		bWarmStart = kFALSE;
+		return kTRUE;
+	}
+	if (!strncmp(arg, "--profile=", 10)) {
+		strncpy(pcsProfile, arg+10, STRING_SIZE-1);
+		return kTRUE;
+	}
+	if (sscanf(arg, "--points=%d", &nProfilePoints) == 1) {
+		nProfilePoints = TMath::Max(2, TMath::Min(nProfilePoints, nMaxProfilePoints));
+		return kTRUE;
+	}
+	if (sscanf(arg, "--toys=%d", &nToys) == 1) return kTRUE;
+	if (sscanf(arg, "--seed=%u", &iToySeed) == 1) return kTRUE;
+	if (!strcmp(arg, "--bootstrap")) {
+		bBootstrap = kTRUE;
+		return kTRUE;
+	}
+	return kFALSE;
+}
+
+// Warm-start store. BFitWarmStart.txt has one line per fit: the key (BDN case, BFit case,
+// toggles as a string of 0s and 1s, bin width), then nPars, the nPars parameters and the
+// nPars x nPars covariance, tab separated. A later fit with the same key replaces the line.
+// The store is read and rewritten under BFIT_LOCK, since batch fits finish at any time.
+TString WarmStartKey (const BDNCase_t *pstBDNCase, const BFitCase_t *pstBFitCase) {
+	using namespace BFitNamespace;
+	TString key = TString::Format("%s\t%s\t", pstBDNCase->pcsCaseCode, pstBFitCase->pcsCaseCode);
+	for (Int_t j = 0; j < pstBFitCase->iNPars; j++) key += pstBFitCase->pbToggle[j] ? "1" : "0";
+	key += TString::Format("\t%.6g", pstBFitCase->pdSeed[dt]);
+	return key;
+}
+
+// Free parameters of the stored fit for this case into par, and their errors into step.
+// Returns kFALSE (par and step untouched) if there is none.
+Bool_t ReadWarmStart (const BDNCase_t *pstBDNCase, const BFitCase_t *pstBFitCase, Double_t *par, Double_t *step) {
+	using namespace std;
+	Int_t j, nPars = pstBFitCase->iNPars, nStored;
+	TString key = WarmStartKey(pstBDNCase, pstBFitCase);
+	string line;
+	vector<Double_t> vPar, vCov;
+	BFIT_LOCK;
+	ifstream in(pcsWarmStartFile);
+	while (getline(in, line)) {
+		if (line.compare(0, key.Length(), key.Data()) || line[key.Length()] != '\t') continue;
+		istringstream fields(line.substr(key.Length()+1));
+		if (!(fields >> nStored) || nStored != nPars) continue;
+		vPar.resize(nPars);
+		vCov.resize(nPars*nPars);
+		for (j = 0; j < nPars; j++) fields >> vPar[j];
+		for (j = 0; j < nPars*nPars; j++) fields >> vCov[j];
+		if (fields.fail()) { vPar.clear(); continue; }
+	}
+	if (vPar.empty()) return kFALSE;
+	for (j = 0; j < nPars; j++) {
+		if (!pstBFitCase->pbToggle[j] || j == BFitNamespace::nCyc) continue;
+		par[j] = vPar[j];
+		if (vCov[j*nPars+j] > 0) step[j] = TMath::Sqrt(vCov[j*nPars+j]);
+	}
+	return kTRUE;
+}
+
+// Store par and cov (nPars x nPars) as the warm start for this case
+void SaveWarmStart (const BDNCase_t *pstBDNCase, const BFitCase_t *pstBFitCase, const Double_t *par, const Double_t *cov) {
+	using namespace std;
+	Int_t j, nPars = pstBFitCase->iNPars;
+	TString key = WarmStartKey(pstBDNCase, pstBFitCase);
+	string line;
+	vector<string> vLines;
+	BFIT_LOCK;
+	ifstream in(pcsWarmStartFile);
+	while (getline(in, line))
+		if (line.compare(0, key.Length(), key.Data()) || line[key.Length()] != '\t') vLines.push_back(line);
+	in.close();
+	ostringstream out;
+	out.precision(12);
+	out << key.Data() << '\t' << nPars;
+	for (j = 0; j < nPars; j++) out << '\t' << par[j];
+	for (j = 0; j < nPars*nPars; j++) out << '\t' << cov[j];
+	vLines.push_back(out.str());
+	TString tmp = TString::Format("%s.tmp", pcsWarmStartFile);
+	ofstream file(tmp.Data());
+	for (j = 0; j < (Int_t)vLines.size(); j++) file << vLines[j] << '\n';
+	file.close();
+	if (file.fail() || rename(tmp.Data(), pcsWarmStartFile)) cout << "Can't write " << pcsWarmStartFile << "; this fit isn't stored." << endl;
+}
+
+// Number of betas detected over the cycle from the pops in pops (what frT1->Integral(0, tCyc) is for popT1)
+Double_t CycleIntegral (BFitNamespace::ModelContext_t *ctx, Int_t pops, Double_t *a) {
+	BFitNamespace::UpdateParameterDependentVars(ctx, a);
+	return BFitNamespace::rIntegral(ctx, pops, a, 0.0, ctx->tCyc);
+}
+
+// Chi-square of the fit bins (BatchChi2, or BatchChi2Grad if grad is given) plus, if pops
+// is set, the penalty ((CycleIntegral - target)/width)^2 that holds the integral at target
+Double_t ProfileChi2 (FitBins_t *fb, Int_t pops, Double_t target, Double_t width, const Double_t *par, Double_t *grad) {
+	Double_t chi2 = grad ? BatchChi2Grad(fb, par, grad) : BatchChi2(fb, par);
+	if (!pops) return chi2;
+	Double_t dI[BFitNamespace::nParIndex], r;
+	if (grad) {
+		r = (BFitNamespace::rIntegralGradient(fb->ctx, pops, fb->fitPar, 0.0, fb->ctx->tCyc, dI) - target)/width;
+		for (Int_t j = 0; j < fb->ctx->nPars; j++) grad[j] += 2.0*r/width*dI[j];
+	}
+	else r = (CycleIntegral(fb->ctx, pops, fb->fitPar) - target)/width;
+	return chi2 + r*r;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ProfileChi2Function -- ProfileChi2 with its gradient, for Minuit2
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class ProfileChi2Function : public ROOT::Math::IMultiGradFunction {
+public:
+	ProfileChi2Function (FitBins_t *b, Int_t p, Double_t q, Double_t w) : fb(b), pops(p), target(q), width(w) {}
+	ROOT::Math::IMultiGenFunction* Clone () const { return new ProfileChi2Function(fb, pops, target, width); }
+	unsigned int NDim () const { return fb->ctx->nPars; }
+	void Gradient (const Double_t *par, Double_t *grad) const { ProfileChi2(fb, pops, target, width, par, grad); }
+	void FdF (const Double_t *par, Double_t &f, Double_t *grad) const { f = ProfileChi2(fb, pops, target, width, par, grad); }
+private:
+	FitBins_t *fb;
+	Int_t pops;
+	Double_t target, width;
+	Double_t DoEval (const Double_t *par) const { return ProfileChi2(fb, pops, target, width, par, 0); }
+	Double_t DoDerivative (const Double_t *par, unsigned int i) const {
+		Double_t grad[BFitNamespace::nParIndex];
+		ProfileChi2(fb, pops, target, width, par, grad);
+		return grad[i];
+	}
+};
+
+// One side of a profile: refit at each grid point with the quantity held there, starting
+// from the previous point's parameters with the best fit's errors (stepBest) as steps,
+// until the chi-square is 4 above chi2Min
+static void RunProfileScan (ProfileScan_t *ps, BFitCase_t *pstBFitCase, const Double_t *parBest, const Double_t *stepBest, Double_t qBest, Double_t chi2Min) {
+	using namespace BFitNamespace;
+	Int_t i, j, nPars = ps->ctx.nPars;
+	Double_t start[nParIndex], target;
+	memcpy(start, parBest, nPars*sizeof(Double_t));
+	for (i = 0; i < nProfilePoints; i++) {
+		target = qBest + ps->iDir*(i+1)*ps->step;
+		if (ps->jPar >= 0) start[ps->jPar] = target;
+		ProfileChi2Function fcn(&ps->fb, ps->pops, target, ps->width);
+		ROOT::Fit::Fitter fitter;
+		fitter.Config().SetMinimizer("Minuit2");
+		fitter.Config().MinimizerOptions().SetPrintLevel(0);
+		fitter.Config().SetParamsSettings(nPars, start, stepBest);
+		for (j = 0; j < nPars; j++)
+			if (pstBFitCase->pbToggle[j] == 0 || j == ps->jPar) fitter.Config().ParSettings(j).Fix();
+		if (ps->ctx.b134sbFlag && pstBFitCase->pbToggle[gammaT2] == 0) fitter.Config().ParSettings(gammaT3).Fix();
+		fitter.FitFCN(fcn, 0, ps->fb.nFitBins, true); // no parameter array, so the steps are kept
+		const ROOT::Fit::FitResult &result = fitter.Result();
+		for (j = 0; j < nPars; j++) start[j] = result.Parameter(j);
+		ps->dChi2[i]	= BatchChi2(&ps->fb, start) - chi2Min;
+		ps->q[i]		= (ps->jPar >= 0) ? start[ps->jPar] : CycleIntegral(&ps->ctx, ps->pops, ps->fb.fitPar);
+		ps->status[i]	= result.Status();
+		ps->nPoints		= i+1;
+		if (ps->dChi2[i] > 4.0) break;
+	}
+}
+
+// Where one side of a profile crosses chi2Min + 1, interpolating linearly in sqrt(dChi2)
+// (linear in q for a parabolic chi-square). Returns kFALSE if the scan never got there.
+static Bool_t ProfileCrossing (const ProfileScan_t *ps, Double_t qBest, Double_t &qCross) {
+	Double_t qPrev = qBest, sPrev = 0.0, s;
+	for (Int_t i = 0; i < ps->nPoints; i++) {
+		s = TMath::Sqrt(TMath::Max(ps->dChi2[i], 0.0));
+		if (s >= 1.0) {
+			qCross = qPrev + (1.0 - sPrev)/(s - sPrev)*(ps->q[i] - qPrev);
+			return kTRUE;
+		}
+		qPrev = ps->q[i];
+		sPrev = s;
+	}
+	return kFALSE;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ProfileScan -- profile-likelihood errors of the parameters and integrals named in pcsProfile,
+// for the fit of fn to h (fn holds the best fit, cov its covariance, nPars x nPars).
+// Parameters are named as in parNames, integrals as in pcsIntegralNames (T1, U1, ..., All,
+// with or without _integral). Each quantity is scanned from the best fit over nProfilePoints
+// steps of 3 sigma/nProfilePoints (parabolic sigma) each way, on up to iFitThreads threads.
+// Prints the errors and writes every grid point to pcsFile.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void ProfileScan (BDNCase_t *pstBDNCase, TH1 *h, TF1 *fn, BFitCase_t *pstBFitCase, Double_t *cov, const char *pcsFile) {
+	using namespace BFitNamespace;
+	TString separator = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+	Int_t nPars = pstBFitCase->iNPars, *tog = pstBFitCase->pbToggle, i, j, k, jPar, pops;
+	Double_t parBest[nParIndex], stepBest[nParIndex], xMin, xMax, sigma, chi2Min;
+	char pcsList[STRING_SIZE], *pcsName;
+	vector<TString> vName;
+	vector<Double_t> vBest, vSigma;
+	vector<ProfileScan_t*> vScans;
+	
+	if (strchr(pstBFitCase->pcsOptions,'R')) fn->GetRange(xMin,xMax);
+	else { xMin = h->GetXaxis()->GetXmin(); xMax = h->GetXaxis()->GetXmax(); }
+	memcpy(parBest, fn->GetParameters(), nPars*sizeof(Double_t));
+	for (j = 0; j < nPars; j++) stepBest[j] = (fn->GetParError(j) > 0) ? fn->GetParError(j) : pstBFitCase->pdStep[j];
+// The best fit's chi-square, from the same FCN the scans use
+	ModelContext_t ctx;
+	FitBins_t fb;
+	InitModelContext(&ctx, pstBDNCase, nPars, parBest);
+	SetActiveExponentials(&ctx, parBest, tog);
+	FillFitBins(&fb, &ctx, h, xMin, xMax, pstBFitCase->pcsOptions);
+	chi2Min = BatchChi2(&fb, parBest);
+	
+	strncpy(pcsList, pcsProfile, STRING_SIZE);
+	for (pcsName = strtok(pcsList, ","); pcsName; pcsName = strtok(0, ",")) {
+		jPar = -1;
+		pops = 0;
+		for (j = 0; j < nPars; j++) if (!strcmp(pcsName, parNames[j])) jPar = j;
+		for (k = 0; k < nIntegrals; k++)
+			if (!strcmp(pcsName, pcsIntegralNames[k]) || !strcmp(pcsName, TString::Format("%s_integral", pcsIntegralNames[k]).Data())) pops = piIntegralPops[k];
+		if (jPar >= 0) {
+			if (!tog[jPar]) { cout << "Parameter " << pcsName << " is fixed; not profiling it." << endl; continue; }
+			vBest.push_back(parBest[jPar]);
+			sigma = TMath::Sqrt(cov[jPar*nPars+jPar]);
+		}
+		else if (pops) {
+			vBest.push_back(CycleIntegral(&ctx, pops, fb.fitPar));
+			sigma = IntegralError(&ctx, pops, fb.fitPar, cov, 0.0, ctx.tCyc);
+		}
+		else { cout << "No parameter or integral " << pcsName << "; not profiling it." << endl; continue; }
+		if (!(sigma > 0.0)) { cout << "No parabolic error for " << pcsName << "; not profiling it." << endl; vBest.pop_back(); continue; }
+		vName.push_back(pcsName);
+		vSigma.push_back(sigma);
+		for (k = -1; k <= 1; k += 2) {
+			ProfileScan_t *ps = new ProfileScan_t;
+			ps->jPar	= jPar;
+			ps->pops	= pops;
+			ps->iDir	= k;
+			ps->step	= 3.0*sigma/nProfilePoints;
+			ps->width	= 1e-3*sigma;
+			ps->nPoints	= 0;
+			InitModelContext(&ps->ctx, pstBDNCase, nPars, parBest);
+			SetActiveExponentials(&ps->ctx, parBest, tog);
+			FillFitBins(&ps->fb, &ps->ctx, h, xMin, xMax, pstBFitCase->pcsOptions);
+			ps->fb.nThreads = 1;
+			vScans.push_back(ps);
+		}
+	}
+	FreeFitBins(&fb);
+	FreeModelContext(&ctx);
+	Int_t nScans = vScans.size();
+	if (nScans == 0) return;
+	
+	Int_t nThreads = TMath::Max(1, TMath::Min(iFitThreads, nScans));
+	cout << "Profiling " << nScans/2 << " quantities (" << nScans << " scans of up to " << nProfilePoints << " points) on " << nThreads << " thread(s)" << endl;
+	TStopwatch stopwatch;
+#ifdef BFIT_THREADS
+	ROOT::EnableThreadSafety();
+	std::atomic<Int_t> next(0);
+	auto worker = [&] () {
+		Int_t s;
+		while ((s = next++) < nScans) RunProfileScan(vScans[s], pstBFitCase, parBest, stepBest, vBest[s/2], chi2Min);
+	};
+	vector<std::thread> vPool;
+	for (i = 0; i < nThreads; i++) vPool.push_back(std::thread(worker));
+	for (i = 0; i < nThreads; i++) vPool[i].join();
+#else
+	for (i = 0; i < nScans; i++) RunProfileScan(vScans[i], pstBFitCase, parBest, stepBest, vBest[i/2], chi2Min);
+#endif
+	
+	Double_t qLo, qHi;
+	Bool_t bLo, bHi;
+	FILE *file = fopen(pcsFile, "w");
+	if (!file) cout << "Can't open " << pcsFile << "; profile points go nowhere." << endl;
+	else fprintf(file, "quantity\tq\tdChi2\tstatus\n");
+	cout << separator << endl << "PROFILE-LIKELIHOOD ERRORS (chi2 rises by 1), " << stopwatch.RealTime() << " s" << endl << separator << endl;
+	printf("%-12s %14s %12s %12s %12s\n", "Quantity", "Best", "Parabolic", "Minus", "Plus");
+	for (k = 0; k < (Int_t)vName.size(); k++) {
+		bLo = ProfileCrossing(vScans[2*k],   vBest[k], qLo);
+		bHi = ProfileCrossing(vScans[2*k+1], vBest[k], qHi);
+		printf("%-12s %14.6e %12.4e ", vName[k].Data(), vBest[k], vSigma[k]);
+		if (bLo) printf("%12.4e ", qLo - vBest[k]); else printf("%12s ", "not reached");
+		if (bHi) printf("%12.4e\n", qHi - vBest[k]); else printf("%12s\n", "not reached");
+		if (!file) continue;
+		fprintf(file, "%s\t%.8e\t%.6e\t%d\n", vName[k].Data(), vBest[k], 0.0, 0);
+		for (i = 0; i < 2; i++) {
+			ProfileScan_t *ps = vScans[2*k+i];
+			for (j = 0; j < ps->nPoints; j++) fprintf(file, "%s\t%.8e\t%.6e\t%d\n", vName[k].Data(), ps->q[j], ps->dChi2[j], ps->status[j]);
+		}
+	}
+	cout << separator << endl;
+	if (file) {
+		fclose(file);
+		cout << "Profile points written to " << pcsFile << endl;
+	}
+	for (i = 0; i < nScans; i++) {
+		FreeFitBins(&vScans[i]->fb);
+		FreeModelContext(&vScans[i]->ctx);
+		delete vScans[i];
+	}
+}
+
+// One worker of a toy study: its own model context and fit bins, refilled for each toy
+struct ToyWorker_t {
+	BFitNamespace::ModelContext_t ctx;
+	FitBins_t	fb;
+};
+
+// Results of a toy study, toy by toy
+struct ToyStudy_t {
+	Int_t		nPars;
+	const FitBins_t	*pfbData; // the data's fit bins; the toys redraw their contents
+	const Double_t	*pMean; // Poisson mean of each bin: best-fit model, or data (bootstrap)
+	const Double_t	*parBest, *step;
+	BFitCase_t	*pstBFitCase;
+	std::vector<Int_t>		vStatus;
+	std::vector<Double_t>	vPar, vErr; // nParIndex per toy
+	std::vector<Double_t>	vInt, vIntErr; // nIntegrals per toy
+};
+
+// Toy iToy: redraw the bins with seed iToySeed + iToy, refit from the best fit, and keep the
+// parameters, errors and cycle integrals. Chi-square fits drop the bins that come up empty,
+// as TH1::Fit would, and take sqrt(n) as the error of the rest.
+static void RunToy (ToyStudy_t *ts, ToyWorker_t *tw, Int_t iToy) {
+	using namespace BFitNamespace;
+	const FitBins_t *fd = ts->pfbData;
+	FitBins_t *fb = &tw->fb;
+	Int_t i, j, k, nPars = ts->nPars, n;
+	Double_t par[nParIndex], cov[nParIndex*nParIndex];
+	TRandom3 rng(iToySeed + iToy);
+	fb->nFitBins = 0;
+	for (i = 0; i < fd->nFitBins; i++) {
+		n = rng.Poisson(TMath::Max(ts->pMean[i], 0.0));
+		if (!fb->bFitPoisson && n <= 0) continue;
+		k = fb->nFitBins++;
+		fb->fitBinT[k]	= fd->fitBinT[i];
+		fb->fitBinLo[k]	= fd->fitBinLo[i];
+		fb->fitBinHi[k]	= fd->fitBinHi[i];
+		fb->fitBinY[k]	= n;
+		fb->fitBinE[k]	= TMath::Sqrt((Double_t)n);
+	}
+	BatchChi2Function fcn(fb);
+	ROOT::Fit::Fitter fitter;
+	fitter.Config().SetMinimizer("Minuit2");
+	fitter.Config().MinimizerOptions().SetPrintLevel(0);
+	fitter.Config().SetParamsSettings(nPars, ts->parBest, ts->step);
+	for (j = 0; j < nPars; j++)
+		if (ts->pstBFitCase->pbToggle[j] == 0) fitter.Config().ParSettings(j).Fix();
+	if (tw->ctx.b134sbFlag && ts->pstBFitCase->pbToggle[gammaT2] == 0) fitter.Config().ParSettings(gammaT3).Fix();
+	fitter.FitFCN(fcn, 0, fb->nFitBins, true); // no parameter array, so the steps (the best fit's errors) are kept
+	const ROOT::Fit::FitResult &result = fitter.Result();
+	for (j = 0; j < nPars; j++) {
+		par[j] = result.Parameter(j);
+		ts->vPar[iToy*nParIndex+j] = par[j];
+		ts->vErr[iToy*nParIndex+j] = result.ParError(j);
+		for (i = 0; i < nPars; i++) cov[i+j*nPars] = result.CovMatrix(i,j);
+	}
+	ts->vStatus[iToy] = result.Status();
+	for (k = 0; k < nIntegrals; k++) {
+		ts->vInt[iToy*nIntegrals+k]		= CycleIntegral(&tw->ctx, piIntegralPops[k], par);
+		ts->vIntErr[iToy*nIntegrals+k]	= IntegralError(&tw->ctx, piIntegralPops[k], par, cov, 0.0, tw->ctx.tCyc);
+	}
+}
+
+// Mean, spread, mean error and pulls of one quantity over the converged toys, on screen
+static void ToySummaryLine (const char *pcsName, Double_t truth, const ToyStudy_t *ts, const std::vector<Double_t> &vX, const std::vector<Double_t> &vE, Int_t nPer, Int_t j) {
+	Double_t sx = 0.0, sxx = 0.0, se = 0.0, sp = 0.0, spp = 0.0, x, pull;
+	Int_t i, n = 0;
+	for (i = 0; i < (Int_t)ts->vStatus.size(); i++) {
+		if (ts->vStatus[i] != 0 || !(vE[i*nPer+j] > 0.0)) continue;
+		x = vX[i*nPer+j];
+		pull = (x - truth)/vE[i*nPer+j];
+		sx += x; sxx += x*x; se += vE[i*nPer+j]; sp += pull; spp += pull*pull;
+		n++;
+	}
+	if (n < 2) { printf("%-12s %14.6e %14s\n", pcsName, truth, "too few toys"); return; }
+	Double_t mean = sx/n, rms = TMath::Sqrt(TMath::Max(sxx/n - mean*mean, 0.0)*n/(n-1));
+	Double_t pMean = sp/n, pRms = TMath::Sqrt(TMath::Max(spp/n - pMean*pMean, 0.0)*n/(n-1));
+	printf("%-12s %14.6e %14.6e %11.3e %11.3e %11.3e %8.3f +/- %5.3f %8.3f +/- %5.3f\n", pcsName, truth, mean, mean - truth, rms, se/n,
+		pMean, pRms/TMath::Sqrt((Double_t)n), pRms, pRms/TMath::Sqrt(2.0*(n-1)));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ToyStudy -- nToys refits of the fit of fn to h (fn holds the best fit) with the bins
+// redrawn about the best-fit model, or about the data with bBootstrap. The toys live in
+// memory only and are fit on up to iFitThreads threads. Prints the bias and pulls of the
+// free parameters and the cycle integrals, and writes every toy to pcsFile.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void ToyStudy (BDNCase_t *pstBDNCase, TH1 *h, TF1 *fn, BFitCase_t *pstBFitCase, const char *pcsFile) {
+	using namespace BFitNamespace;
+	TString separator = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+	Int_t nPars = pstBFitCase->iNPars, *tog = pstBFitCase->pbToggle, i, j, k;
+	Double_t parBest[nParIndex], step[nParIndex], intBest[nIntegrals], xMin, xMax;
+	
+	if (strchr(pstBFitCase->pcsOptions,'R')) fn->GetRange(xMin,xMax);
+	else { xMin = h->GetXaxis()->GetXmin(); xMax = h->GetXaxis()->GetXmax(); }
+	memcpy(parBest, fn->GetParameters(), nPars*sizeof(Double_t));
+	for (j = 0; j < nPars; j++) step[j] = (fn->GetParErrors()[j] > 0.0) ? fn->GetParErrors()[j] : pstBFitCase->pdStep[j];
+// The data's fit bins and the best-fit model in them
+	ModelContext_t ctx;
+	FitBins_t fbData;
+	InitModelContext(&ctx, pstBDNCase, nPars, parBest);
+	SetActiveExponentials(&ctx, parBest, tog);
+	FillFitBins(&fbData, &ctx, h, xMin, xMax, pstBFitCase->pcsOptions);
+	BatchChi2(&fbData, parBest);
+	for (k = 0; k < nIntegrals; k++) intBest[k] = CycleIntegral(&ctx, piIntegralPops[k], fbData.fitPar);
+	
+	ToyStudy_t ts;
+	ts.nPars		= nPars;
+	ts.pfbData		= &fbData;
+	ts.pMean		= bBootstrap ? fbData.fitBinY : fbData.fitBinModel;
+	ts.parBest		= parBest;
+	ts.step			= step;
+	ts.pstBFitCase	= pstBFitCase;
+	ts.vStatus.assign(nToys, -1);
+	ts.vPar.assign(nToys*nParIndex, 0.0);
+	ts.vErr.assign(nToys*nParIndex, 0.0);
+	ts.vInt.assign(nToys*nIntegrals, 0.0);
+	ts.vIntErr.assign(nToys*nIntegrals, 0.0);
+	
+	Int_t nThreads = TMath::Max(1, TMath::Min(iFitThreads, nToys));
+	vector<ToyWorker_t*> vWorkers;
+	for (i = 0; i < nThreads; i++) {
+		ToyWorker_t *tw = new ToyWorker_t;
+		InitModelContext(&tw->ctx, pstBDNCase, nPars, parBest);
+		SetActiveExponentials(&tw->ctx, parBest, tog);
+		FillFitBins(&tw->fb, &tw->ctx, h, xMin, xMax, pstBFitCase->pcsOptions);
+		tw->fb.nThreads = 1;
+		vWorkers.push_back(tw);
+	}
+	cout << "Fitting " << nToys << (bBootstrap ? " bootstrap" : " toy Monte Carlo") << " histograms (seeds " << iToySeed << " ... "
+		<< iToySeed + nToys - 1 << ") on " << nThreads << " thread(s)" << endl;
+	TStopwatch stopwatch;
+#ifdef BFIT_THREADS
+	ROOT::EnableThreadSafety();
+	std::atomic<Int_t> next(0);
+	auto worker = [&] (ToyWorker_t *tw) {
+		Int_t t;
+		while ((t = next++) < nToys) RunToy(&ts, tw, t);
+	};
+	vector<std::thread> vPool;
+	for (i = 0; i < nThreads; i++) vPool.push_back(std::thread(worker, vWorkers[i]));
+	for (i = 0; i < nThreads; i++) vPool[i].join();
+#else
+	for (i = 0; i < nToys; i++) RunToy(&ts, vWorkers[0], i);
+#endif
+	stopwatch.Stop();
+	
+	Int_t nGood = 0;
+	for (i = 0; i < nToys; i++) if (ts.vStatus[i] == 0) nGood++;
+	cout << separator << endl << (bBootstrap ? "BOOTSTRAP" : "TOY MONTE CARLO") << ": " << nGood << " of " << nToys
+		<< " fits converged, " << stopwatch.RealTime() << " s; pull = (toy - best fit)/toy error" << endl << separator << endl;
+	printf("%-12s %14s %14s %11s %11s %11s %17s %17s\n", "Quantity", "Best fit", "Toy mean", "Bias", "Toy RMS", "Mean error", "Pull mean", "Pull width");
+	for (j = 0; j < nPars; j++)
+		if (tog[j] && j != nCyc) ToySummaryLine(parNames[j], parBest[j], &ts, ts.vPar, ts.vErr, nParIndex, j);
+	for (k = 0; k < nIntegrals; k++)
+		ToySummaryLine(TString::Format("%s_integral", pcsIntegralNames[k]).Data(), intBest[k], &ts, ts.vInt, ts.vIntErr, nIntegrals, k);
+	cout << separator << endl;
+	
+	FILE *file = fopen(pcsFile, "w");
+	if (!file) cout << "Can't open " << pcsFile << "; toys go nowhere." << endl;
+	else {
+		fprintf(file, "toy\tseed\tstatus");
+		for (j = 0; j < nPars; j++) if (tog[j]) fprintf(file, "\t%s\t%s_err", parNames[j], parNames[j]);
+		for (k = 0; k < nIntegrals; k++) fprintf(file, "\t%s_integral\t%s_integral_err", pcsIntegralNames[k], pcsIntegralNames[k]);
+		fprintf(file, "\n");
+		for (i = 0; i < nToys; i++) {
+			fprintf(file, "%d\t%u\t%d", i, iToySeed + i, ts.vStatus[i]);
+			for (j = 0; j < nPars; j++) if (tog[j]) fprintf(file, "\t%.8e\t%.8e", ts.vPar[i*nParIndex+j], ts.vErr[i*nParIndex+j]);
+			for (k = 0; k < nIntegrals; k++) fprintf(file, "\t%.8e\t%.8e", ts.vInt[i*nIntegrals+k], ts.vIntErr[i*nIntegrals+k]);
+			fprintf(file, "\n");
 		}
+		fclose(file);
+		cout << "Toys written to " << pcsFile << endl;
 	}
-	return Sqrt(variance);
+	for (i = 0; i < nThreads; i++) {
+		FreeFitBins(&vWorkers[i]->fb);
+		FreeModelContext(&vWorkers[i]->ctx);
+		delete vWorkers[i];
+	}
+	FreeFitBins(&fbData);
+	FreeModelContext(&ctx);
+}
+
+// Error of the integral of the flagged pops from t1 to t2 at the best-fit pars, from
+// the exact gradient of the integral and the fit covariance cov (nPars x nPars; fixed
+// pars have zero rows, so they drop out): sigma^2 = sum_ij dI/dp_i cov_ij dI/dp_j
+Double_t IntegralError (BFitNamespace::ModelContext_t *ctx, Int_t pops, Double_t *par, Double_t *cov, Double_t t1, Double_t t2) {
+	Double_t dIdp[BFitNamespace::nParIndex], variance = 0.0;
+	Int_t i, j, nPar = ctx->nPars;
+	BFitNamespace::rIntegralGradient(ctx, pops, par, t1, t2, dIdp);
+	for (i = 0; i < nPar; i++)
+		for (j = 0; j < nPar; j++) variance += dIdp[i] * cov[i+j*nPar] * dIdp[j];
+	return TMath::Sqrt(TMath::Max(variance, 0.0));
 }
 
 //int find_struct_index (void *p, char* pcsSearchString, int numStructs, int struct_size ) {
@@ -0,0 +1,258 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// BFit2Batch
+// 2015-05-14
+//
+// Whole-histogram evaluation of yAll. The fitter asks for the model at every bin
+// centre, and yAll() fans each point out into Ttot, Vtot, ..., Ytot for three species,
+// each recomputing the tooth number n and its own exponentials (~50 Exp's per point).
+//
+// Within capture tooth n every population is a sum of the same six exponentials
+// exp(-tn/tT1), ..., exp(-tn/tU3) in tn = t - tBac - (n-1)*tCap, and the background
+// parts are sums of exp(-t/tU1), exp(-t/tU2), exp(-t/tU3). So yAllBatch() collects the
+// amplitudes, sigmas, efficiencies and lifetimes of all populations into six
+// coefficients per tooth (once per run of points in the same tooth) and three
+// background coefficients (once per call), and the per-point work is nine Exp's in
+// branch-free loops over the run. The result is the same as yAll() point by point.
+//
+// 2015-06-10: many cases have species or populations that can't contribute (a rate or an
+// efficiency fixed at zero), so their exponentials are zero in every tooth. The loops are
+// a template on the set of exponentials that can be nonzero (SetActiveExponentials(), at
+// the start of a fit), and yAllBatch() runs the one compiled for the fit's set.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "BFit2Model.h"
+#include "TMath.h"
+#include <iostream>
+using namespace std;
+
+static const Int_t nBatchChunk = 256; // max points per pass of the exponential loops
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// BatchKernel -- yAllBatch for the exponentials in mask only (ExpFlag bits). The mask is a
+// template argument, so each kernel is compiled with just its own Exp loops and terms.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+namespace BFitNamespace {
+template <Int_t mask>
+static void BatchKernel (ModelContext_t *ctx, Int_t nPts, const Double_t *t, Double_t *a, Double_t *y) {
+	using namespace TMath;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tCyc = ctx->tCyc, t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3;
+	Double_t ampT1 = ctx->ampT1, ampT2 = ctx->ampT2, ampT3 = ctx->ampT3, *sigmaT1 = ctx->sigmaT1, *sigmaT2 = ctx->sigmaT2, *sigmaT3 = ctx->sigmaT3;
+	Double_t tau[6] = { ctx->tT1, ctx->tT2, ctx->tT3, ctx->tU1, ctx->tU2, ctx->tU3 };
+	Double_t c[6], bk[3], s;
+	Double_t tn[nBatchChunk], e[6][nBatchChunk];
+	Int_t j, k, k0, k1, n;
+
+// DC and background parts (0 <= t <= tCyc)
+	BackgroundCoefficients(ctx, a, bk);
+	for (k0 = 0; k0 < nPts; k0 = k1) {
+		k1 = Min(nPts, k0 + nBatchChunk);
+		for (j = 0; j < 3; j++)
+			if (mask & (expU1 << j))
+				for (k = k0; k < k1; k++)
+					e[j][k-k0] = Exp(-t[k]/tau[3+j]);
+		for (k = k0; k < k1; k++) {
+			y[k] = a[nCyc]*a[DC];
+			if ((mask & (expU1|expU2|expU3)) && 0 <= t[k] && t[k] <= tCyc) {
+				s = 0.0;
+				if (mask & expU1) s += bk[0]*e[0][k-k0];
+				if (mask & expU2) s += bk[1]*e[1][k-k0];
+				if (mask & expU3) s += bk[2]*e[2][k-k0];
+				y[k] += s;
+			}
+		}
+	}
+
+// Capture parts (tBac <= t <= tCyc), one run of points in the same tooth at a time
+	for (k0 = 0; k0 < nPts; k0 = k1) {
+		k1 = k0 + 1;
+		if (t[k0] < tBac || t[k0] > tCyc) continue;
+		if (t[k0] == tBac) { // only the T pops are nonzero here, with n=1 (see Ttot)
+			y[k0] += a[nCyc]*a[epsT] * ( ampT1*sigmaT1[1]/t1 + ampT2*sigmaT2[1]/t2 + ampT3*sigmaT3[1]/t3 );
+			continue;
+		}
+		n = Ceil((t[k0]-tBac)/tCap);
+		while (k1 < nPts && k1-k0 < nBatchChunk && tBac < t[k1] && t[k1] <= tCyc && Ceil((t[k1]-tBac)/tCap) == n) k1++;
+		ToothCoefficients(ctx, a, n, c);
+		for (k = k0; k < k1; k++)
+			tn[k-k0] = t[k] - tBac - (n-1)*tCap;
+		for (j = 0; j < 6; j++)
+			if (mask & (1 << j))
+				for (k = 0; k < k1-k0; k++)
+					e[j][k] = Exp(-tn[k]/tau[j]);
+		for (k = k0; k < k1; k++) {
+			s = 0.0;
+			if (mask & expT1) s += c[0]*e[0][k-k0];
+			if (mask & expT2) s += c[1]*e[1][k-k0];
+			if (mask & expT3) s += c[2]*e[2][k-k0];
+			if (mask & expU1) s += c[3]*e[3][k-k0];
+			if (mask & expU2) s += c[4]*e[4][k-k0];
+			if (mask & expU3) s += c[5]*e[5][k-k0];
+			y[k] += s;
+		}
+	}
+
+	for (k = 0; k < nPts; k++) y[k] *= a[dt];
+}
+
+// Table of the 64 kernels, indexed by mask, filled by instantiating BatchKernel<mask> for
+// mask = expAll ... 0
+typedef void (*BatchKernel_t) (ModelContext_t*, Int_t, const Double_t*, Double_t*, Double_t*);
+template <Int_t mask> struct BatchKernelTable {
+	static void Fill (BatchKernel_t *table) {
+		table[mask] = BatchKernel<mask>;
+		BatchKernelTable<mask-1>::Fill(table);
+	}
+};
+template <> struct BatchKernelTable<-1> {
+	static void Fill (BatchKernel_t*) {}
+};
+static BatchKernel_t *BatchKernels () {
+	static BatchKernel_t table[expAll+1];
+	static bool bFilled = (BatchKernelTable<expAll>::Fill(table), true);
+	(void)bFilled;
+	return table;
+}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// yAllBatch -- yAll at nPts times t[], written to y[]
+// Points in the same tooth should be contiguous (eg. sorted) to get the benefit.
+// Runs the kernel for ctx->activeExp, which leaves out the exponentials that are zero.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::yAllBatch (ModelContext_t *ctx, Int_t nPts, const Double_t *t, Double_t *a, Double_t *y) {
+	using namespace BFitNamespace;
+	UpdateParameterDependentVars(ctx, a);
+	BatchKernels()[ctx->activeExp & expAll](ctx, nPts, t, a, y);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// SetActiveExponentials -- ctx->activeExp = the exponentials that some population can put
+// a nonzero term on, given that the parameters with tog[j] == 0 stay at par[j]. A rate r_s or
+// an efficiency fixed at zero switches off the populations it feeds:
+//   T_s: eT_s (r_s, epsT)          V_s, W_s: eU_s (r_s, epsU*epsV or epsW)   Z_s: eT_s, eU_s (r_s)
+//   X2:  eT1, eU2 (r1, epsU*epsX)  X3: eT2, eU3 (r2)
+//   Y2:  eT1, eU1, eU2 (r1, epsU*epsY)      Y3: eT1, eU1 ... eU3 (r1) and eT2, eU2, eU3 (r2)
+// Leaving an exponential out only drops terms that are exactly zero, so yAllBatch() is
+// unchanged; the only derivatives that change are those wrt the fixed parameters.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::SetActiveExponentials (ModelContext_t *ctx, const Double_t *par, const Int_t *tog) {
+	using namespace BFitNamespace;
+	Bool_t bLive[nParIndex];
+	Int_t j, mask = 0;
+	for (j = 0; j < nParIndex; j++) bLive[j] = (j >= ctx->nPars) || tog[j] || par[j] != 0.0;
+	Bool_t bR[3] = { bLive[r1], bLive[r2], bLive[r3] };
+	Bool_t bT = bLive[epsT], bU = bLive[epsU];
+	Bool_t bV = bU && bLive[epsV], bW = bU && bLive[epsW], bZ = bU && bLive[epsZ], bX = bU && bLive[epsX], bY = bU && bLive[epsY];
+	for (j = 0; j < 3; j++) {
+		if (!bR[j]) continue;
+		if (bT) mask |= expT1 << j;
+		if (bV || bW) mask |= expU1 << j;
+		if (bZ) mask |= (expT1 | expU1) << j;
+	}
+	if (bX && bR[0]) mask |= expT1 | expU2;
+	if (bX && bR[1]) mask |= expT2 | expU3;
+	if (bY && bR[0]) mask |= expT1 | expU1 | expU2 | expU3; // Y2, and Y3 fed from species 1
+	if (bY && bR[1]) mask |= expT2 | expU2 | expU3; // Y3 fed from species 2
+	ctx->activeExp = mask;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ToothCoefficients -- detection rate in tooth n = c[0]*eT1 + c[1]*eT2 + c[2]*eT3 + c[3]*eU1 + c[4]*eU2 + c[5]*eU3
+// where eT1 = Exp(-tn/tT1) etc. Collects the capture parts of rT1 ... rU3 (see Ttot ... Ycap)
+// for the populations flagged in pops.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::ToothCoefficients (ModelContext_t *ctx, Double_t *a, Int_t n, Double_t *c, Int_t pops) {
+	using namespace BFitNamespace;
+	Double_t t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3;
+	Double_t tU1U2 = ctx->tU1U2, tT1U2 = ctx->tT1U2, tU2U3 = ctx->tU2U3, tT2U3 = ctx->tT2U3, tU1U3 = ctx->tU1U3, tT1U3 = ctx->tT1U3;
+	Double_t ampT1 = ctx->ampT1, ampT2 = ctx->ampT2, ampT3 = ctx->ampT3, ampV1 = ctx->ampV1, ampV2 = ctx->ampV2, ampV3 = ctx->ampV3;
+	Double_t ampW1 = ctx->ampW1, ampW2 = ctx->ampW2, ampW3 = ctx->ampW3, ampZ1 = ctx->ampZ1, ampZ2 = ctx->ampZ2, ampZ3 = ctx->ampZ3, ampX2 = ctx->ampX2, ampX3 = ctx->ampX3;
+	Double_t *sigmaT1 = ctx->sigmaT1, *sigmaT2 = ctx->sigmaT2, *sigmaT3 = ctx->sigmaT3, *sigmaV1 = ctx->sigmaV1, *sigmaV2 = ctx->sigmaV2, *sigmaV3 = ctx->sigmaV3;
+	Double_t *sigmaW1 = ctx->sigmaW1, *sigmaW2 = ctx->sigmaW2, *sigmaW3 = ctx->sigmaW3, *sigmaZ1 = ctx->sigmaZ1, *sigmaZ2 = ctx->sigmaZ2, *sigmaZ3 = ctx->sigmaZ3;
+	Double_t *sigmaX2 = ctx->sigmaX2, *sigmaX3 = ctx->sigmaX3, *sigmaY2 = ctx->sigmaY2, *sigmaY3 = ctx->sigmaY3, *sY2v1 = ctx->sY2v1, *sY2w1 = ctx->sY2w1, *sY2z1 = ctx->sY2z1;
+	Double_t kT1, kT2, kT3, kV1, kV2, kV3, kW1, kW2, kW3, kZ1, kZ2, kZ3, kX2, kX3, kY2, kY3; // efficiencies of flagged pops
+	Double_t A1, A2, B1, qU1, qU2, qT1, qT2;
+	enum { T1, T2, T3, U1, U2, U3 };
+	kT1 = (pops & popT1) ? a[nCyc]*a[epsT] : 0.0;
+	kT2 = (pops & popT2) ? a[nCyc]*a[epsT] : 0.0;
+	kT3 = (pops & popT3) ? a[nCyc]*a[epsT] : 0.0;
+	kV1 = (pops & popV1) ? a[nCyc]*a[epsU]*a[epsV] : 0.0;
+	kV2 = (pops & popV2) ? a[nCyc]*a[epsU]*a[epsV] : 0.0;
+	kV3 = (pops & popV3) ? a[nCyc]*a[epsU]*a[epsV] : 0.0;
+	kW1 = (pops & popW1) ? a[nCyc]*a[epsU]*a[epsW] : 0.0;
+	kW2 = (pops & popW2) ? a[nCyc]*a[epsU]*a[epsW] : 0.0;
+	kW3 = (pops & popW3) ? a[nCyc]*a[epsU]*a[epsW] : 0.0;
+	kZ1 = (pops & popZ1) ? a[nCyc]*a[epsU]*a[epsZ] : 0.0;
+	kZ2 = (pops & popZ2) ? a[nCyc]*a[epsU]*a[epsZ] : 0.0;
+	kZ3 = (pops & popZ3) ? a[nCyc]*a[epsU]*a[epsZ] : 0.0;
+	kX2 = (pops & popX2) ? a[nCyc]*a[epsU]*a[epsX] : 0.0;
+	kX3 = (pops & popX3) ? a[nCyc]*a[epsU]*a[epsX] : 0.0;
+	kY2 = (pops & popY2) ? a[nCyc]*a[epsU]*a[epsY] : 0.0;
+	kY3 = (pops & popY3) ? a[nCyc]*a[epsU]*a[epsY] : 0.0;
+// T, V, W, Z, X -- each species
+	c[T1] = ( kT1*ampT1*sigmaT1[n] - kZ1*ampZ1*sigmaT1[n] ) / t1;
+	c[U1] = ( kV1*ampV1*sigmaV1[n] + kW1*ampW1*sigmaW1[n] + kZ1*ampZ1*sigmaZ1[n] ) / t1;
+	c[T2] = ( kT2*ampT2*sigmaT2[n] - kZ2*ampZ2*sigmaT2[n] ) / t2;
+	c[U2] = ( kV2*ampV2*sigmaV2[n] + kW2*ampW2*sigmaW2[n] + kZ2*ampZ2*sigmaZ2[n] + kX2*ampX2*sigmaX2[n] ) / t2;
+	c[T1]-=   kX2*ampX2*sigmaT1[n] / t2;
+	c[T3] = ( kT3*ampT3*sigmaT3[n] - kZ3*ampZ3*sigmaT3[n] ) / t3;
+	c[U3] = ( kV3*ampV3*sigmaV3[n] + kW3*ampW3*sigmaW3[n] + kZ3*ampZ3*sigmaZ3[n] + kX3*ampX3*sigmaX3[n] ) / t3;
+	c[T2]-=   kX3*ampX3*sigmaT2[n] / t3;
+// Y2 (see Ycap)
+	A1 = ampV1*sigmaV1[n] + ampW1*sigmaW1[n] + ampZ1*sigmaZ1[n];
+	c[U2] += kY2/t2 * ( sigmaY2[n] + A1*tU1U2/t1 - ampZ1*sigmaT1[n]*tT1U2/t1 );
+	c[U1] -= kY2/t2 * A1*tU1U2/t1;
+	c[T1] += kY2/t2 * ampZ1*sigmaT1[n]*tT1U2/t1;
+// Y3 = sigmaY3*eU3 + qU2*(eU3-eU2) - qU1*(eU3-eU1) - qT2*(eU3-eT2) - qT1*(eU3-eT1)
+	A2  = ampV2*sigmaV2[n] + ampW2*sigmaW2[n] + ampZ2*sigmaZ2[n] + ampX2*sigmaX2[n];
+	B1  = ampV1*sY2v1[n] + ampW1*sY2w1[n] + ampZ1*sY2z1[n];
+	qU2 = ( A2 + B1 + A1*tU1U2/t1 - ampZ1*sigmaT1[n]*tT1U2/t1 ) * tU2U3/t2;
+	qU1 = A1 * tU1U2/t1 * tU1U3/t2;
+	qT2 = ampZ2*sigmaT2[n] * tT2U3/t2;
+	qT1 = ampX2*sigmaT1[n] * tT1U3/t2 - ampZ1*sigmaT1[n] * tT1U2/t1 * tT1U3/t2;
+	c[U3] += kY3/t3 * ( sigmaY3[n] + qU2 - qU1 - qT2 - qT1 );
+	c[U2] -= kY3/t3 * qU2;
+	c[U1] += kY3/t3 * qU1;
+	c[T2] += kY3/t3 * qT2;
+	c[T1] += kY3/t3 * qT1;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// BackgroundCoefficients -- background detection rate = bk[0]*Exp(-t/tU1) + bk[1]*Exp(-t/tU2) + bk[2]*Exp(-t/tU3)
+// Collects the background parts of Vtot ... Xtot and Ybkgd for the populations flagged in pops.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::BackgroundCoefficients (ModelContext_t *ctx, Double_t *a, Double_t *bk, Int_t pops) {
+	using namespace BFitNamespace;
+	Double_t t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3;
+	Double_t V10 = ctx->V10, V20 = ctx->V20, V30 = ctx->V30, W10 = ctx->W10, W20 = ctx->W20, W30 = ctx->W30, Z10 = ctx->Z10, Z20 = ctx->Z20, Z30 = ctx->Z30;
+	Double_t X20 = ctx->X20, X30 = ctx->X30, Y20 = ctx->Y20, Y30 = ctx->Y30, U10 = ctx->U10, U20 = ctx->U20;
+	Double_t kV1, kV2, kV3, kW1, kW2, kW3, kZ1, kZ2, kZ3, kX2, kX3, kY2, kY3, c21, c32, c31;
+	kV1 = (pops & popV1) ? a[nCyc]*a[epsU]*a[epsV] : 0.0;
+	kV2 = (pops & popV2) ? a[nCyc]*a[epsU]*a[epsV] : 0.0;
+	kV3 = (pops & popV3) ? a[nCyc]*a[epsU]*a[epsV] : 0.0;
+	kW1 = (pops & popW1) ? a[nCyc]*a[epsU]*a[epsW] : 0.0;
+	kW2 = (pops & popW2) ? a[nCyc]*a[epsU]*a[epsW] : 0.0;
+	kW3 = (pops & popW3) ? a[nCyc]*a[epsU]*a[epsW] : 0.0;
+	kZ1 = (pops & popZ1) ? a[nCyc]*a[epsU]*a[epsZ] : 0.0;
+	kZ2 = (pops & popZ2) ? a[nCyc]*a[epsU]*a[epsZ] : 0.0;
+	kZ3 = (pops & popZ3) ? a[nCyc]*a[epsU]*a[epsZ] : 0.0;
+	kX2 = (pops & popX2) ? a[nCyc]*a[epsU]*a[epsX] : 0.0;
+	kX3 = (pops & popX3) ? a[nCyc]*a[epsU]*a[epsX] : 0.0;
+	kY2 = (pops & popY2) ? a[nCyc]*a[epsU]*a[epsY] : 0.0;
+	kY3 = (pops & popY3) ? a[nCyc]*a[epsU]*a[epsY] : 0.0;
+	bk[0] = ( kV1*V10 + kW1*W10 + kZ1*Z10 ) / t1;
+	bk[1] = ( kV2*V20 + kW2*W20 + kZ2*Z20 + kX2*X20 ) / t2;
+	bk[2] = ( kV3*V30 + kW3*W30 + kZ3*Z30 + kX3*X30 ) / t3;
+// Y2 background: Y20*eU2 + c21*(eU2-eU1)
+	c21 = U10 * tU1/t1 * tU2/(tU2-tU1);
+	bk[1] += kY2/t2 * ( Y20 + c21 );
+	bk[0] -= kY2/t2 * c21;
+// Y3 background: Y30*eU3 + c32*(eU3-eU2) + c31*( tU1*(tU3-tU2)*eU1 - tU2*(tU3-tU1)*eU2 + tU3*(tU2-tU1)*eU3 )
+	c32 = U20 * tU2/t2 * tU3/(tU3-tU2);
+	c31 = U10 * tU1/t1 * tU2/t2 * tU3/(tU3-tU2)/(tU3-tU1)/(tU2-tU1);
+	bk[2] += kY3/t3 * ( Y30 + c32 + c31*tU3*(tU2-tU1) );
+	bk[1] -= kY3/t3 * ( c32 + c31*tU2*(tU3-tU1) );
+	bk[0] += kY3/t3 * c31*tU1*(tU3-tU2);
+}
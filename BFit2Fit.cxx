@@ -0,0 +1,276 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// BFit2Fit
+// 2015-06-14
+//
+// Fit bins, their chi-square and BatchFit(); see BFit2Fit.h. These were in BFit2.cxx.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "BFit2Fit.h"
+#include <iostream>
+#include <cstring>
+#include "TMath.h"
+#include "TFitResult.h"
+#include "Fit/FitConfig.h"
+#include "Fit/Fitter.h"
+using namespace std;
+
+// Threads each BatchFit() may split its model evaluation and sum over bins across: all
+// cores for a single fit, shared out among the fits in batch mode. Short histograms aren't split.
+Int_t		iFitThreads = 1;
+const Int_t	nMinBinsPerThread = 4096;
+
+// Fit bins of h between xMin and xMax (bin centres) for the model in ctx, with the fit
+// options in pcsOptions (I: bin averages; L: chi2_L, which keeps empty bins). Returns
+// the number of bins. Free with FreeFitBins().
+static void AllocFitBins (FitBins_t *fb, BFitNamespace::ModelContext_t *ctx, Int_t nBins, const char *pcsOptions) {
+	using namespace BFitNamespace;
+	fb->ctx			= ctx;
+	fb->fitBinT		= new Double_t [nBins];
+	fb->fitBinY		= new Double_t [nBins];
+	fb->fitBinE		= new Double_t [nBins];
+	fb->fitBinModel	= new Double_t [nBins];
+	fb->fitBinLo	= new Double_t [nBins];
+	fb->fitBinHi	= new Double_t [nBins];
+	fb->fitBinGrad	= new Double_t [nBins*nParIndex];
+	fb->fitPar		= new Double_t [nParIndex];
+	for (Int_t j = 0; j < nParIndex; j++) fb->fitPar[j] = 0.0;
+	fb->bFitIntegral = (strchr(pcsOptions,'I') != 0);
+	fb->bFitPoisson	= (strchr(pcsOptions,'L') != 0);
+	fb->nThreads	= iFitThreads;
+	fb->pool		= 0;
+	fb->nEval		= fb->nEvalGrad = 0;
+	fb->nFitBins = 0;
+}
+
+Int_t FillFitBins (FitBins_t *fb, BFitNamespace::ModelContext_t *ctx, TH1 *h, Double_t xMin, Double_t xMax, const char *pcsOptions) {
+	Int_t bin;
+	AllocFitBins(fb, ctx, h->GetNbinsX(), pcsOptions);
+	for (bin = 1; bin <= h->GetNbinsX(); bin++) {
+		if (h->GetBinCenter(bin) < xMin || h->GetBinCenter(bin) > xMax) continue;
+		if (!fb->bFitPoisson && h->GetBinError(bin) <= 0) continue;
+		fb->fitBinT[fb->nFitBins] = h->GetBinCenter(bin);
+		fb->fitBinY[fb->nFitBins] = h->GetBinContent(bin);
+		fb->fitBinE[fb->nFitBins] = h->GetBinError(bin);
+		fb->fitBinLo[fb->nFitBins] = h->GetBinLowEdge(bin);
+		fb->fitBinHi[fb->nFitBins] = h->GetBinLowEdge(bin) + h->GetBinWidth(bin);
+		fb->nFitBins++;
+	}
+	return fb->nFitBins;
+}
+
+// Fit bins as FillFitBins() gives for the histogram in sums rebinned by nRebin, as
+// TH1::Rebin(nRebin) would make it (the last nRaw % nRebin raw bins are dropped)
+Int_t FillFitBinsFromSums (FitBins_t *fb, BFitNamespace::ModelContext_t *ctx, const BinSums_t *sums, Int_t nRebin, Double_t xMin, Double_t xMax, const char *pcsOptions) {
+	Int_t k, nBins = sums->nRaw/nRebin;
+	Double_t w = nRebin*sums->width, lo, e2;
+	AllocFitBins(fb, ctx, nBins, pcsOptions);
+	for (k = 0; k < nBins; k++) {
+		lo = sums->xLow + k*w;
+		if (lo + 0.5*w < xMin || lo + 0.5*w > xMax) continue;
+		e2 = sums->sumE2[(k+1)*nRebin] - sums->sumE2[k*nRebin];
+		if (!fb->bFitPoisson && e2 <= 0) continue;
+		fb->fitBinT[fb->nFitBins] = lo + 0.5*w;
+		fb->fitBinY[fb->nFitBins] = sums->sumY[(k+1)*nRebin] - sums->sumY[k*nRebin];
+		fb->fitBinE[fb->nFitBins] = TMath::Sqrt(e2);
+		fb->fitBinLo[fb->nFitBins] = lo;
+		fb->fitBinHi[fb->nFitBins] = lo + w;
+		fb->nFitBins++;
+	}
+	return fb->nFitBins;
+}
+
+void FreeFitBins (FitBins_t *fb) {
+	delete [] fb->fitBinT;
+	delete [] fb->fitBinY;
+	delete [] fb->fitBinE;
+	delete [] fb->fitBinModel;
+	delete [] fb->fitBinLo;
+	delete [] fb->fitBinHi;
+	delete [] fb->fitBinGrad;
+	delete [] fb->fitPar;
+#ifdef BFIT_THREADS
+	delete fb->pool;
+#endif
+	fb->pool = 0;
+}
+
+Double_t BatchChi2 (FitBins_t *fb, const Double_t *par) {
+	fb->nEval++;
+	memcpy(fb->fitPar, par, fb->ctx->nPars*sizeof(Double_t));
+	return SumBins(fb, 0);
+}
+
+// Chi-square as BatchChi2, and its derivatives wrt the parameters to grad[]
+Double_t BatchChi2Grad (FitBins_t *fb, const Double_t *par, Double_t *grad) {
+	fb->nEvalGrad++;
+	memcpy(fb->fitPar, par, fb->ctx->nPars*sizeof(Double_t));
+	return SumBins(fb, grad);
+}
+
+// Model values (and derivatives, if bGrad) in fit bins i0 ... i1-1 at the pars in a
+static void EvalBinRange (FitBins_t *fb, Double_t *a, Int_t i0, Int_t i1, Bool_t bGrad) {
+	using namespace BFitNamespace;
+	Int_t n = i1 - i0;
+	if (bGrad) {
+		if (fb->bFitIntegral) yAllBatchIntegralGradient(fb->ctx, n, fb->fitBinLo+i0, fb->fitBinHi+i0, a, fb->fitBinModel+i0, fb->fitBinGrad+i0*nParIndex);
+		else                  yAllBatchGradient(fb->ctx, n, fb->fitBinT+i0, a, fb->fitBinModel+i0, fb->fitBinGrad+i0*nParIndex);
+	}
+	else {
+		if (fb->bFitIntegral) yAllBatchIntegral(fb->ctx, n, fb->fitBinLo+i0, fb->fitBinHi+i0, a, fb->fitBinModel+i0);
+		else                  yAllBatch(fb->ctx, n, fb->fitBinT+i0, a, fb->fitBinModel+i0);
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// SumBinRange -- sum over fit bins i0 ... i1-1 of the chi-square (or chi2_L) terms, given
+// the model values in fitBinModel; if grad is given, their derivatives go to grad[].
+// Chi-square:	((n - mu)/e)^2,					d/dp = -2 (n - mu)/e^2 dmu/dp
+// chi2_L:		2 (mu - n + n ln(n/mu)),		d/dp = 2 (1 - n/mu) dmu/dp
+// A model at or below zero is held at muMin so an empty-looking bin can't give -inf; such a
+// bin's chi2_L doesn't depend on the pars, so it adds nothing to the gradient.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static Double_t SumBinRange (const FitBins_t *fb, Int_t i0, Int_t i1, Double_t *grad) {
+	using namespace BFitNamespace;
+	const Double_t muMin = 1e-300;
+	Double_t sum = 0.0, n, mu, r, w;
+	Int_t i, j, nPars = fb->ctx->nPars;
+	if (grad) for (j = 0; j < nPars; j++) grad[j] = 0.0;
+	for (i = i0; i < i1; i++) {
+		n = fb->fitBinY[i];
+		if (fb->bFitPoisson) {
+			mu = TMath::Max(fb->fitBinModel[i], muMin);
+			sum += 2.0*(mu - n);
+			if (n > 0) sum += 2.0*n*TMath::Log(n/mu);
+			w = (fb->fitBinModel[i] > muMin) ? 2.0*(1.0 - n/mu) : 0.0;
+		}
+		else {
+			r = (n - fb->fitBinModel[i]) / fb->fitBinE[i];
+			sum += r*r;
+			w = -2.0 * r / fb->fitBinE[i];
+		}
+		if (grad) for (j = 0; j < nPars; j++) grad[j] += w * fb->fitBinGrad[i*nParIndex+j];
+	}
+	return sum;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// SumBins -- model (EvalBinRange) and SumBinRange over all the fit bins at fb->fitPar, split
+// into contiguous blocks on up to fb->nThreads threads of fb->pool (at least
+// nMinBinsPerThread bins each). The parameter-dependent values are brought up to date once,
+// by a call on no bins, so the blocks only read the model context. The blocks' sums are
+// added in block order, so the result doesn't depend on thread timing.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Double_t SumBins (FitBins_t *fb, Double_t *grad) {
+	Int_t nBlocks = TMath::Min(fb->nThreads, fb->nFitBins/nMinBinsPerThread);
+#ifdef BFIT_THREADS
+	if (nBlocks > 1) {
+		using namespace BFitNamespace;
+		Int_t k, j, nPars = fb->ctx->nPars;
+		vector<Double_t> vSum(nBlocks), vGrad(grad ? nBlocks*nParIndex : 0);
+		EvalBinRange(fb, fb->fitPar, 0, 0, grad != 0);
+		if (!fb->pool) fb->pool = new FitPool_t(fb->nThreads - 1);
+		fb->pool->Run(nBlocks, [=, &vSum, &vGrad] (Int_t b) {
+			Int_t i0 = (Int_t)((Long64_t)fb->nFitBins*b/nBlocks), i1 = (Int_t)((Long64_t)fb->nFitBins*(b+1)/nBlocks);
+			Double_t a[nParIndex]; // each block's own copy, equal to the one the context was updated for
+			memcpy(a, fb->fitPar, nParIndex*sizeof(Double_t));
+			EvalBinRange(fb, a, i0, i1, grad != 0);
+			vSum[b] = SumBinRange(fb, i0, i1, grad ? &vGrad[b*nParIndex] : 0);
+		});
+		Double_t sum = 0.0;
+		if (grad) for (j = 0; j < nPars; j++) grad[j] = 0.0;
+		for (k = 0; k < nBlocks; k++) {
+			sum += vSum[k];
+			if (grad) for (j = 0; j < nPars; j++) grad[j] += vGrad[k*nParIndex+j];
+		}
+		return sum;
+	}
+#endif
+	EvalBinRange(fb, fb->fitPar, 0, fb->nFitBins, grad != 0);
+	return SumBinRange(fb, 0, fb->nFitBins, grad);
+}
+
+// Chi-square fit of h to fn with an FCN that evaluates the whole histogram at once.
+// Same bins as TH1::Fit: bin centres inside the function range with option R, and
+// empty (zero-error) bins skipped. Honours fixed parameters and the options of TH1::Fit
+// that change the result: M runs Migrad a second time from the first minimum (Minuit2
+// has no IMPROVE) and keeps the lower, M and E have Hesse work out the errors and
+// covariance after Migrad, E then runs MINOS, Q prints nothing and V prints everything.
+// Minuit's initial steps are fn's parameter errors, as with TH1::Fit.
+// With option L the FCN is the Baker-Cousins likelihood chi-square instead, and the
+// empty bins are kept (they pull the model down as much as any other bin).
+// The numbers of model evaluations without and with gradient go in *pnEval and *pnEvalGrad if given.
+TFitResultPtr BatchFit (BFitNamespace::ModelContext_t *ctx, TH1 *h, TF1 *fn, const BFitCase_t *pstBFitCase, Long64_t *pnEval, Long64_t *pnEvalGrad) {
+	using namespace BFitNamespace;
+	Double_t xMin, xMax, *par;
+	Int_t index, nPars = ctx->nPars;
+	const char *pcsOptions = pstBFitCase->pcsOptions;
+	Bool_t bQuiet, bVerbose, bMore, bMinos;
+	FitBins_t fb;
+	
+	if (strchr(pstBFitCase->pcsOptions,'R')) fn->GetRange(xMin,xMax);
+	else { xMin = h->GetXaxis()->GetXmin(); xMax = h->GetXaxis()->GetXmax(); }
+	FillFitBins(&fb, ctx, h, xMin, xMax, pstBFitCase->pcsOptions);
+	
+	bQuiet		= strchr(pcsOptions,'Q') != 0;
+	bVerbose	= strchr(pcsOptions,'V') != 0 && !bQuiet;
+	bMore		= strchr(pcsOptions,'M') != 0;
+	bMinos		= strchr(pcsOptions,'E') != 0;
+	
+	par = fn->GetParameters();
+	BatchChi2Function fcn(&fb);
+	ROOT::Fit::Fitter fitter;
+	fitter.Config().SetMinimizer("Minuit2","Migrad");
+	fitter.Config().MinimizerOptions().SetPrintLevel(bVerbose ? 3 : 0);
+	fitter.Config().SetParamsSettings(nPars, par, fn->GetParErrors());
+	for (index = 0; index < nPars; index++) {
+		fitter.Config().ParSettings(index).SetName(fn->GetParName(index));
+		if (pstBFitCase->pbToggle[index] == 0) fitter.Config().ParSettings(index).Fix();
+		else if (fitter.Config().ParSettings(index).StepSize() <= 0) // no error to step by: TH1::Fit's default
+			fitter.Config().ParSettings(index).SetStepSize(par[index] ? 0.3*TMath::Abs(par[index]) : 0.3);
+	}
+	if (ctx->b134sbFlag && pstBFitCase->pbToggle[gammaT2] == 0) fitter.Config().ParSettings(gammaT3).Fix();
+	fitter.Config().SetParabErrors(bMore || bMinos);
+	fitter.Config().SetMinosErrors(bMinos && !bMore);
+	fitter.FitFCN(fcn, 0, fb.nFitBins, true); // no parameter array: it would reset the steps to 0.3*|par|
+	
+	// M: Migrad again from the first minimum, with the Hesse errors as steps. The first minimum stands if the second
+	// fit fails or ends higher; MINOS (E) runs on the second only.
+	TFitResultPtr fit;
+	if (bMore) {
+		ROOT::Fit::FitResult first = fitter.Result();
+		for (index = 0; index < nPars; index++) {
+			fitter.Config().ParSettings(index).SetValue(first.Parameter(index));
+			if (first.ParError(index) > 0) fitter.Config().ParSettings(index).SetStepSize(first.ParError(index));
+		}
+		fitter.Config().SetMinosErrors(bMinos);
+		if (fitter.FitFCN(fcn, 0, fb.nFitBins, true) && fitter.Result().MinFcnValue() <= first.MinFcnValue())
+			fit = TFitResultPtr(new TFitResult(fitter.Result()));
+		else
+			fit = TFitResultPtr(new TFitResult(first));
+	}
+	else
+		fit = TFitResultPtr(new TFitResult(fitter.Result()));
+	if (!bQuiet) fit->Print(bVerbose ? "V" : "");
+	fn->SetParameters(fit->GetParams());
+	fn->SetParErrors(fit->GetErrors());
+	fn->SetChisquare(fit->Chi2());
+	fn->SetNDF(fit->Ndf());
+	fn->SetNumberFitPoints(fb.nFitBins);
+	h->GetListOfFunctions()->Add(fn); // so the stats box shows the fit, as after TH1::Fit
+	if (pnEval)		*pnEval		= fb.nEval;
+	if (pnEvalGrad)	*pnEvalGrad	= fb.nEvalGrad;
+	
+	FreeFitBins(&fb);
+	return fit;
+}
+
+// Whether BatchFit() does what TH1::Fit would with these options: Q, V, R, I, L (LL), M, E
+// and S, and O, which only affects drawing. Anything else (W, B, N, +, ...), and lower case,
+// which BatchFit() wouldn't see (main() puts the CSV options in upper case), goes to TH1::Fit.
+Bool_t BatchFitOptions (const char *pcsOptions) {
+	for (const char *c = pcsOptions; *c; c++)
+		if (!strchr("QVRILMESO ", *c)) return kFALSE;
+	return kTRUE;
+}
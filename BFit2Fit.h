@@ -0,0 +1,154 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// BFit2Fit
+// 2015-06-14
+//
+// The chi-square (or chi2_L) fit of a BFit2 model to a histogram that BFit2 runs: the fit
+// bins, the FCN that evaluates the model on all of them at once (yAllBatch() and co, split
+// over a pool of threads on long histograms) with its gradient, and BatchFit(), which hands
+// that to Minuit2 in place of TH1::Fit. Split out of BFit2.cxx so that BFitModelCompare
+// can check the same fit against TH1::Fit.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef BFIT2FIT_H
+#define BFIT2FIT_H
+
+#include <vector>
+#include "RVersion.h"
+#include "TH1.h"
+#include "TF1.h"
+#include "TFitResultPtr.h"
+#include "Math/IFunction.h"
+#include "CSVtoStruct.h"
+#include "BFit2Model.h"
+
+// Fits (and BFit2's batch mode) run on several threads with ROOT 6.06 or later
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+#define BFIT_THREADS
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#endif
+
+// Histogram bins in the fit range, set in BatchFit() and used by BatchChi2()
+class FitPool_t;
+struct FitBins_t {
+	BFitNamespace::ModelContext_t *ctx; // model being fit
+	Int_t		nFitBins;
+	Double_t	*fitBinT, *fitBinY, *fitBinE, *fitBinModel; // bin centre, content, error, and model value
+	Double_t	*fitBinLo, *fitBinHi; // bin edges, for integral fits
+	Bool_t		bFitIntegral; // kTRUE: compare bin contents to the bin average of yAll (option I)
+	Bool_t		bFitPoisson; // kTRUE: Baker-Cousins likelihood chi-square (option L); else chi-square
+	Int_t		nThreads; // threads the model and the sum over bins may be split over
+	FitPool_t	*pool; // those threads, started on the first split evaluation (0 until then)
+	Double_t	*fitBinGrad; // derivatives of the model value wrt each parameter, nParIndex per bin
+	Double_t	*fitPar; // copy of the fitter's parameters, nParIndex long (the model modifies its parameter array)
+	Long64_t	nEval, nEvalGrad; // BatchChi2() and BatchChi2Grad() calls, for the benchmark
+};
+
+// Cumulative contents and squared errors of a histogram's raw bins, so it can be rebinned
+// by any whole factor m without TH1::Rebin: rebinned bin k (from 0) holds raw bins
+// k*m+1 ... (k+1)*m, and its content is sumY[(k+1)*m] - sumY[k*m]
+struct BinSums_t {
+	Int_t		nRaw;
+	Double_t	xLow, width; // low edge of the first raw bin, and the raw bin width
+	std::vector<Double_t>	sumY, sumE2; // nRaw+1 entries each, from 0
+};
+
+#ifdef BFIT_THREADS
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// FitPool_t -- worker threads kept for the whole fit, so each FCN call hands its blocks to
+// threads that are already waiting instead of starting its own. Run(n, job) calls job(k)
+// for k = 0 ... n-1 on the workers and the calling thread, and returns when all are done.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class FitPool_t {
+public:
+	FitPool_t (Int_t nWorkers) : pJob(0), nJobs(0), iNext(0), nActive(0), bStop(false) {
+		for (Int_t i = 0; i < nWorkers; i++) vThreads.push_back(std::thread(&FitPool_t::Work, this));
+	}
+	~FitPool_t () {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			bStop = true;
+		}
+		cvStart.notify_all();
+		for (size_t i = 0; i < vThreads.size(); i++) vThreads[i].join();
+	}
+	void Run (Int_t n, const std::function<void (Int_t)> &job) {
+		std::unique_lock<std::mutex> lock(mtx);
+		pJob	= &job;
+		nJobs	= n;
+		iNext	= 0;
+		cvStart.notify_all();
+		while (iNext < nJobs) {
+			Int_t k = iNext++;
+			lock.unlock();
+			job(k);
+			lock.lock();
+		}
+		cvDone.wait(lock, [this] { return nActive == 0; });
+		pJob	= 0;
+		nJobs	= iNext = 0;
+	}
+private:
+	std::vector<std::thread>	vThreads;
+	std::mutex					mtx;
+	std::condition_variable		cvStart, cvDone;
+	const std::function<void (Int_t)> *pJob;
+	Int_t	nJobs, iNext, nActive; // jobs handed out under mtx, so a late worker can't take one from a finished Run
+	bool	bStop;
+	void Work () {
+		std::unique_lock<std::mutex> lock(mtx);
+		for (;;) {
+			cvStart.wait(lock, [this] { return bStop || iNext < nJobs; });
+			if (bStop) return;
+			Int_t k = iNext++;
+			const std::function<void (Int_t)> *job = pJob;
+			nActive++;
+			lock.unlock();
+			(*job)(k);
+			lock.lock();
+			if (--nActive == 0) cvDone.notify_all();
+		}
+	}
+};
+#endif
+
+// Threads each BatchFit() may split its model evaluation and sum over bins across: all
+// cores for a single fit, shared out among the fits in batch mode. Short histograms aren't split.
+extern Int_t		iFitThreads;
+extern const Int_t	nMinBinsPerThread;
+
+TFitResultPtr BatchFit (BFitNamespace::ModelContext_t*, TH1*, TF1*, const BFitCase_t*, Long64_t* = 0, Long64_t* = 0);
+Bool_t BatchFitOptions (const char*);
+Double_t BatchChi2 (FitBins_t*, const Double_t*);
+Double_t BatchChi2Grad (FitBins_t*, const Double_t*, Double_t*);
+Double_t SumBins (FitBins_t*, Double_t*);
+Int_t FillFitBins (FitBins_t*, BFitNamespace::ModelContext_t*, TH1*, Double_t, Double_t, const char*);
+Int_t FillFitBinsFromSums (FitBins_t*, BFitNamespace::ModelContext_t*, const BinSums_t*, Int_t, Double_t, Double_t, const char*);
+void FreeFitBins (FitBins_t*);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// BatchChi2Function -- the chi-square (or chi2_L) of the fit bins with its gradient, for Minuit2
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class BatchChi2Function : public ROOT::Math::IMultiGradFunction {
+public:
+	BatchChi2Function (FitBins_t *b) : fb(b) {}
+	ROOT::Math::IMultiGenFunction* Clone () const { return new BatchChi2Function(fb); }
+	unsigned int NDim () const { return fb->ctx->nPars; }
+	void Gradient (const Double_t *par, Double_t *grad) const { BatchChi2Grad(fb, par, grad); }
+	void FdF (const Double_t *par, Double_t &f, Double_t *grad) const { f = BatchChi2Grad(fb, par, grad); }
+private:
+	FitBins_t *fb;
+	Double_t DoEval (const Double_t *par) const { return BatchChi2(fb, par); }
+	Double_t DoDerivative (const Double_t *par, unsigned int i) const {
+		Double_t grad[BFitNamespace::nParIndex];
+		BatchChi2Grad(fb, par, grad);
+		return grad[i];
+	}
+};
+
+#endif
@@ -0,0 +1,602 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// BFit2Gradient
+// 2015-05-21
+//
+// Derivatives of yAll with respect to every parameter, so Minuit2 can be given
+// the gradient of the chi-square instead of working it out by finite differences
+// (two ComputeParameterDependentVars + full model evaluations per free parameter
+// per gradient).
+//
+// The derivatives are exact (to rounding): every quantity that the model builds
+// from the parameters -- lifetimes, decay factors, amplitudes, the sigma series,
+// the start-of-cycle values V10 ... Y30, the tooth and background coefficients --
+// is carried here as a Dual_t, a value together with its derivatives wrt all
+// nParIndex parameters, and the usual rules (product, quotient, chain) are applied
+// at every step. The code below mirrors ComputeParameterDependentVars(), the
+// sigma recurrences and _cap functions, and ToothCoefficients()/BackgroundCoefficients()
+// line by line, with Double_t replaced by Dual_t; keep them in step.
+//
+// The parameter array is not modified (the 2*iota offset of the gammaU's is done
+// here on the dual copy, as the value path does on local copies).
+//
+// 2015-06-04: rIntegralGradient() -- the same for the population integrals of
+// BFit2Integrals.cxx, for the errors of the integrals and the profile scans in BFit2.cxx.
+//
+// 2015-06-10: the exponentials outside ctx->activeExp are left out (see BFit2Batch.cxx), so
+// derivatives wrt parameters fixed at zero are no longer complete; Minuit doesn't use them.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "BFit2Model.h"
+#include "TMath.h"
+#include <iostream>
+#include <cstring>
+using namespace std;
+
+namespace BFitNamespace {
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Dual_t -- value v and derivatives d[j] = dv/da[j]
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+struct Dual_t {
+	Double_t v, d[nParIndex];
+};
+static inline Dual_t Const (Double_t x) {
+	Dual_t f;
+	f.v = x;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = 0.0;
+	return f;
+}
+static inline Dual_t operator+ (const Dual_t &x, const Dual_t &y) {
+	Dual_t f;
+	f.v = x.v + y.v;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = x.d[j] + y.d[j];
+	return f;
+}
+static inline Dual_t operator- (const Dual_t &x, const Dual_t &y) {
+	Dual_t f;
+	f.v = x.v - y.v;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = x.d[j] - y.d[j];
+	return f;
+}
+static inline Dual_t operator* (const Dual_t &x, const Dual_t &y) {
+	Dual_t f;
+	f.v = x.v * y.v;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = x.d[j]*y.v + x.v*y.d[j];
+	return f;
+}
+static inline Dual_t operator/ (const Dual_t &x, const Dual_t &y) {
+	Dual_t f;
+	f.v = x.v / y.v;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = (x.d[j] - f.v*y.d[j]) / y.v;
+	return f;
+}
+static inline Dual_t operator- (const Dual_t &x) {
+	Dual_t f;
+	f.v = -x.v;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = -x.d[j];
+	return f;
+}
+static inline Dual_t operator+ (const Dual_t &x, Double_t c) { Dual_t f = x; f.v += c; return f; }
+static inline Dual_t operator+ (Double_t c, const Dual_t &x) { return x + c; }
+static inline Dual_t operator- (const Dual_t &x, Double_t c) { Dual_t f = x; f.v -= c; return f; }
+static inline Dual_t operator- (Double_t c, const Dual_t &x) { Dual_t f = -x; f.v += c; return f; }
+static inline Dual_t operator* (const Dual_t &x, Double_t c) {
+	Dual_t f;
+	f.v = x.v * c;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = x.d[j] * c;
+	return f;
+}
+static inline Dual_t operator* (Double_t c, const Dual_t &x) { return x * c; }
+static inline Dual_t operator/ (const Dual_t &x, Double_t c) { return x * (1.0/c); }
+static inline Dual_t operator/ (Double_t c, const Dual_t &x) {
+	Dual_t f;
+	f.v = c / x.v;
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = -f.v * x.d[j] / x.v;
+	return f;
+}
+static inline Dual_t Exp (const Dual_t &x) {
+	Dual_t f;
+	f.v = TMath::Exp(x.v);
+	for (Int_t j = 0; j < nParIndex; j++) f.d[j] = f.v * x.d[j];
+	return f;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Dual copies of the parameter-dependent vars (names as in ModelContext_t), one per context
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+struct GradVars_t {
+	Dual_t a[nParIndex];
+	Dual_t tT1, tT2, tT3, tU1, tU2, tU3;
+	Dual_t aT1, aT2, aT3, aU1, aU2, aU3;
+	Dual_t tT1U2, tT1U3, tU1U2, tU1U3, tT2U3, tU2U3;
+	Dual_t ampT1, ampT2, ampT3, ampV1, ampV2, ampV3, ampW1, ampW2, ampW3, ampZ1, ampZ2, ampZ3, ampX2, ampX3;
+	Dual_t *sigmaT1, *sigmaT2, *sigmaT3, *sigmaV1, *sigmaV2, *sigmaV3, *sigmaW1, *sigmaW2, *sigmaW3;
+	Dual_t *sigmaZ1, *sigmaZ2, *sigmaZ3, *sigmaX2, *sigmaX3, *sigmaY2, *sigmaY3;
+	Dual_t *sY2v1, *sY2w1, *sY2z1;
+	Dual_t V10, V20, V30, W10, W20, W30, Z10, Z20, Z30, X20, X30, Y20, Y30, U10, U20;
+// What the above were computed for
+	Double_t lastPar[nParIndex], tCap, tBac, tCyc, t1, t2, t3;
+	Int_t nCapMax;
+};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// FreeGradVars -- release a context's dual vars (called by FreeModelContext)
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void FreeGradVars (GradVars_t *pgv) {
+	Dual_t *pp[] = { pgv->sigmaT1, pgv->sigmaT2, pgv->sigmaT3, pgv->sigmaV1, pgv->sigmaV2, pgv->sigmaV3, pgv->sigmaW1, pgv->sigmaW2, pgv->sigmaW3,
+		pgv->sigmaZ1, pgv->sigmaZ2, pgv->sigmaZ3, pgv->sigmaX2, pgv->sigmaX3, pgv->sigmaY2, pgv->sigmaY3, pgv->sY2v1, pgv->sY2w1, pgv->sY2z1 };
+	for (Int_t j = 0; j < (Int_t)(sizeof(pp)/sizeof(pp[0])); j++) delete [] pp[j];
+	delete pgv;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ComputeGradVars -- ComputeParameterDependentVars() on duals
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void ComputeGradVars (ModelContext_t *ctx, Double_t *par) {
+	using namespace TMath;
+	GradVars_t &gv = *ctx->grad;
+	Int_t nCapMax = ctx->nCapMax;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tCyc = ctx->tCyc, t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3;
+	Dual_t *a = gv.a;
+	Dual_t sY3v2, sY3w2, sY3z2, sY3x2, sY3v1, sY3w1, sY3z1;
+	Dual_t eT1, eT2, eT3, eU1, eU2, eU3, eU1tCyc, eU2tCyc, eU3tCyc;
+	Dual_t Vcap1, Vcap2, Vcap3, Wcap1, Wcap2, Wcap3, Zcap1, Zcap2, Zcap3, Xcap2, Xcap3, Ycap2, Ycap3;
+	Double_t tn;
+	Int_t j, k, n;
+
+// (Re)allocate the sigma arrays for this nCapMax
+	if (gv.nCapMax != nCapMax || gv.sigmaT1 == 0) {
+		Dual_t **pp[] = { &gv.sigmaT1, &gv.sigmaT2, &gv.sigmaT3, &gv.sigmaV1, &gv.sigmaV2, &gv.sigmaV3, &gv.sigmaW1, &gv.sigmaW2, &gv.sigmaW3,
+			&gv.sigmaZ1, &gv.sigmaZ2, &gv.sigmaZ3, &gv.sigmaX2, &gv.sigmaX3, &gv.sigmaY2, &gv.sigmaY3, &gv.sY2v1, &gv.sY2w1, &gv.sY2z1 };
+		for (j = 0; j < (Int_t)(sizeof(pp)/sizeof(pp[0])); j++) {
+			delete [] *pp[j];
+			*pp[j] = new Dual_t [nCapMax+1];
+			(*pp[j])[0] = Const(0.0); // zero index not used
+		}
+	}
+	gv.nCapMax = nCapMax;
+	gv.tCap = tCap; gv.tBac = tBac; gv.tCyc = tCyc;
+	gv.t1 = t1; gv.t2 = t2; gv.t3 = t3;
+	memcpy(gv.lastPar, par, nParIndex*sizeof(Double_t));
+
+// Parameters: da[j]/da[i] = 1 if i==j
+	for (j = 0; j < nParIndex; j++) {
+		a[j] = Const(par[j]);
+		a[j].d[j] = 1.0;
+	}
+	if (ctx->b134sbFlag) a[gammaT3] = a[gammaT2];
+	a[gammaU1] = a[gammaU1] + 2*iota;
+	a[gammaU2] = a[gammaU2] + 2*iota;
+	a[gammaU3] = a[gammaU3] + 2*iota;
+// Modified lifetimes
+	gv.tT1 = 1.0 / ( 1.0/t1 + a[gammaT1]/1000.0 );
+	gv.tT2 = 1.0 / ( 1.0/t2 + a[gammaT2]/1000.0 );
+	gv.tT3 = 1.0 / ( 1.0/t3 + a[gammaT3]/1000.0 );
+	gv.tU1 = 1.0 / ( 1.0/t1 + a[gammaU1]/1000.0 );
+	gv.tU2 = 1.0 / ( 1.0/t2 + a[gammaU2]/1000.0 );
+	gv.tU3 = 1.0 / ( 1.0/t3 + a[gammaU3]/1000.0 );
+// Decay factors
+	gv.aT1 = Exp(-tCap/gv.tT1);
+	gv.aT2 = Exp(-tCap/gv.tT2);
+	gv.aT3 = Exp(-tCap/gv.tT3);
+	gv.aU1 = Exp(-tCap/gv.tU1);
+	gv.aU2 = Exp(-tCap/gv.tU2);
+	gv.aU3 = Exp(-tCap/gv.tU3);
+// Special factors
+	gv.tT1U2 = gv.tT1*gv.tU2/(gv.tU2-gv.tT1);
+	gv.tT1U3 = gv.tT1*gv.tU3/(gv.tU3-gv.tT1);
+	gv.tU1U2 = gv.tU1*gv.tU2/(gv.tU2-gv.tU1);
+	gv.tU1U3 = gv.tU1*gv.tU3/(gv.tU3-gv.tU1);
+	gv.tT2U3 = gv.tT2*gv.tU3/(gv.tU3-gv.tT2);
+	gv.tU2U3 = gv.tU2*gv.tU3/(gv.tU3-gv.tU2);
+// Amplitudes
+	gv.ampT1 = a[r1] * tCap * a[p];
+	gv.ampT2 = a[r2] * tCap * a[p];
+	gv.ampT3 = a[r3] * tCap * a[p];
+	gv.ampV1 = a[r1] * tCap * (1-a[p]);
+	gv.ampV2 = a[r2] * tCap * (1-a[p]);
+	gv.ampV3 = a[r3] * tCap * (1-a[p]);
+	gv.ampW1 = a[r1] * tCap * a[p] * (1-a[rho]);
+	gv.ampW2 = a[r2] * tCap * a[p] * (1-a[rho]);
+	gv.ampW3 = a[r3] * tCap * a[p] * (1-a[rho]);
+	gv.ampZ1 = a[r1] * tCap * a[p] * a[gammaT1]/(a[gammaT1]-a[gammaU1]);
+	gv.ampZ2 = a[r2] * tCap * a[p] * a[gammaT2]/(a[gammaT2]-a[gammaU2]);
+	gv.ampZ3 = a[r3] * tCap * a[p] * a[gammaT3]/(a[gammaT3]-a[gammaU3]);
+	gv.ampX2 = a[r1] * tCap * a[p] * (1/t1) * (gv.tT1*gv.tU2/(gv.tU2-gv.tT1));
+	gv.ampX3 = a[r2] * tCap * a[p] * (1/t2) * (gv.tT2*gv.tU3/(gv.tU3-gv.tT2));
+// Sigmas
+	Dual_t &aT1 = gv.aT1, &aT2 = gv.aT2, &aT3 = gv.aT3, &aU1 = gv.aU1, &aU2 = gv.aU2, &aU3 = gv.aU3;
+	Dual_t &tU1U2 = gv.tU1U2, &tT1U2 = gv.tT1U2, &tU2U3 = gv.tU2U3, &tT2U3 = gv.tT2U3, &tU1U3 = gv.tU1U3, &tT1U3 = gv.tT1U3;
+	Dual_t sI_T1, sI_T2, sI_T3, sI_U1, sI_U2, sI_U3; // running sigma series, as in ComputeParameterDependentVars()
+	Dual_t sII_T1U1, sII_T2U2, sII_T3U3, sII_T1U2, sII_T2U3, sII_T1U3, sII_U1U2, sII_U2U3, sII_U1U3;
+	Dual_t sIII_T1U1U2, sIII_T2U2U3, sIII_T1U2U3, sIII_T1U1U3, sIII_U1U2U3, sIV_T1U1U2U3;
+	sI_T1 = sI_T2 = sI_T3 = sI_U1 = sI_U2 = sI_U3 = Const(0.0);
+	sII_T1U1 = sII_T2U2 = sII_T3U3 = sII_T1U2 = sII_T2U3 = sII_T1U3 = sII_U1U2 = sII_U2U3 = sII_U1U3 = Const(0.0);
+	sIII_T1U1U2 = sIII_T2U2U3 = sIII_T1U2U3 = sIII_T1U1U3 = sIII_U1U2U3 = sIV_T1U1U2U3 = Const(0.0);
+	for (k = 1; k <= nCapMax; k++) {
+		sIV_T1U1U2U3	= aU3*sIV_T1U1U2U3 + sIII_T1U1U2;
+		sIII_T1U1U2	= aU2*sIII_T1U1U2  + sII_T1U1;
+		sIII_T2U2U3	= aU3*sIII_T2U2U3  + sII_T2U2;
+		sIII_T1U2U3	= aU3*sIII_T1U2U3  + sII_T1U2;
+		sIII_T1U1U3	= aU3*sIII_T1U1U3  + sII_T1U1;
+		sIII_U1U2U3	= aU3*sIII_U1U2U3  + sII_U1U2;
+		sII_T1U1	= aU1*sII_T1U1 + sI_T1;
+		sII_T2U2	= aU2*sII_T2U2 + sI_T2;
+		sII_T3U3	= aU3*sII_T3U3 + sI_T3;
+		sII_T1U2	= aU2*sII_T1U2 + sI_T1;
+		sII_T2U3	= aU3*sII_T2U3 + sI_T2;
+		sII_T1U3	= aU3*sII_T1U3 + sI_T1;
+		sII_U1U2	= aU2*sII_U1U2 + sI_U1;
+		sII_U2U3	= aU3*sII_U2U3 + sI_U2;
+		sII_U1U3	= aU3*sII_U1U3 + sI_U1;
+		sI_T1		= 1 + a[rho]*aT1*sI_T1;
+		sI_T2		= 1 + a[rho]*aT2*sI_T2;
+		sI_T3		= 1 + a[rho]*aT3*sI_T3;
+		sI_U1		= 1 + aU1*sI_U1;
+		sI_U2		= 1 + aU2*sI_U2;
+		sI_U3		= 1 + aU3*sI_U3;
+		gv.sigmaT1[k] = sI_T1;
+		gv.sigmaT2[k] = sI_T2;
+		gv.sigmaT3[k] = sI_T3;
+		gv.sigmaV1[k] = sI_U1;
+		gv.sigmaV2[k] = sI_U2;
+		gv.sigmaV3[k] = sI_U3;
+		gv.sigmaW1[k] = aT1 * sII_T1U1;
+		gv.sigmaW2[k] = aT2 * sII_T2U2;
+		gv.sigmaW3[k] = aT3 * sII_T3U3;
+		gv.sigmaZ1[k] = (aU1-aT1) * sII_T1U1 + gv.sigmaT1[k];
+		gv.sigmaZ2[k] = (aU2-aT2) * sII_T2U2 + gv.sigmaT2[k];
+		gv.sigmaZ3[k] = (aU3-aT3) * sII_T3U3 + gv.sigmaT3[k];
+		gv.sigmaX2[k] = (aU2-aT1) * sII_T1U2 + gv.sigmaT1[k];
+		gv.sigmaX3[k] = (aU3-aT2) * sII_T2U3 + gv.sigmaT2[k];
+		gv.sY2v1[k] = tU1U2/t1 * (aU2-aU1) *             sII_U1U2;
+		gv.sY2w1[k] = tU1U2/t1 * (aU2-aU1) *  aT1      * sIII_T1U1U2;
+		gv.sY2z1[k] = tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * sIII_T1U1U2 + ( tU1U2/t1 * (aU2-aU1) - tT1U2/t1 * (aU2-aT1) ) * sII_T1U2;
+		sY3v2 = tU2U3/t2 * (aU3-aU2) *             sII_U2U3;
+		sY3w2 = tU2U3/t2 * (aU3-aU2) *  aT2      * sIII_T2U2U3;
+		sY3z2 = tU2U3/t2 * (aU3-aU2) * (aU2-aT2) * sIII_T2U2U3 + ( tU2U3/t2 * (aU3-aU2) - tT2U3/t2 * (aU3-aT2) ) * sII_T2U3;
+		sY3x2 = tU2U3/t2 * (aU3-aU2) * (aU2-aT1) * sIII_T1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tT1U3/t2 * (aU3-aT1) ) * sII_T1U3;
+		sY3v1 = tU1U2/t1 *       ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * sIII_U1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * sII_U1U3 );
+		sY3w1 = tU1U2/t1 * aT1 * ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * sIV_T1U1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * sIII_T1U1U3 );
+		sY3z1 = tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * sIV_T1U1U2U3
+			  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1)             * sIII_T1U2U3
+			  - tU2U3/t2 * (aU3-aU2) * tT1U2/t1 * (aU2-aT1)             * sIII_T1U2U3
+			  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1             * (aU1-aT1) * sIII_T1U1U3
+			  - tU1U3/t2 * (aU3-aU1) * tU1U2/t1             * (aU1-aT1) * sIII_T1U1U3
+			  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1                         * sII_T1U3
+			  - tU1U3/t2 * (aU3-aU1) * tU1U2/t1                         * sII_T1U3
+			  - tU2U3/t2 * (aU3-aU2) * tT1U2/t1                         * sII_T1U3
+			  + tT1U3/t2 * (aU3-aT1) * tT1U2/t1                         * sII_T1U3;
+		gv.sigmaY2[k] = gv.ampV1*gv.sY2v1[k] + gv.ampW1*gv.sY2w1[k] + gv.ampZ1*gv.sY2z1[k];
+		gv.sigmaY3[k] = gv.ampV2*sY3v2 + gv.ampW2*sY3w2 + gv.ampZ2*sY3z2 + gv.ampX2*sY3x2 + gv.ampV1*sY3v1 + gv.ampW1*sY3w1 + gv.ampZ1*sY3z1;
+	}
+
+// Capture parts of the populations at tCyc (see Vcap ... Ycap)
+	n  = Ceil((tCyc-tBac)/tCap);
+	tn = tCyc-tBac-(n-1)*tCap;
+	eT1 = Exp(-tn/gv.tT1); eT2 = Exp(-tn/gv.tT2); eT3 = Exp(-tn/gv.tT3);
+	eU1 = Exp(-tn/gv.tU1); eU2 = Exp(-tn/gv.tU2); eU3 = Exp(-tn/gv.tU3);
+	Vcap1 = gv.ampV1 * gv.sigmaV1[n] * eU1;
+	Vcap2 = gv.ampV2 * gv.sigmaV2[n] * eU2;
+	Vcap3 = gv.ampV3 * gv.sigmaV3[n] * eU3;
+	Wcap1 = gv.ampW1 * gv.sigmaW1[n] * eU1;
+	Wcap2 = gv.ampW2 * gv.sigmaW2[n] * eU2;
+	Wcap3 = gv.ampW3 * gv.sigmaW3[n] * eU3;
+	Zcap1 = gv.ampZ1 * ( gv.sigmaZ1[n]*eU1 - gv.sigmaT1[n]*eT1 );
+	Zcap2 = gv.ampZ2 * ( gv.sigmaZ2[n]*eU2 - gv.sigmaT2[n]*eT2 );
+	Zcap3 = gv.ampZ3 * ( gv.sigmaZ3[n]*eU3 - gv.sigmaT3[n]*eT3 );
+	Xcap2 = gv.ampX2 * ( gv.sigmaX2[n]*eU2 - gv.sigmaT1[n]*eT1 );
+	Xcap3 = gv.ampX3 * ( gv.sigmaX3[n]*eU3 - gv.sigmaT2[n]*eT2 );
+	Ycap2 = gv.sigmaY2[n] * eU2
+		+ gv.ampV1 * gv.sigmaV1[n] * tU1U2/t1 * ( eU2 - eU1 )
+		+ gv.ampW1 * gv.sigmaW1[n] * tU1U2/t1 * ( eU2 - eU1 )
+		+ gv.ampZ1 * gv.sigmaZ1[n] * tU1U2/t1 * ( eU2 - eU1 )
+		- gv.ampZ1 * gv.sigmaT1[n] * tT1U2/t1 * ( eU2 - eT1 );
+	Ycap3 = gv.sigmaY3[n] * eU3
+		+ gv.ampV2 * gv.sigmaV2[n] * tU2U3/t2 * ( eU3 - eU2 )
+		+ gv.ampW2 * gv.sigmaW2[n] * tU2U3/t2 * ( eU3 - eU2 )
+		+ gv.ampZ2 * gv.sigmaZ2[n] * tU2U3/t2 * ( eU3 - eU2 )
+		- gv.ampZ2 * gv.sigmaT2[n] * tT2U3/t2 * ( eU3 - eT2 )
+		+ gv.ampX2 * gv.sigmaX2[n] * tU2U3/t2 * ( eU3 - eU2 )
+		- gv.ampX2 * gv.sigmaT1[n] * tT1U3/t2 * ( eU3 - eT1 )
+		+ gv.ampV1 *   gv.sY2v1[n] *            tU2U3/t2 * ( eU3 - eU2 )
+		+ gv.ampV1 * gv.sigmaV1[n] * tU1U2/t1 * tU2U3/t2 * ( eU3 - eU2 )
+		- gv.ampV1 * gv.sigmaV1[n] * tU1U2/t1 * tU1U3/t2 * ( eU3 - eU1 )
+		+ gv.ampW1 *   gv.sY2w1[n] *            tU2U3/t2 * ( eU3 - eU2 )
+		+ gv.ampW1 * gv.sigmaW1[n] * tU1U2/t1 * tU2U3/t2 * ( eU3 - eU2 )
+		- gv.ampW1 * gv.sigmaW1[n] * tU1U2/t1 * tU1U3/t2 * ( eU3 - eU1 )
+		+ gv.ampZ1 *   gv.sY2z1[n] *            tU2U3/t2 * ( eU3 - eU2 )
+		+ gv.ampZ1 * gv.sigmaZ1[n] * tU1U2/t1 * tU2U3/t2 * ( eU3 - eU2 )
+		- gv.ampZ1 * gv.sigmaZ1[n] * tU1U2/t1 * tU1U3/t2 * ( eU3 - eU1 )
+		- gv.ampZ1 * gv.sigmaT1[n] * tT1U2/t1 * tU2U3/t2 * ( eU3 - eU2 )
+		+ gv.ampZ1 * gv.sigmaT1[n] * tT1U2/t1 * tT1U3/t2 * ( eU3 - eT1 );
+
+// Initial values of populations
+	Dual_t &tU1 = gv.tU1, &tU2 = gv.tU2, &tU3 = gv.tU3;
+	eU1tCyc = Exp(-tCyc/tU1);
+	eU2tCyc = Exp(-tCyc/tU2);
+	eU3tCyc = Exp(-tCyc/tU3);
+	gv.V10 = Vcap1 / (1-eU1tCyc);
+	gv.V20 = Vcap2 / (1-eU2tCyc);
+	gv.V30 = Vcap3 / (1-eU3tCyc);
+	gv.W10 = Wcap1 / (1-eU1tCyc);
+	gv.W20 = Wcap2 / (1-eU2tCyc);
+	gv.W30 = Wcap3 / (1-eU3tCyc);
+	gv.Z10 = Zcap1 / (1-eU1tCyc);
+	gv.Z20 = Zcap2 / (1-eU2tCyc);
+	gv.Z30 = Zcap3 / (1-eU3tCyc);
+	gv.X20 = Xcap2 / (1-eU2tCyc);
+	gv.X30 = Xcap3 / (1-eU3tCyc);
+	gv.U10 = ( gv.V10 + gv.W10 + gv.Z10 );
+	gv.Y20 = ( Ycap2 + gv.U10 * tU1/t1 * tU2/(tU2-tU1) * ( eU2tCyc - eU1tCyc ) ) / ( 1 - eU2tCyc );
+	gv.U20 = ( gv.V20 + gv.W20 + gv.Z20 + gv.X20 + gv.Y20 );
+	gv.Y30 = ( Ycap3
+		+ gv.U20 * tU2/t2 * tU3/(tU3-tU2) * ( eU3tCyc - eU2tCyc )
+		+ gv.U10 * tU1/t1 * tU2/t2 * tU3/(tU3-tU2)/(tU3-tU1)/(tU2-tU1) * ( tU1 * (tU3-tU2) * eU1tCyc - tU2 * (tU3-tU1) * eU2tCyc + tU3 * (tU2-tU1) * eU3tCyc ) ) / ( 1 - eU3tCyc );
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// UpdateGradVars -- recompute the dual vars if the parameters or the case have changed
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void UpdateGradVars (ModelContext_t *ctx, Double_t *par) {
+	if (ctx->grad == 0) ctx->grad = new GradVars_t();
+	GradVars_t &gv = *ctx->grad;
+	Int_t j;
+	if (gv.sigmaT1 == 0
+		|| gv.nCapMax != ctx->nCapMax || gv.tCap != ctx->tCap || gv.tBac != ctx->tBac || gv.tCyc != ctx->tCyc
+		|| gv.t1 != ctx->t1 || gv.t2 != ctx->t2 || gv.t3 != ctx->t3
+		|| ChangedDependencies(par, gv.lastPar, nParIndex, 0.0))
+		ComputeGradVars(ctx, par);
+// Only scale pars (eps's, DC, ...) changed: nothing but their own duals depends on them
+	else if (memcmp(gv.lastPar, par, nParIndex*sizeof(Double_t)) != 0) {
+		for (j = 0; j < nParIndex; j++) {
+			if (par[j] == gv.lastPar[j]) continue;
+			gv.a[j] = Const(par[j]);
+			gv.a[j].d[j] = 1.0;
+		}
+		memcpy(gv.lastPar, par, nParIndex*sizeof(Double_t));
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// dToothCoefficients, dBackgroundCoefficients -- ToothCoefficients() and
+// BackgroundCoefficients() (BFit2Batch.cxx) on duals, for the populations flagged in pops
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void dToothCoefficients (ModelContext_t *ctx, Int_t n, Dual_t *c, Int_t pops = popAll) {
+	GradVars_t &gv = *ctx->grad;
+	Double_t t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3;
+	Dual_t *a = gv.a;
+	Dual_t kT, kV, kW, kZ, kX, kY, zero = Const(0.0);
+	Dual_t A1, A2, B1, qU1, qU2, qT1, qT2;
+	enum { T1, T2, T3, U1, U2, U3 };
+	kT = a[nCyc]*a[epsT];
+	kV = a[nCyc]*a[epsU]*a[epsV];
+	kW = a[nCyc]*a[epsU]*a[epsW];
+	kZ = a[nCyc]*a[epsU]*a[epsZ];
+	kX = a[nCyc]*a[epsU]*a[epsX];
+	kY = a[nCyc]*a[epsU]*a[epsY];
+	const Dual_t &kT1 = (pops & popT1) ? kT : zero, &kT2 = (pops & popT2) ? kT : zero, &kT3 = (pops & popT3) ? kT : zero;
+	const Dual_t &kV1 = (pops & popV1) ? kV : zero, &kV2 = (pops & popV2) ? kV : zero, &kV3 = (pops & popV3) ? kV : zero;
+	const Dual_t &kW1 = (pops & popW1) ? kW : zero, &kW2 = (pops & popW2) ? kW : zero, &kW3 = (pops & popW3) ? kW : zero;
+	const Dual_t &kZ1 = (pops & popZ1) ? kZ : zero, &kZ2 = (pops & popZ2) ? kZ : zero, &kZ3 = (pops & popZ3) ? kZ : zero;
+	const Dual_t &kX2 = (pops & popX2) ? kX : zero, &kX3 = (pops & popX3) ? kX : zero;
+	const Dual_t &kY2 = (pops & popY2) ? kY : zero, &kY3 = (pops & popY3) ? kY : zero;
+	c[T1] = ( kT1*gv.ampT1*gv.sigmaT1[n] - kZ1*gv.ampZ1*gv.sigmaT1[n] ) / t1;
+	c[U1] = ( kV1*gv.ampV1*gv.sigmaV1[n] + kW1*gv.ampW1*gv.sigmaW1[n] + kZ1*gv.ampZ1*gv.sigmaZ1[n] ) / t1;
+	c[T2] = ( kT2*gv.ampT2*gv.sigmaT2[n] - kZ2*gv.ampZ2*gv.sigmaT2[n] ) / t2;
+	c[U2] = ( kV2*gv.ampV2*gv.sigmaV2[n] + kW2*gv.ampW2*gv.sigmaW2[n] + kZ2*gv.ampZ2*gv.sigmaZ2[n] + kX2*gv.ampX2*gv.sigmaX2[n] ) / t2;
+	c[T1] = c[T1] - kX2*gv.ampX2*gv.sigmaT1[n] / t2;
+	c[T3] = ( kT3*gv.ampT3*gv.sigmaT3[n] - kZ3*gv.ampZ3*gv.sigmaT3[n] ) / t3;
+	c[U3] = ( kV3*gv.ampV3*gv.sigmaV3[n] + kW3*gv.ampW3*gv.sigmaW3[n] + kZ3*gv.ampZ3*gv.sigmaZ3[n] + kX3*gv.ampX3*gv.sigmaX3[n] ) / t3;
+	c[T2] = c[T2] - kX3*gv.ampX3*gv.sigmaT2[n] / t3;
+// Y2
+	A1 = gv.ampV1*gv.sigmaV1[n] + gv.ampW1*gv.sigmaW1[n] + gv.ampZ1*gv.sigmaZ1[n];
+	c[U2] = c[U2] + kY2/t2 * ( gv.sigmaY2[n] + A1*gv.tU1U2/t1 - gv.ampZ1*gv.sigmaT1[n]*gv.tT1U2/t1 );
+	c[U1] = c[U1] - kY2/t2 * A1*gv.tU1U2/t1;
+	c[T1] = c[T1] + kY2/t2 * gv.ampZ1*gv.sigmaT1[n]*gv.tT1U2/t1;
+// Y3
+	A2  = gv.ampV2*gv.sigmaV2[n] + gv.ampW2*gv.sigmaW2[n] + gv.ampZ2*gv.sigmaZ2[n] + gv.ampX2*gv.sigmaX2[n];
+	B1  = gv.ampV1*gv.sY2v1[n] + gv.ampW1*gv.sY2w1[n] + gv.ampZ1*gv.sY2z1[n];
+	qU2 = ( A2 + B1 + A1*gv.tU1U2/t1 - gv.ampZ1*gv.sigmaT1[n]*gv.tT1U2/t1 ) * gv.tU2U3/t2;
+	qU1 = A1 * gv.tU1U2/t1 * gv.tU1U3/t2;
+	qT2 = gv.ampZ2*gv.sigmaT2[n] * gv.tT2U3/t2;
+	qT1 = gv.ampX2*gv.sigmaT1[n] * gv.tT1U3/t2 - gv.ampZ1*gv.sigmaT1[n] * gv.tT1U2/t1 * gv.tT1U3/t2;
+	c[U3] = c[U3] + kY3/t3 * ( gv.sigmaY3[n] + qU2 - qU1 - qT2 - qT1 );
+	c[U2] = c[U2] - kY3/t3 * qU2;
+	c[U1] = c[U1] + kY3/t3 * qU1;
+	c[T2] = c[T2] + kY3/t3 * qT2;
+	c[T1] = c[T1] + kY3/t3 * qT1;
+}
+static void dBackgroundCoefficients (ModelContext_t *ctx, Dual_t *bk, Int_t pops = popAll) {
+	GradVars_t &gv = *ctx->grad;
+	Double_t t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3;
+	Dual_t *a = gv.a;
+	Dual_t &tU1 = gv.tU1, &tU2 = gv.tU2, &tU3 = gv.tU3;
+	Dual_t kV, kW, kZ, kX, kY, c21, c32, c31, zero = Const(0.0);
+	kV = a[nCyc]*a[epsU]*a[epsV];
+	kW = a[nCyc]*a[epsU]*a[epsW];
+	kZ = a[nCyc]*a[epsU]*a[epsZ];
+	kX = a[nCyc]*a[epsU]*a[epsX];
+	kY = a[nCyc]*a[epsU]*a[epsY];
+	const Dual_t &kV1 = (pops & popV1) ? kV : zero, &kV2 = (pops & popV2) ? kV : zero, &kV3 = (pops & popV3) ? kV : zero;
+	const Dual_t &kW1 = (pops & popW1) ? kW : zero, &kW2 = (pops & popW2) ? kW : zero, &kW3 = (pops & popW3) ? kW : zero;
+	const Dual_t &kZ1 = (pops & popZ1) ? kZ : zero, &kZ2 = (pops & popZ2) ? kZ : zero, &kZ3 = (pops & popZ3) ? kZ : zero;
+	const Dual_t &kX2 = (pops & popX2) ? kX : zero, &kX3 = (pops & popX3) ? kX : zero;
+	const Dual_t &kY2 = (pops & popY2) ? kY : zero, &kY3 = (pops & popY3) ? kY : zero;
+	bk[0] = ( kV1*gv.V10 + kW1*gv.W10 + kZ1*gv.Z10 ) / t1;
+	bk[1] = ( kV2*gv.V20 + kW2*gv.W20 + kZ2*gv.Z20 + kX2*gv.X20 ) / t2;
+	bk[2] = ( kV3*gv.V30 + kW3*gv.W30 + kZ3*gv.Z30 + kX3*gv.X30 ) / t3;
+	c21 = gv.U10 * tU1/t1 * tU2/(tU2-tU1);
+	bk[1] = bk[1] + kY2/t2 * ( gv.Y20 + c21 );
+	bk[0] = bk[0] - kY2/t2 * c21;
+	c32 = gv.U20 * tU2/t2 * tU3/(tU3-tU2);
+	c31 = gv.U10 * tU1/t1 * tU2/t2 * tU3/(tU3-tU2)/(tU3-tU1)/(tU2-tU1);
+	bk[2] = bk[2] + kY3/t3 * ( gv.Y30 + c32 + c31*tU3*(tU2-tU1) );
+	bk[1] = bk[1] - kY3/t3 * ( c32 + c31*tU2*(tU3-tU1) );
+	bk[0] = bk[0] + kY3/t3 * c31*tU1*(tU3-tU2);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// dExpIntegral -- integral from x0 to x1 of sum_j c[j]*exp(-x/tau[j]) on duals, for the j
+// with bit j set in mask (the others are zero, see SetActiveExponentials())
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static Dual_t dExpIntegral (Int_t nExp, Int_t mask, const Dual_t *c, const Dual_t *tau, Double_t x0, Double_t x1) {
+	Dual_t f = Const(0.0);
+	for (Int_t j = 0; j < nExp; j++)
+		if (mask & (1 << j)) f = f + c[j]*tau[j]*( Exp(-x0/tau[j]) - Exp(-x1/tau[j]) );
+	return f;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// dPopIntegral -- PopIntegral() (BFit2Integrals.cxx) on duals: integral of the flagged rates
+// from lo to hi, with the background coefficients bk[] and lifetimes tau[] already worked out
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static Dual_t dPopIntegral (ModelContext_t *ctx, Int_t pops, const Dual_t *bk, const Dual_t *tau, Double_t lo, Double_t hi, Int_t &nLast, Dual_t *c) {
+	Int_t nCapMax = ctx->nCapMax;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tCyc = ctx->tCyc;
+	using namespace TMath;
+	Dual_t *a = ctx->grad->a;
+	Dual_t f = Const(0.0);
+	Double_t x0, x1, s0, s1, tStart;
+	Int_t n, n0, n1;
+
+	if (hi <= lo) return f;
+	if (pops & popDC) f = a[nCyc]*a[DC]*(hi - lo);
+	x0 = Max(lo, 0.0);
+	x1 = Min(hi, tCyc);
+	if (x1 > x0) f = f + dExpIntegral(3, ctx->activeExp >> 3, bk, tau+3, x0, x1);
+	x0 = Max(lo, tBac);
+	x1 = Min(hi, tCyc);
+	if (x1 > x0) {
+		n0 = Max(1,       (Int_t)Floor((x0-tBac)/tCap) + 1);
+		n1 = Min(nCapMax, (Int_t)Ceil ((x1-tBac)/tCap));
+		for (n = n0; n <= n1; n++) {
+			tStart = tBac + (n-1)*tCap;
+			s0 = Max(x0, tStart);
+			s1 = (n == nCapMax) ? x1 : Min(x1, tStart + tCap);
+			if (s1 <= s0) continue;
+			if (n != nLast) {
+				dToothCoefficients(ctx, n, c, pops);
+				nLast = n;
+			}
+			f = f + dExpIntegral(6, ctx->activeExp, c, tau, s0 - tStart, s1 - tStart);
+		}
+	}
+	return f;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// SaveDual -- value to y, derivatives to dyda[0 ... nParIndex-1]
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static inline void SaveDual (const Dual_t &f, Double_t *y, Double_t *dyda) {
+	*y = f.v;
+	memcpy(dyda, f.d, nParIndex*sizeof(Double_t));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// dBatchKernel -- yAllBatchGradient for the exponentials in mask only, one kernel per mask
+// as BatchKernel in BFit2Batch.cxx. Each dual Exp left out saves nParIndex+1 multiplies.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+template <Int_t mask>
+static void dBatchKernel (ModelContext_t *ctx, Int_t nPts, const Double_t *t, Double_t *y, Double_t *dyda) {
+	using namespace TMath;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tCyc = ctx->tCyc, t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3;
+	Dual_t tau[6], c[6], bk[3], f;
+	Double_t tn;
+	Int_t j, k, n, nLast = 0;
+
+	GradVars_t &gv = *ctx->grad;
+	Dual_t *a = gv.a;
+	tau[0] = gv.tT1; tau[1] = gv.tT2; tau[2] = gv.tT3;
+	tau[3] = gv.tU1; tau[4] = gv.tU2; tau[5] = gv.tU3;
+	dBackgroundCoefficients(ctx, bk);
+	for (k = 0; k < nPts; k++) {
+		f = a[nCyc]*a[DC];
+		if (0 <= t[k] && t[k] <= tCyc)
+			for (j = 0; j < 3; j++)
+				if (mask & (expU1 << j)) f = f + bk[j]*Exp(-t[k]/tau[3+j]);
+		if (t[k] == tBac) // see Ttot
+			f = f + a[nCyc]*a[epsT] * ( gv.ampT1*gv.sigmaT1[1]/t1 + gv.ampT2*gv.sigmaT2[1]/t2 + gv.ampT3*gv.sigmaT3[1]/t3 );
+		else if (tBac < t[k] && t[k] <= tCyc) {
+			n = Ceil((t[k]-tBac)/tCap);
+			if (n != nLast) {
+				dToothCoefficients(ctx, n, c);
+				nLast = n;
+			}
+			tn = t[k] - tBac - (n-1)*tCap;
+			for (j = 0; j < 6; j++)
+				if (mask & (1 << j)) f = f + c[j]*Exp(-tn/tau[j]);
+		}
+		SaveDual(a[dt]*f, &y[k], &dyda[k*nParIndex]);
+	}
+}
+
+typedef void (*dBatchKernel_t) (ModelContext_t*, Int_t, const Double_t*, Double_t*, Double_t*);
+template <Int_t mask> struct dBatchKernelTable {
+	static void Fill (dBatchKernel_t *table) {
+		table[mask] = dBatchKernel<mask>;
+		dBatchKernelTable<mask-1>::Fill(table);
+	}
+};
+template <> struct dBatchKernelTable<-1> {
+	static void Fill (dBatchKernel_t*) {}
+};
+static dBatchKernel_t *dBatchKernels () {
+	static dBatchKernel_t table[expAll+1];
+	static bool bFilled = (dBatchKernelTable<expAll>::Fill(table), true);
+	(void)bFilled;
+	return table;
+}
+
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// yAllBatchGradient -- yAll at nPts times t[] to y[], and dy[k]/da[j] to dyda[k*nParIndex+j]
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::yAllBatchGradient (ModelContext_t *ctx, Int_t nPts, const Double_t *t, Double_t *par, Double_t *y, Double_t *dyda) {
+	using namespace BFitNamespace;
+	UpdateGradVars(ctx, par);
+	dBatchKernels()[ctx->activeExp & expAll](ctx, nPts, t, y, dyda);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// yAllBatchIntegralGradient -- yAllBatchIntegral() to y[], and dy[k]/da[j] to dyda[k*nParIndex+j]
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::yAllBatchIntegralGradient (ModelContext_t *ctx, Int_t nBins, const Double_t *lo, const Double_t *hi, Double_t *par, Double_t *y, Double_t *dyda) {
+	using namespace BFitNamespace;
+	using namespace TMath;
+	Dual_t tau[6], c[6], bk[3], f;
+	Int_t k, nLast = 0;
+
+	UpdateGradVars(ctx, par);
+	GradVars_t &gv = *ctx->grad;
+	Dual_t *a = gv.a;
+	tau[0] = gv.tT1; tau[1] = gv.tT2; tau[2] = gv.tT3;
+	tau[3] = gv.tU1; tau[4] = gv.tU2; tau[5] = gv.tU3;
+	dBackgroundCoefficients(ctx, bk);
+	for (k = 0; k < nBins; k++) {
+		f = dPopIntegral(ctx, popAll, bk, tau, lo[k], hi[k], nLast, c);
+		SaveDual(a[dt]*f/(hi[k] - lo[k]), &y[k], &dyda[k*nParIndex]);
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// rIntegralGradient -- rIntegral() of the flagged pops from lo to hi (returned), and its
+// derivatives wrt every parameter to dIda[0 ... nParIndex-1]
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Double_t BFitNamespace::rIntegralGradient (ModelContext_t *ctx, Int_t pops, Double_t *par, Double_t lo, Double_t hi, Double_t *dIda) {
+	using namespace BFitNamespace;
+	Dual_t tau[6], c[6], bk[3];
+	Double_t I;
+	Int_t nLast = 0;
+
+	UpdateGradVars(ctx, par);
+	GradVars_t &gv = *ctx->grad;
+	tau[0] = gv.tT1; tau[1] = gv.tT2; tau[2] = gv.tT3;
+	tau[3] = gv.tU1; tau[4] = gv.tU2; tau[5] = gv.tU3;
+	dBackgroundCoefficients(ctx, bk, pops);
+	SaveDual(dPopIntegral(ctx, pops, bk, tau, lo, hi, nLast, c), &I, dIda);
+	return I;
+}
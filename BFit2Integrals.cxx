@@ -0,0 +1,117 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// BFit2Integrals
+// 2015-05-18
+//
+// Exact integrals of the BFit2 detection rates over an interval [lo,hi] (ms).
+// TH1::Fit option "I" integrates yAll numerically over every bin (many dozens of
+// yAll calls per bin per FCN call); but in each capture tooth and in the background
+// region every population is a sum of exponentials (see BFit2Batch.cxx), so the
+// integral of c*exp(-x/tau) from x0 to x1 is just c*tau*(exp(-x0/tau) - exp(-x1/tau)).
+//
+// The interval is split where the rates are discontinuous: at t = 0 and tCyc
+// (background switches on/off), t = tBac (capture starts) and t = tBac + n*tCap
+// (tooth edges). A bin narrower than tCap touches at most two teeth, so the cost
+// per bin is O(1).
+//
+// Populations are selected with the PopFlag bits in BFit2Model.h, so
+//   rIntegral(ctx, popT1, a, lo, hi)  = integral of rT1 from lo to hi (# of betas)
+//   yIntegral(ctx, popU2, a, lo, hi)  = integral of yU2 from lo to hi
+//   rIntegral(ctx, popAll, a, lo, hi) = integral of rAll, and so on.
+// Like the r and y functions, rIntegral() and yIntegral() expect the parameter
+// dependent vars to be up to date; yAllBatchIntegral() updates them itself.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "BFit2Model.h"
+#include "TMath.h"
+#include <iostream>
+using namespace std;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ExpIntegral -- integral from x0 to x1 of sum_j c[j]*exp(-x/tau[j]), j = 0 ... nExp-1
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static Double_t ExpIntegral (Int_t nExp, const Double_t *c, const Double_t *tau, Double_t x0, Double_t x1) {
+	using namespace TMath;
+	Double_t f = 0.0;
+	for (Int_t j = 0; j < nExp; j++)
+		if (c[j] != 0.0) f += c[j]*tau[j]*( Exp(-x0/tau[j]) - Exp(-x1/tau[j]) );
+	return f;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// PopIntegral -- integral of the flagged rates from lo to hi, with the background
+// coefficients bk[] already computed. The tooth coefficients of the last tooth used
+// are kept in c[] (tooth nLast) so runs of bins in the same tooth don't recompute them.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+namespace BFitNamespace {
+static Double_t PopIntegral (ModelContext_t *ctx, Int_t pops, Double_t *a, const Double_t *bk, Double_t lo, Double_t hi, Int_t &nLast, Double_t *c) {
+	using namespace BFitNamespace;
+	using namespace TMath;
+	Int_t nCapMax = ctx->nCapMax;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tCyc = ctx->tCyc;
+	Double_t tau[6] = { ctx->tT1, ctx->tT2, ctx->tT3, ctx->tU1, ctx->tU2, ctx->tU3 };
+	Double_t f = 0.0, x0, x1, s0, s1, tStart;
+	Int_t n, n0, n1;
+
+	if (hi <= lo) return 0.0;
+// DC (all t)
+	if (pops & popDC) f += a[nCyc]*a[DC]*(hi - lo);
+// Background parts (0 <= t <= tCyc)
+	x0 = Max(lo, 0.0);
+	x1 = Min(hi, tCyc);
+	if (x1 > x0) f += ExpIntegral(3, bk, tau+3, x0, x1);
+// Capture parts (tBac <= t <= tCyc), tooth by tooth
+	x0 = Max(lo, tBac);
+	x1 = Min(hi, tCyc);
+	if (x1 > x0) {
+		n0 = Max(1,       (Int_t)Floor((x0-tBac)/tCap) + 1);
+		n1 = Min(nCapMax, (Int_t)Ceil ((x1-tBac)/tCap));
+		for (n = n0; n <= n1; n++) {
+			tStart = tBac + (n-1)*tCap;
+			s0 = Max(x0, tStart);
+			s1 = (n == nCapMax) ? x1 : Min(x1, tStart + tCap);
+			if (s1 <= s0) continue;
+			if (n != nLast) {
+				ToothCoefficients(ctx, a, n, c, pops);
+				nLast = n;
+			}
+			f += ExpIntegral(6, c, tau, s0 - tStart, s1 - tStart);
+		}
+	}
+	return f;
+}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// rIntegral -- integral of the flagged r functions from lo to hi (# of betas detected)
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Double_t BFitNamespace::rIntegral (ModelContext_t *ctx, Int_t pops, Double_t *a, Double_t lo, Double_t hi) {
+	using namespace BFitNamespace;
+	Double_t bk[3], c[6];
+	Int_t nLast = 0;
+	BackgroundCoefficients(ctx, a, bk, pops);
+	return PopIntegral(ctx, pops, a, bk, lo, hi, nLast, c);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// yIntegral -- integral of the flagged y functions from lo to hi
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Double_t BFitNamespace::yIntegral (ModelContext_t *ctx, Int_t pops, Double_t *a, Double_t lo, Double_t hi) {
+	return a[dt]*rIntegral(ctx, pops, a, lo, hi);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// yAllBatchIntegral -- average of yAll over each of nBins bins [lo[k],hi[k]], written to y[]
+// This is what TH1::Fit option "I" compares to the bin contents.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::yAllBatchIntegral (ModelContext_t *ctx, Int_t nBins, const Double_t *lo, const Double_t *hi, Double_t *a, Double_t *y) {
+	using namespace BFitNamespace;
+	Double_t bk[3], c[6];
+	Int_t k, nLast = 0;
+
+	UpdateParameterDependentVars(ctx, a);
+	BackgroundCoefficients(ctx, a, bk);
+	for (k = 0; k < nBins; k++)
+		y[k] = a[dt]*PopIntegral(ctx, popAll, a, bk, lo[k], hi[k], nLast, c) / (hi[k] - lo[k]);
+}
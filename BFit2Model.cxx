@@ -53,6 +53,32 @@
 //	weren't needed.
 //	- Moved the population functions to their own file: BFit2Populations.cxx.
 //	
+// 2015-05-25
+//	- The precomputed values no longer live in the global namespace. They are members
+//	of a ModelContext_t (BFit2Model.h), set up by InitModelContext(), and every model
+//	function takes the context as its first argument. The static locals are gone too,
+//	so separate fits can be evaluated at the same time, each with its own context.
+//	The TF1s get the r, y, o functions through ModelFunctor, which binds the context.
+//	
+// 2015-05-28
+//	- The parameter-dependent values are split into dependency groups (DepGroup in
+//	BFit2Model.h): the amplitudes (r's and p), rho, and one group per species (its
+//	gammaT and gammaU). UpdateParameterDependentVars() works out which groups the
+//	changed pars belong to and ComputeParameterDependentVars() redoes only the sigma
+//	arrays and lifetimes that depend on them. The eps's, DC, dt and nCyc only scale
+//	the rates, so a change in those recomputes nothing.
+//	- The 2*iota offset of the gammaU's is no longer added to the caller's parameter
+//	array. It used to be, so lastPar never matched the next copy that Minuit passed in
+//	and everything was recomputed on every call; and it crept into the TF1 parameters.
+//	
+// 2015-05-29
+//	- The sigma arrays are built with recurrences over the teeth (sigmaI(k) from
+//	sigmaI(k-1), sigmaII(k) from sigmaII(k-1) and sigmaI(k-1), and so on) instead of
+//	the closed forms sigmaI() ... sigmaIV() with their Power(..., n-1)'s. That's O(nCapMax)
+//	rather than O(nCapMax^2), and it is exact when rho*aTi == aUj, where the iota in the
+//	closed forms gave wrong W and Z sigmas (eg. rho = 1 and gammaTi = gammaUi, as in the
+//	seeds; harmless there since ampWi = ampZi = 0). BFit2SigmaTest compares the two.
+//	
 
 #include "BFit2Model.h"
 #include "CSVtoStruct.h"
@@ -64,35 +90,42 @@ using namespace std;
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Fitting function -- sum of all components
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::yAll(Double_t *t, Double_t *a) {
+Double_t BFitNamespace::yAll (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	// Global variables that are constant throughout the fit
-	extern char parNames[30][5];
-	extern BFitCase_t stBFitCases[FILE_ROWS_BFit];
-	extern Int_t iBFitCaseIndex, nPars;
-	extern Double_t iota, t1, t2, t3;
-	// Global variables that depend only on the parameters
-	extern Int_t nParChanges; // counts # of times pars have changed
-	extern Double_t *lastPar; // holds most recent paramter values for comparison
-	// Global variables that depend on t
-	extern Double_t T1val, T2val, T3val, U1val, U2val, U3val, V1val, V2val, V3val, W1val, W2val, W3val, Z1val, Z2val, Z3val, X2val, X3val, Y2val, Y3val;
-	// Local variables
-	static Double_t f;
-	static Int_t index; // index of parameter array
 
+	UpdateParameterDependentVars(ctx,a);
+	return yDC(ctx,t,a) + yT1(ctx,t,a) + yT2(ctx,t,a) + yT3(ctx,t,a) + yU1(ctx,t,a) + yU2(ctx,t,a) + yU3(ctx,t,a);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// UpdateParameterDependentVars -- recompute the parameter-dependent values if the fitter changed the pars
+// Used by yAll and yAllBatch. Returns true if the pars changed. Only the DepGroups of the pars that
+// changed are recomputed, so eg. a step in an eps (which only scales the rates) recomputes nothing.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool BFitNamespace::UpdateParameterDependentVars (ModelContext_t *ctx, Double_t *a) {
+	using namespace BFitNamespace;
+	Int_t index; // index of parameter array
+	Int_t groups; // DepGroups of the pars that changed
+
+	// Same special case as ComputeParameterDependentVars(), so a compares like lastPar
+	if (ctx->b134sbFlag) a[gammaT3] = a[gammaT2];
 	// When parameters change:
-	if (!CompareParArrays(a,lastPar,sizeof(Double_t),iota)) {
-		ComputeParameterDependentVars(a);
-		memcpy(lastPar,a,nPars*sizeof(Double_t));
-		nParChanges++;
+	if (!CompareParArrays(a,ctx->lastPar,ctx->nPars,iota)) {
+		groups = ChangedDependencies(a,ctx->lastPar,ctx->nPars,iota);
+		if (groups)	ComputeParameterDependentVars(ctx,a,groups);
+		else		memcpy(ctx->lastPar,a,ctx->nPars*sizeof(Double_t));
+		ctx->nParChanges++;
 		// Print updated paramters
-		printf("New pars (%4d): ",nParChanges);
-		for (index = 0; index < nPars; index++) {
-			if (stBFitCases[iBFitCaseIndex].pbToggle[index]) printf("%s=%.4e ",parNames[index],a[index]);
+		if (ctx->pbToggle) {
+			printf("New pars (%4d): ",ctx->nParChanges);
+			for (index = 0; index < ctx->nPars; index++) {
+				if (ctx->pbToggle[index]) printf("%s=%.4e ",parNames[index],a[index]);
+			}
+			printf("\n");
 		}
-		printf("\n");
+		return true;
 	}
-	return yDC(t,a) + yT1(t,a) + yT2(t,a) + yT3(t,a) + yU1(t,a) + yU2(t,a) + yU3(t,a);
+	return false;
 }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -105,79 +138,182 @@ bool BFitNamespace::CompareParArrays (const Double_t *par1, const Double_t *par2
 }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// ComputeParameterDependentVars -- when pars change, update parameter-dependent globals
+// InitModelContext -- case constants and arrays for the BDN case, and the parameter-dependent
+// values for par (which gets the 134sb treatment, gammaT3 = gammaT2)
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-void BFitNamespace::ComputeParameterDependentVars (Double_t *a) {
+void BFitNamespace::InitModelContext (ModelContext_t *ctx, const BDNCase_t *pstBDNCase, Int_t nPars, Double_t *par) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// Global variables that are constant throughout the fit
-	extern Int_t nCapMax;
-	extern Double_t iota, tCap, tBac, tCyc, t1, t2, t3;
-	extern Double_t eU1tCyc, eU2tCyc, eU3tCyc;
-	extern bool b134sbFlag;
-// Global variables that depend only on the parameters
-	extern Double_t tT1, tT2, tT3, tU1, tU2, tU3;
-	extern Double_t aT1, aT2, aT3, aU1, aU2, aU3;
-	extern Double_t tT1U2, tT1U3, tU1U2, tU1U3, tT2U3, tU2U3;
-	extern Double_t	*timeOfCapt;
-	extern Double_t	*sigmaT1, *sigmaT2, *sigmaT3;
-	extern Double_t	*sigmaV1, *sigmaV2, *sigmaV3;
-	extern Double_t	*sigmaW1, *sigmaW2, *sigmaW3;
-	extern Double_t	*sigmaZ1, *sigmaZ2, *sigmaZ3;
-	extern Double_t           *sigmaX2, *sigmaX3;
-	extern Double_t           *sigmaY2, *sigmaY3;
-	extern Double_t	*sY2v1, *sY2w1, *sY2z1;
-	extern Double_t	*sY3v2, *sY3w2, *sY3z2, *sY3x2, *sY3v1, *sY3w1, *sY3z1;
-	extern Double_t ampT1, ampT2, ampT3;
-	extern Double_t ampV1, ampV2, ampV3;
-	extern Double_t ampW1, ampW2, ampW3;
-	extern Double_t ampZ1, ampZ2, ampZ3;
-	extern Double_t        ampX2, ampX3;
-	extern Double_t V10, V20, V30;
-	extern Double_t W10, W20, W30;
-	extern Double_t Z10, Z20, Z30;
-	extern Double_t      X20, X30;
-	extern Double_t      Y20, Y30;
-	extern Double_t U10, U20, U30;
-	static Int_t k;
+	Int_t k;
+	Double_t **ppSigma[] = { &ctx->sigmaT1, &ctx->sigmaT2, &ctx->sigmaT3, &ctx->sigmaV1, &ctx->sigmaV2, &ctx->sigmaV3,
+		&ctx->sigmaW1, &ctx->sigmaW2, &ctx->sigmaW3, &ctx->sigmaZ1, &ctx->sigmaZ2, &ctx->sigmaZ3,
+		&ctx->sigmaX2, &ctx->sigmaX3, &ctx->sigmaY2, &ctx->sigmaY3, &ctx->sY2v1, &ctx->sY2w1, &ctx->sY2z1,
+		&ctx->sY3v2, &ctx->sY3w2, &ctx->sY3z2, &ctx->sY3x2, &ctx->sY3v1, &ctx->sY3w1, &ctx->sY3z1 };
+
+	memset(ctx, 0, sizeof(ModelContext_t));
+	ctx->nPars	= nPars;
+	ctx->tCap	= 1000.0 * pstBDNCase->dCaptureTime;	// Time between BPT captures (ms)
+	ctx->tBac	= 1000.0 * pstBDNCase->dBackgroundTime; // Time spent in background measurment, per cycle (ms)
+	ctx->tCyc	= 1000.0 * pstBDNCase->dCycleTime;	// Time between BPT ejections (ms)
+	ctx->t1		= 1000.0 * pstBDNCase->dLifetime1[0]; // radioactive lifetime (1/e) in ms
+	ctx->t2		= 1000.0 * pstBDNCase->dLifetime2[0]; // radioactive lifetime (1/e) in ms
+	ctx->t3		= 1000.0 * pstBDNCase->dLifetime3[0]; // radioactive lifetime (1/e) in ms
+	ctx->nCapMax	= Ceil((ctx->tCyc-ctx->tBac)/ctx->tCap);
+	ctx->activeExp	= expAll;
+// Special cases -- modifications to parameters -- catch right after param import
+	ctx->b134sbFlag = !strcmp(pstBDNCase->pcsCaseCode,"134sb01") ||
+		!strcmp(pstBDNCase->pcsCaseCode,"134sb02") ||
+		!strcmp(pstBDNCase->pcsCaseCode,"134sb03") ||
+		!strcmp(pstBDNCase->pcsCaseCode,"134sb0103");
+	if (ctx->b134sbFlag) par[gammaT3] = par[gammaT2];
+// Array to hold injection times
+	ctx->timeOfCapt = new Double_t [ctx->nCapMax+1];
+	for (k=0; k<ctx->nCapMax+1; k++)
+		ctx->timeOfCapt[k] = ctx->tBac + k*ctx->tCap;
+// Arrays to hold the sigma values in each [index] tooth:
+// Zero index not used (+1 element), for notational consistency -- set to zero for definiteness
+	for (k=0; k<(Int_t)(sizeof(ppSigma)/sizeof(ppSigma[0])); k++) {
+		*ppSigma[k] = new Double_t [ctx->nCapMax+1];
+		(*ppSigma[k])[0] = 0.0;
+	}
+// lastPar is set to par here, so the first yAll doesn't recompute what is computed here
+	ctx->lastPar = new Double_t [nPars];
+	ComputeParameterDependentVars(ctx,par);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// FreeModelContext -- release the arrays allocated by InitModelContext and the gradient functions
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::FreeModelContext (ModelContext_t *ctx) {
+	using namespace BFitNamespace;
+	Double_t *pp[] = { ctx->timeOfCapt, ctx->lastPar, ctx->sigmaT1, ctx->sigmaT2, ctx->sigmaT3, ctx->sigmaV1, ctx->sigmaV2, ctx->sigmaV3,
+		ctx->sigmaW1, ctx->sigmaW2, ctx->sigmaW3, ctx->sigmaZ1, ctx->sigmaZ2, ctx->sigmaZ3,
+		ctx->sigmaX2, ctx->sigmaX3, ctx->sigmaY2, ctx->sigmaY3, ctx->sY2v1, ctx->sY2w1, ctx->sY2z1,
+		ctx->sY3v2, ctx->sY3w2, ctx->sY3z2, ctx->sY3x2, ctx->sY3v1, ctx->sY3w1, ctx->sY3z1 };
+	for (Int_t k=0; k<(Int_t)(sizeof(pp)/sizeof(pp[0])); k++) delete [] pp[k];
+	if (ctx->grad) FreeGradVars(ctx->grad);
+	memset(ctx, 0, sizeof(ModelContext_t));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ParDependencies -- the DepGroup bits of the values that depend on parameter index
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Int_t BFitNamespace::ParDependencies (Int_t index) {
+	using namespace BFitNamespace;
+	switch (index) {
+		case r1: case r2: case r3: case p:	return depAmp;
+		case rho:				return depRho;
+		case gammaT1: case gammaU1:		return depSpecies1;
+		case gammaT2: case gammaU2:		return depSpecies2;
+		case gammaT3: case gammaU3:		return depSpecies3;
+		default:				return 0; // nCyc, dt, DC, eps's only scale the rates
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ChangedDependencies -- DepGroup bits of the pars that differ by more than eps between two arrays
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Int_t BFitNamespace::ChangedDependencies (const Double_t *par1, const Double_t *par2, size_t n, Double_t eps) {
+	Int_t groups = 0;
+	for (size_t i=0; i<n; i++) if (fabs(par1[i]-par2[i]) > eps) groups |= ParDependencies(i);
+	return groups;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ComputeParameterDependentVars -- when pars change, update parameter-dependent values in the context
+// Only the values in the DepGroups flagged in groups are recomputed (default: all of them); the
+// rest are assumed to be up to date already. a is copied to lastPar.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BFitNamespace::ComputeParameterDependentVars (ModelContext_t *ctx, Double_t *a, Int_t groups) {
+	using namespace BFitNamespace;
+	using namespace TMath;
+// Values that are constant throughout the fit
+	Int_t nCapMax = ctx->nCapMax;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tCyc = ctx->tCyc, t1 = ctx->t1, t2 = ctx->t2, t3 = ctx->t3;
+	Double_t &eU1tCyc = ctx->eU1tCyc, &eU2tCyc = ctx->eU2tCyc, &eU3tCyc = ctx->eU3tCyc;
+// Values that depend only on the parameters
+	Double_t &tT1 = ctx->tT1, &tT2 = ctx->tT2, &tT3 = ctx->tT3, &tU1 = ctx->tU1, &tU2 = ctx->tU2, &tU3 = ctx->tU3;
+	Double_t &aT1 = ctx->aT1, &aT2 = ctx->aT2, &aT3 = ctx->aT3, &aU1 = ctx->aU1, &aU2 = ctx->aU2, &aU3 = ctx->aU3;
+	Double_t &tT1U2 = ctx->tT1U2, &tT1U3 = ctx->tT1U3, &tU1U2 = ctx->tU1U2, &tU1U3 = ctx->tU1U3, &tT2U3 = ctx->tT2U3, &tU2U3 = ctx->tU2U3;
+	Double_t	*sigmaT1 = ctx->sigmaT1, *sigmaT2 = ctx->sigmaT2, *sigmaT3 = ctx->sigmaT3;
+	Double_t	*sigmaV1 = ctx->sigmaV1, *sigmaV2 = ctx->sigmaV2, *sigmaV3 = ctx->sigmaV3;
+	Double_t	*sigmaW1 = ctx->sigmaW1, *sigmaW2 = ctx->sigmaW2, *sigmaW3 = ctx->sigmaW3;
+	Double_t	*sigmaZ1 = ctx->sigmaZ1, *sigmaZ2 = ctx->sigmaZ2, *sigmaZ3 = ctx->sigmaZ3;
+	Double_t	                          *sigmaX2 = ctx->sigmaX2, *sigmaX3 = ctx->sigmaX3;
+	Double_t	                          *sigmaY2 = ctx->sigmaY2, *sigmaY3 = ctx->sigmaY3;
+	Double_t	*sY2v1 = ctx->sY2v1, *sY2w1 = ctx->sY2w1, *sY2z1 = ctx->sY2z1;
+	Double_t	*sY3v2 = ctx->sY3v2, *sY3w2 = ctx->sY3w2, *sY3z2 = ctx->sY3z2, *sY3x2 = ctx->sY3x2, *sY3v1 = ctx->sY3v1, *sY3w1 = ctx->sY3w1, *sY3z1 = ctx->sY3z1;
+	Double_t &ampT1 = ctx->ampT1, &ampT2 = ctx->ampT2, &ampT3 = ctx->ampT3;
+	Double_t &ampV1 = ctx->ampV1, &ampV2 = ctx->ampV2, &ampV3 = ctx->ampV3;
+	Double_t &ampW1 = ctx->ampW1, &ampW2 = ctx->ampW2, &ampW3 = ctx->ampW3;
+	Double_t &ampZ1 = ctx->ampZ1, &ampZ2 = ctx->ampZ2, &ampZ3 = ctx->ampZ3;
+	Double_t                        &ampX2 = ctx->ampX2, &ampX3 = ctx->ampX3;
+	Double_t &V10 = ctx->V10, &V20 = ctx->V20, &V30 = ctx->V30;
+	Double_t &W10 = ctx->W10, &W20 = ctx->W20, &W30 = ctx->W30;
+	Double_t &Z10 = ctx->Z10, &Z20 = ctx->Z20, &Z30 = ctx->Z30;
+	Double_t                  &X20 = ctx->X20, &X30 = ctx->X30;
+	Double_t                  &Y20 = ctx->Y20, &Y30 = ctx->Y30;
+	Double_t &U10 = ctx->U10, &U20 = ctx->U20;
+	Double_t gammaU1o, gammaU2o, gammaU3o;
+// Running values of the sigma series at tooth k: sI_T1 = sigmaI(rho,aT1,k), sII_U1U2 = sigmaII(1,aU1,aU2,k), ...
+	Double_t sI_T1 = 0, sI_T2 = 0, sI_T3 = 0, sI_U1 = 0, sI_U2 = 0, sI_U3 = 0;
+	Double_t sII_T1U1 = 0, sII_T2U2 = 0, sII_T3U3 = 0, sII_T1U2 = 0, sII_T2U3 = 0, sII_T1U3 = 0, sII_U1U2 = 0, sII_U2U3 = 0, sII_U1U3 = 0;
+	Double_t sIII_T1U1U2 = 0, sIII_T2U2U3 = 0, sIII_T1U2U3 = 0, sIII_T1U1U3 = 0, sIII_U1U2U3 = 0;
+	Double_t sIV_T1U1U2U3 = 0;
+	Int_t k;
+// Which groups to recompute
+	bool d1 = groups & depSpecies1, d2 = groups & depSpecies2, d3 = groups & depSpecies3, dR = groups & depRho;
 	
 // Special cases:
-	if (b134sbFlag) a[gammaT3] = a[gammaT2];
+	if (ctx->b134sbFlag) a[gammaT3] = a[gammaT2];
+	if (ctx->b134sbFlag && d2) d3 = true;
 // Offset gammaUi to avoid gammaTi == gammaUi (== 0)
-	a[gammaU1] += 2*iota;
-	a[gammaU2] += 2*iota;
-	a[gammaU3] += 2*iota;
-// Modified lifetimes:
-	tT1 = 1.0 / ( 1.0/t1 + a[gammaT1]/1000.0 ); // net variable lifetime (1/e) in ms
-	tT2 = 1.0 / ( 1.0/t2 + a[gammaT2]/1000.0 ); // net variable lifetime (1/e) in ms
-	tT3 = 1.0 / ( 1.0/t3 + a[gammaT3]/1000.0 ); // net variable lifetime (1/e) in ms
-	tU1 = 1.0 / ( 1.0/t1 + a[gammaU1]/1000.0 ); // net variable lifetime (1/e) in ms
-	tU2 = 1.0 / ( 1.0/t2 + a[gammaU2]/1000.0 ); // net variable lifetime (1/e) in ms
-	tU3 = 1.0 / ( 1.0/t3 + a[gammaU3]/1000.0 ); // net variable lifetime (1/e) in ms
-	if (tT1==tU1 || tT2==tU2 || tT3==tU3) { // this probably won't be needed, since I put the 1000*iota offset in tUi
-	// In the future I hope you won't need the variable lifetimes!
-		printf("\n************************************************************");
-		printf("\n*** WARNING: Found gamma_Ti = gamma_Ui for some i.");
-		printf("\n*** Z_i population will wrongly evaluate to 0, and");
-		printf("\n*** Y_{i+1} populations will be too small.");
-		printf("\n*** Suggestion: Slightly change either gamma_Ti or gamma_Ui.");
-		printf("\n************************************************************\n\n");
+// (on local copies: a belongs to the caller, and lastPar has to match it)
+	gammaU1o = a[gammaU1] + 2*iota;
+	gammaU2o = a[gammaU2] + 2*iota;
+	gammaU3o = a[gammaU3] + 2*iota;
+// Modified lifetimes, decay factors and end of cycle exp factors -- each species depends on its own gammas only
+	if (d1) {
+		tT1 = 1.0 / ( 1.0/t1 + a[gammaT1]/1000.0 ); // net variable lifetime (1/e) in ms
+		tU1 = 1.0 / ( 1.0/t1 + gammaU1o/1000.0 ); // net variable lifetime (1/e) in ms
+		aT1 = Exp(-tCap/tT1);
+		aU1 = Exp(-tCap/tU1);
+		eU1tCyc	= Exp(-tCyc/tU1);
 	}
-	//printf("tT1=%f, tT2=%f, tT3=%f\ntU1=%f, tU2=%f, tU3=%f\n", tT1, tT2, tT3, tU1, tU2, tU3);
-// Decay factors
-	aT1 = Exp(-tCap/tT1);
-	aT2 = Exp(-tCap/tT2);
-	aT3 = Exp(-tCap/tT3);
-	aU1 = Exp(-tCap/tU1);
-	aU2 = Exp(-tCap/tU2);
-	aU3 = Exp(-tCap/tU3);
-// Special factors
-	tT1U2	= tT1*tU2/(tU2-tT1);
-	tT1U3	= tT1*tU3/(tU3-tT1);
-	tU1U2	= tU1*tU2/(tU2-tU1);
-	tU1U3	= tU1*tU3/(tU3-tU1);
-	tT2U3	= tT2*tU3/(tU3-tT2);
-	tU2U3	= tU2*tU3/(tU3-tU2);
+	if (d2) {
+		tT2 = 1.0 / ( 1.0/t2 + a[gammaT2]/1000.0 ); // net variable lifetime (1/e) in ms
+		tU2 = 1.0 / ( 1.0/t2 + gammaU2o/1000.0 ); // net variable lifetime (1/e) in ms
+		aT2 = Exp(-tCap/tT2);
+		aU2 = Exp(-tCap/tU2);
+		eU2tCyc	= Exp(-tCyc/tU2);
+	}
+	if (d3) {
+		tT3 = 1.0 / ( 1.0/t3 + a[gammaT3]/1000.0 ); // net variable lifetime (1/e) in ms
+		tU3 = 1.0 / ( 1.0/t3 + gammaU3o/1000.0 ); // net variable lifetime (1/e) in ms
+		aT3 = Exp(-tCap/tT3);
+		aU3 = Exp(-tCap/tU3);
+		eU3tCyc	= Exp(-tCyc/tU3);
+	}
+	if (d1 || d2 || d3) {
+		if (tT1==tU1 || tT2==tU2 || tT3==tU3) { // this probably won't be needed, since I put the 1000*iota offset in tUi
+		// In the future I hope you won't need the variable lifetimes!
+			printf("\n************************************************************");
+			printf("\n*** WARNING: Found gamma_Ti = gamma_Ui for some i.");
+			printf("\n*** Z_i population will wrongly evaluate to 0, and");
+			printf("\n*** Y_{i+1} populations will be too small.");
+			printf("\n*** Suggestion: Slightly change either gamma_Ti or gamma_Ui.");
+			printf("\n************************************************************\n\n");
+		}
+		//printf("tT1=%f, tT2=%f, tT3=%f\ntU1=%f, tU2=%f, tU3=%f\n", tT1, tT2, tT3, tU1, tU2, tU3);
+	// Special factors
+		tT1U2	= tT1*tU2/(tU2-tT1);
+		tT1U3	= tT1*tU3/(tU3-tT1);
+		tU1U2	= tU1*tU2/(tU2-tU1);
+		tU1U3	= tU1*tU3/(tU3-tU1);
+		tT2U3	= tT2*tU3/(tU3-tT2);
+		tU2U3	= tU2*tU3/(tU3-tU2);
+	}
+// Amplitudes (cheap, so always recomputed)
 // Amplitudes -- Ti
 	ampT1		= a[r1] * tCap * a[p];
 	ampT2		= a[r2] * tCap * a[p];
@@ -191,200 +327,241 @@ void BFitNamespace::ComputeParameterDependentVars (Double_t *a) {
 	ampW2		= a[r2] * tCap * a[p] * (1-a[rho]);
 	ampW3		= a[r3] * tCap * a[p] * (1-a[rho]);
 // Amplitudes -- Zi
-	ampZ1		= a[r1] * tCap * a[p] * a[gammaT1]/(a[gammaT1]-a[gammaU1]);//(a[gammaT1]+iota)/((a[gammaT1]-a[gammaU1])+iota);
-	ampZ2		= a[r2] * tCap * a[p] * a[gammaT2]/(a[gammaT2]-a[gammaU2]);
-	ampZ3		= a[r3] * tCap * a[p] * a[gammaT3]/(a[gammaT3]-a[gammaU3]);
+	ampZ1		= a[r1] * tCap * a[p] * a[gammaT1]/(a[gammaT1]-gammaU1o);//(a[gammaT1]+iota)/((a[gammaT1]-a[gammaU1])+iota);
+	ampZ2		= a[r2] * tCap * a[p] * a[gammaT2]/(a[gammaT2]-gammaU2o);
+	ampZ3		= a[r3] * tCap * a[p] * a[gammaT3]/(a[gammaT3]-gammaU3o);
 	//printf("ampZ1=%f, ampZ2=%f, ampZ3=%f\n", ampZ1, ampZ2, ampZ3);
 // Amplitudes -- Xi
 	ampX2		= a[r1] * tCap * a[p] * (1/t1) * (tT1*tU2/(tU2-tT1));
 	ampX3		= a[r2] * tCap * a[p] * (1/t2) * (tT2*tU3/(tU3-tT2));
 // Sigmas:
 // See sigmas and _cap functions
+// The sigma series are built up tooth by tooth with the recurrences
+//	sigmaI  (r,a,k)          = 1 + r*a * sigmaI(r,a,k-1)
+//	sigmaII (r,a1,a2,k)      = a2 * sigmaII (r,a1,a2,k-1)    + sigmaI  (r,a1,k-1)
+//	sigmaIII(r,a1,a2,a3,k)   = a3 * sigmaIII(r,a1,a2,a3,k-1) + sigmaII (r,a1,a2,k-1)
+//	sigmaIV (r,a1,a2,a3,a4,k)= a4 * sigmaIV (r,a1,...,a4,k-1) + sigmaIII(r,a1,a2,a3,k-1)
+// starting from 0 at k=0, instead of the closed forms sigmaI() ... sigmaIV(). That is O(nCapMax)
+// instead of O(nCapMax^2) Power()s, and there is no 0/0 when two decay factors are equal (eg.
+// rho*aT1 == aU1), so the iota fudge in the closed forms isn't needed.
+// Each array below depends on rho (unless it is a V) and on the species whose decay factors it
+// uses; the amplitudes are not in them, except in sigmaY2 and sigmaY3.
 	for (k=1; k<=nCapMax; k++) {
+	// Advance the series from k-1 to k (highest order first, since each uses the one below at k-1)
+		sIV_T1U1U2U3	= aU3*sIV_T1U1U2U3 + sIII_T1U1U2;
+		sIII_T1U1U2	= aU2*sIII_T1U1U2  + sII_T1U1;
+		sIII_T2U2U3	= aU3*sIII_T2U2U3  + sII_T2U2;
+		sIII_T1U2U3	= aU3*sIII_T1U2U3  + sII_T1U2;
+		sIII_T1U1U3	= aU3*sIII_T1U1U3  + sII_T1U1;
+		sIII_U1U2U3	= aU3*sIII_U1U2U3  + sII_U1U2;
+		sII_T1U1	= aU1*sII_T1U1 + sI_T1;
+		sII_T2U2	= aU2*sII_T2U2 + sI_T2;
+		sII_T3U3	= aU3*sII_T3U3 + sI_T3;
+		sII_T1U2	= aU2*sII_T1U2 + sI_T1;
+		sII_T2U3	= aU3*sII_T2U3 + sI_T2;
+		sII_T1U3	= aU3*sII_T1U3 + sI_T1;
+		sII_U1U2	= aU2*sII_U1U2 + sI_U1;
+		sII_U2U3	= aU3*sII_U2U3 + sI_U2;
+		sII_U1U3	= aU3*sII_U1U3 + sI_U1;
+		sI_T1		= 1 + a[rho]*aT1*sI_T1;
+		sI_T2		= 1 + a[rho]*aT2*sI_T2;
+		sI_T3		= 1 + a[rho]*aT3*sI_T3;
+		sI_U1		= 1 + aU1*sI_U1;
+		sI_U2		= 1 + aU2*sI_U2;
+		sI_U3		= 1 + aU3*sI_U3;
 	// zero index of these set to zero in BFit()
-		sigmaT1[k] = sigmaI(a[rho],aT1,k);
-		sigmaT2[k] = sigmaI(a[rho],aT2,k);
-		sigmaT3[k] = sigmaI(a[rho],aT3,k);
-		sigmaV1[k] = sigmaI(1.0000,aU1,k);
-		sigmaV2[k] = sigmaI(1.0000,aU2,k);
-		sigmaV3[k] = sigmaI(1.0000,aU3,k);
-		sigmaW1[k] = aT1 * sigmaII(a[rho],aT1,aU1,k);
-		sigmaW2[k] = aT2 * sigmaII(a[rho],aT2,aU2,k);
-		sigmaW3[k] = aT3 * sigmaII(a[rho],aT3,aU3,k);
-		sigmaZ1[k] = (aU1-aT1) * sigmaII(a[rho],aT1,aU1,k) + sigmaT1[k]; // corresponds to $\sigma'_{Z1}$ in thesis
-		sigmaZ2[k] = (aU2-aT2) * sigmaII(a[rho],aT2,aU2,k) + sigmaT2[k]; // corresponds to $\sigma'_{Z2}$ in thesis
-		sigmaZ3[k] = (aU3-aT3) * sigmaII(a[rho],aT3,aU3,k) + sigmaT3[k]; // corresponds to $\sigma'_{Z3}$ in thesis
-		sigmaX2[k] = (aU2-aT1) * sigmaII(a[rho],aT1,aU2,k) + sigmaT1[k]; // corresponds to $\sigma'_{X2}$ in thesis
-		sigmaX3[k] = (aU3-aT2) * sigmaII(a[rho],aT2,aU3,k) + sigmaT2[k]; // corresponds to $\sigma'_{X3}$ in thesis
+		if (d1 || dR) {
+			sigmaT1[k] = sI_T1;
+			sigmaW1[k] = aT1 * sII_T1U1;
+			sigmaZ1[k] = (aU1-aT1) * sII_T1U1 + sigmaT1[k]; // corresponds to $\sigma'_{Z1}$ in thesis
+		}
+		if (d2 || dR) {
+			sigmaT2[k] = sI_T2;
+			sigmaW2[k] = aT2 * sII_T2U2;
+			sigmaZ2[k] = (aU2-aT2) * sII_T2U2 + sigmaT2[k]; // corresponds to $\sigma'_{Z2}$ in thesis
+		}
+		if (d3 || dR) {
+			sigmaT3[k] = sI_T3;
+			sigmaW3[k] = aT3 * sII_T3U3;
+			sigmaZ3[k] = (aU3-aT3) * sII_T3U3 + sigmaT3[k]; // corresponds to $\sigma'_{Z3}$ in thesis
+		}
+		if (d1) sigmaV1[k] = sI_U1;
+		if (d2) sigmaV2[k] = sI_U2;
+		if (d3) sigmaV3[k] = sI_U3;
+		if (d1 || d2 || dR) sigmaX2[k] = (aU2-aT1) * sII_T1U2 + sigmaT1[k]; // corresponds to $\sigma'_{X2}$ in thesis
+		if (d2 || d3 || dR) sigmaX3[k] = (aU3-aT2) * sII_T2U3 + sigmaT2[k]; // corresponds to $\sigma'_{X3}$ in thesis
 		// Components of sigmaY2:
-		sY2v1[k]  = tU1U2/t1 * (aU2-aU1) *             sigmaII (1.0000,aU1,aU2,k);
-		sY2w1[k]  = tU1U2/t1 * (aU2-aU1) *  aT1      * sigmaIII(a[rho],aT1,aU1,aU2,k);
-		sY2z1[k]  = tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * sigmaIII(a[rho],aT1,aU1,aU2,k) + ( tU1U2/t1 * (aU2-aU1) - tT1U2/t1 * (aU2-aT1) ) * sigmaII(a[rho],aT1,aU2,k);
+		if (d1 || d2) sY2v1[k]  = tU1U2/t1 * (aU2-aU1) *             sII_U1U2;
+		if (d1 || d2 || dR) {
+			sY2w1[k]  = tU1U2/t1 * (aU2-aU1) *  aT1      * sIII_T1U1U2;
+			sY2z1[k]  = tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * sIII_T1U1U2 + ( tU1U2/t1 * (aU2-aU1) - tT1U2/t1 * (aU2-aT1) ) * sII_T1U2;
+		}
 		// Components of sigmaY3:
-		sY3v2[k]  = tU2U3/t2 * (aU3-aU2) *             sigmaII (1.0000,aU2,aU3,k);
-		sY3w2[k]  = tU2U3/t2 * (aU3-aU2) *  aT2      * sigmaIII(a[rho],aT2,aU2,aU3,k);
-		sY3z2[k]  = tU2U3/t2 * (aU3-aU2) * (aU2-aT2) * sigmaIII(a[rho],aT2,aU2,aU3,k) + ( tU2U3/t2 * (aU3-aU2) - tT2U3/t2 * (aU3-aT2) ) * sigmaII(a[rho],aT2,aU3,k);
-		sY3x2[k]  = tU2U3/t2 * (aU3-aU2) * (aU2-aT1) * sigmaIII(a[rho],aT1,aU2,aU3,k) + ( tU2U3/t2 * (aU3-aU2) - tT1U3/t2 * (aU3-aT1) ) * sigmaII(a[rho],aT1,aU3,k);
-		sY3v1[k]  = tU1U2/t1 *       ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * sigmaIII(1.0000,aU1,aU2,aU3,    k) + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * sigmaII (1.0000,aU1,aU3,    k) );
-		sY3w1[k]  = tU1U2/t1 * aT1 * ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * sigmaIV (a[rho],aT1,aU1,aU2,aU3,k) + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * sigmaIII(a[rho],aT1,aU1,aU3,k) );
-		sY3z1[k]  = tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * sigmaIV (a[rho],aT1,aU1,aU2,aU3,k)
-				  //
-				  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1)             * sigmaIII(a[rho],aT1,aU2,aU3,    k)
-				  - tU2U3/t2 * (aU3-aU2) * tT1U2/t1 * (aU2-aT1)             * sigmaIII(a[rho],aT1,aU2,aU3,    k)
-				  //
-				  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1             * (aU1-aT1) * sigmaIII(a[rho],aT1,aU1,aU3,    k)
-				  - tU1U3/t2 * (aU3-aU1) * tU1U2/t1             * (aU1-aT1) * sigmaIII(a[rho],aT1,aU1,aU3,    k)
-				  //
-				  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1                         * sigmaII (a[rho],aT1,aU3,        k)
-				  - tU1U3/t2 * (aU3-aU1) * tU1U2/t1                         * sigmaII (a[rho],aT1,aU3,        k)
-				  //
-				  - tU2U3/t2 * (aU3-aU2) * tT1U2/t1                         * sigmaII (a[rho],aT1,aU3,        k)
-				  + tT1U3/t2 * (aU3-aT1) * tT1U2/t1                         * sigmaII (a[rho],aT1,aU3,        k);
+		if (d2 || d3) sY3v2[k]  = tU2U3/t2 * (aU3-aU2) *             sII_U2U3;
+		if (d2 || d3 || dR) {
+			sY3w2[k]  = tU2U3/t2 * (aU3-aU2) *  aT2      * sIII_T2U2U3;
+			sY3z2[k]  = tU2U3/t2 * (aU3-aU2) * (aU2-aT2) * sIII_T2U2U3 + ( tU2U3/t2 * (aU3-aU2) - tT2U3/t2 * (aU3-aT2) ) * sII_T2U3;
+		}
+		if (d1 || d2 || d3) sY3v1[k]  = tU1U2/t1 *       ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * sIII_U1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * sII_U1U3 );
+		if (d1 || d2 || d3 || dR) {
+			sY3x2[k]  = tU2U3/t2 * (aU3-aU2) * (aU2-aT1) * sIII_T1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tT1U3/t2 * (aU3-aT1) ) * sII_T1U3;
+			sY3w1[k]  = tU1U2/t1 * aT1 * ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * sIV_T1U1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * sIII_T1U1U3 );
+			sY3z1[k]  = tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * sIV_T1U1U2U3
+					  //
+					  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1)             * sIII_T1U2U3
+					  - tU2U3/t2 * (aU3-aU2) * tT1U2/t1 * (aU2-aT1)             * sIII_T1U2U3
+					  //
+					  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1             * (aU1-aT1) * sIII_T1U1U3
+					  - tU1U3/t2 * (aU3-aU1) * tU1U2/t1             * (aU1-aT1) * sIII_T1U1U3
+					  //
+					  + tU2U3/t2 * (aU3-aU2) * tU1U2/t1                         * sII_T1U3
+					  - tU1U3/t2 * (aU3-aU1) * tU1U2/t1                         * sII_T1U3
+					  //
+					  - tU2U3/t2 * (aU3-aU2) * tT1U2/t1                         * sII_T1U3
+					  + tT1U3/t2 * (aU3-aT1) * tT1U2/t1                         * sII_T1U3;
+		}
 		// sigmaY2 & sigmaY3 -- these have amplitudes and therefore are the full initial values of Y2 and Y3 for each tooth, unlike other sigmas
 		sigmaY2[k] = ampV1*sY2v1[k] + ampW1*sY2w1[k] + ampZ1*sY2z1[k];
 		sigmaY3[k] = ampV2*sY3v2[k] + ampW2*sY3w2[k] + ampZ2*sY3z2[k] + ampX2*sY3x2[k] + ampV1*sY3v1[k] + ampW1*sY3w1[k] + ampZ1*sY3z1[k];
 	}
 	
-// End of cycle exp factors
-	eU1tCyc	= Exp(-tCyc/tU1);
-	eU2tCyc	= Exp(-tCyc/tU2);
-	eU3tCyc	= Exp(-tCyc/tU3);
 // Initial values of populations
-	V10 = Vcap(1,a,tCyc) / (1-eU1tCyc);
-	V20 = Vcap(2,a,tCyc) / (1-eU2tCyc);
-	V30 = Vcap(3,a,tCyc) / (1-eU3tCyc);
+	V10 = Vcap(ctx,1,a,tCyc) / (1-eU1tCyc);
+	V20 = Vcap(ctx,2,a,tCyc) / (1-eU2tCyc);
+	V30 = Vcap(ctx,3,a,tCyc) / (1-eU3tCyc);
 	//////////////////////////////////////////
-	W10 = Wcap(1,a,tCyc) / (1-eU1tCyc);
-	W20 = Wcap(2,a,tCyc) / (1-eU2tCyc);
-	W30 = Wcap(3,a,tCyc) / (1-eU3tCyc);
+	W10 = Wcap(ctx,1,a,tCyc) / (1-eU1tCyc);
+	W20 = Wcap(ctx,2,a,tCyc) / (1-eU2tCyc);
+	W30 = Wcap(ctx,3,a,tCyc) / (1-eU3tCyc);
 	//////////////////////////////////////////
-	Z10 = Zcap(1,a,tCyc) / (1-eU1tCyc);
-	Z20 = Zcap(2,a,tCyc) / (1-eU2tCyc);
-	Z30 = Zcap(3,a,tCyc) / (1-eU3tCyc);
+	Z10 = Zcap(ctx,1,a,tCyc) / (1-eU1tCyc);
+	Z20 = Zcap(ctx,2,a,tCyc) / (1-eU2tCyc);
+	Z30 = Zcap(ctx,3,a,tCyc) / (1-eU3tCyc);
 	//////////////////////////////////////////
-	X20 = Xcap(2,a,tCyc) / (1-eU2tCyc);
-	X30 = Xcap(3,a,tCyc) / (1-eU3tCyc);
+	X20 = Xcap(ctx,2,a,tCyc) / (1-eU2tCyc);
+	X30 = Xcap(ctx,3,a,tCyc) / (1-eU3tCyc);
 	//////////////////////////////////////////
 	U10 = ( V10 + W10 + Z10 );
-	Y20 = ( Ycap(2,a,tCyc) + U10 * tU1/t1 * tU2/(tU2-tU1) * ( eU2tCyc - eU1tCyc ) ) / ( 1 - eU2tCyc );
+	Y20 = ( Ycap(ctx,2,a,tCyc) + U10 * tU1/t1 * tU2/(tU2-tU1) * ( eU2tCyc - eU1tCyc ) ) / ( 1 - eU2tCyc );
 	//////////////////////////////////////////
 	U20 = ( V20 + W20 + Z20 + X20 + Y20 );
-	Y30 = ( Ycap(3,a,tCyc)
+	Y30 = ( Ycap(ctx,3,a,tCyc)
 		+ U20 * tU2/t2 * tU3/(tU3-tU2) * ( eU3tCyc - eU2tCyc )
 		+ U10 * tU1/t1 * tU2/t2 * tU3/(tU3-tU2)/(tU3-tU1)/(tU2-tU1) * ( tU1 * (tU3-tU2) * eU1tCyc - tU2 * (tU3-tU1) * eU2tCyc + tU3 * (tU2-tU1) * eU3tCyc ) ) / ( 1 - eU3tCyc );
 //	U30 = ( V30 + W30 + Z30 + X30 + Y30 );
 //	printf("Parameter-dependent values computed.\n");
-//	printf("Y20=%f, Y30=%f, Ycap(3,a,tCyc)=%f\n", Y20, Y30, Ycap(3,a,tCyc));
+//	printf("Y20=%f, Y30=%f, Ycap(ctx,3,a,tCyc)=%f\n", Y20, Y30, Ycap(ctx,3,a,tCyc));
+	memcpy(ctx->lastPar,a,ctx->nPars*sizeof(Double_t));
 }
 
 //////////////////////////////////////////////////////////////////////////
 // "r" functions
 // Instantaneous detection rate
 //////////////////////////////////////////////////////////////////////////
-Double_t BFitNamespace::rDC (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rDC (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	return a[nCyc]*a[DC];
 }
-Double_t BFitNamespace::rT1 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rT1 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
-	return a[nCyc]*a[epsT]*Ttot(1,a,t[0])/t1;
+	Double_t t1 = ctx->t1;
+	return a[nCyc]*a[epsT]*Ttot(ctx,1,a,t[0])/t1;
 }
-Double_t BFitNamespace::rT2 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rT2 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
-	return a[nCyc]*a[epsT]*Ttot(2,a,t[0])/t2;
+	Double_t t2 = ctx->t2;
+	return a[nCyc]*a[epsT]*Ttot(ctx,2,a,t[0])/t2;
 }
-Double_t BFitNamespace::rT3 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rT3 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
-	return a[nCyc]*a[epsT]*Ttot(3,a,t[0])/t3;
+	Double_t t3 = ctx->t3;
+	return a[nCyc]*a[epsT]*Ttot(ctx,3,a,t[0])/t3;
 }
-Double_t BFitNamespace::rU1 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rU1 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
-	return rV1(t,a) + rW1(t,a) + rZ1(t,a);
-	//a[nCyc]*a[epsU]*(a[epsV]*Vtot(1,a,t[0]) + a[epsW]*Wtot(1,a,t[0]) + a[epsZ]*Ztot(1,a,t[0]))/t1;
+	Double_t t1 = ctx->t1;
+	return rV1(ctx,t,a) + rW1(ctx,t,a) + rZ1(ctx,t,a);
+	//a[nCyc]*a[epsU]*(a[epsV]*Vtot(ctx,1,a,t[0]) + a[epsW]*Wtot(ctx,1,a,t[0]) + a[epsZ]*Ztot(ctx,1,a,t[0]))/t1;
 }
-Double_t BFitNamespace::rU2 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rU2 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
-	return rV2(t,a) + rW2(t,a) + rZ2(t,a) + rX2(t,a) + rY2(t,a);
-	//a[nCyc]*a[epsU]*(a[epsV]*Vtot(2,a,t[0]) + a[epsW]*Wtot(2,a,t[0]) + a[epsZ]*Ztot(2,a,t[0]) + a[epsX]*Xtot(2,a,t[0]) + a[epsY]*Ytot(2,a,t[0]))/t2;
+	Double_t t2 = ctx->t2;
+	return rV2(ctx,t,a) + rW2(ctx,t,a) + rZ2(ctx,t,a) + rX2(ctx,t,a) + rY2(ctx,t,a);
+	//a[nCyc]*a[epsU]*(a[epsV]*Vtot(ctx,2,a,t[0]) + a[epsW]*Wtot(ctx,2,a,t[0]) + a[epsZ]*Ztot(ctx,2,a,t[0]) + a[epsX]*Xtot(ctx,2,a,t[0]) + a[epsY]*Ytot(ctx,2,a,t[0]))/t2;
 }
-Double_t BFitNamespace::rU3 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rU3 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
-	return rV3(t,a) + rW3(t,a) + rZ3(t,a) + rX3(t,a) + rY3(t,a);
-	//a[nCyc]*a[epsU]*(a[epsV]*Vtot(3,a,t[0]) + a[epsW]*Wtot(3,a,t[0]) + a[epsZ]*Ztot(3,a,t[0]) + a[epsX]*Xtot(3,a,t[0]) + a[epsY]*Ytot(3,a,t[0]))/t3;
+	Double_t t3 = ctx->t3;
+	return rV3(ctx,t,a) + rW3(ctx,t,a) + rZ3(ctx,t,a) + rX3(ctx,t,a) + rY3(ctx,t,a);
+	//a[nCyc]*a[epsU]*(a[epsV]*Vtot(ctx,3,a,t[0]) + a[epsW]*Wtot(ctx,3,a,t[0]) + a[epsZ]*Ztot(ctx,3,a,t[0]) + a[epsX]*Xtot(ctx,3,a,t[0]) + a[epsY]*Ytot(ctx,3,a,t[0]))/t3;
 }
-Double_t BFitNamespace::rV1 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rV1 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
-	return a[nCyc]*a[epsU]*a[epsV]*Vtot(1,a,t[0])/t1;
+	Double_t t1 = ctx->t1;
+	return a[nCyc]*a[epsU]*a[epsV]*Vtot(ctx,1,a,t[0])/t1;
 }
-Double_t BFitNamespace::rV2 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rV2 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
-	return a[nCyc]*a[epsU]*a[epsV]*Vtot(2,a,t[0])/t2;
+	Double_t t2 = ctx->t2;
+	return a[nCyc]*a[epsU]*a[epsV]*Vtot(ctx,2,a,t[0])/t2;
 }
-Double_t BFitNamespace::rV3 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rV3 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
-	return a[nCyc]*a[epsU]*a[epsV]*Vtot(3,a,t[0])/t3;
+	Double_t t3 = ctx->t3;
+	return a[nCyc]*a[epsU]*a[epsV]*Vtot(ctx,3,a,t[0])/t3;
 }
-Double_t BFitNamespace::rW1 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rW1 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
-	return a[nCyc]*a[epsU]*a[epsW]*Wtot(1,a,t[0])/t1;
+	Double_t t1 = ctx->t1;
+	return a[nCyc]*a[epsU]*a[epsW]*Wtot(ctx,1,a,t[0])/t1;
 }
-Double_t BFitNamespace::rW2 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rW2 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
-	return a[nCyc]*a[epsU]*a[epsW]*Wtot(2,a,t[0])/t2;
+	Double_t t2 = ctx->t2;
+	return a[nCyc]*a[epsU]*a[epsW]*Wtot(ctx,2,a,t[0])/t2;
 }
-Double_t BFitNamespace::rW3 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rW3 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
-	return a[nCyc]*a[epsU]*a[epsW]*Wtot(3,a,t[0])/t3;
+	Double_t t3 = ctx->t3;
+	return a[nCyc]*a[epsU]*a[epsW]*Wtot(ctx,3,a,t[0])/t3;
 }
-Double_t BFitNamespace::rZ1 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rZ1 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
-	return a[nCyc]*a[epsU]*a[epsZ]*Ztot(1,a,t[0])/t1;
+	Double_t t1 = ctx->t1;
+	return a[nCyc]*a[epsU]*a[epsZ]*Ztot(ctx,1,a,t[0])/t1;
 }
-Double_t BFitNamespace::rZ2 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rZ2 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
-	return a[nCyc]*a[epsU]*a[epsZ]*Ztot(2,a,t[0])/t2;
+	Double_t t2 = ctx->t2;
+	return a[nCyc]*a[epsU]*a[epsZ]*Ztot(ctx,2,a,t[0])/t2;
 }
-Double_t BFitNamespace::rZ3 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rZ3 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
-	return a[nCyc]*a[epsU]*a[epsZ]*Ztot(3,a,t[0])/t3;
+	Double_t t3 = ctx->t3;
+	return a[nCyc]*a[epsU]*a[epsZ]*Ztot(ctx,3,a,t[0])/t3;
 }
-Double_t BFitNamespace::rX2 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rX2 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
-	return a[nCyc]*a[epsU]*a[epsX]*Xtot(2,a,t[0])/t2;
+	Double_t t2 = ctx->t2;
+	return a[nCyc]*a[epsU]*a[epsX]*Xtot(ctx,2,a,t[0])/t2;
 }
-Double_t BFitNamespace::rX3 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rX3 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
-	return a[nCyc]*a[epsU]*a[epsX]*Xtot(3,a,t[0])/t3;
+	Double_t t3 = ctx->t3;
+	return a[nCyc]*a[epsU]*a[epsX]*Xtot(ctx,3,a,t[0])/t3;
 }
-Double_t BFitNamespace::rY2 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rY2 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
-	return a[nCyc]*a[epsU]*a[epsY]*Ytot(2,a,t[0])/t2;
+	Double_t t2 = ctx->t2;
+	return a[nCyc]*a[epsU]*a[epsY]*Ytot(ctx,2,a,t[0])/t2;
 }
-Double_t BFitNamespace::rY3 (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rY3 (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
-	return a[nCyc]*a[epsU]*a[epsY]*Ytot(3,a,t[0])/t3;
+	Double_t t3 = ctx->t3;
+	return a[nCyc]*a[epsU]*a[epsY]*Ytot(ctx,3,a,t[0])/t3;
 }
-Double_t BFitNamespace::rAll (Double_t *t, Double_t *a) {
+Double_t BFitNamespace::rAll (ModelContext_t *ctx, Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	return a[nCyc]*a[DC] + rT1(t,a) + rT2(t,a) + rT3(t,a) + rU1(t,a) + rU2(t,a) + rU3(t,a);
+	return a[nCyc]*a[DC] + rT1(ctx,t,a) + rT2(ctx,t,a) + rT3(ctx,t,a) + rU1(ctx,t,a) + rU2(ctx,t,a) + rU3(ctx,t,a);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -393,37 +570,37 @@ Double_t BFitNamespace::rAll (Double_t *t, Double_t *a) {
 // -- these have the right signature for use in a TF1
 // -- must run ComputerParameterDependentVars() before calling these!
 /////////////////////////////////////////////////////////////////////
-Double_t BFitNamespace::yDC (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rDC(t,a); }
-Double_t BFitNamespace::yT1 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rT1(t,a); }
-Double_t BFitNamespace::yT2 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rT2(t,a); }
-Double_t BFitNamespace::yT3 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rT3(t,a); }
-Double_t BFitNamespace::yU1 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rU1(t,a); }
-Double_t BFitNamespace::yU2 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rU2(t,a); }
-Double_t BFitNamespace::yU3 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rU3(t,a); }
-Double_t BFitNamespace::yV1 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rV1(t,a); }
-Double_t BFitNamespace::yV2 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rV2(t,a); }
-Double_t BFitNamespace::yV3 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rV3(t,a); }
-Double_t BFitNamespace::yW1 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rW1(t,a); }
-Double_t BFitNamespace::yW2 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rW2(t,a); }
-Double_t BFitNamespace::yW3 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rW3(t,a); }
-Double_t BFitNamespace::yZ1 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rZ1(t,a); }
-Double_t BFitNamespace::yZ2 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rZ2(t,a); }
-Double_t BFitNamespace::yZ3 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rZ3(t,a); }
-Double_t BFitNamespace::yX2 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rX2(t,a); }
-Double_t BFitNamespace::yX3 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rX3(t,a); }
-Double_t BFitNamespace::yY2 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rY2(t,a); }
-Double_t BFitNamespace::yY3 (Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rY3(t,a); }
+Double_t BFitNamespace::yDC (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rDC(ctx,t,a); }
+Double_t BFitNamespace::yT1 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rT1(ctx,t,a); }
+Double_t BFitNamespace::yT2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rT2(ctx,t,a); }
+Double_t BFitNamespace::yT3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rT3(ctx,t,a); }
+Double_t BFitNamespace::yU1 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rU1(ctx,t,a); }
+Double_t BFitNamespace::yU2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rU2(ctx,t,a); }
+Double_t BFitNamespace::yU3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rU3(ctx,t,a); }
+Double_t BFitNamespace::yV1 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rV1(ctx,t,a); }
+Double_t BFitNamespace::yV2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rV2(ctx,t,a); }
+Double_t BFitNamespace::yV3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rV3(ctx,t,a); }
+Double_t BFitNamespace::yW1 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rW1(ctx,t,a); }
+Double_t BFitNamespace::yW2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rW2(ctx,t,a); }
+Double_t BFitNamespace::yW3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rW3(ctx,t,a); }
+Double_t BFitNamespace::yZ1 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rZ1(ctx,t,a); }
+Double_t BFitNamespace::yZ2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rZ2(ctx,t,a); }
+Double_t BFitNamespace::yZ3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rZ3(ctx,t,a); }
+Double_t BFitNamespace::yX2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rX2(ctx,t,a); }
+Double_t BFitNamespace::yX3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rX3(ctx,t,a); }
+Double_t BFitNamespace::yY2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rY2(ctx,t,a); }
+Double_t BFitNamespace::yY3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return a[dt]*BFitNamespace::rY3(ctx,t,a); }
 
 //////////////////////////////////////////////////////////////////////////
 // "o" functions
 // Offset functions to improve visualization: oT1 = yT1 + yDC
 //////////////////////////////////////////////////////////////////////////
-Double_t BFitNamespace::oT1 (Double_t *t, Double_t *a) { return BFitNamespace::yDC(t,a) + BFitNamespace::yT1(t,a); }
-Double_t BFitNamespace::oT2 (Double_t *t, Double_t *a) { return BFitNamespace::yDC(t,a) + BFitNamespace::yT2(t,a); }
-Double_t BFitNamespace::oT3 (Double_t *t, Double_t *a) { return BFitNamespace::yDC(t,a) + BFitNamespace::yT3(t,a); }
-Double_t BFitNamespace::oU1 (Double_t *t, Double_t *a) { return BFitNamespace::yDC(t,a) + BFitNamespace::yU1(t,a); }
-Double_t BFitNamespace::oU2 (Double_t *t, Double_t *a) { return BFitNamespace::yDC(t,a) + BFitNamespace::yU2(t,a); }
-Double_t BFitNamespace::oU3 (Double_t *t, Double_t *a) { return BFitNamespace::yDC(t,a) + BFitNamespace::yU3(t,a); }
+Double_t BFitNamespace::oT1 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return BFitNamespace::yDC(ctx,t,a) + BFitNamespace::yT1(ctx,t,a); }
+Double_t BFitNamespace::oT2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return BFitNamespace::yDC(ctx,t,a) + BFitNamespace::yT2(ctx,t,a); }
+Double_t BFitNamespace::oT3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return BFitNamespace::yDC(ctx,t,a) + BFitNamespace::yT3(ctx,t,a); }
+Double_t BFitNamespace::oU1 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return BFitNamespace::yDC(ctx,t,a) + BFitNamespace::yU1(ctx,t,a); }
+Double_t BFitNamespace::oU2 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return BFitNamespace::yDC(ctx,t,a) + BFitNamespace::yU2(ctx,t,a); }
+Double_t BFitNamespace::oU3 (ModelContext_t *ctx, Double_t *t, Double_t *a) { return BFitNamespace::yDC(ctx,t,a) + BFitNamespace::yU3(ctx,t,a); }
 
 /*
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
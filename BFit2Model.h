@@ -4,10 +4,44 @@
 
 #include "Rtypes.h"
 #include "TString.h"
+#include "CSVtoStruct.h"
 
 namespace BFitNamespace {
 	
 	enum ParIndex { nCyc, dt, DC, r1, r2, r3, p, rho, epsT, epsU, epsV, epsW, epsX, epsY, epsZ, gammaT1, gammaT2, gammaT3, gammaU1, gammaU2, gammaU3 };
+	const Int_t nParIndex = gammaU3 + 1; // number of entries in ParIndex
+// Population flags for selecting which detection rates to sum (rIntegral(popU2,...) is the integral of rU2, etc.)
+	enum PopFlag {
+		popDC = 0x00001,
+		popT1 = 0x00002, popT2 = 0x00004, popT3 = 0x00008,
+		popV1 = 0x00010, popV2 = 0x00020, popV3 = 0x00040,
+		popW1 = 0x00080, popW2 = 0x00100, popW3 = 0x00200,
+		popZ1 = 0x00400, popZ2 = 0x00800, popZ3 = 0x01000,
+		                 popX2 = 0x02000, popX3 = 0x04000,
+		                 popY2 = 0x08000, popY3 = 0x10000,
+		popU1 = popV1 | popW1 | popZ1,
+		popU2 = popV2 | popW2 | popZ2 | popX2 | popY2,
+		popU3 = popV3 | popW3 | popZ3 | popX3 | popY3,
+		popAll = popDC | popT1 | popT2 | popT3 | popU1 | popU2 | popU3
+	};
+// Exponential flags: the six exponentials exp(-tn/tT1) ... exp(-tn/tU3) that every rate in a
+// capture tooth is a sum of (the background uses the three U ones), in ToothCoefficients() order
+	enum ExpFlag {
+		expT1 = 0x01, expT2 = 0x02, expT3 = 0x04,
+		expU1 = 0x08, expU2 = 0x10, expU3 = 0x20,
+		expAll = 0x3F
+	};
+// Dependency groups of the parameter-dependent values: ComputeParameterDependentVars() only
+// recomputes the groups whose pars changed. nCyc, dt, DC and the eps's are in no group,
+// since they only scale the rates.
+	enum DepGroup {
+		depAmp		= 0x01, // r1, r2, r3, p: amplitudes, sigmaY2, sigmaY3 and initial values only
+		depRho		= 0x02, // rho: every sigma except the V's, + the depAmp values
+		depSpecies1	= 0x04, // gammaT1, gammaU1: lifetimes of species 1 and its sigmas, + the depAmp values
+		depSpecies2	= 0x08, // gammaT2, gammaU2 (and gammaT3 for 134sb, where it follows gammaT2)
+		depSpecies3	= 0x10, // gammaT3, gammaU3
+		depAll = depAmp | depRho | depSpecies1 | depSpecies2 | depSpecies3
+	};
 	// a[dt]	= bin width in ms
 	// a[DC]	= DC detection rate in cycles/ms
 	// a[r1]	= Species 1 injection rate in cycles/ms
@@ -31,29 +65,91 @@ namespace BFitNamespace {
 	// a[gammaU3]	= Non-radioactive decay rate of untrapped species 3 population (U3) (1/s)
 	// NB: the words are array indices, ie. numbers! If you put p instead of a[p] you will get 
 	
+	const Double_t iota = 1e-9; // tiny number for avoiding divide-by-0
+	
+// Model context -- everything the model functions need besides t and the parameters:
+// the case constants and the parameter-dependent values that ComputeParameterDependentVars()
+// precomputes. Each fit has its own context and every model function takes it as the first
+// argument, so there are no globals or static locals in the model and several fits can be
+// evaluated at once (one context per thread).
+	struct GradVars_t; // dual copies of the parameter-dependent values (BFit2Gradient.cxx)
+	struct ModelContext_t {
+	// These never change during fitting and are set in InitModelContext()
+		Int_t		nPars; // number of model parameters
+		Double_t	tCap, tBac, tCyc; // cycle times (ms)
+		Double_t	t1, t2, t3; // radioactive lifetimes (ms)
+		Int_t		nCapMax; // number of injections per cycle
+		bool		b134sbFlag; // flag for 134sb cases which get special treatment
+		Int_t		activeExp; // ExpFlag bits of the exponentials the fit can make nonzero (expAll unless SetActiveExponentials() is called)
+		const Int_t	*pbToggle; // if set, UpdateParameterDependentVars() prints the toggled pars when they change
+		Double_t	*timeOfCapt; // injection times
+	// These change only when the parameters change and are set in ComputeParameterDependentVars()
+	// (lastPar holds the pars they were computed for)
+		Int_t		nParChanges; // counts # of times pars have changed
+		Double_t	*lastPar; // holds most recent paramter values for comparison
+		Double_t	tT1, tT2, tT3, tU1, tU2, tU3; // modified lifetimes
+		Double_t	aT1, aT2, aT3, aU1, aU2, aU3; // Decay factors for one capture interval tCap
+		Double_t	eU1tCyc, eU2tCyc, eU3tCyc; // background decay at end of cycle: exp(-tCyc/tU1), ...
+		Double_t	tT1U2, tT1U3, tU1U2, tU1U3, tT2U3, tU2U3; // Coefficients used in Y2 and Y3
+		Double_t	*sigmaT1, *sigmaT2, *sigmaT3;
+		Double_t	*sigmaV1, *sigmaV2, *sigmaV3;
+		Double_t	*sigmaW1, *sigmaW2, *sigmaW3;
+		Double_t	*sigmaZ1, *sigmaZ2, *sigmaZ3;
+		Double_t			  *sigmaX2, *sigmaX3;
+		Double_t			  *sigmaY2, *sigmaY3;
+		Double_t	*sY2v1, *sY2w1, *sY2z1;
+		Double_t	*sY3v2, *sY3w2, *sY3z2, *sY3x2, *sY3v1, *sY3w1, *sY3z1;
+		Double_t	ampT1, ampT2, ampT3; // amplitudes of the T pops
+		Double_t	ampV1, ampV2, ampV3; // amplitudes of the V pops
+		Double_t	ampW1, ampW2, ampW3; // amplitudes of the W pops
+		Double_t	ampZ1, ampZ2, ampZ3; // amplitudes of the Z pops
+		Double_t		   ampX2, ampX3;  // amplitudes of the X pops
+		Double_t	V10, V20, V30, W10, W20, W30, Z10, Z20, Z30, X20, X30, Y20, Y30, U10, U20; // initial value (t=0) for each pop
+	// Derivatives for the gradient functions, allocated on first use
+		GradVars_t	*grad;
+	};
+// Set up a context for the BDN case, with the parameter-dependent values computed for par
+	void InitModelContext (ModelContext_t*, const BDNCase_t*, Int_t nPars, Double_t *par);
+	void FreeModelContext (ModelContext_t*);
+	void FreeGradVars (GradVars_t*);
+	
+// TF1 adapter: binds a context to one of the r, y, o functions below, eg.
+//   TF1 *fyAll = new TF1("fyAll", ModelFunctor(&ctx, yAll), 0.0, ctx.tCyc, ctx.nPars);
+	typedef Double_t (*ModelFunction_t) (ModelContext_t*, Double_t*, Double_t*);
+	struct ModelFunctor {
+		ModelContext_t	*ctx;
+		ModelFunction_t	fn;
+		ModelFunctor (ModelContext_t *c, ModelFunction_t f) : ctx(c), fn(f) {}
+		Double_t operator() (Double_t *t, Double_t *a) const { return fn(ctx, t, a); }
+	};
+	
 // Function used to detect when the fitter changes the parameters
 	bool CompareParArrays (const Double_t*, const Double_t*, size_t n, Double_t eps);
-	void ComputeParameterDependentVars (Double_t*);
+	Int_t ParDependencies (Int_t index);
+	Int_t ChangedDependencies (const Double_t*, const Double_t*, size_t n, Double_t eps);
+	void ComputeParameterDependentVars (ModelContext_t*, Double_t*, Int_t groups = depAll);
+	bool UpdateParameterDependentVars (ModelContext_t*, Double_t*);
 //	void ComputeTimeDependentVars (Double_t*, Double_t*);
 //	void ComputePopulations (Double_t*, Double_t*);
 	
 // Ion populations by type -- Each takes species number as first argument
-	Double_t Ttot		(Int_t, Double_t*, Double_t);
-	Double_t Utot		(Int_t, Double_t*, Double_t);
-	Double_t Vtot		(Int_t, Double_t*, Double_t);
-	Double_t Wtot		(Int_t, Double_t*, Double_t);
-	Double_t Ztot		(Int_t, Double_t*, Double_t);
-	Double_t Xtot		(Int_t, Double_t*, Double_t);
-	Double_t Ytot		(Int_t, Double_t*, Double_t);
+	Double_t Ttot		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Utot		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Vtot		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Wtot		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Ztot		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Xtot		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Ytot		(ModelContext_t*, Int_t, Double_t*, Double_t);
 // For untrapped pops, just the component that grows during capture
-	Double_t Ucap		(Int_t, Double_t*, Double_t);
-	Double_t Vcap		(Int_t, Double_t*, Double_t);
-	Double_t Wcap		(Int_t, Double_t*, Double_t);
-	Double_t Zcap		(Int_t, Double_t*, Double_t);
-	Double_t Xcap		(Int_t, Double_t*, Double_t);
-	Double_t Ycap		(Int_t, Double_t*, Double_t);
-	Double_t Ybkgd		(Int_t, Double_t);
-// Helper functions to calculate pops
+	Double_t Ucap		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Vcap		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Wcap		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Zcap		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Xcap		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Ycap		(ModelContext_t*, Int_t, Double_t*, Double_t);
+	Double_t Ybkgd		(ModelContext_t*, Int_t, Double_t);
+// Closed forms of the sigma series. ComputeParameterDependentVars() builds the sigma arrays
+// by recurrence instead; these are kept for reference and for BFit2SigmaTest.
 	Double_t sigmaI			(Double_t, Double_t, Int_t);
 	Double_t sigmaII		(Double_t, Double_t, Double_t, Int_t);
 	Double_t sigmaIII		(Double_t, Double_t, Double_t, Double_t, Int_t);
@@ -113,89 +209,73 @@ namespace BFitNamespace {
 //	Double_t yY (Int_t, Double_t*, Double_t);
 // These are kept as a layer having the signature that works easily in ROOT
 // They just call the yT, yV, etc...
-	Double_t yDC (Double_t*, Double_t*);
-	Double_t yT1 (Double_t*, Double_t*);
-	Double_t yT2 (Double_t*, Double_t*);
-	Double_t yT3 (Double_t*, Double_t*);
-	Double_t yU1 (Double_t*, Double_t*);
-	Double_t yU2 (Double_t*, Double_t*);
-	Double_t yU3 (Double_t*, Double_t*);
-	Double_t yV1 (Double_t*, Double_t*);
-	Double_t yV2 (Double_t*, Double_t*);
-	Double_t yV3 (Double_t*, Double_t*);
-	Double_t yW1 (Double_t*, Double_t*);
-	Double_t yW2 (Double_t*, Double_t*);
-	Double_t yW3 (Double_t*, Double_t*);
-	Double_t yX2 (Double_t*, Double_t*);
-	Double_t yX3 (Double_t*, Double_t*);
-	Double_t yY2 (Double_t*, Double_t*);
-	Double_t yY3 (Double_t*, Double_t*);
-	Double_t yZ1 (Double_t*, Double_t*);
-	Double_t yZ2 (Double_t*, Double_t*);
-	Double_t yZ3 (Double_t*, Double_t*);
-	Double_t yAll (Double_t*, Double_t*);
+	Double_t yDC (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yT1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yT2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yT3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yU1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yU2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yU3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yV1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yV2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yV3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yW1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yW2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yW3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yX2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yX3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yY2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yY3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yZ1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yZ2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yZ3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t yAll (ModelContext_t*, Double_t*, Double_t*);
+// Whole-histogram evaluation of yAll at an array of times (BFit2Batch.cxx)
+	void yAllBatch (ModelContext_t*, Int_t, const Double_t*, Double_t*, Double_t*);
+	void ToothCoefficients (ModelContext_t*, Double_t*, Int_t, Double_t*, Int_t pops = popAll);
+	void BackgroundCoefficients (ModelContext_t*, Double_t*, Double_t*, Int_t pops = popAll);
+	void SetActiveExponentials (ModelContext_t*, const Double_t*, const Int_t*);
+// Exact integrals of the detection rates over [lo,hi] in ms (BFit2Integrals.cxx)
+// rIntegral = integral of rX = # of betas detected; yIntegral = integral of yX
+	Double_t rIntegral (ModelContext_t*, Int_t, Double_t*, Double_t, Double_t);
+	Double_t yIntegral (ModelContext_t*, Int_t, Double_t*, Double_t, Double_t);
+	void yAllBatchIntegral (ModelContext_t*, Int_t, const Double_t*, const Double_t*, Double_t*, Double_t*);
+// The same with derivatives wrt every parameter, dyda[k*nParIndex+j] = dy[k]/da[j] (BFit2Gradient.cxx)
+	void yAllBatchGradient (ModelContext_t*, Int_t, const Double_t*, Double_t*, Double_t*, Double_t*);
+	void yAllBatchIntegralGradient (ModelContext_t*, Int_t, const Double_t*, const Double_t*, Double_t*, Double_t*, Double_t*);
+	Double_t rIntegralGradient (ModelContext_t*, Int_t, Double_t*, Double_t, Double_t, Double_t*);
 	
 // Detection rates (/ms) for calculating integrals --> # of betas
-	Double_t rDC (Double_t*, Double_t*);
-	Double_t rT1 (Double_t*, Double_t*);
-	Double_t rT2 (Double_t*, Double_t*);
-	Double_t rT3 (Double_t*, Double_t*);
-	Double_t rU1 (Double_t*, Double_t*);
-	Double_t rU2 (Double_t*, Double_t*);
-	Double_t rU3 (Double_t*, Double_t*);
-	Double_t rV1 (Double_t*, Double_t*);
-	Double_t rV2 (Double_t*, Double_t*);
-	Double_t rV3 (Double_t*, Double_t*);
-	Double_t rW1 (Double_t*, Double_t*);
-	Double_t rW2 (Double_t*, Double_t*);
-	Double_t rW3 (Double_t*, Double_t*);
-	Double_t rX2 (Double_t*, Double_t*);
-	Double_t rX3 (Double_t*, Double_t*);
-	Double_t rY2 (Double_t*, Double_t*);
-	Double_t rY3 (Double_t*, Double_t*);
-	Double_t rZ1 (Double_t*, Double_t*);
-	Double_t rZ2 (Double_t*, Double_t*);
-	Double_t rZ3 (Double_t*, Double_t*);
-	Double_t rAll (Double_t*, Double_t*);
+	Double_t rDC (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rT1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rT2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rT3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rU1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rU2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rU3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rV1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rV2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rV3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rW1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rW2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rW3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rX2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rX3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rY2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rY3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rZ1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rZ2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rZ3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t rAll (ModelContext_t*, Double_t*, Double_t*);
 	
 // Offset functions to improve visualization: oTi = yTi + yDC
-	Double_t oT1 (Double_t*, Double_t*);
-	Double_t oT2 (Double_t*, Double_t*);
-	Double_t oT3 (Double_t*, Double_t*);
-	Double_t oU1 (Double_t*, Double_t*);
-	Double_t oU2 (Double_t*, Double_t*);
-	Double_t oU3 (Double_t*, Double_t*);
+	Double_t oT1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t oT2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t oT3 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t oU1 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t oU2 (ModelContext_t*, Double_t*, Double_t*);
+	Double_t oU3 (ModelContext_t*, Double_t*, Double_t*);
 	
 }
 
-// Variables to hold integrals of functions
-static Double_t T1_integral = 0.0;
-static Double_t T2_integral = 0.0;
-static Double_t T3_integral = 0.0;
-static Double_t U1_integral = 0.0;
-static Double_t U2_integral = 0.0;
-static Double_t U3_integral = 0.0;
-static Double_t DC_integral = 0.0;
-static Double_t All_integral = 0.0;
-
-static Double_t U1_integral_trap_empty = 0.0;
-static Double_t U2_integral_trap_empty = 0.0;
-static Double_t U3_integral_trap_empty = 0.0;
-static Double_t U1_integral_trap_full = 0.0;
-static Double_t U2_integral_trap_full = 0.0;
-static Double_t U3_integral_trap_full = 0.0;
-
-static Double_t Integral_sum = 0.0;
-
-static Double_t T1_integral_error = 0.0;
-static Double_t T2_integral_error = 0.0;
-static Double_t T3_integral_error = 0.0;
-static Double_t U1_integral_error = 0.0;
-static Double_t U2_integral_error = 0.0;
-static Double_t U3_integral_error = 0.0;
-static Double_t DC_integral_error = 0.0;
-static Double_t All_integral_error = 0.0;
-
-static Double_t Integral_sum_error = 0.0;
-
 #endif
@@ -4,7 +4,9 @@
 using namespace std;
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// sigmas
+// sigmas -- closed forms, with iota to dodge 0/0 when two decay factors are equal.
+// Not used by the model any more: ComputeParameterDependentVars() gets the same
+// series by recurrence over the teeth. BFit2SigmaTest checks the two against each other.
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 Double_t BFitNamespace::sigmaI (Double_t r, Double_t a, Int_t n) {
 	using namespace TMath;
@@ -12,30 +14,27 @@ Double_t BFitNamespace::sigmaI (Double_t r, Double_t a, Int_t n) {
 }
 Double_t BFitNamespace::sigmaII (Double_t r, Double_t a1, Double_t a2, Int_t n) {
 	using namespace TMath;
-	extern Double_t iota, tCap;
 	return 1/(1-r*a1) * ( (1-Power(a2,n-1))/(1-a2) - r*a1 * (Power(a2,n-1)-Power(r*a1,n-1)+iota)/(a2-r*a1+iota) );
 }
 Double_t BFitNamespace::sigmaIII (Double_t r, Double_t aT1, Double_t aU1, Double_t aU2, Int_t n) {
 	using namespace TMath;
-	extern Double_t iota, tCap;
 	return 1/(1-r*aT1) * ( 1/(1-aU1) * ( (1-Power(aU2,n-1))/(1-aU2) - (Power(aU2,n-1)-Power(aU1,n-1))/(aU2-aU1) ) - (r*aT1+iota)/(aU1-r*aT1+iota) * ( (Power(aU2,n-1)-Power(aU1,n-1))/(aU2-aU1) - (Power(aU2,n-1)-Power(r*aT1,n-1))/(aU2-r*aT1) ) );
 }
 Double_t BFitNamespace::sigmaIV (Double_t r, Double_t aT1, Double_t aU1, Double_t aU2, Double_t aU3, Int_t n) {
 	using namespace TMath;
-	extern Double_t iota;
 	return 1/(1-r*aT1) * ( 1/(1-aU1) * ( 1/(1-aU2) * ( (1-Power(aU3,n-1))/(1-aU3) - (Power(aU3,n-1)-Power(aU2,n-1))/(aU3-aU2) ) - 1/(aU2-aU1) * ( (Power(aU3,n-1)-Power(aU2,n-1))/(aU3-aU2) - (Power(aU3,n-1)-Power(aU1,n-1))/(aU3-aU1) ) ) - (r*aT1+iota)/(aU1-r*aT1+iota) * ( ( 1/(aU2-aU1) * ( (Power(aU3,n-1)-Power(aU2,n-1))/(aU3-aU2) - (Power(aU3,n-1)-Power(aU1,n-1))/(aU3-aU1) ) ) - 1/(aU2-r*aT1) * ( (Power(aU3,n-1)-Power(aU2,n-1))/(aU3-aU2) - (Power(aU3,n-1)-Power(r*aT1,n-1))/(aU3-r*aT1) ) ) );
 }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // T populations
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::Ttot (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Ttot (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tCap, tBac, tCyc, tT1, tT2, tT3;
-	extern Double_t ampT1, ampT2, ampT3, *sigmaT1, *sigmaT2, *sigmaT3;
-	static Double_t f;
-	static Int_t n;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tCyc = ctx->tCyc, tT1 = ctx->tT1, tT2 = ctx->tT2, tT3 = ctx->tT3;
+	Double_t ampT1 = ctx->ampT1, ampT2 = ctx->ampT2, ampT3 = ctx->ampT3, *sigmaT1 = ctx->sigmaT1, *sigmaT2 = ctx->sigmaT2, *sigmaT3 = ctx->sigmaT3;
+	Double_t f;
+	Int_t n;
 	f = 0.0;
 	n = Ceil((tvar-tBac)/tCap);
 	if (tvar==tBac) n=1;
@@ -49,37 +48,37 @@ Double_t BFitNamespace::Ttot (Int_t i, Double_t *a, Double_t tvar) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // U populations -- made of V, W, Z, X, Y
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::Utot (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Utot (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tBac, tCyc;
-	static Double_t f;
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc;
+	Double_t f;
 	f = 0.0;
 	if (tBac <= tvar && tvar <= tCyc) {
-		if (i==1) f = Vtot(1,a,tvar) + Wtot(1,a,tvar) + Ztot(1,a,tvar);
-		if (i==2) f = Vtot(2,a,tvar) + Wtot(2,a,tvar) + Ztot(2,a,tvar) + Xtot(2,a,tvar) + Ytot(2,a,tvar);
-		if (i==3) f = Vtot(3,a,tvar) + Wtot(3,a,tvar) + Ztot(3,a,tvar) + Xtot(3,a,tvar) + Ytot(3,a,tvar);
+		if (i==1) f = Vtot(ctx,1,a,tvar) + Wtot(ctx,1,a,tvar) + Ztot(ctx,1,a,tvar);
+		if (i==2) f = Vtot(ctx,2,a,tvar) + Wtot(ctx,2,a,tvar) + Ztot(ctx,2,a,tvar) + Xtot(ctx,2,a,tvar) + Ytot(ctx,2,a,tvar);
+		if (i==3) f = Vtot(ctx,3,a,tvar) + Wtot(ctx,3,a,tvar) + Ztot(ctx,3,a,tvar) + Xtot(ctx,3,a,tvar) + Ytot(ctx,3,a,tvar);
 	}
 	return f;
 }
-Double_t BFitNamespace::Ucap (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Ucap (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tBac, tCyc;
-	static Double_t f;
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc;
+	Double_t f;
 	f = 0.0;
-	if (i==1) f = Vcap(1,a,tvar) + Wcap(1,a,tvar) + Zcap(1,a,tvar);
-	if (i==2) f = Vcap(2,a,tvar) + Wcap(2,a,tvar) + Zcap(2,a,tvar) + Xcap(2,a,tvar) + Ycap(2,a,tvar);
-	if (i==3) f = Vcap(3,a,tvar) + Wcap(3,a,tvar) + Zcap(3,a,tvar) + Xcap(3,a,tvar) + Ycap(3,a,tvar);
+	if (i==1) f = Vcap(ctx,1,a,tvar) + Wcap(ctx,1,a,tvar) + Zcap(ctx,1,a,tvar);
+	if (i==2) f = Vcap(ctx,2,a,tvar) + Wcap(ctx,2,a,tvar) + Zcap(ctx,2,a,tvar) + Xcap(ctx,2,a,tvar) + Ycap(ctx,2,a,tvar);
+	if (i==3) f = Vcap(ctx,3,a,tvar) + Wcap(ctx,3,a,tvar) + Zcap(ctx,3,a,tvar) + Xcap(ctx,3,a,tvar) + Ycap(ctx,3,a,tvar);
 	return f;
 }
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // V populations
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::Vtot (Int_t i, Double_t *a, Double_t tvar) {
-	extern Double_t tBac, tCyc, tU1, tU2, tU3, V10, V20, V30;
-	static Double_t f;
+Double_t BFitNamespace::Vtot (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3, V10 = ctx->V10, V20 = ctx->V20, V30 = ctx->V30;
+	Double_t f;
 	f = 0.0; //catch bad values of tvar
 	if (0 <= tvar && tvar <= tCyc) {
 		if (i==1) f += V10 * TMath::Exp(-tvar/tU1);
@@ -87,16 +86,16 @@ Double_t BFitNamespace::Vtot (Int_t i, Double_t *a, Double_t tvar) {
 		if (i==3) f += V30 * TMath::Exp(-tvar/tU3);
 	}
 	if (tBac <= tvar && tvar <= tCyc)
-		f += BFitNamespace::Vcap(i,a,tvar);
+		f += BFitNamespace::Vcap(ctx,i,a,tvar);
 	return f;
 }
-Double_t BFitNamespace::Vcap (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Vcap (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tCap, tBac, tU1, tU2, tU3;
-	extern Double_t ampV1, ampV2, ampV3, *sigmaV1, *sigmaV2, *sigmaV3;
-	static Double_t f;
-	static Int_t n;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3;
+	Double_t ampV1 = ctx->ampV1, ampV2 = ctx->ampV2, ampV3 = ctx->ampV3, *sigmaV1 = ctx->sigmaV1, *sigmaV2 = ctx->sigmaV2, *sigmaV3 = ctx->sigmaV3;
+	Double_t f;
+	Int_t n;
 	f = 0.0;
 	n = Ceil((tvar-tBac)/tCap);
 	if (i==1) f = ampV1 * sigmaV1[n] * Exp(-(tvar-tBac-(n-1)*tCap)/tU1);
@@ -108,9 +107,9 @@ Double_t BFitNamespace::Vcap (Int_t i, Double_t *a, Double_t tvar) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // W populations
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::Wtot (Int_t i, Double_t *a, Double_t tvar) {
-	extern Double_t tBac, tCyc, tU1, tU2, tU3, W10, W20, W30;
-	static Double_t f;
+Double_t BFitNamespace::Wtot (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3, W10 = ctx->W10, W20 = ctx->W20, W30 = ctx->W30;
+	Double_t f;
 	f = 0.0; //catch bad values of tvar
 	if (0 <= tvar && tvar <= tCyc) {
 		if (i==1) f += W10 * TMath::Exp(-tvar/tU1);
@@ -118,17 +117,17 @@ Double_t BFitNamespace::Wtot (Int_t i, Double_t *a, Double_t tvar) {
 		if (i==3) f += W30 * TMath::Exp(-tvar/tU3);
 	}
 	if (tBac <= tvar && tvar <= tCyc)
-		f += BFitNamespace::Wcap(i,a,tvar);
+		f += BFitNamespace::Wcap(ctx,i,a,tvar);
 //	printf("Wtot: i=%d, par=%f, tvar=%f, f=%f\n",i,W30,tvar,f);
 	return f;
 }
-Double_t BFitNamespace::Wcap (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Wcap (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tCap, tBac, tT1, tT2, tT3, tU1, tU2, tU3;
-	extern Double_t ampW1, ampW2, ampW3, *sigmaW1, *sigmaW2, *sigmaW3;
-	static Double_t f;
-	static Int_t n;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tT1 = ctx->tT1, tT2 = ctx->tT2, tT3 = ctx->tT3, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3;
+	Double_t ampW1 = ctx->ampW1, ampW2 = ctx->ampW2, ampW3 = ctx->ampW3, *sigmaW1 = ctx->sigmaW1, *sigmaW2 = ctx->sigmaW2, *sigmaW3 = ctx->sigmaW3;
+	Double_t f;
+	Int_t n;
 	f = 0.0;
 	n = Ceil((tvar-tBac)/tCap);
 	if (i==1) f += ampW1 * sigmaW1[n] * Exp(-(tvar-tBac-(n-1)*tCap)/tU1);
@@ -141,9 +140,9 @@ Double_t BFitNamespace::Wcap (Int_t i, Double_t *a, Double_t tvar) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Z populations
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::Ztot (Int_t i, Double_t *a, Double_t tvar) {
-	extern Double_t tBac, tCyc, tU1, tU2, tU3, Z10, Z20, Z30;
-	static Double_t f;
+Double_t BFitNamespace::Ztot (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3, Z10 = ctx->Z10, Z20 = ctx->Z20, Z30 = ctx->Z30;
+	Double_t f;
 	f = 0.0; //catch bad values of tvar
 	if (0 <= tvar && tvar <= tCyc) {
 		if (i==1) f += Z10 * TMath::Exp(-tvar/tU1);
@@ -151,16 +150,16 @@ Double_t BFitNamespace::Ztot (Int_t i, Double_t *a, Double_t tvar) {
 		if (i==3) f += Z30 * TMath::Exp(-tvar/tU3);
 	}
 	if (tBac <= tvar && tvar <= tCyc)
-		f += BFitNamespace::Zcap(i,a,tvar);
+		f += BFitNamespace::Zcap(ctx,i,a,tvar);
 	return f;
 }
-Double_t BFitNamespace::Zcap (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Zcap (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tCap, tBac, tT1, tT2, tT3, tU1, tU2, tU3;
-	extern Double_t ampZ1, ampZ2, ampZ3, *sigmaT1, *sigmaT2, *sigmaT3, *sigmaZ1, *sigmaZ2, *sigmaZ3;
-	static Double_t f;
-	static Int_t n;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tT1 = ctx->tT1, tT2 = ctx->tT2, tT3 = ctx->tT3, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3;
+	Double_t ampZ1 = ctx->ampZ1, ampZ2 = ctx->ampZ2, ampZ3 = ctx->ampZ3, *sigmaT1 = ctx->sigmaT1, *sigmaT2 = ctx->sigmaT2, *sigmaT3 = ctx->sigmaT3, *sigmaZ1 = ctx->sigmaZ1, *sigmaZ2 = ctx->sigmaZ2, *sigmaZ3 = ctx->sigmaZ3;
+	Double_t f;
+	Int_t n;
 	f = 0.0;
 	n = Ceil((tvar-tBac)/tCap);
 	if (i==1) f += ampZ1 * ( sigmaZ1[n]*Exp(-(tvar-tBac-(n-1)*tCap)/tU1) - sigmaT1[n]*Exp(-(tvar-tBac-(n-1)*tCap)/tT1) );
@@ -172,25 +171,25 @@ Double_t BFitNamespace::Zcap (Int_t i, Double_t *a, Double_t tvar) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // X populations
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::Xtot (Int_t i, Double_t *a, Double_t tvar) {
-	extern Double_t tBac, tCyc, tU2, tU3, X20, X30;
-	static Double_t f;
+Double_t BFitNamespace::Xtot (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc, tU2 = ctx->tU2, tU3 = ctx->tU3, X20 = ctx->X20, X30 = ctx->X30;
+	Double_t f;
 	f = 0.0; //catch bad values of tvar
 	if (0 <= tvar && tvar <= tCyc) {
 		if (i==2) f += X20 * TMath::Exp(-tvar/tU2);
 		if (i==3) f += X30 * TMath::Exp(-tvar/tU3);
 	}
 	if (tBac <= tvar && tvar <= tCyc)
-		f += BFitNamespace::Xcap(i,a,tvar);
+		f += BFitNamespace::Xcap(ctx,i,a,tvar);
 	return f;
 }
-Double_t BFitNamespace::Xcap (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Xcap (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tCap, tBac, tT1, tT2, tU2, tU3;
-	extern Double_t ampX2, ampX3, *sigmaT1, *sigmaT2, *sigmaX2, *sigmaX3;
-	static Double_t f;
-	static Int_t n;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, tT1 = ctx->tT1, tT2 = ctx->tT2, tU2 = ctx->tU2, tU3 = ctx->tU3;
+	Double_t ampX2 = ctx->ampX2, ampX3 = ctx->ampX3, *sigmaT1 = ctx->sigmaT1, *sigmaT2 = ctx->sigmaT2, *sigmaX2 = ctx->sigmaX2, *sigmaX3 = ctx->sigmaX3;
+	Double_t f;
+	Int_t n;
 	f = 0.0;
 	n = Ceil((tvar-tBac)/tCap);
 	if (i==2) f += ampX2 * ( sigmaX2[n] * Exp(-(tvar-tBac-(n-1)*tCap)/tU2) - sigmaT1[n] * Exp(-(tvar-tBac-(n-1)*tCap)/tT1) );
@@ -201,23 +200,22 @@ Double_t BFitNamespace::Xcap (Int_t i, Double_t *a, Double_t tvar) {
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Y populations
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-Double_t BFitNamespace::Ytot (Int_t i, Double_t *a, Double_t tvar) {
-	extern Int_t nCap;
-	extern Double_t tBac, tCyc, tU1, tU2, tU3, U10, U20, Y20, Y30;
-	static Double_t f;
+Double_t BFitNamespace::Ytot (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3, U10 = ctx->U10, U20 = ctx->U20, Y20 = ctx->Y20, Y30 = ctx->Y30;
+	Double_t f;
 	f = 0.0;
 	if (0 <= tvar && tvar <= tCyc) {
-		f += BFitNamespace::Ybkgd(i,tvar);
+		f += BFitNamespace::Ybkgd(ctx,i,tvar);
 	//	if (i==2) f += Ybkgd(2,tvar);//Y20 * Exp(-tvar/tU2) + U10 * tU1/t1 * tU2/(tU2-tU1) * ( Exp(-tvar/tU2) - Exp(-tvar/tU1) );
 	//	if (i==3) f += Ybkgd(3,tvar);//Y3Background(U10,U20,Y30,tvar);
 	}
 	if (tBac < tvar && tvar <= tCyc)
-		f += BFitNamespace::Ycap(i,a,tvar);
+		f += BFitNamespace::Ycap(ctx,i,a,tvar);
 	return f;
 }
-Double_t BFitNamespace::Ybkgd (Int_t i, Double_t tvar) {
+Double_t BFitNamespace::Ybkgd (ModelContext_t *ctx, Int_t i, Double_t tvar) {
 	using namespace TMath;
-	extern Double_t tBac, tCyc, t1, t2, tU1, tU2, tU3, U10, U20, Y20, Y30;
+	Double_t tBac = ctx->tBac, tCyc = ctx->tCyc, t1 = ctx->t1, t2 = ctx->t2, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3, U10 = ctx->U10, U20 = ctx->U20, Y20 = ctx->Y20, Y30 = ctx->Y30;
 	Double_t f = 0.0;
 	if (i==2) f += Y20 * Exp(-tvar/tU2)
 				 + U10 * tU1/t1 * tU2/(tU2-tU1) * ( Exp(-tvar/tU2) - Exp(-tvar/tU1) );
@@ -227,14 +225,14 @@ Double_t BFitNamespace::Ybkgd (Int_t i, Double_t tvar) {
 	return f;
 }
 
-Double_t BFitNamespace::Ycap (Int_t i, Double_t *a, Double_t tvar) {
+Double_t BFitNamespace::Ycap (ModelContext_t *ctx, Int_t i, Double_t *a, Double_t tvar) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-	extern Double_t tCap, tBac, t1, t2, tT1, tT2, tU1, tU2, tU3, aT1, aU1, aU2, aU3, tU1U2, tT1U2, tU2U3, tT2U3, tU1U3, tT1U3;
-	extern Double_t ampV1, ampW1, ampZ1, ampV2, ampW2, ampZ2, ampX2, ampY2;
-	extern Double_t *sigmaT1, *sigmaV1, *sigmaW1, *sigmaZ1, *sigmaT2, *sigmaV2, *sigmaW2, *sigmaZ2, *sigmaX2, *sigmaY2, *sigmaY3, *sY2v1, *sY2w1, *sY2z1, *sY3w1;
-	static Double_t tn, expT1, expT2, expU1, expU2, expU3, f;
-	static Int_t n;
+	Double_t tCap = ctx->tCap, tBac = ctx->tBac, t1 = ctx->t1, t2 = ctx->t2, tT1 = ctx->tT1, tT2 = ctx->tT2, tU1 = ctx->tU1, tU2 = ctx->tU2, tU3 = ctx->tU3, aT1 = ctx->aT1, aU1 = ctx->aU1, aU2 = ctx->aU2, aU3 = ctx->aU3, tU1U2 = ctx->tU1U2, tT1U2 = ctx->tT1U2, tU2U3 = ctx->tU2U3, tT2U3 = ctx->tT2U3, tU1U3 = ctx->tU1U3, tT1U3 = ctx->tT1U3;
+	Double_t ampV1 = ctx->ampV1, ampW1 = ctx->ampW1, ampZ1 = ctx->ampZ1, ampV2 = ctx->ampV2, ampW2 = ctx->ampW2, ampZ2 = ctx->ampZ2, ampX2 = ctx->ampX2;
+	Double_t *sigmaT1 = ctx->sigmaT1, *sigmaV1 = ctx->sigmaV1, *sigmaW1 = ctx->sigmaW1, *sigmaZ1 = ctx->sigmaZ1, *sigmaT2 = ctx->sigmaT2, *sigmaV2 = ctx->sigmaV2, *sigmaW2 = ctx->sigmaW2, *sigmaZ2 = ctx->sigmaZ2, *sigmaX2 = ctx->sigmaX2, *sigmaY2 = ctx->sigmaY2, *sigmaY3 = ctx->sigmaY3, *sY2v1 = ctx->sY2v1, *sY2w1 = ctx->sY2w1, *sY2z1 = ctx->sY2z1, *sY3w1 = ctx->sY3w1;
+	Double_t tn, expT1, expT2, expU1, expU2, expU3, f;
+	Int_t n;
 	f = 0.0;
 	n = Ceil((tvar-tBac)/tCap);
 	//if (tvar==tBac) n=1;
@@ -0,0 +1,238 @@
+// 2015-05-29
+// Regression test for the sigma recurrences in ComputeParameterDependentVars() (BFit2Model.cxx).
+// For every BFit case in BFitCases.csv, with its BDN case and seed parameters, each sigma array
+// in the model context is compared with the closed forms sigmaI() ... sigmaIV() (BFit2Populations.cxx)
+// that the model used before. The closed forms carry the iota fudge, which is wrong when two decay
+// factors (nearly) coincide -- eg. rho = 1 with gammaTi = gammaUi -- so where they disagree the arrays
+// are also compared with the series summed term by term. A case fails if the model matches neither.
+// A few arrays (sY2z1, sY3z1, ...) subtract nearly equal products of the special factors and lose
+// digits to that, so the default tolerance is 1e-6 rather than round-off. Run it from the directory
+// with the CSV files; returns nonzero if any case fails.
+//   './BFit2SigmaTest [tolerance]'
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include "CSVtoStruct.h"
+#include "BFit2Model.h"
+#include "TMath.h"
+#include "TStopwatch.h"
+using namespace std;
+
+BDNCase_t	stBDNCases[FILE_ROWS_BDN];
+BFitCase_t	stBFitCases[FILE_ROWS_BFit];
+Int_t		iNumStructs_BDN, iNumStructs_BFit;
+
+const Int_t nArrays = 26; // number of sigma arrays in ModelContext_t
+const char *pcsArrayNames[nArrays] = { "sigmaT1", "sigmaT2", "sigmaT3", "sigmaV1", "sigmaV2", "sigmaV3",
+	"sigmaW1", "sigmaW2", "sigmaW3", "sigmaZ1", "sigmaZ2", "sigmaZ3", "sigmaX2", "sigmaX3", "sigmaY2", "sigmaY3",
+	"sY2v1", "sY2w1", "sY2z1", "sY3v2", "sY3w2", "sY3z2", "sY3x2", "sY3v1", "sY3w1", "sY3z1" };
+
+// Values of the sigma series at one tooth k (names as in ComputeParameterDependentVars():
+// I_T1 = sigmaI(rho,aT1,k), II_U1U2 = sigmaII(1,aU1,aU2,k), ...)
+struct Series_t {
+	Double_t I_T1, I_T2, I_T3, I_U1, I_U2, I_U3;
+	Double_t II_T1U1, II_T2U2, II_T3U3, II_T1U2, II_T2U3, II_T1U3, II_U1U2, II_U2U3, II_U1U3;
+	Double_t III_T1U1U2, III_T2U2U3, III_T1U2U3, III_T1U1U3, III_U1U2U3, IV_T1U1U2U3;
+};
+
+// The series from the closed forms sigmaI() ... sigmaIV(), which the model used before
+void ClosedFormSeries (BFitNamespace::ModelContext_t *ctx, Double_t r, Int_t k, Series_t &s) {
+	using namespace BFitNamespace;
+	Double_t aT1 = ctx->aT1, aT2 = ctx->aT2, aT3 = ctx->aT3, aU1 = ctx->aU1, aU2 = ctx->aU2, aU3 = ctx->aU3;
+	s.I_T1 = sigmaI(r,aT1,k);			s.I_T2 = sigmaI(r,aT2,k);			s.I_T3 = sigmaI(r,aT3,k);
+	s.I_U1 = sigmaI(1.0,aU1,k);			s.I_U2 = sigmaI(1.0,aU2,k);			s.I_U3 = sigmaI(1.0,aU3,k);
+	s.II_T1U1 = sigmaII(r,aT1,aU1,k);	s.II_T2U2 = sigmaII(r,aT2,aU2,k);	s.II_T3U3 = sigmaII(r,aT3,aU3,k);
+	s.II_T1U2 = sigmaII(r,aT1,aU2,k);	s.II_T2U3 = sigmaII(r,aT2,aU3,k);	s.II_T1U3 = sigmaII(r,aT1,aU3,k);
+	s.II_U1U2 = sigmaII(1.0,aU1,aU2,k);	s.II_U2U3 = sigmaII(1.0,aU2,aU3,k);	s.II_U1U3 = sigmaII(1.0,aU1,aU3,k);
+	s.III_T1U1U2 = sigmaIII(r,aT1,aU1,aU2,k);
+	s.III_T2U2U3 = sigmaIII(r,aT2,aU2,aU3,k);
+	s.III_T1U2U3 = sigmaIII(r,aT1,aU2,aU3,k);
+	s.III_T1U1U3 = sigmaIII(r,aT1,aU1,aU3,k);
+	s.III_U1U2U3 = sigmaIII(1.0,aU1,aU2,aU3,k);
+	s.IV_T1U1U2U3 = sigmaIV(r,aT1,aU1,aU2,aU3,k);
+}
+
+// The series from their definitions, summed term by term in long double:
+//   sigmaI(r,a,k) = sum_{j<k} (r*a)^j,  and each higher one  S'(..., b, k) = sum_{m<k} b^(k-1-m) S(..., m)
+// O(nCapMax^2), but immune to 0/0 -- this is the referee when the closed forms and the model disagree.
+static void DirectI (long double ra, Int_t nMax, long double *out) {
+	for (Int_t k = 0; k <= nMax; k++) {
+		out[k] = 0;
+		for (Int_t j = 0; j < k; j++) out[k] += powl(ra, j);
+	}
+}
+static void DirectUp (long double b, const long double *in, Int_t nMax, long double *out) {
+	for (Int_t k = 0; k <= nMax; k++) {
+		out[k] = 0;
+		for (Int_t m = 1; m < k; m++) out[k] += powl(b, k-1-m) * in[m];
+	}
+}
+void DirectSeries (BFitNamespace::ModelContext_t *ctx, Double_t r, Series_t *s) {
+	Int_t n = ctx->nCapMax, k;
+	long double aT1 = ctx->aT1, aT2 = ctx->aT2, aT3 = ctx->aT3, aU1 = ctx->aU1, aU2 = ctx->aU2, aU3 = ctx->aU3;
+	std::vector<long double> w(21*(n+1));
+	long double *I_T1 = &w[0], *I_T2 = I_T1+n+1, *I_T3 = I_T2+n+1, *I_U1 = I_T3+n+1, *I_U2 = I_U1+n+1, *I_U3 = I_U2+n+1;
+	long double *II_T1U1 = I_U3+n+1, *II_T2U2 = II_T1U1+n+1, *II_T3U3 = II_T2U2+n+1, *II_T1U2 = II_T3U3+n+1, *II_T2U3 = II_T1U2+n+1;
+	long double *II_T1U3 = II_T2U3+n+1, *II_U1U2 = II_T1U3+n+1, *II_U2U3 = II_U1U2+n+1, *II_U1U3 = II_U2U3+n+1;
+	long double *III_T1U1U2 = II_U1U3+n+1, *III_T2U2U3 = III_T1U1U2+n+1, *III_T1U2U3 = III_T2U2U3+n+1, *III_T1U1U3 = III_T1U2U3+n+1;
+	long double *III_U1U2U3 = III_T1U1U3+n+1, *IV_T1U1U2U3 = III_U1U2U3+n+1;
+	DirectI(r*aT1, n, I_T1);	DirectI(r*aT2, n, I_T2);	DirectI(r*aT3, n, I_T3);
+	DirectI(aU1, n, I_U1);		DirectI(aU2, n, I_U2);		DirectI(aU3, n, I_U3);
+	DirectUp(aU1, I_T1, n, II_T1U1);	DirectUp(aU2, I_T2, n, II_T2U2);	DirectUp(aU3, I_T3, n, II_T3U3);
+	DirectUp(aU2, I_T1, n, II_T1U2);	DirectUp(aU3, I_T2, n, II_T2U3);	DirectUp(aU3, I_T1, n, II_T1U3);
+	DirectUp(aU2, I_U1, n, II_U1U2);	DirectUp(aU3, I_U2, n, II_U2U3);	DirectUp(aU3, I_U1, n, II_U1U3);
+	DirectUp(aU2, II_T1U1, n, III_T1U1U2);
+	DirectUp(aU3, II_T2U2, n, III_T2U2U3);
+	DirectUp(aU3, II_T1U2, n, III_T1U2U3);
+	DirectUp(aU3, II_T1U1, n, III_T1U1U3);
+	DirectUp(aU3, II_U1U2, n, III_U1U2U3);
+	DirectUp(aU3, III_T1U1U2, n, IV_T1U1U2U3);
+	for (k = 1; k <= n; k++) {
+		s[k].I_T1 = I_T1[k];	s[k].I_T2 = I_T2[k];	s[k].I_T3 = I_T3[k];
+		s[k].I_U1 = I_U1[k];	s[k].I_U2 = I_U2[k];	s[k].I_U3 = I_U3[k];
+		s[k].II_T1U1 = II_T1U1[k];	s[k].II_T2U2 = II_T2U2[k];	s[k].II_T3U3 = II_T3U3[k];
+		s[k].II_T1U2 = II_T1U2[k];	s[k].II_T2U3 = II_T2U3[k];	s[k].II_T1U3 = II_T1U3[k];
+		s[k].II_U1U2 = II_U1U2[k];	s[k].II_U2U3 = II_U2U3[k];	s[k].II_U1U3 = II_U1U3[k];
+		s[k].III_T1U1U2 = III_T1U1U2[k];	s[k].III_T2U2U3 = III_T2U2U3[k];	s[k].III_T1U2U3 = III_T1U2U3[k];
+		s[k].III_T1U1U3 = III_T1U1U3[k];	s[k].III_U1U2U3 = III_U1U2U3[k];	s[k].IV_T1U1U2U3 = IV_T1U1U2U3[k];
+	}
+}
+
+// The 26 sigma arrays at tooth k from the series, as ComputeParameterDependentVars() puts them together
+void AssembleSigmas (BFitNamespace::ModelContext_t *ctx, const Series_t &s, Int_t k, Double_t **out) {
+	Double_t aT1 = ctx->aT1, aT2 = ctx->aT2, aT3 = ctx->aT3, aU1 = ctx->aU1, aU2 = ctx->aU2, aU3 = ctx->aU3;
+	Double_t tT1U2 = ctx->tT1U2, tT1U3 = ctx->tT1U3, tU1U2 = ctx->tU1U2, tU1U3 = ctx->tU1U3, tT2U3 = ctx->tT2U3, tU2U3 = ctx->tU2U3;
+	Double_t t1 = ctx->t1, t2 = ctx->t2;
+	out[0][k]  = s.I_T1;
+	out[1][k]  = s.I_T2;
+	out[2][k]  = s.I_T3;
+	out[3][k]  = s.I_U1;
+	out[4][k]  = s.I_U2;
+	out[5][k]  = s.I_U3;
+	out[6][k]  = aT1 * s.II_T1U1;
+	out[7][k]  = aT2 * s.II_T2U2;
+	out[8][k]  = aT3 * s.II_T3U3;
+	out[9][k]  = (aU1-aT1) * s.II_T1U1 + s.I_T1;
+	out[10][k] = (aU2-aT2) * s.II_T2U2 + s.I_T2;
+	out[11][k] = (aU3-aT3) * s.II_T3U3 + s.I_T3;
+	out[12][k] = (aU2-aT1) * s.II_T1U2 + s.I_T1;
+	out[13][k] = (aU3-aT2) * s.II_T2U3 + s.I_T2;
+	out[16][k] = tU1U2/t1 * (aU2-aU1) *             s.II_U1U2;
+	out[17][k] = tU1U2/t1 * (aU2-aU1) *  aT1      * s.III_T1U1U2;
+	out[18][k] = tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * s.III_T1U1U2 + ( tU1U2/t1 * (aU2-aU1) - tT1U2/t1 * (aU2-aT1) ) * s.II_T1U2;
+	out[19][k] = tU2U3/t2 * (aU3-aU2) *             s.II_U2U3;
+	out[20][k] = tU2U3/t2 * (aU3-aU2) *  aT2      * s.III_T2U2U3;
+	out[21][k] = tU2U3/t2 * (aU3-aU2) * (aU2-aT2) * s.III_T2U2U3 + ( tU2U3/t2 * (aU3-aU2) - tT2U3/t2 * (aU3-aT2) ) * s.II_T2U3;
+	out[22][k] = tU2U3/t2 * (aU3-aU2) * (aU2-aT1) * s.III_T1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tT1U3/t2 * (aU3-aT1) ) * s.II_T1U3;
+	out[23][k] = tU1U2/t1 *       ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * s.III_U1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * s.II_U1U3 );
+	out[24][k] = tU1U2/t1 * aT1 * ( tU2U3/t2 * (aU3-aU2) * (aU2-aU1) * s.IV_T1U1U2U3 + ( tU2U3/t2 * (aU3-aU2) - tU1U3/t2 * (aU3-aU1) ) * s.III_T1U1U3 );
+	out[25][k] = tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1) * (aU1-aT1) * s.IV_T1U1U2U3
+			   + tU2U3/t2 * (aU3-aU2) * tU1U2/t1 * (aU2-aU1)             * s.III_T1U2U3
+			   - tU2U3/t2 * (aU3-aU2) * tT1U2/t1 * (aU2-aT1)             * s.III_T1U2U3
+			   + tU2U3/t2 * (aU3-aU2) * tU1U2/t1             * (aU1-aT1) * s.III_T1U1U3
+			   - tU1U3/t2 * (aU3-aU1) * tU1U2/t1             * (aU1-aT1) * s.III_T1U1U3
+			   + tU2U3/t2 * (aU3-aU2) * tU1U2/t1                         * s.II_T1U3
+			   - tU1U3/t2 * (aU3-aU1) * tU1U2/t1                         * s.II_T1U3
+			   - tU2U3/t2 * (aU3-aU2) * tT1U2/t1                         * s.II_T1U3
+			   + tT1U3/t2 * (aU3-aT1) * tT1U2/t1                         * s.II_T1U3;
+	out[14][k] = ctx->ampV1*out[16][k] + ctx->ampW1*out[17][k] + ctx->ampZ1*out[18][k];
+	out[15][k] = ctx->ampV2*out[19][k] + ctx->ampW2*out[20][k] + ctx->ampZ2*out[21][k] + ctx->ampX2*out[22][k]
+			   + ctx->ampV1*out[23][k] + ctx->ampW1*out[24][k] + ctx->ampZ1*out[25][k];
+}
+
+// Largest difference between two sets of arrays, relative to the largest |value| of each array in ref
+Double_t WorstDiff (Double_t **test, Double_t **ref, Int_t nMax, Int_t &iWorst) {
+	using namespace TMath;
+	Double_t dWorst = 0, dScale, dDiff;
+	for (Int_t iArr = 0; iArr < nArrays; iArr++) {
+		dScale = 0;
+		for (Int_t k = 1; k <= nMax; k++) dScale = Max(dScale, Abs(ref[iArr][k]));
+		if (dScale == 0) dScale = 1;
+		for (Int_t k = 1; k <= nMax; k++) {
+			dDiff = Abs(test[iArr][k] - ref[iArr][k]) / dScale;
+			if (!(dDiff <= dWorst)) { dWorst = dDiff; iWorst = iArr; } // catches NaN too
+		}
+	}
+	return dWorst;
+}
+
+int main (int argc, char *argv[]) {
+	using namespace BFitNamespace;
+	using namespace TMath;
+	Double_t	dTolerance = (argc > 1) ? atof(argv[1]) : 1e-6;
+	Double_t	dClosed, dDirect, dWorstAll = 0;
+	Double_t	*par, *closed[nArrays], *direct[nArrays];
+	Int_t		iBFit, iBDN, iArr, iClosed, iDirect, k, nCases = 0, nFailed = 0, nClosedOff = 0;
+	Series_t	stSeries, *pstDirect;
+	ModelContext_t ctx;
+	TStopwatch	swRecurrence, swClosedForm;
+
+	iNumStructs_BDN  = CSVtoStruct_BDN  ((char*)"BDNCases.csv_transposed", stBDNCases);
+	iNumStructs_BFit = CSVtoStruct_BFit ((char*)"BFitCases.csv_transposed", stBFitCases);
+	cout << "Imported " << iNumStructs_BDN << " BDN cases and " << iNumStructs_BFit << " BFit cases" << endl;
+	swRecurrence.Reset();
+	swClosedForm.Reset();
+
+	for (iBFit = 0; iBFit < iNumStructs_BFit; iBFit++) {
+		iBDN = FindBDNCaseIndex(stBDNCases, iNumStructs_BDN, stBFitCases[iBFit].pcsCaseCode);
+		if (iBDN < 0 || !(stBDNCases[iBDN].dCaptureTime > 0) || !(stBDNCases[iBDN].dCycleTime > 0)) continue;
+	// Model context with the seed parameters (sigma arrays by recurrence)
+		par = new Double_t [stBFitCases[iBFit].iNPars];
+		memcpy(par, stBFitCases[iBFit].pdSeed, stBFitCases[iBFit].iNPars*sizeof(Double_t));
+		swRecurrence.Start(kFALSE);
+		InitModelContext(&ctx, &stBDNCases[iBDN], stBFitCases[iBFit].iNPars, par);
+		swRecurrence.Stop();
+		Double_t *model[nArrays] = { ctx.sigmaT1, ctx.sigmaT2, ctx.sigmaT3, ctx.sigmaV1, ctx.sigmaV2, ctx.sigmaV3,
+			ctx.sigmaW1, ctx.sigmaW2, ctx.sigmaW3, ctx.sigmaZ1, ctx.sigmaZ2, ctx.sigmaZ3, ctx.sigmaX2, ctx.sigmaX3,
+			ctx.sigmaY2, ctx.sigmaY3, ctx.sY2v1, ctx.sY2w1, ctx.sY2z1,
+			ctx.sY3v2, ctx.sY3w2, ctx.sY3z2, ctx.sY3x2, ctx.sY3v1, ctx.sY3w1, ctx.sY3z1 };
+	// Same arrays from the closed forms, and from the direct sums
+		for (iArr = 0; iArr < nArrays; iArr++) {
+			closed[iArr] = new Double_t [ctx.nCapMax+1];
+			direct[iArr] = new Double_t [ctx.nCapMax+1];
+		}
+		swClosedForm.Start(kFALSE);
+		for (k = 1; k <= ctx.nCapMax; k++) {
+			ClosedFormSeries(&ctx, par[rho], k, stSeries);
+			AssembleSigmas(&ctx, stSeries, k, closed);
+		}
+		swClosedForm.Stop();
+		pstDirect = new Series_t [ctx.nCapMax+1];
+		DirectSeries(&ctx, par[rho], pstDirect);
+		for (k = 1; k <= ctx.nCapMax; k++) AssembleSigmas(&ctx, pstDirect[k], k, direct);
+	// Compare. Where the model and the closed forms disagree, the direct sums say which is right
+	// (it should be the closed forms that are off, when a decay factor nearly equals another)
+		iClosed = iDirect = 0;
+		dClosed = WorstDiff(model, closed, ctx.nCapMax, iClosed);
+		dDirect = WorstDiff(model, direct, ctx.nCapMax, iDirect);
+		printf("%-16s %-10s nCapMax = %4d   vs closed forms %.3e (%-7s)   vs direct sums %.3e (%-7s)", stBFitCases[iBFit].pcsCaseCode,
+			stBDNCases[iBDN].pcsCaseCode, ctx.nCapMax, dClosed, pcsArrayNames[iClosed], dDirect, pcsArrayNames[iDirect]);
+		if (dClosed <= dTolerance) printf("\n");
+		else if (dDirect <= dTolerance) {
+			printf("   closed forms off\n");
+			nClosedOff++;
+		}
+		else {
+			printf("   FAILED\n");
+			nFailed++;
+		}
+		if (!(Min(dClosed,dDirect) <= dWorstAll)) dWorstAll = Min(dClosed,dDirect);
+		nCases++;
+		for (iArr = 0; iArr < nArrays; iArr++) {
+			delete [] closed[iArr];
+			delete [] direct[iArr];
+		}
+		delete [] pstDirect;
+		FreeModelContext(&ctx);
+		delete [] par;
+	}
+
+	printf("\n%d cases, %d failed, %d where only the direct sums agree (tolerance %.1e), worst rel. diff = %.3e\n",
+		nCases, nFailed, nClosedOff, dTolerance, dWorstAll);
+	printf("CPU time: recurrence (all parameter-dependent vars) %.3f s, closed forms (sigmas only) %.3f s\n",
+		swRecurrence.CpuTime(), swClosedForm.CpuTime());
+	return (nFailed == 0) ? 0 : 1;
+}
@@ -3,9 +3,14 @@
 #include "TMath.h"
 #include "string.h"
 
+// Case constants and flags, defined with the program (BFit.cxx). Declared out here: inside a
+// BFitNamespace function an extern declaration would name BFitNamespace::tCap and so on,
+// which nobody defines.
+extern Double_t	iota, tCap, tBac, tCyc, t1, t2, t3;
+extern bool		b134sbFlag;
+
 Double_t BFitNamespace::SigmaT (Double_t rho, Double_t tau, Int_t n) {
 	using namespace TMath;
-	extern Double_t tCap;
 	static Double_t a;
 	a = Exp(-tCap/tau);
 	return ( 1-Power(rho*a,n) ) / (1-rho*a);
@@ -16,7 +21,6 @@ Double_t BFitNamespace::T1 (Double_t *t, Double_t *a) {
 	using namespace TMath;
 	static Int_t n;
 	static Double_t ST1, tT1, f;
-	extern Double_t tCap, tBac, tCyc, t1, t2, t3;
 	f = 0.0; //catch bad values of t[0]
 	if (tBac <= t[0] && t[0] <= tCyc)
 	{
@@ -32,7 +36,6 @@ Double_t BFitNamespace::T2 (Double_t *t, Double_t *a) {
 	using namespace TMath;
 	static Int_t n;
 	static Double_t ST2, tT2, f;
-	extern Double_t tCap, tBac, tCyc, t2;
 	f = 0.0; //catch bad values of t[0]
 	if (tBac <= t[0] && t[0] <= tCyc)
 	{
@@ -48,10 +51,6 @@ Double_t BFitNamespace::T3 (Double_t *t, Double_t *a) {
 	using namespace TMath;
 	static Int_t n;
 	static Double_t ST3, tT3, f;
-	extern Double_t tCap, tBac, tCyc, t3;
-	extern BDNCase_t stBDNCases[FILE_ROWS_BDN]; // This comes from the main program (BFit.cxx)
-	extern Int_t iBDNCaseIndex; // This comes from the main program (BFit.cxx)
-	extern bool b134sbFlag;
 	f = 0.0; //catch bad values of t[0]
 	if (tBac <= t[0] && t[0] <= tCyc)
 	{
@@ -119,32 +118,26 @@ Double_t BFitNamespace::rDC (Double_t *t, Double_t *a) {
 }
 Double_t BFitNamespace::rT1 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
 	return a[epsT]*T1(t,a)/t1;
 }
 Double_t BFitNamespace::rT2 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
 	return a[epsT]*T2(t,a)/t2;
 }
 Double_t BFitNamespace::rT3 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
 	return a[epsT]*T3(t,a)/t3;
 }
 Double_t BFitNamespace::rU1 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
 	return (a[epsV]*V1(t,a) + a[epsW]*W1(t,a))/t1;
 }
 Double_t BFitNamespace::rU2 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
 	return (a[epsV]*V2(t,a) + a[epsW]*W2(t,a) + a[epsX]*X2(t,a) + a[epsY]*Y2(t,a))/t2;
 }
 Double_t BFitNamespace::rU3 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
 	return (a[epsV]*V3(t,a) + a[epsW]*W3(t,a) + a[epsX]*X3(t,a) + a[epsY]*Y3(t,a))/t3;
 }
 Double_t BFitNamespace::rAll (Double_t *t, Double_t *a) {
@@ -157,7 +150,6 @@ Double_t BFitNamespace::V1 (Double_t *t, Double_t *a) {
 	using namespace TMath;
 	static Int_t n, N;
 	static Double_t tU1, v10, v1, V1, f;
-	extern Double_t tCap, tBac, tCyc, t1;
 	tU1 = 1.0 / ( 1.0/t1 + a[gammaU1]/1000.0 ); // net variable lifetime (1/e) in ms
 	f = 0.0; //catch bad values of t[0]
 	n = Ceil((t[0]-tBac)/tCap);
@@ -183,7 +175,6 @@ Double_t BFitNamespace::V2 (Double_t *t, Double_t *a) {
 	using namespace TMath;
 	static Int_t n, N;
 	static Double_t tU2, v20, v2, V2, f;
-	extern Double_t tCap, tBac, tCyc, t2;
 	tU2 = 1.0 / ( 1.0/t2 + a[gammaU2]/1000.0 ); // net variable lifetime (1/e) in ms
 	f = 0.0; //catch bad values of t[0]
 	n = Ceil((t[0]-tBac)/tCap);
@@ -209,7 +200,6 @@ Double_t BFitNamespace::V3 (Double_t *t, Double_t *a) {
 	using namespace TMath;
 	static Int_t n, N;
 	static Double_t tU3, v30, v3, V3, f;
-	extern Double_t tCap, tBac, tCyc, t3;
 	tU3 = 1.0 / ( 1.0/t3 + a[gammaU3]/1000.0 ); // net variable lifetime (1/e) in ms
 	f = 0.0; //catch bad values of t[0]
 	n = Ceil((t[0]-tBac)/tCap);
@@ -233,17 +223,14 @@ Double_t BFitNamespace::V3 (Double_t *t, Double_t *a) {
 
 Double_t BFitNamespace::yV1 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
 	return a[nCyc]*a[dt]*a[epsV]*V1(t,a)/t1;
 }
 Double_t BFitNamespace::yV2 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
 	return a[nCyc]*a[dt]*a[epsV]*V2(t,a)/t2;
 }
 Double_t BFitNamespace::yV3 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
 	return a[nCyc]*a[dt]*a[epsV]*V3(t,a)/t3;
 }
 
@@ -254,7 +241,6 @@ Double_t BFitNamespace::SigmaW (Double_t rho, Double_t tT, Double_t tU, Int_t n)
 	using namespace TMath;
 	static Double_t expT, expU, f;
 	static Int_t k;
-	extern Double_t iota, tCap;
 	f = 0.0;
 	if (n>=2) {
 		expT = Exp(-tCap/tT);
@@ -269,8 +255,6 @@ Double_t BFitNamespace::SigmaW (Double_t rho, Double_t tT, Double_t tU, Int_t n)
 Double_t BFitNamespace::W1 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t1;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT1, tU1, w10, w1, W1, f, amplitude;
@@ -301,8 +285,6 @@ Double_t BFitNamespace::W1 (Double_t *t, Double_t *a) {
 Double_t BFitNamespace::W2 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t2;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT2, tU2, w20, w2, W2, f, amplitude;
@@ -333,8 +315,6 @@ Double_t BFitNamespace::W2 (Double_t *t, Double_t *a) {
 Double_t BFitNamespace::W3 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t3;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT3, tU3, w30, w3, W3, f, amplitude;
@@ -364,17 +344,14 @@ Double_t BFitNamespace::W3 (Double_t *t, Double_t *a) {
 }
 Double_t BFitNamespace::yW1 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t1;
 	return a[nCyc]*a[dt]*a[epsW]*W1(t,a)/t1;
 }
 Double_t BFitNamespace::yW2 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t2;
 	return a[nCyc]*a[dt]*a[epsW]*W2(t,a)/t2;
 }
 Double_t BFitNamespace::yW3 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
-	extern Double_t t3;
 	return a[nCyc]*a[dt]*a[epsW]*W3(t,a)/t3;
 }
 
@@ -385,7 +362,6 @@ Double_t BFitNamespace::SigmaZ (Double_t rho, Double_t tT, Double_t tU, Int_t n)
 	using namespace TMath;
 	static Double_t expT, expU, f;
 	static Int_t k;
-	extern Double_t tCap;
 	f = 0.0;
 	if (n>=2) {
 		expT = Exp(-tCap/tT);
@@ -400,8 +376,6 @@ Double_t BFitNamespace::SigmaZ (Double_t rho, Double_t tT, Double_t tU, Int_t n)
 Double_t BFitNamespace::Z1 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t1;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT1, tU1, z10, z1, Z1, f, amplitude;
@@ -432,8 +406,6 @@ Double_t BFitNamespace::Z1 (Double_t *t, Double_t *a) {
 Double_t BFitNamespace::Z2 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t2;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT2, tU2, z20, z2, Z2, f, amplitude;
@@ -467,8 +439,6 @@ Double_t BFitNamespace::Z2 (Double_t *t, Double_t *a) {
 Double_t BFitNamespace::Z3 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t3;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT3, tU3, z30, z3, Z3, f, amplitude;
@@ -497,15 +467,12 @@ Double_t BFitNamespace::Z3 (Double_t *t, Double_t *a) {
 	return f;
 }
 Double_t BFitNamespace::yZ1 (Double_t *t, Double_t *a) {
-	extern Double_t t1;
 	return a[nCyc]*a[dt]*a[epsZ]*BFitNamespace::Z1(t,a)/t1;
 }
 Double_t BFitNamespace::yZ2 (Double_t *t, Double_t *a) {
-	extern Double_t t2;
 	return a[nCyc]*a[dt]*a[epsZ]*BFitNamespace::Z2(t,a)/t2;
 }
 Double_t BFitNamespace::yZ3 (Double_t *t, Double_t *a) {
-	extern Double_t t3;
 	return a[nCyc]*a[dt]*a[epsZ]*BFitNamespace::Z3(t,a)/t3;
 }
 
@@ -515,8 +482,6 @@ Double_t BFitNamespace::yZ3 (Double_t *t, Double_t *a) {
 Double_t BFitNamespace::X2 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t1, t2;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT1, tU2, x20, x2, X2, f, amplitude, boundary;
@@ -547,8 +512,6 @@ Double_t BFitNamespace::X2 (Double_t *t, Double_t *a) {
 Double_t BFitNamespace::X3 (Double_t *t, Double_t *a) {
 	using namespace BFitNamespace;
 	using namespace TMath;
-// externs: constant over all computations
-	extern Double_t iota, tCap, tBac, tCyc, t2, t3;
 // statics: recomputed many times (keep memory allocated)
 	static Int_t n, N;
 	static Double_t tT2, tU3, x30, x3, X3, f, amplitude, boundary;
@@ -577,11 +540,9 @@ Double_t BFitNamespace::X3 (Double_t *t, Double_t *a) {
 	return f;
 }
 Double_t BFitNamespace::yX2 (Double_t *t, Double_t *a) {
-	extern Double_t t2;
 	return a[nCyc]*a[dt]*a[epsX]*BFitNamespace::X2(t,a)/t2;
 }
 Double_t BFitNamespace::yX3 (Double_t *t, Double_t *a) {
-	extern Double_t t3;
 	return a[nCyc]*a[dt]*a[epsX]*BFitNamespace::X3(t,a)/t3;
 }
 
@@ -592,7 +553,6 @@ Double_t BFitNamespace::Y2InitialValue (Double_t *t, Double_t *a, Double_t t0, D
 	using namespace BFitNamespace;
 	using namespace TMath;
 	static Double_t tT1, tU1, tU2, cT1, cU1, cU2, expT1, expU1, expU2, tk, A, B, f;
-	extern Double_t iota, tCap, tBac, t1, t2;
 	tT1 = 1.0 / ( 1.0/t1 + a[gammaT1]/1000.0 ); // net variable lifetime (1/e) in ms
 	tU1 = 1.0 / ( 1.0/t1 + a[gammaU1]/1000.0 ); // net variable lifetime (1/e) in ms
 	tU2 = 1.0 / ( 1.0/t2 + a[gammaU2]/1000.0 ); // net variable lifetime (1/e) in ms
@@ -614,7 +574,6 @@ Double_t BFitNamespace::Y2Trapping (Double_t *t, Double_t *a, Int_t n) {
 	using namespace TMath;
 	static Double_t tk, f;
 	static Int_t k;
-	extern Double_t tCap, tBac;
 	f = 0.0;
 	for (k=1; k<=n; k++) {
 		tk = tBac+(k-1)*tCap;
@@ -628,7 +587,6 @@ Double_t BFitNamespace::Y2 (Double_t *t, Double_t *a) {
 	using namespace TMath;
 	static Int_t n, N;
 	static Double_t tT1, tU1, tU2, tn, tN, u10, y20, y2, Y2, f;
-	extern Double_t tCap, tBac, tCyc, t1, t2, t3;
 //	bookGlobals();
 	tT1 = 1.0 / ( 1.0/t1 + a[gammaT1]/1000.0 ); // net variable lifetime (1/e) in ms
 	tU1 = 1.0 / ( 1.0/t1 + a[gammaU1]/1000.0 ); // net variable lifetime (1/e) in ms
@@ -661,7 +619,6 @@ Double_t BFitNamespace::Y3InitialValue (Double_t *t, Double_t *a, Double_t t0, D
 	static Double_t cZT2, cZU2, cZU3, cXT1, cXU2, cXU3, cYU1, cYU2, cYU3;
 	static Double_t ampV, ampW, ampZ, ampX, ampY_ST1, ampY_SW11, ampY_SZ11;
 	static Double_t V, W, Z, X, Y;
-	extern Double_t iota, tCap, tBac, t1, t2, t3;
 	tT1 = 1.0 / ( 1.0/t1 + a[gammaT1]/1000.0 ); // net variable lifetime (1/e) in ms
 	tT2 = 1.0 / ( 1.0/t2 + a[gammaT2]/1000.0 ); // net variable lifetime (1/e) in ms
 	tU1 = 1.0 / ( 1.0/t1 + a[gammaU1]/1000.0 ); // net variable lifetime (1/e) in ms
@@ -733,7 +690,6 @@ Double_t BFitNamespace::Y3Trapping (Double_t *t, Double_t *a, Int_t n) {
 	static Double_t tk, expT1, expT2, expU1, expU2, expU3, ThetaU, ST1, SW11, SZ11, ST2, SW22, SZ22, bU1, bU2, bU3, cT2, cU2, cU3, dT1, dU1, dU2, dU3, A, B, C, D, f;
 	static Double_t tT1, tT2, tU1, tU2, tU3;
 	static Int_t k;
-	extern Double_t iota, tCap, tBac, tCyc, t1, t2, t3;
 	if (t[0] < tBac || t[0] > tCyc) return 0.0;
 	else {
 		f	= 0.0;
@@ -759,7 +715,6 @@ Double_t BFitNamespace::Y3 (Double_t *t, Double_t *a) {
 	static Double_t tT1, tT2, tU1, tU2, tU3, tn, tN, An, AN, Bn, BN, cT1, cU1, cU2, amplitude, u10, u20, y30, y3, Y3, f, A, B, ThetaU;
 	static Double_t expT1n, expU1n, expU2n;
 	static Double_t expT1N, expU1N, expU2N;
-	extern Double_t iota, tCap, tBac, tCyc, t1, t2, t3;
 	tT1 = 1.0 / ( 1.0/t1 + a[gammaT1]/1000.0 ); // net variable lifetime (1/e) in ms
 	tU1 = 1.0 / ( 1.0/t1 + a[gammaU1]/1000.0 ); // net variable lifetime (1/e) in ms
 	tT2 = 1.0 / ( 1.0/t2 + a[gammaT2]/1000.0 ); // net variable lifetime (1/e) in ms
@@ -795,10 +750,8 @@ Double_t BFitNamespace::Y3 (Double_t *t, Double_t *a) {
 }
 
 Double_t BFitNamespace::yY2 (Double_t *t, Double_t *a) {
-	extern Double_t t2;
 	return a[nCyc]*a[dt]*a[epsY]*BFitNamespace::Y2(t,a)/t2;
 }
 Double_t BFitNamespace::yY3 (Double_t *t, Double_t *a) {
-	extern Double_t t3;
 	return a[nCyc]*a[dt]*a[epsY]*BFitNamespace::Y3(t,a)/t3;
 }
@@ -0,0 +1,385 @@
+// 2015-06-14
+// Cross-check and benchmark of the three generations of the beta-singles cycle model:
+//   BFit    BFitModel.cxx (2014, used by BFit.cxx): free functions, case constants in globals
+//   B_fit   B_fit_model.cxx (B_fit.cpp): net lifetimes tauT1 ... tauU3 as the parameters, l for
+//           rho, no nCyc (a[dt] carries it), and the 137I cycle (5 s captures, 101 s background,
+//           246 s cycle) built in
+//   BFit2   BFit2Model.cxx & co (BFit2.cxx): model context, pointwise yAll and yAllBatch
+// For every BFit case (or those matching the codes or shell patterns given), with its BDN case, the
+// models are evaluated at the centres of the case's bins over the cycle for the seed parameters and
+// for nSets-1 random variations of them (fixed seed, so every run uses the same sets).
+// Each y function (yDC, yT1 ... yU3, yAll) is compared with BFit2's, as the largest difference over
+// the cycle relative to the largest yAll, and has to agree to within the tolerance where the models
+// are the same model: BFit2's yAllBatch with its pointwise yAll, the 2014 model on yDC and the yT's.
+// The untrapped populations of the 2014 model are an earlier derivation (no Z populations, no epsU
+// factor, 0/0 at rho = 1 or gammaUi = gammaTi, which the seeds usually are), so its yU's and yAll
+// are only reported. B_fit is only evaluated for cases with its cycle, and is checked only on yDC:
+// its rates decay by net lifetime, so its yT's agree only when the gammaT's are 0.
+// The time per evaluation of yAll is measured for each model at the seeds.
+// With --fit, a Poisson histogram is drawn from BFit2 at the seeds and fit by TH1::Fit with each
+// model, to compare the fit results and times on the same histogram. (Every fit starts at the seeds,
+// where the 2014 yAll is often 0/0; its fit status says so.) BFit2 is also fit by BatchFit(), the way
+// BFit2.cxx fits, which has to end at TH1::Fit's minimum: in the parameters (dFitShift errors) and the
+// chi-square (dFitChi2 relative), with the chi-square it reports matching its parameters.
+// Run it from the directory with the CSV files; returns nonzero if any comparison fails.
+//   './BFitModelCompare [--tolerance=<x>] [--reps=<n>] [--fit] [<B_fit case code or pattern> ...]'
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <fnmatch.h>
+#include "CSVtoStruct.h"
+#include "BFit2Model.h"
+#include "BFit2Fit.h"
+#include "B_fit_model.h"
+#include "TMath.h"
+#include "TH1.h"
+#include "TF1.h"
+#include "TFitResult.h"
+#include "TRandom3.h"
+#include "TStopwatch.h"
+using namespace std;
+
+BDNCase_t	stBDNCases[FILE_ROWS_BDN];
+BFitCase_t	stBFitCases[FILE_ROWS_BFit];
+Int_t		iNumStructs_BDN, iNumStructs_BFit;
+// Case constants of the 2014 model (BFitModel.cxx), as BFit.cxx defines them
+Double_t	tCap, tBac, tCyc;
+Double_t	t1, t2, t3;
+Double_t	iota;
+bool		b134sbFlag = 0;
+
+// Entry points of the 2014 model. Its header can't be included with BFit2Model.h (both define
+// BFitNamespace::ParIndex, in the same order), so they are declared here.
+namespace BFitNamespace {
+	Double_t yDC (Double_t*, Double_t*);
+	Double_t yT1 (Double_t*, Double_t*);
+	Double_t yT2 (Double_t*, Double_t*);
+	Double_t yT3 (Double_t*, Double_t*);
+	Double_t yU1 (Double_t*, Double_t*);
+	Double_t yU2 (Double_t*, Double_t*);
+	Double_t yU3 (Double_t*, Double_t*);
+	Double_t yAll (Double_t*, Double_t*);
+}
+
+typedef Double_t (*PlainModel_t) (Double_t*, Double_t*);
+const Int_t nComponents = 8;
+const char *pcsComponentNames[nComponents] = { "yDC", "yT1", "yT2", "yT3", "yU1", "yU2", "yU3", "yAll" };
+const BFitNamespace::ModelFunction_t pfBFit2[nComponents] = { BFitNamespace::yDC, BFitNamespace::yT1, BFitNamespace::yT2,
+	BFitNamespace::yT3, BFitNamespace::yU1, BFitNamespace::yU2, BFitNamespace::yU3, BFitNamespace::yAll };
+const PlainModel_t pfBFit[nComponents] = { BFitNamespace::yDC, BFitNamespace::yT1, BFitNamespace::yT2,
+	BFitNamespace::yT3, BFitNamespace::yU1, BFitNamespace::yU2, BFitNamespace::yU3, BFitNamespace::yAll };
+const PlainModel_t pfB_fit[nComponents] = { B_fit_model::yDC, B_fit_model::yT1, B_fit_model::yT2,
+	B_fit_model::yT3, B_fit_model::yU1, B_fit_model::yU2, B_fit_model::yU3, B_fit_model::yAll };
+// BFit2 parameter behind each B_fit parameter (tauXi from gammaXi, l from rho)
+const Int_t piB_fitFrom[B_fit_model::nPars] = { BFitNamespace::DC, BFitNamespace::r1, BFitNamespace::r2, BFitNamespace::r3,
+	BFitNamespace::p, BFitNamespace::rho, BFitNamespace::epsT, BFitNamespace::epsU, BFitNamespace::epsV, BFitNamespace::epsW,
+	BFitNamespace::epsX, BFitNamespace::epsY, BFitNamespace::gammaT1, BFitNamespace::gammaT2, BFitNamespace::gammaT3,
+	BFitNamespace::gammaU1, BFitNamespace::gammaU2, BFitNamespace::gammaU3, BFitNamespace::dt };
+
+const Int_t nSets = 3; // parameter sets per case: the seeds and two variations
+const Double_t dFitShift = 0.1, dFitChi2 = 1e-3; // how far BatchFit() may end from TH1::Fit: in errors, relative chi-square
+const Int_t nImpls = 4;
+const char *pcsImplNames[nImpls] = { "BFit2 batch", "BFit2", "BFit", "B_fit" };
+enum { implBatch, implBFit2, implBFit, implB_fit };
+// Components that have to agree with BFit2 (bit c for pcsComponentNames[c]); the others are only
+// reported. The 2014 and B_fit untrapped populations are different derivations from BFit2's.
+const Int_t piChecked[nImpls] = { 1 << 7, 0, 0xF, 0x1 };
+
+// Case constants of the 2014 model for a BDN case
+void SetBFitGlobals (const BFitNamespace::ModelContext_t *ctx) {
+	tCap = ctx->tCap;
+	tBac = ctx->tBac;
+	tCyc = ctx->tCyc;
+	t1 = ctx->t1;
+	t2 = ctx->t2;
+	t3 = ctx->t3;
+	b134sbFlag = ctx->b134sbFlag;
+}
+
+// B_fit only knows the 137I cycle
+Bool_t HasB_fitCycle (const BFitNamespace::ModelContext_t *ctx) {
+	return fabs(ctx->tCap - 5000.0) < 1e-6 && fabs(ctx->tBac - 101000.0) < 1e-6 && fabs(ctx->tCyc - 246000.0) < 1e-6;
+}
+
+// B_fit parameters for BFit2 parameters a
+void B_fitPars (const BFitNamespace::ModelContext_t *ctx, const Double_t *a, Double_t *b) {
+	using namespace BFitNamespace;
+	Double_t tRad[6] = { ctx->t1, ctx->t2, ctx->t3, ctx->t1, ctx->t2, ctx->t3 };
+	for (Int_t j = 0; j < B_fit_model::nPars; j++) b[j] = a[piB_fitFrom[j]];
+	for (Int_t j = 0; j < 6; j++) b[B_fit_model::tauT1+j] = 1.0 / ( 1.0/tRad[j] + a[gammaT1+j]/1000.0 );
+	b[B_fit_model::dt] = a[nCyc]*a[dt];
+}
+
+// Largest |y - yRef| over the grid, relative to the largest |yAll| of the reference
+Double_t WorstDiff (const vector<Double_t> &y, const vector<Double_t> &yRef, Double_t scale) {
+	Double_t d = 0.0;
+	for (size_t i = 0; i < y.size(); i++) if (!(fabs(y[i] - yRef[i]) <= d)) d = fabs(y[i] - yRef[i]);
+	return scale > 0 ? d/scale : d;
+}
+
+// Nanoseconds per yAll evaluation of one model over the grid, nReps passes
+Double_t TimeModel (Int_t impl, BFitNamespace::ModelContext_t *ctx, const Double_t *a, vector<Double_t> &t, Int_t nReps) {
+	using namespace BFitNamespace;
+	Int_t nBins = t.size(), i, k;
+	Double_t par[nParIndex], bpar[B_fit_model::nPars];
+	vector<Double_t> y(nBins);
+	memcpy(par, a, ctx->nPars*sizeof(Double_t));
+	B_fitPars(ctx, a, bpar);
+	TStopwatch sw;
+	for (k = 0; k < nReps; k++) {
+		if (impl == implBatch) yAllBatch(ctx, nBins, &t[0], par, &y[0]);
+		else for (i = 0; i < nBins; i++) {
+			if (impl == implBFit2)		y[i] = yAll(ctx, &t[i], par);
+			else if (impl == implBFit)	y[i] = pfBFit[nComponents-1](&t[i], par);
+			else						y[i] = B_fit_model::yAll(&t[i], bpar);
+		}
+	}
+	sw.Stop();
+	return 1e9*sw.CpuTime()/(Double_t(nReps)*nBins);
+}
+
+// Fit of h with one model, starting from the seeds a with the case's toggles and steps: through
+// TH1::Fit, or for implBatch through BatchFit() (BFit2Fit.cxx) with BFit2, as BFit2.cxx fits
+struct CompareFit_t {
+	Int_t		iStatus;
+	Double_t	dChi2, dTime;
+	Int_t		iNDF;
+	Double_t	dPar[BFitNamespace::nParIndex], dErr[BFitNamespace::nParIndex]; // BFit2 indices (B_fit: mapped back)
+};
+
+void FitModel (Int_t impl, BFitNamespace::ModelContext_t *ctx, const BFitCase_t *pstBFitCase, const Double_t *a, TH1D *h, CompareFit_t &fr) {
+	using namespace BFitNamespace;
+	Int_t nPars = pstBFitCase->iNPars, j;
+	const Int_t *tog = pstBFitCase->pbToggle;
+	Double_t bpar[B_fit_model::nPars];
+	TF1 *fn;
+	TString options = strchr(pstBFitCase->pcsOptions,'L') ? "QN0SL" : "QN0S";
+	if (impl == implB_fit) {
+		B_fitPars(ctx, a, bpar);
+		fn = new TF1("fB_fit", B_fit_model::yAll, 0.0, ctx->tCyc, B_fit_model::nPars);
+		fn->SetParameters(bpar);
+		for (j = 0; j < B_fit_model::nPars; j++)
+			if (!tog[piB_fitFrom[j]] || j == B_fit_model::dt) fn->FixParameter(j, bpar[j]);
+	}
+	else {
+		if (impl == implBFit) fn = new TF1("fBFit", pfBFit[nComponents-1], 0.0, ctx->tCyc, nPars);
+		else fn = new TF1(impl == implBatch ? "fBatch" : "fBFit2", ModelFunctor(ctx, yAll), 0.0, ctx->tCyc, nPars);
+		fn->SetParameters(a);
+		fn->SetParErrors(pstBFitCase->pdStep);
+		for (j = 0; j < nPars; j++) if (!tog[j]) fn->FixParameter(j, a[j]);
+		if (ctx->b134sbFlag && !tog[gammaT2]) fn->FixParameter(gammaT3, a[gammaT2]);
+	}
+	TStopwatch sw;
+	TFitResultPtr fit;
+	if (impl == implBatch) {
+		// The case with the options BatchFit() reads for the same fit (N and 0 are TH1::Fit's)
+		BFitCase_t stBatchCase = *pstBFitCase;
+		strcpy(stBatchCase.pcsOptions, strchr(pstBFitCase->pcsOptions,'L') ? "QSL" : "QS");
+		SetActiveExponentials(ctx, a, tog);
+		fit = BatchFit(ctx, h, fn, &stBatchCase);
+		h->GetListOfFunctions()->Remove(fn); // BatchFit() hands fn to h, as TH1::Fit without N would
+		ctx->activeExp = expAll;
+	}
+	else fit = h->Fit(fn, options);
+	sw.Stop();
+	fr.dTime	= sw.RealTime();
+	fr.iStatus	= fit->Status();
+	fr.dChi2	= fit->Chi2();
+	fr.iNDF		= fit->Ndf();
+	for (j = 0; j < nPars; j++) { fr.dPar[j] = a[j]; fr.dErr[j] = 0.0; }
+	if (impl == implB_fit) {
+		for (j = 0; j < B_fit_model::tauT1; j++) {
+			fr.dPar[piB_fitFrom[j]] = fn->GetParameter(j);
+			fr.dErr[piB_fitFrom[j]] = fn->GetParError(j);
+		}
+	}
+	else for (j = 0; j < nPars; j++) {
+		fr.dPar[j] = fn->GetParameter(j);
+		fr.dErr[j] = fn->GetParError(j);
+	}
+	delete fn;
+}
+
+// Chi-square of the BFit2 model with parameters par on the bins of h as BatchChi2() and TH1::Fit
+// take them without option I: at the bin centres, bins with zero error left out, or chi2_L
+// (over all bins) with bPoisson
+Double_t HistChi2 (BFitNamespace::ModelContext_t *ctx, TH1D *h, Double_t *par, Bool_t bPoisson) {
+	Double_t sum = 0.0, t, n, mu;
+	for (Int_t bin = 1; bin <= h->GetNbinsX(); bin++) {
+		t	= h->GetBinCenter(bin);
+		n	= h->GetBinContent(bin);
+		mu	= TMath::Max(BFitNamespace::yAll(ctx, &t, par), 1e-300);
+		if (bPoisson) sum += 2.0*(mu - n + (n > 0 ? n*log(n/mu) : 0.0));
+		else if (h->GetBinError(bin) > 0) sum += (n - mu)*(n - mu)/(h->GetBinError(bin)*h->GetBinError(bin));
+	}
+	return sum;
+}
+
+int main (int argc, char *argv[]) {
+	using namespace BFitNamespace;
+	Double_t	dTolerance = 1e-6, dWorst[nImpls], dNsTotal[nImpls], dNs[nImpls], d, scale;
+	Int_t		nReps = 3, iBFit, iBDN, iArg, iSet, iImpl, c, i, j, nCases = 0, nFailed = 0, nTimed[nImpls];
+	Bool_t		bFit = kFALSE, bAnyPattern = kFALSE;
+	vector<Bool_t> vChosen;
+
+	iNumStructs_BDN  = CSVtoStruct_BDN  ((char*)"BDNCases.csv_transposed", stBDNCases);
+	iNumStructs_BFit = CSVtoStruct_BFit ((char*)"BFitCases.csv_transposed", stBFitCases);
+	cout << "Imported " << iNumStructs_BDN << " BDN cases and " << iNumStructs_BFit << " BFit cases" << endl;
+	vChosen.assign(iNumStructs_BFit, kFALSE);
+	for (iArg = 1; iArg < argc; iArg++) {
+		if (sscanf(argv[iArg], "--tolerance=%lf", &dTolerance) == 1) continue;
+		if (sscanf(argv[iArg], "--reps=%d", &nReps) == 1) continue;
+		if (!strcmp(argv[iArg], "--fit")) { bFit = kTRUE; continue; }
+		bAnyPattern = kTRUE;
+		for (iBFit = 0; iBFit < iNumStructs_BFit; iBFit++)
+			if (!fnmatch(argv[iArg], stBFitCases[iBFit].pcsCaseCode, 0)) vChosen[iBFit] = kTRUE;
+	}
+	::iota = 0.000000000001; // as in BFit.cxx
+	for (iImpl = 0; iImpl < nImpls; iImpl++) { dWorst[iImpl] = dNsTotal[iImpl] = 0.0; nTimed[iImpl] = 0; }
+
+	printf("%-16s %-10s %3s  %-11s  %-5s %-9s  %s\n", "BFit case", "BDN case", "set", "model", "worst", "diff", "(worst of the components not checked)");
+	for (iBFit = 0; iBFit < iNumStructs_BFit; iBFit++) {
+		if (bAnyPattern && !vChosen[iBFit]) continue;
+		BFitCase_t &stBFitCase = stBFitCases[iBFit];
+		iBDN = FindBDNCaseIndex(stBDNCases, iNumStructs_BDN, stBFitCase.pcsCaseCode);
+		if (iBDN < 0 || !(stBDNCases[iBDN].dCaptureTime > 0) || !(stBDNCases[iBDN].dCycleTime > 0)) continue;
+		Int_t nPars = stBFitCase.iNPars;
+		Double_t seed[nParIndex], par[nParIndex], bpar[B_fit_model::nPars];
+		memcpy(seed, stBFitCase.pdSeed, nPars*sizeof(Double_t));
+		seed[nCyc] = stBDNCases[iBDN].nCycles;
+		ModelContext_t ctx;
+		InitModelContext(&ctx, &stBDNCases[iBDN], nPars, seed);
+		SetBFitGlobals(&ctx);
+		Bool_t bB_fit = HasB_fitCycle(&ctx);
+	// Bin centres over the cycle, at the case's bin width
+		Double_t width = (seed[dt] > 0) ? seed[dt] : 1.0;
+		vector<Double_t> t;
+		for (Double_t x = 0.5*width; x < ctx.tCyc; x += width) t.push_back(x);
+		Int_t nBins = t.size();
+		vector<Double_t> yRef[nComponents], y(nBins);
+		for (c = 0; c < nComponents; c++) yRef[c].resize(nBins);
+		TRandom3 rng(iBFit + 1);
+		nCases++;
+
+		for (iSet = 0; iSet < nSets; iSet++) {
+			memcpy(par, seed, nPars*sizeof(Double_t));
+		// Variations: every rate, fraction and efficiency scaled by up to 20%, rho kept below 1 and
+		// the gammas pulled off 0, so the 2014 closed forms are away from their 0/0 points
+			if (iSet > 0) {
+				for (j = DC; j < nPars; j++) par[j] *= 1.0 + 0.2*rng.Uniform(-1.0, 1.0);
+				par[p]		= TMath::Min(par[p], 1.0);
+				par[rho]	= seed[rho]*rng.Uniform(0.8, 0.95);
+				for (j = gammaT1; j < nPars; j++) par[j] += rng.Uniform(0.01, 0.1);
+			}
+			if (ctx.b134sbFlag) par[gammaT3] = par[gammaT2];
+		// BFit2 pointwise is the reference (the component functions don't update the context; yAll does)
+			UpdateParameterDependentVars(&ctx, par);
+			for (c = 0; c < nComponents; c++)
+				for (i = 0; i < nBins; i++) yRef[c][i] = pfBFit2[c](&ctx, &t[i], par);
+			scale = 0.0;
+			for (i = 0; i < nBins; i++) scale = TMath::Max(scale, fabs(yRef[nComponents-1][i]));
+			for (iImpl = 0; iImpl < nImpls; iImpl++) {
+				if (iImpl == implBFit2 || (iImpl == implB_fit && !bB_fit)) continue;
+				Double_t dMax = 0.0, dOther = 0.0;
+				Int_t cMax = -1, cOther = -1;
+				for (c = 0; c < nComponents; c++) {
+					if (iImpl == implBatch && c < nComponents-1) continue;
+					if (iImpl == implBatch) yAllBatch(&ctx, nBins, &t[0], par, &y[0]);
+					else if (iImpl == implBFit) {
+						Double_t a[nParIndex];
+						memcpy(a, par, nPars*sizeof(Double_t));
+						for (i = 0; i < nBins; i++) y[i] = pfBFit[c](&t[i], a);
+					}
+					else {
+						B_fitPars(&ctx, par, bpar);
+						for (i = 0; i < nBins; i++) y[i] = pfB_fit[c](&t[i], bpar);
+					}
+					d = WorstDiff(y, yRef[c], scale);
+					if (piChecked[iImpl] & (1 << c))	{ if (!(d <= dMax)) { dMax = d; cMax = c; } }
+					else if (!(d <= dOther))		{ dOther = d; cOther = c; }
+				}
+				Bool_t bFail = !(dMax <= dTolerance);
+				if (!(dMax <= dWorst[iImpl])) dWorst[iImpl] = dMax;
+				printf("%-16s %-10s %3d  %-11s", stBFitCase.pcsCaseCode, stBDNCases[iBDN].pcsCaseCode, iSet, pcsImplNames[iImpl]);
+				if (cMax >= 0)		printf("  %-5s %9.3e", pcsComponentNames[cMax], dMax);
+				else			printf("  %-5s %9s", "-", "");
+				if (cOther >= 0)	printf("  (not checked: %-5s %9.3e)", pcsComponentNames[cOther], dOther);
+				printf("%s\n", bFail ? "  FAILED" : "");
+				if (bFail) nFailed++;
+			}
+		}
+
+	// Time per yAll evaluation at the seeds
+		for (iImpl = 0; iImpl < nImpls; iImpl++) {
+			if (iImpl == implB_fit && !bB_fit) { dNs[iImpl] = 0.0; continue; }
+			dNs[iImpl] = TimeModel(iImpl, &ctx, seed, t, nReps);
+			dNsTotal[iImpl] += dNs[iImpl];
+			nTimed[iImpl]++;
+		}
+		printf("%-16s %-10s time per yAll: BFit2 batch %.1f ns, BFit2 %.1f ns, BFit %.1f ns", stBFitCase.pcsCaseCode,
+			stBDNCases[iBDN].pcsCaseCode, dNs[implBatch], dNs[implBFit2], dNs[implBFit]);
+		if (bB_fit) printf(", B_fit %.1f ns", dNs[implB_fit]);
+		printf(" (%d bins)\n", nBins);
+
+	// The same Poisson histogram fit with each model
+		if (bFit) {
+			TH1D *h = new TH1D(TString::Format("h_%s", stBFitCase.pcsCaseCode), "", nBins, 0.0, nBins*width);
+			TRandom3 rngHist(4357);
+			for (i = 0; i < nBins; i++) {
+				Double_t mu = yAll(&ctx, &t[i], seed);
+				h->SetBinContent(i+1, rngHist.Poisson(TMath::Max(mu, 0.0)));
+				h->SetBinError(i+1, TMath::Sqrt(h->GetBinContent(i+1)));
+			}
+			// BFit2 through TH1::Fit first: the other fits are compared with it
+			const Int_t piFitOrder[nImpls] = { implBFit2, implBatch, implBFit, implB_fit };
+			CompareFit_t fits[nImpls];
+			for (c = 0; c < nImpls; c++) {
+				iImpl = piFitOrder[c];
+				if (iImpl == implB_fit && !bB_fit) continue;
+				FitModel(iImpl, &ctx, &stBFitCase, seed, h, fits[iImpl]);
+				Double_t shift = 0.0;
+				for (j = 0; j < nPars; j++) {
+					if (!stBFitCase.pbToggle[j] || !(fits[implBFit2].dErr[j] > 0)) continue;
+					if (iImpl == implB_fit && j >= gammaT1) continue;
+					shift = TMath::Max(shift, fabs(fits[iImpl].dPar[j] - fits[implBFit2].dPar[j])/fits[implBFit2].dErr[j]);
+				}
+				printf("%-16s %-10s fit with %-6s status %d, chi2/ndf = %.2f/%d, %.2f s, largest shift from BFit2 %.3f errors\n",
+					stBFitCase.pcsCaseCode, stBDNCases[iBDN].pcsCaseCode, pcsImplNames[iImpl], fits[iImpl].iStatus,
+					fits[iImpl].dChi2, fits[iImpl].iNDF, fits[iImpl].dTime, shift);
+				if (iImpl != implBatch) continue;
+				// BatchFit() has to find TH1::Fit's minimum (to within dFitShift errors and a relative dFitChi2 in
+				// the chi-square, both taken pointwise here), and report the chi-square of the minimum it found
+				Bool_t bPoisson = strchr(stBFitCase.pcsOptions,'L') != 0;
+				Double_t chi2Batch	= HistChi2(&ctx, h, fits[implBatch].dPar, bPoisson);
+				Double_t chi2BFit2	= HistChi2(&ctx, h, fits[implBFit2].dPar, bPoisson);
+				Double_t dChi2Diff	= fabs(chi2Batch - chi2BFit2)/TMath::Max(chi2BFit2, 1.0);
+				Double_t dChi2Own	= fabs(fits[implBatch].dChi2 - chi2Batch)/TMath::Max(chi2Batch, 1.0);
+				Bool_t bFail = (fits[implBatch].iStatus != 0 && fits[implBFit2].iStatus == 0) || dChi2Own > dTolerance
+					|| (fits[implBatch].iStatus == 0 && fits[implBFit2].iStatus == 0 && (shift > dFitShift || dChi2Diff > dFitChi2));
+				printf("%-16s %-10s BatchFit vs TH1::Fit: %s %.3f from %.3f, reported %.3f  %s\n",
+					stBFitCase.pcsCaseCode, stBDNCases[iBDN].pcsCaseCode, bPoisson ? "chi2_L" : "chi2", chi2Batch, chi2BFit2,
+					fits[implBatch].dChi2, bFail ? "FAILED" : "ok");
+				if (bFail) nFailed++;
+			}
+			delete h;
+		}
+		FreeModelContext(&ctx);
+	}
+
+	printf("\n%d case(s), %d parameter sets each, tolerance %.1e\n", nCases, nSets, dTolerance);
+	for (iImpl = 0; iImpl < nImpls; iImpl++) {
+		if (iImpl == implBFit2) continue;
+		if (!nTimed[iImpl]) { printf("%-11s  not evaluated (no case with its cycle)\n", pcsImplNames[iImpl]); continue; }
+		TString checked;
+		for (c = 0; c < nComponents; c++) if (piChecked[iImpl] & (1 << c)) checked += TString::Format(" %s", pcsComponentNames[c]);
+		printf("%-11s  worst difference from BFit2 %.3e (checked on%s), mean time per yAll %.1f ns\n", pcsImplNames[iImpl], dWorst[iImpl],
+			checked.Data(), dNsTotal[iImpl]/nTimed[iImpl]);
+	}
+	printf("%-11s  mean time per yAll %.1f ns\n", pcsImplNames[implBFit2], nTimed[implBFit2] ? dNsTotal[implBFit2]/nTimed[implBFit2] : 0.0);
+	if (nFailed) printf("%d comparison(s) FAILED\n", nFailed);
+	else printf("All comparisons within tolerance\n");
+	return nFailed ? 1 : 0;
+}
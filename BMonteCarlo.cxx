@@ -64,6 +64,35 @@
 	Adding Z populations.
 2014-01-25
 	Found big mistake: Z pops were never added to aggregate histos h_DUi_[] and h_D_[]. This affects all BMC runs through 0011.
+2015-06-15
+	Exact engine: BMonteCarlo(kTRUE) runs BMCExact() instead of The Big Loop. Between the capture and
+	ejection pulses it samples the competing decays and losses of all pops (and the DC background)
+	one event at a time (Gillespie's direct method), so there are no time steps, no a/b splitting of
+	concurrent processes, and the time taken goes with the number of decays and losses rather than with
+	T_run/T_step. Its ions are whole ions: the injected bunch is r*T_capt ions (the fractions carried to
+	the next capture), split between T and V by Binomial(p), and the capture losses are Binomial(1-rho).
+	It fills the same histograms, except that the real-time pops (h_A_realtime, h_T1_realtime, ...),
+	which cost one bin for every T_step of T_run whatever the number of events, are only recorded with
+	bRealTimePops = kTRUE (the last argument). Run it with .x BMonteCarlo.cxx+(kTRUE)
+2015-06-16
+	Replicas: BMonteCarlo(kTRUE, nReplicas, nThreads, bPerReplica, iSeed) runs nReplicas independent
+	simulations with the exact engine, nThreads at a time (default: one per core; needs ROOT 6.06 for
+	threads). Replica k runs on its own TRandom3(iSeed + k), so the results don't depend on the threads,
+	and replica 0 with the default iSeed = 2 is the single run. The file gets the cycle-time histograms
+	summed over the replicas, under the usual names (so BFit2 reads it as a BMC file), h_..._cyctime_var
+	with the variance between replicas in each bin, and, with bPerReplica, each replica's histograms in
+	directory replica_<k>. No real-time histograms in this mode.
+2015-06-17
+	Steady-state start: BMonteCarlo(kTRUE, ..., bSteadyState = kTRUE) doesn't build the pops up from
+	empty. BMCSteadyState() finds the mean pops at the start of a cycle in the periodic steady state (the
+	V10, W10, Z10, X20, Y20, ... of BFit2, for all pops at once) and BMCExact() starts the run at t = 0
+	from Poisson draws around them, with the DC background on from the start. So every one of the nCycles
+	cycles is a steady-state cycle: no warm-up cycles to run through (or bias the first ones), and no
+	empty first background period or extra T_bkgd at the end. Exact engine only.
+2015-06-18
+	The single run uses TRandom3(iSeed) too (it was always TRandom3(2)), so replica 0 is the single
+	run for any iSeed. iSeed has to be at least 1: TRandom3(0) seeds from the clock, and a replica
+	seeded that way couldn't be run again.
 */
 
 #include <iostream>
@@ -80,16 +109,58 @@
 #include "TLegend.h"
 #include "TVector.h"
 #include "TPaveStats.h"
+#include "TStopwatch.h"
+#include "TDirectory.h"
 #include "Fit/FitConfig.h"
+#include "RVersion.h"
+#include <vector>
+
+// Replicas run on several threads with ROOT 6.06 or later
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+#define BMC_THREADS
+#include <thread>
+#include <mutex>
+#include <atomic>
+#endif
 
 //Double_t decay (TRandom3 *, Double_t, Double_t, Double_t);
 
-void BMonteCarlo () {
+// Populations of the exact engine
+enum BMCPop_t { bmcT1, bmcT2, bmcT3, bmcV1, bmcV2, bmcV3, bmcW1, bmcW2, bmcW3, bmcZ1, bmcZ2, bmcZ3, bmcX2, bmcX3, bmcY2, bmcY3, nBMCPops };
+
+// Parameters of the exact engine, from the constants at the top of BMonteCarlo()
+struct BMCExactPars_t {
+	Double_t	rDC, r[3], p, rho;			// injection (1/ms)
+	Long64_t	T_cycle, T_bkgd, T_capt, T_run, T_step;	// cycle (ms); T_step only bins the real-time pops
+	Double_t	kD[3];					// radioactive decay rates 1/ti (1/ms), by species
+	Double_t	kL[nBMCPops];				// non-radioactive loss rates gTi, gUi (1/ms), by pop
+	Double_t	eps[nBMCPops];				// detection efficiencies, by pop
+	Bool_t		bSteady;				// start from the steady state n0 (BMCSteadyState())
+	Double_t	n0[nBMCPops];				// mean pops at the start of a cycle in the steady state
+};
+
+// Histograms the exact engine fills, by pop (the same ones The Big Loop fills). Any of them may be 0,
+// and isn't filled then. BMonteCarlo() leaves the real-time pops at 0 unless asked for them, since
+// recording them costs a little for every T_step bin of T_run.
+struct BMCHistos_t {
+	TH1D	*hD, *hDDC, *hDPop[nBMCPops], *hDU[3];		// detections vs cycle time
+	TH1D	*hDReal, *hDPopReal[nBMCPops], *hDUReal[3];	// detections vs real time
+	TH1D	*hA, *hPop[nBMCPops], *hU[3];			// pops vs real time
+};
+
+void BMCExact (const BMCExactPars_t&, TRandom3*, BMCHistos_t&, Double_t*, Double_t&);
+void BMCReplicas (const BMCExactPars_t&, Int_t, Int_t, Bool_t, Int_t, TFile*);
+void BMCSteadyState (BMCExactPars_t&);
+
+void BMonteCarlo (Bool_t bExact = kFALSE, Int_t nReplicas = 0, Int_t nThreads = 0, Bool_t bPerReplica = kFALSE, Int_t iSeed = 2,
+	Bool_t bSteadyState = kFALSE, Bool_t bRealTimePops = kFALSE) {
 	
 	gROOT->Reset();
 	
+	// TRandom3(0) would seed from the clock, so the run and every replica (iSeed + k) need iSeed >= 1
+	if (iSeed < 1) { printf("iSeed must be at least 1 (got %d).\n", iSeed); return; }
 // Filename for simulation
-	TRandom3 *randgen = new TRandom3(2);
+	TRandom3 *randgen = new TRandom3(iSeed);
 	TFile *rootfile = new TFile("BMC_0033.root","RECREATE");
 // Injection parameters
     const Double_t rDC		= 0.040; // in 1/ms
@@ -124,9 +195,22 @@ void BMonteCarlo () {
 	const Double_t eps_Z	= 0.96;
 	
 // Calculations
-	Int_t	T_run	= nCycles*T_cycle + T_bkgd;
+	Int_t	T_run	= nCycles*T_cycle + (bSteadyState ? 0 : T_bkgd); // no empty first background period from the steady state
 	Int_t	nSteps	= T_run/T_step;
 	Int_t	t, t_cyc, t_bin, cyc_bin;
+	BMCExactPars_t par = { rDC, {r1, r2, r3}, p, rho, T_cycle, T_bkgd, T_capt, T_run, T_step, {1.0/t1, 1.0/t2, 1.0/t3},
+		{gT1, gT2, gT3, gU1, gU2, gU3, gU1, gU2, gU3, gU1, gU2, gU3, gU2, gU3, gU2, gU3},
+		{eps_T, eps_T, eps_T, eps_V, eps_V, eps_V, eps_W, eps_W, eps_W, eps_Z, eps_Z, eps_Z, eps_X, eps_X, eps_Y, eps_Y} };
+	if (bSteadyState) {
+		if (!bExact && nReplicas < 1) printf("The steady-state start runs on the exact engine.\n");
+		bExact = kTRUE;
+		BMCSteadyState(par);
+	}
+	if (nReplicas > 0) {
+		if (!bExact) printf("Replicas run on the exact engine.\n");
+		BMCReplicas(par, nReplicas, nThreads, bPerReplica, iSeed, rootfile);
+		return;
+	}
 // Probability of indivdual decay (D) or loss without decay (L) within T_step
 	const Double_t pD1  = 1.0 - TMath::Exp(-T_step/t1); // beta decay probability of species 1, in time T_step
 	const Double_t pD2  = 1.0 - TMath::Exp(-T_step/t2); // beta decay probability of species 2, in time T_step
@@ -282,8 +366,34 @@ void BMonteCarlo () {
 	// Ions lost from trapped pops when capture pulse happens
 //	Int_t captloss_T1=0, captloss_T2=0, captloss_T3=0;
 	
+	if (bExact) {
+		BMCHistos_t h = { h_D_cyctime, h_DDC_cyctime,
+			{h_DT1_cyctime, h_DT2_cyctime, h_DT3_cyctime, h_DV1_cyctime, h_DV2_cyctime, h_DV3_cyctime, h_DW1_cyctime, h_DW2_cyctime,
+			 h_DW3_cyctime, h_DZ1_cyctime, h_DZ2_cyctime, h_DZ3_cyctime, h_DX2_cyctime, h_DX3_cyctime, h_DY2_cyctime, h_DY3_cyctime},
+			{h_DU1_cyctime, h_DU2_cyctime, h_DU3_cyctime}, h_D_realtime,
+			{h_DT1_realtime, h_DT2_realtime, h_DT3_realtime, h_DV1_realtime, h_DV2_realtime, h_DV3_realtime, h_DW1_realtime, h_DW2_realtime,
+			 h_DW3_realtime, h_DZ1_realtime, h_DZ2_realtime, h_DZ3_realtime, h_DX2_realtime, h_DX3_realtime, h_DY2_realtime, h_DY3_realtime},
+			{h_DU1_realtime, h_DU2_realtime, h_DU3_realtime}, h_A_realtime,
+			{h_T1_realtime, h_T2_realtime, h_T3_realtime, h_V1_realtime, h_V2_realtime, h_V3_realtime, h_W1_realtime, h_W2_realtime,
+			 h_W3_realtime, h_Z1_realtime, h_Z2_realtime, h_Z3_realtime, h_X2_realtime, h_X3_realtime, h_Y2_realtime, h_Y3_realtime},
+			{h_U1_realtime, h_U2_realtime, h_U3_realtime} };
+		if (!bRealTimePops) { // BMCRecordPops() would step through all of T_run
+			h.hA = 0;
+			for (Int_t s = 0; s < nBMCPops; s++) h.hPop[s] = 0;
+			for (Int_t s = 0; s < 3; s++) h.hU[s] = 0;
+		}
+		Double_t nD[nBMCPops];
+		BMCExact(par, randgen, h, nD, nDDC);
+		nDT1 = nD[bmcT1]; nDT2 = nD[bmcT2]; nDT3 = nD[bmcT3];
+		nDV1 = nD[bmcV1]; nDV2 = nD[bmcV2]; nDV3 = nD[bmcV3];
+		nDW1 = nD[bmcW1]; nDW2 = nD[bmcW2]; nDW3 = nD[bmcW3];
+		nDZ1 = nD[bmcZ1]; nDZ2 = nD[bmcZ2]; nDZ3 = nD[bmcZ3];
+		nDX2 = nD[bmcX2]; nDX3 = nD[bmcX3];
+		nDY2 = nD[bmcY2]; nDY3 = nD[bmcY3];
+	}
+	
 	// The Big Loop
-	for (Int_t i=0; i<nSteps; i++) { // not i<=nSteps
+	if (!bExact) for (Int_t i=0; i<nSteps; i++) { // not i<=nSteps
 		
 		t		= i*T_step; // real time in ms
 		t_cyc	= t%T_cycle; // cycle time in ms
@@ -640,6 +750,383 @@ void BMonteCarlo () {
 	
 }
 
+// Exact engine
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Species of each pop, the pop its decays feed (X from trapped parents, Y from untrapped ones; -1 past
+// species 3), and the pop its non-radioactive losses go to (trapped losses make the Z pops; -1 = gone)
+const Int_t piBMCSpecies[nBMCPops]	= { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 1, 2, 1, 2 };
+const Int_t piBMCDaughter[nBMCPops]	= { bmcX2, bmcX3, -1, bmcY2, bmcY3, -1, bmcY2, bmcY3, -1, bmcY2, bmcY3, -1, bmcY3, -1, bmcY3, -1 };
+const Int_t piBMCLossTo[nBMCPops]	= { bmcZ1, bmcZ2, bmcZ3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+
+void BMCAdd (TH1D *h, Double_t x) {
+	if (h) h->AddBinContent(h->FindBin(x));
+}
+
+// Pops at the end of each T_step bin of real time that ends by tEnd, as The Big Loop records them
+// (a bin that ends at a pulse gets the pops from before the pulse)
+void BMCRecordPops (const BMCExactPars_t &par, const Double_t *n, BMCHistos_t &h, Long64_t &tBin, Double_t tEnd) {
+	Int_t s, bin;
+	if (!h.hA) return;
+	for (; tBin + par.T_step <= tEnd; tBin += par.T_step) {
+		bin = h.hA->FindBin(tBin + 0.5*par.T_step);
+		Double_t nU[3] = {0, 0, 0}, nA = 0;
+		for (s = 0; s < nBMCPops; s++) {
+			h.hPop[s]->SetBinContent(bin, n[s]);
+			if (s >= bmcV1) nU[piBMCSpecies[s]] += n[s];
+			nA += n[s];
+		}
+		for (s = 0; s < 3; s++) h.hU[s]->SetBinContent(bin, nU[s]);
+		h.hA->SetBinContent(bin, nA);
+	}
+}
+
+// First capture or ejection pulse after real time t
+Long64_t BMCNextPulse (const BMCExactPars_t &par, Long64_t t) {
+	Long64_t tCycStart = t - t%par.T_cycle, tCyc = t%par.T_cycle, tNext;
+	if (tCyc < par.T_bkgd)	tNext = tCycStart + par.T_bkgd;
+	else					tNext = tCycStart + par.T_bkgd + ((tCyc - par.T_bkgd)/par.T_capt + 1)*par.T_capt;
+	return TMath::Min(tNext, tCycStart + par.T_cycle);
+}
+
+// Simulates the run event by event and fills h. Between pulses the pops only decay and leak, each
+// ion at a constant rate, so the time to the next event of any kind is exponential with the total
+// rate a0 = rDC + sum of n*(kD + kL), and the event is picked in proportion to its rate (Gillespie's
+// direct method). Returns the detections of each pop in nD and of the DC background in nDDC.
+// As in The Big Loop, nothing decays before the first capture at T_bkgd; with par.bSteady the run
+// starts at t = 0 instead, from pops drawn from Poisson distributions about the steady state par.n0.
+void BMCExact (const BMCExactPars_t &par, TRandom3 *randgen, BMCHistos_t &h, Double_t *nD, Double_t &nDDC) {
+	Double_t	n[nBMCPops], k[nBMCPops], fInj[3] = {0, 0, 0};
+	Double_t	t = par.bSteady ? 0 : par.T_bkgd, tStop, tEvent, tCyc, a0, u;
+	Long64_t	tPulse = par.T_bkgd, tBin = par.bSteady ? 0 : par.T_bkgd, tPulseCyc;
+	Int_t		s, i, nIn, nTrap, nLost;
+	
+	for (s = 0; s < nBMCPops; s++) {
+		n[s]	= par.bSteady ? randgen->Poisson(par.n0[s]) : 0;
+		nD[s]	= 0;
+		k[s]	= par.kD[piBMCSpecies[s]] + par.kL[s];
+	}
+	nDDC = 0;
+	
+	while (t < par.T_run) {
+	// Decays and losses up to the next pulse
+		tStop = TMath::Min(tPulse, par.T_run);
+		for (;;) {
+			a0 = par.rDC;
+			for (s = 0; s < nBMCPops; s++) a0 += n[s]*k[s];
+			if (a0 <= 0) break;
+			tEvent = t + randgen->Exp(1.0/a0);
+			if (tEvent >= tStop) break;
+			BMCRecordPops(par, n, h, tBin, tEvent);
+			t = tEvent;
+			tCyc = fmod(t, (Double_t)par.T_cycle);
+			u = randgen->Rndm()*a0;
+			if (u < par.rDC) {
+				nDDC++;
+				BMCAdd(h.hD, tCyc);
+				BMCAdd(h.hDDC, tCyc);
+				BMCAdd(h.hDReal, t);
+				continue;
+			}
+			u -= par.rDC;
+			for (s = 0; s < nBMCPops; s++) {
+				if (n[s] > 0 && u < n[s]*k[s]) break;
+				u -= n[s]*k[s];
+			}
+			if (s == nBMCPops) continue; // rounding at the top of a0
+			i = piBMCSpecies[s];
+			if (u < n[s]*par.kD[i]) { // beta decay
+				if (piBMCDaughter[s] >= 0) n[piBMCDaughter[s]]++;
+				if (randgen->Rndm() < par.eps[s]) {
+					nD[s]++;
+					BMCAdd(h.hD, tCyc);
+					BMCAdd(h.hDPop[s], tCyc);
+					BMCAdd(h.hDPopReal[s], t);
+					BMCAdd(h.hDReal, t);
+					if (s >= bmcV1) {
+						BMCAdd(h.hDU[i], tCyc);
+						BMCAdd(h.hDUReal[i], t);
+					}
+				}
+			}
+			else if (piBMCLossTo[s] >= 0) n[piBMCLossTo[s]]++; // non-radioactive loss
+			n[s]--;
+		}
+		t = tStop;
+		if (t >= par.T_run) break;
+		BMCRecordPops(par, n, h, tBin, t);
+		
+	// CAPTURE PULSE: capture losses move T to W, then the new bunch goes into T and V
+		tPulseCyc = tPulse%par.T_cycle;
+		if (tPulseCyc >= par.T_bkgd && (tPulseCyc - par.T_bkgd)%par.T_capt == 0) {
+			for (i = 0; i < 3; i++) {
+				nLost = randgen->Binomial((Int_t)n[bmcT1+i], 1.0 - par.rho);
+				n[bmcT1+i] -= nLost;
+				n[bmcW1+i] += nLost;
+				fInj[i]	+= par.r[i]*par.T_capt;
+				nIn		= (Int_t)fInj[i];
+				fInj[i]	-= nIn;
+				nTrap	= randgen->Binomial(nIn, par.p);
+				n[bmcT1+i] += nTrap;
+				n[bmcV1+i] += nIn - nTrap;
+			}
+		}
+	// EJECTION PULSE
+		if (tPulseCyc == 0) for (i = 0; i < 3; i++) n[bmcT1+i] = 0;
+		tPulse = BMCNextPulse(par, tPulse);
+	}
+	BMCRecordPops(par, n, h, tBin, par.T_run);
+}
+
+// Replicas
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+const Int_t nBMCCycHistos = 2 + nBMCPops + 3; // D, DDC, each pop, U1 ... U3
+const char *pcsBMCPopNames[nBMCPops] = { "T1", "T2", "T3", "V1", "V2", "V3", "W1", "W2", "W3", "Z1", "Z2", "Z3", "X2", "X3", "Y2", "Y3" };
+const char *pcsBMCPopTitles[6] = { "Trapped Pop T", "Untrapped Pop V, from loss of injected bunch at capture",
+	"Untrapped Pop W, from loss of already-trapped ions at capture", "Untrapped Pop Z, from continuous non-radioactive loss of trapped ions",
+	"Untrapped Pop X, from feeding by trapped parents", "Untrapped Pop Y, from feeding by untrapped parents" };
+
+// The cycle-time histograms of h, in the order D, DDC, pops, U's
+void BMCCycHistos (BMCHistos_t &h, TH1D **ph) {
+	Int_t s;
+	ph[0] = h.hD;
+	ph[1] = h.hDDC;
+	for (s = 0; s < nBMCPops; s++) ph[2+s] = h.hDPop[s];
+	for (s = 0; s < 3; s++) ph[2+nBMCPops+s] = h.hDU[s];
+}
+
+// New cycle-time histograms for h, named and binned as in BMonteCarlo() with pcsSuffix on the
+// names; no real-time ones. They go in the current directory if TH1::AddDirectoryStatus().
+void BMCNewCycHistos (const BMCExactPars_t &par, BMCHistos_t &h, const char *pcsSuffix, const char *pcsTitleSuffix) {
+	Int_t	cycBins = 302000/par.T_step, cycMin = -1000, cycMax = 301000, s;
+	memset(&h, 0, sizeof(h));
+	h.hD	= new TH1D(Form("h_D_cyctime%s", pcsSuffix), Form("All Beta detections vs cycle time in ms%s", pcsTitleSuffix), cycBins, cycMin, cycMax);
+	h.hDDC	= new TH1D(Form("h_DDC_cyctime%s", pcsSuffix), Form("DC Beta detections vs cycle time in ms%s", pcsTitleSuffix), cycBins, cycMin, cycMax);
+	for (s = 0; s < nBMCPops; s++)
+		h.hDPop[s] = new TH1D(Form("h_D%s_cyctime%s", pcsBMCPopNames[s], pcsSuffix), Form("Species %d Betas from %s, vs cycle time in ms%s",
+			piBMCSpecies[s]+1, pcsBMCPopTitles[s < bmcX2 ? s/3 : 4 + (s-bmcX2)/2], pcsTitleSuffix), cycBins, cycMin, cycMax);
+	for (s = 0; s < 3; s++)
+		h.hDU[s] = new TH1D(Form("h_DU%d_cyctime%s", s+1, pcsSuffix), Form("Species %d Betas from All Untrapped Pops (U), vs cycle time in ms%s",
+			s+1, pcsTitleSuffix), cycBins, cycMin, cycMax);
+}
+
+// Sums over the replicas, and what each one adds
+struct BMCReplicaSums_t {
+	std::vector<Double_t>	vSum[nBMCCycHistos], vSum2[nBMCCycHistos];	// sum and sum of squares of each bin
+	Double_t				nD[nBMCPops], nDDC;						// detections
+};
+
+void BMCAddReplica (BMCReplicaSums_t &sums, BMCHistos_t &h, const Double_t *nD, Double_t nDDC) {
+	TH1D	*ph[nBMCCycHistos];
+	Int_t	j, b, s;
+	Double_t c;
+	BMCCycHistos(h, ph);
+	for (j = 0; j < nBMCCycHistos; j++)
+		for (b = 0; b < (Int_t)sums.vSum[j].size(); b++) {
+			c = ph[j]->GetBinContent(b);
+			sums.vSum[j][b]		+= c;
+			sums.vSum2[j][b]	+= c*c;
+		}
+	for (s = 0; s < nBMCPops; s++) sums.nD[s] += nD[s];
+	sums.nDDC += nDDC;
+}
+
+// Runs replica k on h (reset first) with its own generator, TRandom3(iSeed + k)
+void BMCRunReplica (const BMCExactPars_t &par, BMCHistos_t &h, Int_t iSeed, Int_t k, Double_t *nD, Double_t &nDDC) {
+	TH1D	*ph[nBMCCycHistos];
+	BMCCycHistos(h, ph);
+	for (Int_t j = 0; j < nBMCCycHistos; j++) ph[j]->Reset();
+	TRandom3 randgen(iSeed + k);
+	BMCExact(par, &randgen, h, nD, nDDC);
+}
+
+// Writes replica k's histograms to directory replica_<k> of rootfile
+void BMCWriteReplica (TFile *rootfile, BMCHistos_t &h, Int_t k) {
+	TH1D		*ph[nBMCCycHistos];
+	TDirectory	*dir = rootfile->mkdir(Form("replica_%04d", k));
+	BMCCycHistos(h, ph);
+	for (Int_t j = 0; j < nBMCCycHistos; j++) dir->WriteTObject(ph[j]);
+}
+
+// nReplicas independent runs of the exact engine, nThreads at a time. Each thread has its own
+// histograms and generator; adding a replica to the sums (and writing it) is done one at a time.
+void BMCReplicas (const BMCExactPars_t &par, Int_t nReplicas, Int_t nThreads, Bool_t bPerReplica, Int_t iSeed, TFile *rootfile) {
+	BMCReplicaSums_t	sums;
+	BMCHistos_t			hSum, hVar;
+	TH1D				*phSum[nBMCCycHistos], *phVar[nBMCCycHistos];
+	Int_t				i, j, b, s, nBins = 302000/par.T_step + 2;
+	Bool_t				bAddDirectory = TH1::AddDirectoryStatus();
+	
+	for (j = 0; j < nBMCCycHistos; j++) {
+		sums.vSum[j].assign(nBins, 0.0);
+		sums.vSum2[j].assign(nBins, 0.0);
+	}
+	for (s = 0; s < nBMCPops; s++) sums.nD[s] = 0;
+	sums.nDDC = 0;
+#ifdef BMC_THREADS
+	if (nThreads < 1) nThreads = std::thread::hardware_concurrency();
+#endif
+	if (nThreads < 1) nThreads = 1;
+	if (nThreads > nReplicas) nThreads = nReplicas;
+	printf("Running %d replicas (seeds %d ... %d) on %d thread(s)\n", nReplicas, iSeed, iSeed + nReplicas - 1, nThreads);
+	
+// Working histograms, one set per thread, in no directory
+	TH1::AddDirectory(kFALSE);
+	std::vector<BMCHistos_t> vWork(nThreads);
+	for (i = 0; i < nThreads; i++) BMCNewCycHistos(par, vWork[i], "", "");
+	TStopwatch stopwatch;
+#ifdef BMC_THREADS
+	ROOT::EnableThreadSafety();
+	std::mutex mtxSums;
+	std::atomic<Int_t> next(0);
+	auto worker = [&] (BMCHistos_t *h) {
+		Int_t k;
+		Double_t nD[nBMCPops], nDDC;
+		while ((k = next++) < nReplicas) {
+			BMCRunReplica(par, *h, iSeed, k, nD, nDDC);
+			std::lock_guard<std::mutex> lock(mtxSums);
+			BMCAddReplica(sums, *h, nD, nDDC);
+			if (bPerReplica) BMCWriteReplica(rootfile, *h, k);
+		}
+	};
+	std::vector<std::thread> vPool;
+	for (i = 0; i < nThreads; i++) vPool.push_back(std::thread(worker, &vWork[i]));
+	for (i = 0; i < nThreads; i++) vPool[i].join();
+#else
+	if (nThreads > 1) printf("ROOT %s can't run replicas on several threads; running one at a time.\n", ROOT_RELEASE);
+	Double_t nD[nBMCPops], nDDC;
+	for (i = 0; i < nReplicas; i++) {
+		BMCRunReplica(par, vWork[0], iSeed, i, nD, nDDC);
+		BMCAddReplica(sums, vWork[0], nD, nDDC);
+		if (bPerReplica) BMCWriteReplica(rootfile, vWork[0], i);
+	}
+#endif
+	stopwatch.Stop();
+	for (i = 0; i < nThreads; i++) {
+		TH1D *ph[nBMCCycHistos];
+		BMCCycHistos(vWork[i], ph);
+		for (j = 0; j < nBMCCycHistos; j++) delete ph[j];
+	}
+	
+// Sums under the usual names, and the variance between replicas in each bin
+	TH1::AddDirectory(kTRUE);
+	rootfile->cd();
+	BMCNewCycHistos(par, hSum, "", "");
+	BMCNewCycHistos(par, hVar, "_var", ", variance between replicas");
+	BMCCycHistos(hSum, phSum);
+	BMCCycHistos(hVar, phVar);
+	for (j = 0; j < nBMCCycHistos; j++)
+		for (b = 0; b < nBins; b++) {
+			phSum[j]->SetBinContent(b, sums.vSum[j][b]);
+			if (nReplicas > 1) phVar[j]->SetBinContent(b, (sums.vSum2[j][b] - sums.vSum[j][b]*sums.vSum[j][b]/nReplicas)/(nReplicas - 1));
+		}
+	Double_t nDU[3] = {0, 0, 0}, nDAll = sums.nDDC;
+	for (s = 0; s < nBMCPops; s++) {
+		phSum[2+s]->SetEntries(sums.nD[s]);
+		if (s >= bmcV1) nDU[piBMCSpecies[s]] += sums.nD[s];
+		nDAll += sums.nD[s];
+	}
+	for (s = 0; s < 3; s++) phSum[2+nBMCPops+s]->SetEntries(nDU[s]);
+	hSum.hDDC->SetEntries(sums.nDDC);
+	hSum.hD->SetEntries(nDAll);
+	rootfile->Write();
+	rootfile->Close();
+	TH1::AddDirectory(bAddDirectory);
+	
+	printf("\n");
+	printf("%d replicas in %.1f s (%.1f s of CPU)\n", nReplicas, stopwatch.RealTime(), stopwatch.CpuTime());
+	printf("Number of decays, all replicas:\n");
+	printf("DC=%10.1f\n", sums.nDDC);
+	printf("T1=%10.1f  U1=%10.1f  V1=%10.1f  W1=%10.1f  Z1=%10.1f\n", sums.nD[bmcT1], nDU[0], sums.nD[bmcV1], sums.nD[bmcW1], sums.nD[bmcZ1]);
+	printf("T2=%10.1f  U2=%10.1f  V2=%10.1f  W2=%10.1f  Z2=%10.1f  X2=%10.1f  Y2=%10.1f\n", sums.nD[bmcT2], nDU[1], sums.nD[bmcV2],
+		sums.nD[bmcW2], sums.nD[bmcZ2], sums.nD[bmcX2], sums.nD[bmcY2]);
+	printf("T3=%10.1f  U3=%10.1f  V3=%10.1f  W3=%10.1f  Z3=%10.1f  X3=%10.1f  Y3=%10.1f\n", sums.nD[bmcT3], nDU[2], sums.nD[bmcV3],
+		sums.nD[bmcW3], sums.nD[bmcZ3], sums.nD[bmcX3], sums.nD[bmcY3]);
+	printf("\n");
+}
+
+// Steady-state start
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Mean pops n after dt ms of decays and losses alone, n -> exp(A*dt) n, where A is the rate matrix of the
+// tables above (lower triangular: pops only feed pops further down the list). Taylor series over
+// sub-steps short enough (kMax*h <= 1/2) for it to converge in a few tens of terms.
+void BMCMeanEvolve (const BMCExactPars_t &par, Double_t *n, Double_t dt) {
+	Double_t	k[nBMCPops], term[nBMCPops], next[nBMCPops], kMax = 0, h, size, norm;
+	Int_t		s, j, m, nSub;
+	
+	for (s = 0; s < nBMCPops; s++) {
+		k[s] = par.kD[piBMCSpecies[s]] + par.kL[s];
+		kMax = TMath::Max(kMax, k[s]);
+	}
+	nSub	= (Int_t)(2*kMax*dt) + 1;
+	h		= dt/nSub;
+	for (m = 0; m < nSub; m++) {
+		norm = 0;
+		for (s = 0; s < nBMCPops; s++) {
+			term[s] = n[s];
+			norm += TMath::Abs(n[s]);
+		}
+		for (j = 1; j < 100; j++) {
+			for (s = 0; s < nBMCPops; s++) next[s] = -k[s]*term[s];
+			for (s = 0; s < nBMCPops; s++) {
+				if (piBMCDaughter[s] >= 0)	next[piBMCDaughter[s]]	+= par.kD[piBMCSpecies[s]]*term[s];
+				if (piBMCLossTo[s] >= 0)	next[piBMCLossTo[s]]	+= par.kL[s]*term[s];
+			}
+			size = 0;
+			for (s = 0; s < nBMCPops; s++) {
+				term[s]	= next[s]*h/j;
+				n[s]	+= term[s];
+				size	+= TMath::Abs(term[s]);
+			}
+			if (size <= 1e-17*norm) break;
+		}
+	}
+}
+
+// Mean pops at the start of the next cycle from those at the start of this one (just after the
+// ejection), with the same pulses as BMCExact(): the injected bunch is r*T_capt on average.
+void BMCMeanCycle (const BMCExactPars_t &par, Double_t *n) {
+	Long64_t	t = 0, tPulse;
+	Int_t		i;
+	
+	for (;;) {
+		tPulse = BMCNextPulse(par, t);
+		BMCMeanEvolve(par, n, tPulse - t);
+		t = tPulse;
+		if (t >= par.T_cycle) break;
+		for (i = 0; i < 3; i++) {
+			n[bmcW1+i] += (1 - par.rho)*n[bmcT1+i];
+			n[bmcT1+i] = par.rho*n[bmcT1+i] + par.p*par.r[i]*par.T_capt;
+			n[bmcV1+i] += (1 - par.p)*par.r[i]*par.T_capt;
+		}
+	}
+	for (i = 0; i < 3; i++) n[bmcT1+i] = 0;
+}
+
+// Mean pops at the start of a cycle in the periodic steady state, to par.n0, and sets par.bSteady.
+// This is the fixed point of BMCMeanCycle(), reached by running it from empty pops until they stop
+// changing: the sum over all earlier cycles that BFit2 does in closed form for V10, W10, ..., Y30
+// (the T pops are 0 after the ejection). The untrapped pops keep a fraction exp(-T_cycle/tU) a cycle,
+// so it takes some tens of cycles, in much less time than one simulated cycle.
+void BMCSteadyState (BMCExactPars_t &par) {
+	Double_t	n[nBMCPops], change = 1;
+	Int_t		s, nIter;
+	
+	for (s = 0; s < nBMCPops; s++) n[s] = 0;
+	for (nIter = 0; nIter < 10000 && change >= 1e-12; nIter++) {
+		for (s = 0; s < nBMCPops; s++) par.n0[s] = n[s];
+		BMCMeanCycle(par, n);
+		change = 0;
+		for (s = 0; s < nBMCPops; s++)
+			if (n[s] > 0) change = TMath::Max(change, TMath::Abs(n[s] - par.n0[s])/n[s]);
+	}
+	for (s = 0; s < nBMCPops; s++) par.n0[s] = n[s];
+	par.bSteady = kTRUE;
+	if (change >= 1e-12) printf("BMCSteadyState: not converged after %d cycles (relative change %g)\n", nIter, change);
+	printf("Steady-state pops at the start of a cycle (%d cycles of the mean pops):\n", nIter);
+	for (s = bmcV1; s < nBMCPops; s++)
+		printf("%s=%10.3f%s", pcsBMCPopNames[s], n[s], (s < bmcX2 ? s%3 == 2 : s%2 == 1) ? "\n" : "  ");
+}
+
 //Double_t decay (TRandom3 *gen, Double_t n, Double_t tau, Double_t tstep) {
 //	// Use the normal approximation to calculate decays if n is "large enough"
 //	// Large enough means n*p>10 && n*(1-p)>10 according to the internet.
@@ -1,5 +1,6 @@
 #include "B_fit_model.h"
 #include "bdn_cases.h"
+#include "TMath.h"
 
 Double_t B_fit_model::T1 (Double_t *t, Double_t *a) {
 	using namespace B_fit_model;
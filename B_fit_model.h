@@ -2,11 +2,16 @@
 #ifndef _B_fit_model_h
 #define _B_fit_model_h
 
+#include "Rtypes.h"
+#include "TString.h"
+
 namespace B_fit_model {
 	
 	const Int_t nPars = 19;
-	Double_t par[nPars];
-	Double_t err[nPars];
+// Working copies for B_fit.cpp; static, so the model (B_fit_model.cxx) can be linked
+// with other programs that include this header
+	static Double_t par[nPars];
+	static Double_t err[nPars];
 	
 // Parameter indices -- don't change
 	
@@ -104,27 +109,27 @@ namespace B_fit_model {
 	Double_t yY2 (Double_t*, Double_t*);
 	Double_t yY3 (Double_t*, Double_t*);
 	
-	Double_t T1_integral = 0.0;
-	Double_t T2_integral = 0.0;
-	Double_t T3_integral = 0.0;
-	Double_t U1_integral = 0.0;
-	Double_t U2_integral = 0.0;
-	Double_t U3_integral = 0.0;
-	Double_t DC_integral = 0.0;
-	Double_t All_integral = 0.0;
+	static Double_t T1_integral = 0.0;
+	static Double_t T2_integral = 0.0;
+	static Double_t T3_integral = 0.0;
+	static Double_t U1_integral = 0.0;
+	static Double_t U2_integral = 0.0;
+	static Double_t U3_integral = 0.0;
+	static Double_t DC_integral = 0.0;
+	static Double_t All_integral = 0.0;
 	
-	Double_t Integral_sum = 0.0;
+	static Double_t Integral_sum = 0.0;
 	
-	Double_t T1_integral_error = 0.0;
-	Double_t T2_integral_error = 0.0;
-	Double_t T3_integral_error = 0.0;
-	Double_t U1_integral_error = 0.0;
-	Double_t U2_integral_error = 0.0;
-	Double_t U3_integral_error = 0.0;
-	Double_t DC_integral_error = 0.0;
-	Double_t All_integral_error = 0.0;
+	static Double_t T1_integral_error = 0.0;
+	static Double_t T2_integral_error = 0.0;
+	static Double_t T3_integral_error = 0.0;
+	static Double_t U1_integral_error = 0.0;
+	static Double_t U2_integral_error = 0.0;
+	static Double_t U3_integral_error = 0.0;
+	static Double_t DC_integral_error = 0.0;
+	static Double_t All_integral_error = 0.0;
 	
-	Double_t Integral_sum_error = 0.0;
+	static Double_t Integral_sum_error = 0.0;
 	
 }
 
@@ -25,6 +25,9 @@
 //	- Removed the main function from this file
 //	- Made a new version of CSVtoStruct and ParseToStruct for each type of stuct we need to use
 //	- Added FindStructIndex, which Chris also wrote for me 
+// 2015-06-14
+//	parNames and FindBDNCaseIndex moved here from BFit2.cxx, so that BFit2, BFit2SigmaTest and
+//	BFitModelCompare all name the parameters and match BFit cases to BDN cases the same way.
 // Include Files
 #include "CSVtoStruct.h"
 #include <string>
@@ -87,6 +90,23 @@ int FindStructIndex ( void *p, int iStructSize, int iNumStructs, char* pcsSearch
 	return iStructIndex;
 }
 
+char parNames[30][5] = {"nCyc", "dt", "DC", "r1", "r2", "r3", "p", "rho", "epsT", "epsU", "epsV", "epsW", "epsX", "epsY", "epsZ", "gT1", "gT2", "gT3", "gU1", "gU2", "gU3"};
+
+// BDN case for a BFit case: the one with the longest code that starts the BFit case code
+// (134sb0103_05 -> 134sb0103, not 134sb01). Returns -1 if there is none.
+int FindBDNCaseIndex ( const BDNCase_t *pstBDNCases, int iNumStructs, const char *pcsBFitCaseCode ) {
+	int i, iBest = -1;
+	size_t len, lenBest = 0;
+	for (i = 0; i < iNumStructs; i++) {
+		len = strlen(pstBDNCases[i].pcsCaseCode);
+		if (len > lenBest && !strncmp(pstBDNCases[i].pcsCaseCode, pcsBFitCaseCode, len)) {
+			iBest = i;
+			lenBest = len;
+		}
+	}
+	return iBest;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Read BDN struct
 //////////////////////////////////////////////////////////////////////////
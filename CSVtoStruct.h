@@ -28,6 +28,9 @@
 //		- b  = bool, but these are actually C strings. Usage: if (bStringVar)
 //	EVERY STRUCT MUST HAVE THE CASE CODE AS A char AS ITS FIRST MEMBER
 
+#ifndef _CSVtoStruct_h
+#define _CSVtoStruct_h
+
 // Configuration defines
 #define SUCCESS 0
 #define ERROR   1
@@ -152,7 +155,13 @@ struct BFitCase_t
 	char bComputeOtherIntegrals;
 };
 
+// Names of the BFit parameters, in the order of their rows in the BFit CSV (and of pdSeed etc.)
+extern char parNames[30][5];
+
 //Public function prototypes
 int FindStructIndex  ( void *p, int iStructSize, int iNumStructs, char* pcsSearchString );
+int FindBDNCaseIndex ( const BDNCase_t *pstBDNCases, int iNumStructs, const char *pcsBFitCaseCode );
 int CSVtoStruct_BDN  ( char *pcsFileName, BDNCase_t  *pstStruct );
 int CSVtoStruct_BFit ( char *pcsFileName, BFitCase_t *pstStruct );
+
+#endif
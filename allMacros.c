@@ -3445,18 +3445,42 @@ void draw_En_and_vInv_spectra ()
 //	Double_t TOFBkgd	= 1000.0*TOFSampleN/(tof2 - tof1); // counts/us
 	
 	Double_t TOFBkgd	= accidentals; // counts/us
-	TF1 *fnEnBkgd	= new TF1("fn_EnBkgd","[0]*[1]*[2]*[3]*sqrt([4]/(2*x)^3)", 0.1, EnMax);
-//	TF1 *fnEnBkgd	= new TF1("fn_EnBkgd","[0]*[1]*[2]*[3]*sqrt([4]/(2*x)^3)", 70, 200);
-	fnEnBkgd->SetNpx(2000);
-	fnEnBkgd->SetParameters(EnBinWidth, TOFBkgd, rMean, 1.0/c, massFactor);
+	
+// Accidentals are flat in TOF. 2015-05-04: the kinematics tables of bdnSort (bdnKinematics.cxx, incl. the
+// grid correction) turn them into an En spectrum for each MCP, in proportion to its share of h_tof, instead
+// of the analytic sqrt(massFactor/(2*En)^3) Jacobian per bin. rMean is the mean flight path, so the hits
+// are taken at s = sqrt(rMean^2 - z2^2) from the MCP center.
+	gROOT->ProcessLineSync(".L CSVtoStruct.cxx+");
+	gROOT->ProcessLineSync(".L mcpGridCorrection.cxx+");
+	gROOT->ProcessLineSync(".L bdnKinematics.cxx+");
+	char caseCode[32];
+	strcpy(caseCode, bdncase);
+	if (strchr(caseCode, '_')) *strchr(caseCode, '_') = '\0'; // 137i07_TeSubtract is case 137i07
+	BDNCase_t stBDNCases[FILE_ROWS_BDN];
+	Int_t nBDNCases	= CSVtoStruct_BDN("BDNCases.csv_transposed", stBDNCases);
+	Int_t iBDNCase	= FindStructIndex(stBDNCases, sizeof(BDNCase_t), nBDNCases, caseCode);
+	if (iBDNCase == -1) return;
+	BDNCase_t stBDNCase = stBDNCases[iBDNCase];
+	book_kinematics(stBDNCase);
+	TH1D *hTOFAcc	= new TH1D("hTOFAcc","Accidentals vs TOF in ns",TOFBins,TOFMin,TOFMax);
+	for (Int_t bin = 1; bin <= TOFBins; bin++)
+		if (hTOFAcc->GetBinLowEdge(bin) >= 0.0) hTOFAcc->SetBinContent(bin, 0.001*TOFBkgd*hTOFAcc->GetBinWidth(bin)); // ns to us
+	Double_t fracT	= ( ((TH1*)tfile->Get("h_tof_LT"))->Integral() + ((TH1*)tfile->Get("h_tof_BT"))->Integral() ) / hTOF->Integral();
+	TH1D *hEnBkgd	= tofToEnSpectrum(&stKinTableT, hTOFAcc, "hEnBkgd",  Sqrt(rMean*rMean - Power(stBDNCase.dTopMCPDistance,2.0)));
+	TH1D *hEnBkgdR	= tofToEnSpectrum(&stKinTableR, hTOFAcc, "hEnBkgdR", Sqrt(rMean*rMean - Power(stBDNCase.dRightMCPDistance,2.0)));
+	hEnBkgd		-> Scale(fracT);
+	hEnBkgd		-> Add(hEnBkgdR, 1.0 - fracT);
+	hEnBkgd		-> Rebin(EnRebin);
+	hEnBkgd		-> SetLineColor(kRed);
+	free_kinematics();
 	
 // Subtract background
 	hEnNet		-> Rebin(EnRebin);
-	hEnNet		-> Add(fnEnBkgd, -1.0);
+	hEnNet		-> Add(hEnBkgd, -1.0);
 	
 // Initialize final En:
 	hEnFin		-> Rebin(EnRebin);
-	hEnFin		-> Add(fnEnBkgd, -1.0);
+	hEnFin		-> Add(hEnBkgd, -1.0);
 	
 	//for (Int_t bin = 1; bin <= EnBins; bin++) hEnFin->SetBinContent(bin,hEnNet->GetBinContent(bin));	
 	hEnFin		-> Divide(fnEnCorr, 1.0);
@@ -3529,7 +3553,11 @@ void draw_En_and_vInv_spectra ()
 	hEn			-> Draw();
 	EnThreshLine->Draw("same");
   	QBnLine->Draw("same");
-	if (0) {
+	if (0) { // fit the accidental rate with the analytic form (on axis at rMean, no grid correction)
+		TF1 *fnEnBkgd	= new TF1("fn_EnBkgd","[0]*[1]*[2]*[3]*sqrt([4]/(2*x)^3)", 0.1, EnMax);
+	//	TF1 *fnEnBkgd	= new TF1("fn_EnBkgd","[0]*[1]*[2]*[3]*sqrt([4]/(2*x)^3)", 70, 200);
+		fnEnBkgd->SetNpx(2000);
+		fnEnBkgd->SetParameters(EnBinWidth, TOFBkgd, rMean, 1.0/c, massFactor);
 		fnEnBkgd->FixParameter(0, EnBinWidth);
 		fnEnBkgd->FixParameter(2, rMean);
 		fnEnBkgd->FixParameter(3, 1.0/c);
@@ -3540,7 +3568,7 @@ void draw_En_and_vInv_spectra ()
 		hEn->Fit(fnEnBkgd,"MELL","",3500,5000);
 	}
 	
-	fnEnBkgd	-> Draw("same");
+	hEnBkgd		-> Draw("hist same");
 	
 //	gStyle->SetOptStat("");
 	TCanvas *c_EnNet = new TCanvas("c_EnNet","Neutron energy spectrum",945,600);
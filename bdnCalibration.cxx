@@ -0,0 +1,46 @@
+#define _bdn_calibration_cxx "bdnCalibration.cxx"
+#include "bdnCalibration.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// book_calibrations -- build the tables from the constants in bdn.h (call once at startup)
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void book_calibrations () {
+// MCP pedestals
+	buildADCCalibration (&stCal_R_mcpA, -ped_R_mcpA, 1.0, 0.0);
+	buildADCCalibration (&stCal_R_mcpB, -ped_R_mcpB, 1.0, 0.0);
+	buildADCCalibration (&stCal_R_mcpC, -ped_R_mcpC, 1.0, 0.0);
+	buildADCCalibration (&stCal_R_mcpD, -ped_R_mcpD, 1.0, 0.0);
+	buildADCCalibration (&stCal_R_mcpE, -ped_R_mcpE, 1.0, 0.0);
+	buildADCCalibration (&stCal_T_mcpA, -ped_T_mcpA, 1.0, 0.0);
+	buildADCCalibration (&stCal_T_mcpB, -ped_T_mcpB, 1.0, 0.0);
+	buildADCCalibration (&stCal_T_mcpC, -ped_T_mcpC, 1.0, 0.0);
+	buildADCCalibration (&stCal_T_mcpD, -ped_T_mcpD, 1.0, 0.0);
+	buildADCCalibration (&stCal_T_mcpE, -ped_T_mcpE, 1.0, 0.0);
+// HPGe energies
+	buildADCCalibration (&stCal_R_ge,       R_ge_coeff[0],       R_ge_coeff[1],       R_ge_coeff[2]);
+	buildADCCalibration (&stCal_T_ge,       T_ge_coeff[0],       T_ge_coeff[1],       T_ge_coeff[2]);
+	buildADCCalibration (&stCal_R_ge_highE, R_ge_highE_coeff[0], R_ge_highE_coeff[1], R_ge_highE_coeff[2]);
+	buildADCCalibration (&stCal_T_ge_highE, T_ge_highE_coeff[0], T_ge_highE_coeff[1], T_ge_highE_coeff[2]);
+}
+
+void buildADCCalibration (adcCal_t *pstCal, Double_t c0, Double_t c1, Double_t c2) {
+	Int_t x;
+	pstCal->pdCoeff[0] = c0;
+	pstCal->pdCoeff[1] = c1;
+	pstCal->pdCoeff[2] = c2;
+	for (x = 0; x < nADCChannels; x++) {
+		pstCal->pdValue[x] = c0 + x*c1 + x*x*c2;
+		pstCal->pdSlope[x] = c1 + 2.0*x*c2;
+	}
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// adcCalibrateAny -- for values read back from trees, which may be placeholders
+// Uses the table when a is an ADC channel, otherwise evaluates the polynomial.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Double_t adcCalibrateAny (const adcCal_t *pstCal, Double_t a, Double_t u) {
+	Int_t x = (Int_t)a;
+	if (0 <= x && x < nADCChannels && x == a) return adcCalibrate (pstCal, x, u);
+	a += u;
+	return pstCal->pdCoeff[0] + a*pstCal->pdCoeff[1] + a*a*pstCal->pdCoeff[2];
+}
@@ -0,0 +1,44 @@
+// Always enclose header file contents with these ifndef/endif directives.
+#ifndef _bdn_calibration_h
+#define _bdn_calibration_h
+#include "Rtypes.h"
+#include "bdn.h"
+
+#ifndef _bdn_calibration_cxx
+#define CALIBRATION_EXTERNAL extern
+#else
+#define CALIBRATION_EXTERNAL
+#endif
+
+// ADC calibration lookup tables
+//////////////////////////////////////////////////////////////////////////////////////////
+// Every ADC value is a 12-bit integer x, so a calibration f(y) = c0 + c1*y + c2*y*y is
+// tabulated once per channel. The random dithering y = x + u (0 <= u < 1) is kept separate:
+//   f(x+u) = f(x) + u*( f'(x) + c2*u )
+// which is exact for a quadratic, so adcCalibrate() gives the same value as evaluating the
+// polynomial on the dithered channel. Pass u = 0 for no dithering.
+static const Int_t nADCChannels = 4096; // 12-bit ADCs
+
+struct adcCal_t {
+	Double_t	pdCoeff[3];					// {c0, c1, c2}, kept for values that are not ADC channels
+	Double_t	pdValue[nADCChannels];		// f(x)
+	Double_t	pdSlope[nADCChannels];		// f'(x) = c1 + 2*c2*x
+};
+
+// MCP posts: pedestal subtraction, f(y) = y - ped
+CALIBRATION_EXTERNAL adcCal_t stCal_R_mcpA, stCal_R_mcpB, stCal_R_mcpC, stCal_R_mcpD, stCal_R_mcpE;
+CALIBRATION_EXTERNAL adcCal_t stCal_T_mcpA, stCal_T_mcpB, stCal_T_mcpC, stCal_T_mcpD, stCal_T_mcpE;
+// HPGe: energy calibration in keV
+CALIBRATION_EXTERNAL adcCal_t stCal_R_ge, stCal_T_ge, stCal_R_ge_highE, stCal_T_ge_highE;
+
+// Functions
+void		book_calibrations	();
+void		buildADCCalibration	(adcCal_t*, Double_t, Double_t, Double_t);
+Double_t	adcCalibrateAny		(const adcCal_t*, Double_t, Double_t);
+
+// Calibrated value of ADC channel x (0 <= x < 4096) with dithering u
+inline Double_t adcCalibrate (const adcCal_t *pstCal, Int_t x, Double_t u) {
+	return pstCal->pdValue[x] + u * ( pstCal->pdSlope[x] + u * pstCal->pdCoeff[2] );
+}
+
+#endif
@@ -0,0 +1,163 @@
+#define _bdn_kinematics_cxx "bdnKinematics.cxx"
+#include "bdnKinematics.h"
+#include "bdnHistograms.h"
+#include "TMath.h"
+#include <iostream>
+#include <cstring>
+using namespace std;
+
+Double_t tofToMCPGrid (BDNCase_t, char, Double_t);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// book_kinematics -- build the Top and Right MCP tables for this case (call once, before the event loop)
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void book_kinematics (BDNCase_t stBDNCase) {
+	buildKinematicsTable (&stKinTableT, stBDNCase, 'T');
+	buildKinematicsTable (&stKinTableR, stBDNCase, 'R');
+}
+
+void free_kinematics () {
+	freeKinematicsTable (&stKinTableT);
+	freeKinematicsTable (&stKinTableR);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// buildKinematicsTable -- evaluate the grid correction once per half-ns TOF node, then check the
+// interpolation against it at every bin center
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void buildKinematicsTable (kinTable_t *pstTable, BDNCase_t stBDNCase, char whichMCP) {
+	using namespace TMath;
+	Int_t k;
+	Double_t tof, t1, vz, err;
+	pstTable->stBDNCase		= stBDNCase;
+	pstTable->cWhichMCP		= whichMCP;
+	pstTable->nNodes		= TOFBins + 1;
+	pstTable->dTOFMin		= TOFMin;
+	pstTable->dTOFStep		= (TOFMax - TOFMin) / TOFBins;
+	pstTable->dMassFactor	= stBDNCase.dNeutronEnergyMassFactorKeV;
+	if (whichMCP == 'R') pstTable->dZ1 = stBDNCase.dRightGridDistance;
+	if (whichMCP == 'T') pstTable->dZ1 = stBDNCase.dTopGridDistance;
+	pstTable->pdT1			= new Double_t [pstTable->nNodes];
+	pstTable->pdV			= new Double_t [pstTable->nNodes];
+	pstTable->pdVInv		= new Double_t [pstTable->nNodes];
+	pstTable->pdEn			= new Double_t [pstTable->nNodes];
+	for (k = 0; k < pstTable->nNodes; k++) {
+		tof	= pstTable->dTOFMin + k * pstTable->dTOFStep;
+		t1	= 0.001 * tofToMCPGrid (stBDNCase, whichMCP, tof); // need times in us
+		pstTable->pdT1[k]	= t1;
+		pstTable->pdV[k]	= Abs(pstTable->dZ1 / t1);
+		pstTable->pdVInv[k]	= 1.0 / (pstTable->pdV[k] + 0.000000001);
+		pstTable->pdEn[k]	= 0.5 * pstTable->dMassFactor * pstTable->pdV[k] * pstTable->pdV[k];
+	}
+	pstTable->dMaxRelErr	= 0.0;
+	for (k = 0; k < pstTable->nNodes - 1; k++) {
+		tof	= pstTable->dTOFMin + (k + 0.5) * pstTable->dTOFStep;
+		vz	= pstTable->dZ1 / (0.001 * tofToMCPGrid (stBDNCase, whichMCP, tof));
+		err	= Abs(kinematicsVz (pstTable, tof) / vz - 1.0);
+		if (err > pstTable->dMaxRelErr) pstTable->dMaxRelErr = err; // NaN (unphysical tof) never counts
+	}
+	printf("Kinematics table built for %c MCP: %d nodes, %.1f ns to %.1f ns, max rel. error of vz %.1e.\n",
+		whichMCP, pstTable->nNodes, TOFMin, TOFMax, pstTable->dMaxRelErr);
+}
+
+void freeKinematicsTable (kinTable_t *pstTable) {
+	delete [] pstTable->pdT1;
+	delete [] pstTable->pdV;
+	delete [] pstTable->pdVInv;
+	delete [] pstTable->pdEn;
+	pstTable->nNodes = 0;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// kinematicsVz -- z1/t1 at any tof (ns), with t1 interpolated from the table
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Double_t kinematicsVz (const kinTable_t *pstTable, Double_t tof) {
+	Double_t u = (tof - pstTable->dTOFMin) / pstTable->dTOFStep;
+	Int_t k = (Int_t)u;
+	// off the table, or in a bin starting at tof <= 0 (t1 -> 0 there): do it the slow way
+	if (u < 0.0 || k >= pstTable->nNodes - 1 || pstTable->dTOFMin + k * pstTable->dTOFStep <= 0.0)
+		return pstTable->dZ1 / (0.001 * tofToMCPGrid (pstTable->stBDNCase, pstTable->cWhichMCP, tof));
+	u -= k;
+	return pstTable->dZ1 / ((1.0 - u) * pstTable->pdT1[k] + u * pstTable->pdT1[k+1]);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// kinematicsSpeed -- ion speed (mm/us) for one event
+//	tof = TOF used for the grid correction (ns)
+//	t2  = flight time to the MCP (us), eg. with the half-ns dithering of the sort code
+//	s2  = distance of the hit from the MCP center (mm)
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Double_t kinematicsSpeed (const kinTable_t *pstTable, Double_t tof, Double_t t2, Double_t s2) {
+	Double_t vz = kinematicsVz (pstTable, tof);
+	Double_t vs = s2/t2;
+	return TMath::Sqrt(vs*vs + vz*vz);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// tofToEnSpectrum -- transform a whole TOF spectrum into an En spectrum
+//	Each TOF bin is spread uniformly over the En interval between the energies of its two edges,
+//	so counts are conserved (this is the Jacobian of the transformation). s is the distance from
+//	the MCP center (mm) assumed for all counts; s = 0 uses the on-axis table directly.
+//	The returned histogram has the binning of h_En (EnBins, EnMin, EnMax in bdnHistograms.h).
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+TH1D* tofToEnSpectrum (const kinTable_t *pstTable, const TH1 *hTOF, const char *name, Double_t s) {
+	using namespace TMath;
+	Int_t		nBins	= hTOF->GetNbinsX();
+	Double_t	EnWidth	= (EnMax - EnMin) / EnBins;
+	Double_t	*pdEdge	= new Double_t [nBins+1]; // En at each TOF bin edge
+	Double_t	*pdSum	= new Double_t [EnBins+2]; // contents, incl. under/overflow
+	Double_t	*pdVar	= new Double_t [EnBins+2]; // squared errors, incl. under/overflow
+	Double_t	tof, t2, vs, vz, lo, hi, w, var, frac;
+	Int_t		k, bin, binLo, binHi;
+	bool		bSameBins = ( s == 0.0 && nBins == TOFBins
+						   && hTOF->GetXaxis()->GetXmin() == pstTable->dTOFMin
+						   && hTOF->GetXaxis()->GetXmax() == pstTable->dTOFMin + TOFBins * pstTable->dTOFStep );
+	for (bin = 0; bin < EnBins+2; bin++) pdSum[bin] = pdVar[bin] = 0.0;
+
+// Energies at the bin edges
+	if (bSameBins) memcpy(pdEdge, pstTable->pdEn, (nBins+1)*sizeof(Double_t));
+	else {
+		for (k = 0; k <= nBins; k++) {
+			tof	= hTOF->GetXaxis()->GetBinLowEdge(k+1); // bin nBins+1 low edge = upper edge of last bin
+			t2	= 0.001 * tof; // need times in us
+			vz	= kinematicsVz (pstTable, tof);
+			vs	= (s == 0.0) ? 0.0 : s/t2;
+			pdEdge[k] = 0.5 * pstTable->dMassFactor * (vs*vs + vz*vz);
+		}
+	}
+
+// Spread each TOF bin over the En bins it covers
+	for (k = 0; k < nBins; k++) {
+		w	= hTOF->GetBinContent(k+1);
+		if (w == 0.0) continue;
+		var	= Power(hTOF->GetBinError(k+1), 2.0);
+		lo	= Min(pdEdge[k], pdEdge[k+1]);
+		hi	= Max(pdEdge[k], pdEdge[k+1]);
+		if (IsNaN(lo) || IsNaN(hi)) continue; // unphysical tof, eg. below the grid-correction domain
+		binLo = (lo < EnMin) ? 0 : ( (lo >= EnMax) ? EnBins+1 : (Int_t)((lo - EnMin)/EnWidth) + 1 );
+		binHi = (hi < EnMin) ? 0 : ( (hi >= EnMax) ? EnBins+1 : (Int_t)((hi - EnMin)/EnWidth) + 1 );
+		if (binLo == binHi || hi == lo) {
+			pdSum[binLo] += w;
+			pdVar[binLo] += var;
+			continue;
+		}
+		for (bin = binLo; bin <= binHi; bin++) {
+			if (bin == 0)				frac = (Min(hi, EnMin) - lo) / (hi - lo);
+			else if (bin == EnBins+1)	frac = (hi - Max(lo, EnMax)) / (hi - lo);
+			else frac = ( Min(hi, EnMin + bin*EnWidth) - Max(lo, EnMin + (bin-1)*EnWidth) ) / (hi - lo);
+			pdSum[bin] += frac * w;
+			pdVar[bin] += frac * frac * var;
+		}
+	}
+
+	TH1D *hEn = new TH1D(name, "Neutron energy (keV) from TOF spectrum", EnBins, EnMin, EnMax);
+	for (bin = 0; bin < EnBins+2; bin++) {
+		hEn->SetBinContent(bin, pdSum[bin]);
+		hEn->SetBinError(bin, Sqrt(pdVar[bin]));
+	}
+	hEn->SetEntries(hTOF->GetEntries());
+	delete [] pdEdge;
+	delete [] pdSum;
+	delete [] pdVar;
+	return hEn;
+}
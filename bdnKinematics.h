@@ -0,0 +1,52 @@
+// Always enclose header file contents with these ifndef/endif directives.
+#ifndef _bdn_kinematics_h
+#define _bdn_kinematics_h
+#include "Rtypes.h"
+#include "TH1.h"
+#include "CSVtoStruct.h"
+
+#ifndef _bdn_kinematics_cxx
+#define KINEMATICS_EXTERNAL extern
+#else
+#define KINEMATICS_EXTERNAL
+#endif
+
+// Lookup tables for recoil kinematics of one MCP in one BDN case
+//////////////////////////////////////////////////////////////////////////////////////////
+// Nodes sit on the half-ns bin edges of h_tof (TOFMin, TOFMax, TOFBins in bdnHistograms.h),
+// so node k is at tof = TOFMin + k*dTOFStep. The grid correction (tofToMCPGrid) is folded
+// into pdT1, the time to the grid, which is nearly linear in tof: kinematicsVz() interpolates
+// it linearly and divides, z1/t1, so no transcendental math is left for the event loop.
+// (Interpolating z1/t1 itself would be off by a few % near tof = 1 ns.) buildKinematicsTable()
+// checks the interpolation against tofToMCPGrid() at every bin center (dMaxRelErr, ~5e-9 for
+// the BPT geometry). The bin at tof <= 0, where tofToMCPGrid() changes branch, and tof off the
+// table are computed exactly. The on-axis arrays (pdV, pdVInv, pdEn) are for ions hitting the
+// MCP center; use kinematicsSpeed() for an event with a known position on the MCP.
+struct kinTable_t {
+	BDNCase_t	stBDNCase;		// case the table was built for; used for tof outside the table
+	char		cWhichMCP;		// 'T' or 'R'
+	Int_t		nNodes;			// TOFBins+1
+	Double_t	dTOFMin;		// ns
+	Double_t	dTOFStep;		// ns
+	Double_t	dZ1;			// trap center to MCP grid (mm)
+	Double_t	dMassFactor;	// stBDNCase.dNeutronEnergyMassFactorKeV
+	Double_t	dMaxRelErr;		// largest relative error of kinematicsVz() at the bin centers
+	Double_t	*pdT1;			// t1, time from the trap center to the MCP grid (us)
+	Double_t	*pdV;			// on-axis speed (mm/us)
+	Double_t	*pdVInv;		// on-axis inverse speed (us/mm)
+	Double_t	*pdEn;			// on-axis neutron energy (keV)
+};
+
+KINEMATICS_EXTERNAL kinTable_t stKinTableT;	// Top MCP
+KINEMATICS_EXTERNAL kinTable_t stKinTableR;	// Right MCP
+
+// Functions
+void		book_kinematics		(BDNCase_t);
+void		free_kinematics		();
+void		buildKinematicsTable(kinTable_t*, BDNCase_t, char);
+void		freeKinematicsTable	(kinTable_t*);
+Double_t	kinematicsVz		(const kinTable_t*, Double_t);
+Double_t	kinematicsSpeed		(const kinTable_t*, Double_t, Double_t, Double_t);
+TH1D*		tofToEnSpectrum		(const kinTable_t*, const TH1*, const char*, Double_t);
+
+#endif
@@ -155,6 +155,32 @@
 //	- Changed beta-recoil cuts so that the mcp ADC cut uses a_R_mcpSum_corr or a_R_mcpSum_corr (so they include 3-post events)
 //	- Added h_tof_2dE_T_mcp (and 2 other histos) to catch events in which both dE's and an MCP were hit (TOF automatically taken from first dE by virtue of TDC trigger)
 //	--> search for 'two-dE + MCP coincidences: req L & B & an mcp' to find the code
+// 2015-05-04
+//	- Ion speed and En in the beta-recoil section now use the lookup tables in bdnKinematics.h/cxx.
+//	  t1 (incl. the grid correction) is tabulated once per half-ns TOF bin in book_kinematics() and
+//	  interpolated (relative error of z1/t1 ~5e-9), so tofToMCPGrid() is no longer called for every event.
+//	- tofToEnSpectrum() converts a whole TOF spectrum (eg. summed h_tof_LT) into an En spectrum.
+// 2015-05-06
+//	- MCP pedestal subtraction and HPGe energy calibration now use the 4096-entry tables in bdnCalibration.h/cxx,
+//	  built once by book_calibrations() from the constants in bdn.h. Dithering is still one randgen->Rndm() per hit.
+// 2015-05-08
+//	- Added cycle_Tree (bdnTrees.h): one entry per trap cycle with its range of bdn_Tree entries, # of captures,
+//	  live time, trap-state transitions and beta-recoil counts per TOF region. Cycles are found the same way as
+//	  for h_cycles_vs_cycle_time (n_ejects_found). The first and last cycles of a run have complete = 0.
+// 2015-05-11
+//	- Several runs in one process: ./bdnSort <run file> <mcp_corr> <BDN case code> [<more run files> ...]
+//	  The CSV cases, histograms, kinematics and calibration tables are set up once in main(); sortRun() sorts one
+//	  run into its own file. With one run file the output is bdn.root as before. With several, each run goes to
+//	  <run>.root, histograms are Reset between runs, and bdn_sum.root gets the summed histograms and a
+//	  metadata_Tree with one entry per run.
+// 2015-05-12
+//	- Output compression is set per tree (outputSettings_t in bdnTrees.h): --zEvents=<n> for bdn_Tree and the other
+//	  event trees, --zMeta=<n> for metadata_Tree and cycle_Tree, --zFile=<n> for the histograms.
+//	  --threads=1 fills the trees on a writer thread (fill_tree() in bdnTrees.cxx, ROOT >= 6.06), so basket
+//	  compression and file writes overlap with the decoding. (ROOT implicit MT would not help here: it compresses
+//	  different branches in parallel, and each tree has a single "bdn" branch.) cycle.first_entry and last_entry
+//	  now come from a count of bdn_Tree fills rather than bdn_Tree->GetEntries(). The settings and the sort time
+//	  are recorded in metadata_Tree. See bench_bdnSort.
 //////////////////////////////////////////////////////////////////////////////////////////////
 //
 //	~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -207,12 +233,17 @@
 #include "libgen.h"
 #include "ScarletEvntSrc.h"
 #include "ScarletEvnt.h"
+#include "TROOT.h"
+#include "RVersion.h"
 #include "TFile.h"
+#include "TList.h"
+#include "TString.h"
 #include "TH1.h"
 #include "TH2.h"
 #include "TTree.h"
 #include "TEventList.h"
 #include "TRandom3.h"
+#include "TStopwatch.h"
 #include "TMath.h"
 #include "bdn.h"
 //#include "bdn_trees_20140613.h"
@@ -221,11 +252,16 @@
 #include "bdnTrees.h"
 #include "bdnHistograms.h"
 #include "CSVtoStruct.h"
+#include "bdnKinematics.h"
+#include "bdnCalibration.h"
 
 // Declare functions:
 int countbit(int x);
 int time_in_seconds(int, int, int, int);
-Double_t tofToMCPGrid (BDNCase_t, char, Double_t);
+void new_cycle(int, int);
+int sortRun(char*, const char*, BDNCase_t, const char*, outputSettings_t);
+void writeHistograms(TFile*);
+void addHistograms(TList*);
 
 using namespace std;
 using namespace TMath;
@@ -235,28 +271,25 @@ int main(int argc, char *argv[]) {
 	
 	//printf("LT Zerotime = %f",LT_zeroTime[0]);
 	
-	// Get run # from command line and set ROOT filename
-	char *argdup;
-	argdup = strdup(argv[1]);
-	char *filename;
-	filename = basename(argdup);
-	free(argdup);
-	int n_run = atoi(&filename[3]);
-	cout << endl << "Sorting " << filename;
-	char *rootFileName;
-	rootFileName ="bdn.root";
-	
-//	// To allow building ./sorted/runxxxxx.root directly instead of building bdn.root and renaming in the shell
-//	// As is, TFile complains when you give it the rootFileName this produces
-//	// So it doesn't work yet
-//	std::stringstream ss;
-//	ss << "./sorted/" << string(filename) << ".root";
-//	std::string rFN = ss.str();
-//	
-//	//rootFileName = new char [rFN.size()+1];
-//	char *rootFileName[rFN.size()+1];
-//	strcpy (rootFileName, rFN.c_str());
-//	printf(rootFileName);	
+// Options (anywhere on the command line) are taken out of argv; the rest are positional
+	vector<char*> vArgs;
+	outputSettings_t stOutput = stDefaultOutputSettings;
+	for (int k = 0; k < argc; k++) {
+		if      (sscanf(argv[k], "--zEvents=%d", &stOutput.iCompressEvents) == 1) continue;
+		else if (sscanf(argv[k], "--zMeta=%d",   &stOutput.iCompressMeta)   == 1) continue;
+		else if (sscanf(argv[k], "--zFile=%d",   &stOutput.iCompressFile)   == 1) continue;
+		else if (sscanf(argv[k], "--threads=%d", &stOutput.nThreads)        == 1) continue;
+		vArgs.push_back(argv[k]);
+	}
+	if (vArgs.size() <= 3) {
+		cout << "How to run this program:" << endl;
+		cout << "'./bdnSort <run file> <mcp_corr> <BDN case code> [<more run files> ...] [options]'" << endl;
+		cout << "options: --zEvents=<n> --zMeta=<n> --zFile=<n>  compression, 100*algorithm + level (see bdnTrees.h)" << endl;
+		cout << "         --threads=<n>                          n > 0: fill the trees on a writer thread" << endl << endl;
+		return 0;
+	}
+	if (stOutput.nThreads > 1) stOutput.nThreads = 1; // there is one writer thread (see bdnTrees.h)
+	printf("\nCompression: events %d, metadata %d, histograms %d; threads %d\n", stOutput.iCompressEvents, stOutput.iCompressMeta, stOutput.iCompressFile, stOutput.nThreads);
 	
 // Metadata structure
 	BDNCase_t	stBDNCases[FILE_ROWS_BDN];
@@ -267,7 +300,7 @@ int main(int argc, char *argv[]) {
 	cout << endl << "Importing metadata from CSV files..." << endl;
 	iNumStructs_BDN  = CSVtoStruct_BDN  (csvBDNCases, stBDNCases);
 	cout << "Imported " << iNumStructs_BDN << " BDN cases" << endl;
-	iBDNCaseIndex		 = FindStructIndex ( stBDNCases,  sizeof(BDNCase_t),  iNumStructs_BDN,  argv[3] );
+	iBDNCaseIndex		 = FindStructIndex ( stBDNCases,  sizeof(BDNCase_t),  iNumStructs_BDN,  vArgs[3] );
 	BDNCase_t  stBDNCase = stBDNCases[iBDNCaseIndex];
 	// Optional error catching
 	if ( iBDNCaseIndex == -1 )
@@ -278,6 +311,90 @@ int main(int argc, char *argv[]) {
 		return -1; // error return
 	}
 	
+// Booked once for all runs. No file is open yet, so the histograms stay in memory;
+// each run writes them to its own file (writeHistograms), and they are Reset between runs (addHistograms).
+	book_histograms();
+	book_kinematics(stBDNCase);
+	book_calibrations();
+	
+// Run files: vArgs[1] and any after the case code
+	vector<char*> vRunFiles;
+	vRunFiles.push_back(vArgs[1]);
+	for (unsigned k = 4; k < vArgs.size(); k++) vRunFiles.push_back(vArgs[k]);
+	bool bMultiRun = (vRunFiles.size() > 1);
+	
+	TList		*lSumHistograms	= new TList(); // summed histograms over all runs
+	TTree		*sumMetadata_Tree = 0;
+	TString		sRootFileName;
+	char		*argdup;
+	unsigned	iRun;
+	Int_t		nSorted = 0;
+	if (bMultiRun) {
+		sumMetadata_Tree = book_metadata_tree(); // one entry per run
+		sumMetadata_Tree->SetDirectory(0);
+		printf("\nSorting %d runs; per-run output in <run>.root, summed output in bdn_sum.root\n", (int)vRunFiles.size());
+	}
+	
+	for (iRun = 0; iRun < vRunFiles.size(); iRun++) {
+		if (bMultiRun) {
+			argdup = strdup(vRunFiles[iRun]);
+			sRootFileName.Form("%s.root", basename(argdup));
+			free(argdup);
+		}
+		else sRootFileName = "bdn.root";
+		if (sortRun(vRunFiles[iRun], vArgs[2], stBDNCase, sRootFileName.Data(), stOutput) != 0) continue;
+		nSorted++;
+		if (bMultiRun) {
+			sumMetadata_Tree->Fill();
+			addHistograms(lSumHistograms);
+		}
+	}
+	
+	if (bMultiRun) {
+		TFile *fSum = new TFile("bdn_sum.root", "recreate", "", stOutput.iCompressMeta);
+		lSumHistograms->Write();
+		sumMetadata_Tree->SetDirectory(fSum);
+		sumMetadata_Tree->Write();
+		fSum->Close();
+		printf("\nWrote bdn_sum.root: %d of %d runs summed.\n", nSorted, (int)vRunFiles.size());
+	}
+	free_kinematics();
+	return 0;
+	
+} // main
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sortRun -- sort one Scarlet run file into rootFileName (trees and histograms)
+// Returns 0 on success. The histograms booked in main() are written to rootFileName but not
+// Reset; for several runs, main() adds them to the sum and Resets them (addHistograms).
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+int sortRun(char *runFile, const char *mcpCorr, BDNCase_t stBDNCase, const char *rootFileName, outputSettings_t stOutput) {
+	
+	TStopwatch swSort; // sort time, recorded in metadata_Tree
+	swSort.Start();
+	
+	// Get run # from the file name
+	char *argdup;
+	argdup = strdup(runFile);
+	char *filename;
+	filename = basename(argdup);
+	free(argdup);
+	int n_run = atoi(&filename[3]);
+	cout << endl << "Sorting " << filename;
+	memset(&metadata, 0, sizeof(metadata)); // counts accumulate over the run
+	
+//	// To allow building ./sorted/runxxxxx.root directly instead of building bdn.root and renaming in the shell
+//	// As is, TFile complains when you give it the rootFileName this produces
+//	// So it doesn't work yet
+//	std::stringstream ss;
+//	ss << "./sorted/" << string(filename) << ".root";
+//	std::string rFN = ss.str();
+//	
+//	//rootFileName = new char [rFN.size()+1];
+//	char *rootFileName[rFN.size()+1];
+//	strcpy (rootFileName, rFN.c_str());
+//	printf(rootFileName);	
+	
 // TOF bounds for this case	
 	Double_t	tof_R_fast_lo		= 1000.0 * stBDNCase.dRightMCPMinFastIonTOF;
 	Double_t	tof_R_fast_hi		= 1000.0 * stBDNCase.dRightMCPMaxFastIonTOF;
@@ -475,6 +592,7 @@ int main(int argc, char *argv[]) {
 	int lastClock = 0;
 	int event = 0;
 	int first_cycle_flag = 0;	// Indicates that first (partial) trapping cycle is complete
+	int cycle_last_state = -1;	// s_capt_state of the previous event in the current cycle (for cycle_Tree)
 								// Set to 1 upon first ejection pulse
 //	double mcp_x, mcp_y, mcp_r, tof, vInv, En;
 	double n_fast_LT = 0.0;
@@ -509,20 +627,26 @@ int main(int argc, char *argv[]) {
 	int wordc;	  //word counts in a sequential readout
 	
 	// ROOT and Scarlet variables:
-	TFile *f = new TFile(rootFileName, "recreate");
+	TFile *f = new TFile(rootFileName, "recreate", "", stOutput.iCompressFile);
 	book_trees();
-	book_histograms();
+	set_tree_compression(stOutput);
+	new_cycle(0, n_run);
 //	extern bdn_struct bdn;
 //	extern metadata_struct metadata;
 	
 // Procedure:
 	cout << endl;
-	if (argc <= 1) return 0;
-	try {esrc = new ScarletFileSrc(argv[1]);}
+	try {esrc = new ScarletFileSrc(runFile);}
 	catch (std::exception &x){
-		std::cerr << "exception opening " << argv[1] << std::endl;
-		return 0;
+		std::cerr << "exception opening " << runFile << std::endl;
+		f->Close();
+		return -1;
 	}
+	if (stOutput.nThreads > 0 && start_tree_writer() == 0) {
+		printf("\nROOT %s has no writer thread; filling the trees on the sort thread.\n", ROOT_RELEASE);
+		stOutput.nThreads = 0;
+	}
+	Int_t n_bdnEntries = 0; // bdn_Tree entries so far (the writer thread may not have filled them yet)
 	
 //	if (!strcmp(argv[2],"alpha")) {
 //		printf("Correcting MCP pulse heights for missing data, assuming alphas.\n");
@@ -530,7 +654,7 @@ int main(int argc, char *argv[]) {
 //	if (!strcmp(argv[2],"ion")) {
 //		printf("Correcting MCP pulse heights for missing data, assuming ions.\n");
 //	}
-	if (!strcmp(argv[2],"posts")) {
+	if (!strcmp(mcpCorr,"posts")) {
 		printf("Reconstructing missing MCP post values when only one is missing.\n");
 	}
 	
@@ -663,7 +787,7 @@ int main(int argc, char *argv[]) {
 					if (adc_ch == 1) {
 						a_T_mcpE = x;
 						ha_T_mcpE->Fill(x);
-						a_T_mcpE_corr = x - ped_T_mcpE + randgen->Rndm();
+						a_T_mcpE_corr = adcCalibrate (&stCal_T_mcpE, x, randgen->Rndm());
 						ha_T_mcpE_corr->Fill(a_T_mcpE_corr);
 						na_T_mcpE++;
 					}
@@ -685,28 +809,28 @@ int main(int argc, char *argv[]) {
 					if (adc_ch == 5) {
 						a_T_mcpA = x;
 						ha_T_mcpA->Fill(x);
-						a_T_mcpA_corr = x - ped_T_mcpA + randgen->Rndm();
+						a_T_mcpA_corr = adcCalibrate (&stCal_T_mcpA, x, randgen->Rndm());
 						//ha_T_mcpA_corr->Fill(a_T_mcpA_corr); // moved to after 3-post reconstruction
 						na_T_mcpA++;
 					}
 					if (adc_ch == 6) {
 						a_T_mcpB = x;
 						ha_T_mcpB->Fill(x);
-						a_T_mcpB_corr = x - ped_T_mcpB + randgen->Rndm();
+						a_T_mcpB_corr = adcCalibrate (&stCal_T_mcpB, x, randgen->Rndm());
 						//ha_T_mcpB_corr->Fill(a_T_mcpB_corr); // moved to after 3-post reconstruction
 						na_T_mcpB++;
 					}
 					if (adc_ch == 7) {
 						a_T_mcpC = x;
 						ha_T_mcpC->Fill(x);
-						a_T_mcpC_corr = x - ped_T_mcpC + randgen->Rndm();
+						a_T_mcpC_corr = adcCalibrate (&stCal_T_mcpC, x, randgen->Rndm());
 						//ha_T_mcpC_corr->Fill(a_T_mcpC_corr); // moved to after 3-post reconstruction
 						na_T_mcpC++;
 					}
 					if (adc_ch == 8) {
 						a_T_mcpD = x;
 						ha_T_mcpD->Fill(x);
-						a_T_mcpD_corr = x - ped_T_mcpD + randgen->Rndm();
+						a_T_mcpD_corr = adcCalibrate (&stCal_T_mcpD, x, randgen->Rndm());
 						//ha_T_mcpD_corr->Fill(a_T_mcpD_corr); // moved to after 3-post reconstruction
 						na_T_mcpD++;
 					}
@@ -718,7 +842,7 @@ int main(int argc, char *argv[]) {
 					if (adc_ch == 9) {
 						a_R_mcpE = x;
 						ha_R_mcpE->Fill(x);
-						a_R_mcpE_corr = x - ped_R_mcpE + randgen->Rndm();
+						a_R_mcpE_corr = adcCalibrate (&stCal_R_mcpE, x, randgen->Rndm());
 						ha_R_mcpE_corr->Fill(a_R_mcpE_corr);
 						na_R_mcpE++;
 					}
@@ -740,28 +864,28 @@ int main(int argc, char *argv[]) {
 					if (adc_ch == 13) {
 						a_R_mcpA = x;
 						ha_R_mcpA->Fill(x);
-						a_R_mcpA_corr = x - ped_R_mcpA + randgen->Rndm();
+						a_R_mcpA_corr = adcCalibrate (&stCal_R_mcpA, x, randgen->Rndm());
 						//ha_R_mcpA_corr->Fill(a_R_mcpA_corr); // moved to after 3-post reconstruction
 						na_R_mcpA++;
 					}
 					if (adc_ch == 14) {
 						a_R_mcpB = x;
 						ha_R_mcpB->Fill(x);
-						a_R_mcpB_corr = x - ped_R_mcpB + randgen->Rndm();
+						a_R_mcpB_corr = adcCalibrate (&stCal_R_mcpB, x, randgen->Rndm());
 						//ha_R_mcpB_corr->Fill(a_R_mcpB_corr); // moved to after 3-post reconstruction
 						na_R_mcpB++;
 					}
 					if (adc_ch == 15) {
 						a_R_mcpC = x;
 						ha_R_mcpC->Fill(x);
-						a_R_mcpC_corr = x - ped_R_mcpC + randgen->Rndm();
+						a_R_mcpC_corr = adcCalibrate (&stCal_R_mcpC, x, randgen->Rndm());
 						//ha_R_mcpC_corr->Fill(a_R_mcpC_corr); // moved to after 3-post reconstruction
 						na_R_mcpC++;
 					}
 					if (adc_ch == 16) {
 						a_R_mcpD = x;
 						ha_R_mcpD->Fill(x);
-						a_R_mcpD_corr = x - ped_R_mcpD + randgen->Rndm();
+						a_R_mcpD_corr = adcCalibrate (&stCal_R_mcpD, x, randgen->Rndm());
 						//ha_R_mcpD_corr->Fill(a_R_mcpD_corr); // moved to after 3-post reconstruction
 						na_R_mcpD++;
 					}
@@ -791,18 +915,16 @@ int main(int argc, char *argv[]) {
 					adc_ch=(adc_ch>>12)+1;
 					
 					if (adc_ch == 1) {
-						y = x + randgen->Rndm();
 						a_T_ge_highE = x;
-						e_T_ge_highE = T_ge_highE_coeff[0] + y*T_ge_highE_coeff[1] + y*y*T_ge_highE_coeff[2];
+						e_T_ge_highE = adcCalibrate (&stCal_T_ge_highE, x, randgen->Rndm());
 						ha_T_ge_highE->Fill(a_T_ge_highE);
 						//he_T_ge_highE->Fill(e_T_ge_highE);
 						//he_ge_highE	 ->Fill(e_T_ge_highE);
 						na_T_ge_highE++;
 					}
 					if (adc_ch == 2) {
-						y = x + randgen->Rndm();
 						a_R_ge_highE = x;
-						e_R_ge_highE = R_ge_highE_coeff[0] + y*R_ge_highE_coeff[1] + y*y*R_ge_highE_coeff[2];
+						e_R_ge_highE = adcCalibrate (&stCal_R_ge_highE, x, randgen->Rndm());
 						ha_R_ge_highE->Fill(x);
 						//he_R_ge_highE->Fill(e_R_ge_highE);
 						//he_ge_highE	 ->Fill(e_R_ge_highE);
@@ -820,9 +942,8 @@ int main(int argc, char *argv[]) {
 					//}
 					if (n_run < 1682) {
 						if (adc_ch == 9) {
-							y = x + randgen->Rndm();
 							a_T_ge = x;
-							e_T_ge = T_ge_coeff[0] + y*T_ge_coeff[1] + y*y*T_ge_coeff[2];
+							e_T_ge = adcCalibrate (&stCal_T_ge, x, randgen->Rndm());
 							ha_T_ge	->Fill(x);
 							he_T_ge	->Fill(e_T_ge);
 							he_ge	->Fill(e_T_ge);
@@ -831,9 +952,8 @@ int main(int argc, char *argv[]) {
 					}
 					else {
 						if (adc_ch == 7) {
-							y = x + randgen->Rndm();
 							a_T_ge = x;
-							e_T_ge = T_ge_coeff[0] + y*T_ge_coeff[1] + y*y*T_ge_coeff[2];
+							e_T_ge = adcCalibrate (&stCal_T_ge, x, randgen->Rndm());
 							ha_T_ge	->Fill(x);
 							he_T_ge	->Fill(e_T_ge);
 							he_ge	->Fill(e_T_ge);
@@ -841,9 +961,8 @@ int main(int argc, char *argv[]) {
 						}
 					}
 					if (adc_ch == 8) {
-						y = x + randgen->Rndm();
 						a_R_ge = x;
-						e_R_ge = R_ge_coeff[0] + y*R_ge_coeff[1] + y*y*R_ge_coeff[2];
+						e_R_ge = adcCalibrate (&stCal_R_ge, x, randgen->Rndm());
 						ha_R_ge	->Fill(x);
 						he_R_ge	->Fill(e_R_ge);
 						he_ge	->Fill(e_R_ge);
@@ -1190,8 +1309,28 @@ int main(int argc, char *argv[]) {
 						h_cycles_vs_cycle_time->Fill(ms_bin);
 					}
 					last_event_cycle_time_ms = s_ms_since_eject;
+					// Close the last cycle in cycle_Tree
+					cycle.complete = (cycle.n_cycle > 0);
+					fill_tree(cycle_Tree);
+					new_cycle(n_ejects_found, n_run);
+					cycle_last_state = -1;
 				}
 				
+		// Add this event to the current cycle (cycle_Tree)
+				if (cycle.n_entries == 0) {
+					cycle.first_entry	= n_bdnEntries; // this event is filled below
+					cycle.first_ms		= s_ms_since_eject;
+				}
+				cycle.last_entry	= n_bdnEntries;
+				cycle.last_ms		= s_ms_since_eject;
+				cycle.n_entries++;
+				cycle.liveTime_us	+= s_liveTime_us;
+				cycle.runTime_us	+= s_runTime;
+				if (s_capt > cycle.n_capt) cycle.n_capt = s_capt;
+				if (cycle_last_state != -1 && s_capt_state != cycle_last_state) cycle.n_state_changes++;
+				if (s_capt_state == 1 && cycle.ms_trap_empty == -1) cycle.ms_trap_empty = s_ms_since_eject;
+				cycle_last_state	= s_capt_state;
+				
 		// MCP Maps -- Top
 				if (a_mcp_lo < a_T_mcpSum_corr) {
 					h_T_mcpX->Fill(bdn.T_mcpX);
@@ -1224,12 +1363,12 @@ int main(int argc, char *argv[]) {
 						}
 						if (s_capt_state == 0) {
 							h_T_mcpMapPhys_3post->Fill(bdn.T_mcpPhysX, bdn.T_mcpPhysY);
-							if (!strcmp(argv[2],"posts"))		h_T_mcpMapPhys				->Fill(bdn.T_mcpPhysX, bdn.T_mcpPhysY);
+							if (!strcmp(mcpCorr,"posts"))		h_T_mcpMapPhys				->Fill(bdn.T_mcpPhysX, bdn.T_mcpPhysY);
 							if (bdn.fid_area_hit_T_mcp == 1)	h_T_mcpMapPhysFidArea_3post	->Fill(bdn.T_mcpPhysX, bdn.T_mcpPhysY);
 						}
 						if (s_capt_state == 1) {
 							h_bkgd_T_mcpMapPhys_3post							->Fill(bdn.T_mcpPhysX, bdn.T_mcpPhysY);
-							if (!strcmp(argv[2],"posts")) h_bkgd_T_mcpMapPhys	->Fill(bdn.T_mcpPhysX, bdn.T_mcpPhysY);
+							if (!strcmp(mcpCorr,"posts")) h_bkgd_T_mcpMapPhys	->Fill(bdn.T_mcpPhysX, bdn.T_mcpPhysY);
 						}
 					}
 				// 4-post events
@@ -1284,12 +1423,12 @@ int main(int argc, char *argv[]) {
 						}
 						if (s_capt_state == 0) {
 							h_R_mcpMapPhys_3post->Fill(bdn.R_mcpPhysX, bdn.R_mcpPhysY);
-							if (!strcmp(argv[2],"posts"))		h_R_mcpMapPhys				->Fill(bdn.R_mcpPhysX, bdn.R_mcpPhysY);
+							if (!strcmp(mcpCorr,"posts"))		h_R_mcpMapPhys				->Fill(bdn.R_mcpPhysX, bdn.R_mcpPhysY);
 							if (bdn.fid_area_hit_R_mcp == 1)	h_R_mcpMapPhysFidArea_3post	->Fill(bdn.R_mcpPhysX, bdn.R_mcpPhysY);
 						}
 						if (s_capt_state == 1) {
 							h_bkgd_R_mcpMapPhys_3post							->Fill(bdn.R_mcpPhysX, bdn.R_mcpPhysY);
-							if (!strcmp(argv[2],"posts")) h_bkgd_R_mcpMapPhys	->Fill(bdn.R_mcpPhysX, bdn.R_mcpPhysY);
+							if (!strcmp(mcpCorr,"posts")) h_bkgd_R_mcpMapPhys	->Fill(bdn.R_mcpPhysX, bdn.R_mcpPhysY);
 						}
 					}
 				// 4-post events
@@ -1336,7 +1475,8 @@ int main(int argc, char *argv[]) {
 					}
 				}
 				
-				bdn_Tree->Fill();
+				fill_tree(bdn_Tree);
+				n_bdnEntries++;
 				
 //////////////////////////////////////////////////////////////////////////////////////////				
 // Conditional filling:
@@ -1354,14 +1494,12 @@ int main(int argc, char *argv[]) {
 					//if (event_good==1 && t_trigger_lo<bdn.t_L_dE && bdn.t_L_dE<t_trigger_hi && a_dE_lo<bdn.a_L_dEsum && t_trigger_lo<t_T_mcp && a_mcp_lo<bdn.a_T_mcpSum && bdn.fid_area_hit_T_mcp==1) { // 2015-04-18
 					if (event_good==1 && t_trigger_lo<bdn.t_L_dE && bdn.t_L_dE<t_trigger_hi && a_dE_lo<bdn.a_L_dEsum && t_trigger_lo<t_T_mcp && a_mcp_lo<a_T_mcpSum_corr && bdn.fid_area_hit_T_mcp==1) {
 // 2014-10-27						bdn.tof_LT	= t_T_mcp - bdn.t_L_dE - LT_zeroTime[0];
-						t1			= 0.001 * tofToMCPGrid (stBDNCase, 'T', bdn.tof_LT); // need times in us
-						z1			= stBDNCase.dTopGridDistance;
+						vz			= kinematicsVz (&stKinTableT, bdn.tof_LT); // z1/t1 from lookup table, incl. grid correction
 						t2			= 0.001 * (bdn.tof_LT - 0.5 + randgen->Rndm()); // need times in us
 						x2			= bdn.T_mcpPhysX;
 						y2			= bdn.T_mcpPhysY;
 						s2			= Sqrt(x2*x2 + y2*y2);
 						vs			= s2/t2;
-						vz			= z1/t1;//stBDNCase.dTopMCPDistance/t2;//z1/t1;
 						bdn.v_LT	= Sqrt(vs*vs + vz*vz);
 						bdn.En_LT	= 0.5 * stBDNCase.dNeutronEnergyMassFactorKeV * bdn.v_LT * bdn.v_LT;
 						if (s_capt_state == 0) {
@@ -1389,6 +1527,7 @@ int main(int argc, char *argv[]) {
 							h_bkgd_En_LT	->Fill(bdn.En_LT);
 						}
 						if ( tof_zero_lo < bdn.tof_LT && bdn.tof_LT < tof_zero_hi) {
+							cycle.nZeroTOF[LT]	+= 1.0;
 							h_LT_zero_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_zero_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_zero_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1401,6 +1540,7 @@ int main(int argc, char *argv[]) {
 							   h_CE_vs_cycle_time_observed->Fill(s_ms_since_eject);
 						}
 						if ( tof_lowTOF_lo < bdn.tof_LT && bdn.tof_LT < tof_lowTOF_hi) {
+							cycle.nLowTOF[LT]	+= 1.0;
 							h_LT_lowTOF_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_lowTOF_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_lowTOF_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1409,6 +1549,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nLowTOFBkgdCount[LT]	+= 1.0;
 						}
 						if ( tof_T_fast_lo < bdn.tof_LT && bdn.tof_LT < tof_T_fast_hi) {
+							cycle.nFast[LT]	+= 1.0;
 							h_LT_fast_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_fast_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							h_LT_fast_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1418,6 +1559,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nFastBkgdCount[LT]	+= 1.0;
 						}
 						if ( tof_T_slow_lo < bdn.tof_LT && bdn.tof_LT < tof_T_slow_hi) {
+							cycle.nSlow[LT]	+= 1.0;
 							h_LT_slow_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_slow_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							h_LT_slow_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1435,6 +1577,7 @@ int main(int argc, char *argv[]) {
 							}
 						}
 						if ( tof_oops_lo < bdn.tof_LT && bdn.tof_LT < tof_oops_hi) {
+							cycle.nOops[LT]	+= 1.0;
 							h_LT_oops_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_oops_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							h_LT_oops_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1454,14 +1597,12 @@ int main(int argc, char *argv[]) {
 					//if (event_good==1 && t_trigger_lo<bdn.t_L_dE && bdn.t_L_dE<t_trigger_hi && a_dE_lo<bdn.a_L_dEsum && t_trigger_lo<t_R_mcp && a_mcp_lo<bdn.a_R_mcpSum && bdn.fid_area_hit_R_mcp==1) { // 2015-04-18
 					if (event_good==1 && t_trigger_lo<bdn.t_L_dE && bdn.t_L_dE<t_trigger_hi && a_dE_lo<bdn.a_L_dEsum && t_trigger_lo<t_R_mcp && a_mcp_lo<a_R_mcpSum_corr && bdn.fid_area_hit_R_mcp==1) {
 // 2014-10-27						bdn.tof_LR	= t_R_mcp - bdn.t_L_dE - LR_zeroTime[0];
-						t1			= 0.001 * tofToMCPGrid (stBDNCase, 'R', bdn.tof_LR); // need times in us
-						z1			= stBDNCase.dRightGridDistance;
+						vz			= kinematicsVz (&stKinTableR, bdn.tof_LR); // z1/t1 from lookup table, incl. grid correction
 						t2			= 0.001 * (bdn.tof_LR - 0.5 + randgen->Rndm()); // need times in us
 						x2			= bdn.R_mcpPhysX;
 						y2			= bdn.R_mcpPhysY;
 						s2			= Sqrt(x2*x2 + y2*y2);
 						vs			= s2/t2;
-						vz			= z1/t1;//stBDNCase.dRightMCPDistance/t2;//z1/t1;
 						bdn.v_LR	= Sqrt(vs*vs + vz*vz);
 						bdn.En_LR	= 0.5 * stBDNCase.dNeutronEnergyMassFactorKeV * bdn.v_LR * bdn.v_LR;
 						if (s_capt_state == 0) {
@@ -1489,6 +1630,7 @@ int main(int argc, char *argv[]) {
 							h_bkgd_En_LR	->Fill(bdn.En_LR);
 						}
 						if ( tof_zero_lo < bdn.tof_LR && bdn.tof_LR < tof_zero_hi) {
+							cycle.nZeroTOF[LR]	+= 1.0;
 							h_LR_zero_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_zero_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_zero_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1501,6 +1643,7 @@ int main(int argc, char *argv[]) {
 							   h_CE_vs_cycle_time_observed->Fill(s_ms_since_eject);
 						}
 						if ( tof_lowTOF_lo < bdn.tof_LR && bdn.tof_LR < tof_lowTOF_hi) {
+							cycle.nLowTOF[LR]	+= 1.0;
 							h_LR_lowTOF_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_lowTOF_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_lowTOF_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1509,6 +1652,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nLowTOFBkgdCount[LR]	+= 1.0;
 						}
 						if ( tof_R_fast_lo < bdn.tof_LR && bdn.tof_LR < tof_R_fast_hi) {
+							cycle.nFast[LR]	+= 1.0;
 							h_LR_fast_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_fast_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							h_LR_fast_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1518,6 +1662,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nFastBkgdCount[LR]	+= 1.0;
 						}
 						if ( tof_R_slow_lo < bdn.tof_LR && bdn.tof_LR < tof_R_slow_hi) {
+							cycle.nSlow[LR]	+= 1.0;
 							h_LR_slow_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_slow_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							h_LR_slow_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1535,6 +1680,7 @@ int main(int argc, char *argv[]) {
 							}
 						}
 						if ( tof_oops_lo < bdn.tof_LR && bdn.tof_LR < tof_oops_hi) {
+							cycle.nOops[LR]	+= 1.0;
 							h_LR_oops_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_oops_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							h_LR_oops_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1554,14 +1700,12 @@ int main(int argc, char *argv[]) {
 					//if (event_good==1 && t_trigger_lo<bdn.t_B_dE && bdn.t_B_dE<t_trigger_hi && a_dE_lo<bdn.a_B_dEsum && t_trigger_lo<t_T_mcp && a_mcp_lo<bdn.a_T_mcpSum && bdn.fid_area_hit_T_mcp==1) { // 2015-04-18
 					if (event_good==1 && t_trigger_lo<bdn.t_B_dE && bdn.t_B_dE<t_trigger_hi && a_dE_lo<bdn.a_B_dEsum && t_trigger_lo<t_T_mcp && a_mcp_lo<a_T_mcpSum_corr && bdn.fid_area_hit_T_mcp==1) {
 // 2014-10-27						bdn.tof_BT	= t_T_mcp - bdn.t_B_dE - BT_zeroTime[0];
-						t1			= 0.001 * tofToMCPGrid (stBDNCase, 'T', bdn.tof_BT); // need times in us
-						z1			= stBDNCase.dTopGridDistance;
+						vz			= kinematicsVz (&stKinTableT, bdn.tof_BT); // z1/t1 from lookup table, incl. grid correction
 						t2			= 0.001 * (bdn.tof_BT - 0.5 + randgen->Rndm()); // need times in us
 						x2			= bdn.T_mcpPhysX;
 						y2			= bdn.T_mcpPhysY;
 						s2			= Sqrt(x2*x2 + y2*y2);
 						vs			= s2/t2;
-						vz			= z1/t1;//stBDNCase.dTopMCPDistance/t2;//z1/t1;
 						bdn.v_BT	= Sqrt(vs*vs + vz*vz);
 						bdn.En_BT	= 0.5 * stBDNCase.dNeutronEnergyMassFactorKeV * bdn.v_BT * bdn.v_BT;
 						if (s_capt_state == 0) {
@@ -1589,6 +1733,7 @@ int main(int argc, char *argv[]) {
 							h_bkgd_En_BT	->Fill(bdn.En_BT);
 						}
 						if ( tof_zero_lo < bdn.tof_BT && bdn.tof_BT < tof_zero_hi) {
+							cycle.nZeroTOF[BT]	+= 1.0;
 							h_BT_zero_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_zero_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_zero_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1601,6 +1746,7 @@ int main(int argc, char *argv[]) {
 							   h_CE_vs_cycle_time_observed->Fill(s_ms_since_eject);
 						}
 						if ( tof_lowTOF_lo < bdn.tof_BT && bdn.tof_BT < tof_lowTOF_hi) {
+							cycle.nLowTOF[BT]	+= 1.0;
 							h_BT_lowTOF_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_lowTOF_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_lowTOF_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1609,6 +1755,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nLowTOFBkgdCount[BT]	+= 1.0;
 						}
 						if ( tof_T_fast_lo < bdn.tof_BT && bdn.tof_BT < tof_T_fast_hi) {
+							cycle.nFast[BT]	+= 1.0;
 							h_BT_fast_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_fast_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							h_BT_fast_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1618,6 +1765,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nFastBkgdCount[BT]	+= 1.0;
 						}
 						if ( tof_T_slow_lo < bdn.tof_BT && bdn.tof_BT < tof_T_slow_hi) {
+							cycle.nSlow[BT]	+= 1.0;
 							h_BT_slow_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_slow_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							h_BT_slow_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1635,6 +1783,7 @@ int main(int argc, char *argv[]) {
 							}
 						}
 						if ( tof_oops_lo < bdn.tof_BT && bdn.tof_BT < tof_oops_hi) {
+							cycle.nOops[BT]	+= 1.0;
 							h_BT_oops_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							 h_T_oops_mcpMap->Fill(bdn.T_mcpX,bdn.T_mcpY);
 							h_BT_oops_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1656,14 +1805,12 @@ int main(int argc, char *argv[]) {
 //						if (s_capt_state == 0){      h_tof->Fill(bdn.tof_BR);      h_tof_BR->Fill(bdn.tof_BR); }
 //						if (s_capt_state == 1){ h_bkgd_tof->Fill(bdn.tof_BR); h_bkgd_tof_BR->Fill(bdn.tof_BR); }
 // 2014-10-27						bdn.tof_BR	= t_R_mcp - bdn.t_B_dE - BR_zeroTime[0];
-						t1			= 0.001 * tofToMCPGrid (stBDNCase, 'R', bdn.tof_BR); // need times in us
-						z1			= stBDNCase.dRightGridDistance;
+						vz			= kinematicsVz (&stKinTableR, bdn.tof_BR); // z1/t1 from lookup table, incl. grid correction
 						t2			= 0.001 * (bdn.tof_BR - 0.5 + randgen->Rndm()); // need times in us
 						x2			= bdn.R_mcpPhysX;
 						y2			= bdn.R_mcpPhysY;
 						s2			= Sqrt(x2*x2 + y2*y2);
 						vs			= s2/t2;
-						vz			= z1/t1;//stBDNCase.dRightMCPDistance/t2;//z1/t1;
 //						printf("miss(%d,%d,%d,%d); (x, y) = (%f, %f); s = %f; r = %f; t1 = %f; t2 = %f; (vs, vz) = (%f, %f); v = %f\n", bdn.miss_R_mcpA, bdn.miss_R_mcpB, bdn.miss_R_mcpC, bdn.miss_R_mcpD, x2, y2, s2, Sqrt(s2*s2+Power(stBDNCase.dRightMCPDistance,2)), t1, t2, vs, vz);
 						bdn.v_BR	= Sqrt(vs*vs + vz*vz);
 						bdn.En_BR	= 0.5 * stBDNCase.dNeutronEnergyMassFactorKeV * bdn.v_BR * bdn.v_BR;
@@ -1692,6 +1839,7 @@ int main(int argc, char *argv[]) {
 							h_bkgd_En_BR	->Fill(bdn.En_BR);
 						}
 						if ( tof_zero_lo < bdn.tof_BR && bdn.tof_BR < tof_zero_hi) {
+							cycle.nZeroTOF[BR]	+= 1.0;
 							h_BR_zero_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_zero_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_zero_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1704,6 +1852,7 @@ int main(int argc, char *argv[]) {
 							   h_CE_vs_cycle_time_observed->Fill(s_ms_since_eject);
 						}
 						if ( tof_lowTOF_lo < bdn.tof_BR && bdn.tof_BR < tof_lowTOF_hi) {
+							cycle.nLowTOF[BR]	+= 1.0;
 							h_BR_lowTOF_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_lowTOF_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_lowTOF_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1712,6 +1861,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nLowTOFBkgdCount[BR]	+= 1.0;
 						}
 						if ( tof_R_fast_lo < bdn.tof_BR && bdn.tof_BR < tof_R_fast_hi) {
+							cycle.nFast[BR]	+= 1.0;
 							h_BR_fast_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_fast_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							h_BR_fast_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1721,6 +1871,7 @@ int main(int argc, char *argv[]) {
 							if (s_capt_state == 1) metadata.nFastBkgdCount[BR]	+= 1.0;
 						}
 						if ( tof_R_slow_lo < bdn.tof_BR && bdn.tof_BR < tof_R_slow_hi) {
+							cycle.nSlow[BR]	+= 1.0;
 							h_BR_slow_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_slow_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							h_BR_slow_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1738,6 +1889,7 @@ int main(int argc, char *argv[]) {
 							}
 						}
 						if ( tof_oops_lo < bdn.tof_BR && bdn.tof_BR < tof_oops_hi) {
+							cycle.nOops[BR]	+= 1.0;
 							h_BR_oops_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							 h_R_oops_mcpMap->Fill(bdn.R_mcpX,bdn.R_mcpY);
 							h_BR_oops_vs_cycle_time_observed->Fill(s_ms_since_eject);
@@ -1773,7 +1925,7 @@ int main(int argc, char *argv[]) {
 						h_tof_2dE_mcp	-> Fill(tof_2dE);
 					}
 					
-					beta_recoil_tree->Fill();
+					fill_tree(beta_recoil_tree);
 					
 				} // end Beta-Recoil events
 				
@@ -1825,7 +1977,7 @@ int main(int argc, char *argv[]) {
 				(event_good==1 && t_trigger_lo<bdn.t_B_dE && t_trigger_lo<t_T_ge) ||
 				(event_good==1 && t_trigger_lo<bdn.t_B_dE && t_trigger_lo<t_R_ge))
 			{
-				beta_gamma_tree->Fill();
+				fill_tree(beta_gamma_tree);
 			}
 			// old cut 2013-12-02:
 			//if (event_good==1 && s_capt_state==0 && t_E_lo<t_L_E && t_dE_lo<bdn.t_L_dE && a_dE_lo<bdn.a_L_dEsum && a_E_lo<a_L_E && 0 < (t_T_ge-bdn.t_L_dE) && (t_T_ge-bdn.t_L_dE) < 1000) {
@@ -2629,6 +2781,13 @@ int main(int argc, char *argv[]) {
 	} //while (getevent()!=0)
 	
 	//**** Now have data for all events in data tree ****
+	
+	// Last (partial) cycle
+	if (cycle.n_entries > 0) {
+		cycle.complete = 0;
+		fill_tree(cycle_Tree);
+	}
+	stop_tree_writer(); // everything is in the trees from here on
 	//**** Now fill metadata line in metadata tree ****
 	
 	if (stop_flag == 0)	\
@@ -2891,6 +3050,14 @@ int main(int argc, char *argv[]) {
 //	metadata.n_slow_BT	= h_tof_BT->Integral(tof1_bin,tof2_bin) - h_bkgd_tof_BT->Integral(tof1_bin,tof2_bin);
 //	metadata.n_slow_BR	= h_tof_BR->Integral(tof1_bin,tof2_bin) - h_bkgd_tof_BR->Integral(tof1_bin,tof2_bin);
 	
+	metadata.comp_events	= stOutput.iCompressEvents;
+	metadata.comp_meta		= stOutput.iCompressMeta;
+	metadata.comp_file		= stOutput.iCompressFile;
+	metadata.n_threads		= stOutput.nThreads;
+	swSort.Stop();
+	metadata.sort_realTime_s	= swSort.RealTime(); // up to here, ie. not incl. writing the file
+	metadata.sort_cpuTime_s		= swSort.CpuTime();
+	
 	metadata_Tree->Fill();
 	
 //~~~~~~~~ PRINT-OUT ~~~~~~~//
@@ -2967,11 +3134,48 @@ int main(int argc, char *argv[]) {
 	cout<<endl<<endl;
 	
 	f->Write();
+	writeHistograms(f);
 	f->Close();
 	delete esrc;
+	delete randgen;
 	return 0;
 	
-} // main
+} // sortRun
+
+// Write all booked histograms (in memory, see main) into f
+void writeHistograms(TFile *f) {
+	f->cd();
+	TIter next(gROOT->GetList());
+	TObject *obj;
+	while ((obj = next())) if (obj->InheritsFrom(TH1::Class())) obj->Write();
+	gROOT->cd();
+}
+
+// Add the booked histograms to the summed ones in lSum (cloned on the first call), then Reset them for the next run
+void addHistograms(TList *lSum) {
+	TIter next(gROOT->GetList());
+	TObject *obj;
+	TH1 *hSum;
+	while ((obj = next())) {
+		if (!obj->InheritsFrom(TH1::Class())) continue;
+		hSum = (TH1*)lSum->FindObject(obj->GetName());
+		if (hSum) hSum->Add((TH1*)obj);
+		else {
+			hSum = (TH1*)obj->Clone();
+			hSum->SetDirectory(0);
+			lSum->Add(hSum);
+		}
+		((TH1*)obj)->Reset();
+	}
+}
+
+// Start a new entry for cycle_Tree:
+void new_cycle(int n_cycle, int n_run) {
+	memset(&cycle, 0, sizeof(cycle));
+	cycle.n_cycle		= n_cycle;
+	cycle.run			= n_run;
+	cycle.ms_trap_empty	= -1; // no trap-empty events yet
+}
 
 // Function to convert dhms time to seconds:
 // Could be improved by allowing the smallest unit (sec) to be a float
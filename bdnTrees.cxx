@@ -1,5 +1,18 @@
 #define _bdn_trees_20140613_cxx "bdn_trees_20140613.cxx"
 #include "bdnTrees.h"
+#include "TBranch.h"
+#include "TROOT.h"
+#include "RVersion.h"
+#include <vector>
+
+// Trees are filled on a writer thread with ROOT 6.06 or later
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,6,0)
+#define BDN_WRITER_THREAD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#endif
 
 void book_trees()
 {
@@ -23,39 +36,16 @@ tree_bkgd_BT = new TTree("tree_bkgd_BT","all data that looks like a coincidence
 tree_bkgd_BR = new TTree("tree_bkgd_BR","all data that looks like a coincidence (BACKGROUND)");
 
 bdn_Tree 	= new TTree("bdn_Tree", "beta delayed neutron data");
-metadata_Tree = new TTree("metadata_Tree","data about each file");
+metadata_Tree = book_metadata_tree();
+cycle_Tree = new TTree("cycle_Tree","data about each trap cycle");
 zero_time_Tree = new TTree("zero_time_Tree", "Events in zero-time TOF peaks");
 beta_recoil_tree = new TTree("beta_recoil_tree","doubles with plastic and mcp data");
 beta_gamma_tree = new TTree("beta_gamma_tree","doubles with plastic and hpge data");
 
-metadata_Tree->Branch("metadata", &metadata, \
-	"n_run/I:n_trigs:tot_trigs:n_syncs:n_treeEntries:n_bad_events:bkgd_good:"\
-	"start_month:start_day:start_hour:start_min:start_sec:start_time_sec:"\
-	"stop_month:stop_day:stop_hour:stop_min:stop_sec:stop_time_sec:run_time_sec:run_time_ms:tot_liveTime_us:tot_runTime_us:"\
-	"n_scaler_hits_B_dEa:n_scaler_hits_B_dEb:n_scaler_hits_B_E:"\
-	"n_scaler_hits_L_dEa:n_scaler_hits_L_dEb:n_scaler_hits_L_E:"\
-	"n_scaler_hits_R_mcp:n_scaler_hits_R_ge:"\
-	"n_scaler_hits_T_mcp:n_scaler_hits_T_ge:"\
-	"n_tdc_hits_B_dEa:n_tdc_hits_B_dEb:n_tdc_hits_B_E:"\
-	"n_tdc_hits_L_dEa:n_tdc_hits_L_dEb:n_tdc_hits_L_E:"\
-	"n_tdc_hits_R_mcp:n_tdc_hits_R_ge:"\
-	"n_tdc_hits_T_mcp:n_tdc_hits_T_ge:"\
-	"n_adc_hits_B_dEa:n_adc_hits_B_dEb:n_adc_hits_B_E:"\
-	"n_adc_hits_L_dEa:n_adc_hits_L_dEb:n_adc_hits_L_E:"\
-	"n_adc_hits_R_mcpA:n_adc_hits_R_mcpB:n_adc_hits_R_mcpC:n_adc_hits_R_mcpD:n_adc_hits_R_mcpE:n_adc_hits_R_ge:n_adc_hits_R_ge_highE:"\
-	"n_adc_hits_T_mcpA:n_adc_hits_T_mcpB:n_adc_hits_T_mcpC:n_adc_hits_T_mcpD:n_adc_hits_T_mcpE:n_adc_hits_T_ge:n_adc_hits_T_ge_highE:"\
-	"n_missing_adc_hits_R_mcpA:n_missing_adc_hits_R_mcpB:n_missing_adc_hits_R_mcpC:n_missing_adc_hits_R_mcpD:n_missing_adc_hits_R_mcpE:"\
-	"n_missing_adc_hits_T_mcpA:n_missing_adc_hits_T_mcpB:n_missing_adc_hits_T_mcpC:n_missing_adc_hits_T_mcpD:n_missing_adc_hits_T_mcpE:"\
-	"tof_R_fast_lo/F:tof_R_fast_hi:tof_T_fast_lo:tof_T_fast_hi:tof_R_slow_lo:tof_R_slow_hi:tof_T_slow_lo:tof_T_slow_hi:"\
-	"nZeroTOFCount[4]/F:nLowTOFCount[4]:nFastCount[4]:nSlowCount[4]:nOopsCount[4]:"\
-	"nNetZeroTOFCount[4]:nNetLowTOFCount[4]:nNetFastCount[4]:nNetSlowCount[4]:"\
-	"nZeroTOFBkgdCount[4]:nLowTOFBkgdCount[4]:nFastBkgdCount[4]:nSlowBkgdCount[4]:nOopsBkgdCount[4]:"\
-	"nNetZeroTOFBkgdCount[4]:nNetLowTOFBkgdCount[4]:nNetFastBkgdCount[4]:nNetSlowBkgdCount[4]:"\
-	"nZeroTOFIntegral[4]:nLowTOFIntegral[4]:nFastIntegral[4]:nSlowIntegral[4]:nOopsIntegral[4]:"\
-	"nNetZeroTOFIntegral[4]:nNetLowTOFIntegral[4]:nNetFastIntegral[4]:nNetSlowIntegral[4]:"\
-	"nZeroTOFBkgdIntegral[4]:nLowTOFBkgdIntegral[4]:nFastBkgdIntegral[4]:nSlowBkgdIntegral[4]:nOopsBkgdIntegral[4]:"\
-	"nNetZeroTOFBkgdIntegral[4]:nNetLowTOFBkgdIntegral[4]:nNetFastBkgdIntegral[4]:nNetSlowBkgdIntegral[4]:"\
-	"n_cycles");
+cycle_Tree->Branch("cycle", &cycle, \
+	"n_cycle/I:run:complete:first_entry:last_entry:n_entries:first_ms:last_ms:"\
+	"n_capt:n_state_changes:ms_trap_empty:liveTime_us:runTime_us:"\
+	"nZeroTOF[4]/F:nLowTOF[4]:nFast[4]:nSlow[4]:nOops[4]");
 	
 bdn_Tree->Branch("bdn", &bdn, "miss_R_mcpA/O:miss_R_mcpB:miss_R_mcpC:miss_R_mcpD:miss_T_mcpA:miss_T_mcpB:miss_T_mcpC:miss_T_mcpD:fid_area_hit_R_mcp:fid_area_hit_T_mcp:"\
     "a_R_ge/I:a_T_ge:a_R_ge_highE:a_T_ge_highE:"\
@@ -226,3 +216,206 @@ beta_gamma_tree->Branch("bdn", &bdn, "miss_R_mcpA/O:miss_R_mcpB:miss_R_mcpC:miss
     "v_LT:v_LR:v_BT:v_BR:En_LT:En_LR:En_BT:En_BR:rf_phase");
 
 }
+
+// The metadata tree on its own, so that a file of summed runs can have one too
+TTree* book_metadata_tree()
+{
+
+TTree *tree = new TTree("metadata_Tree","data about each file");
+tree->Branch("metadata", &metadata, \
+	"n_run/I:n_trigs:tot_trigs:n_syncs:n_treeEntries:n_bad_events:bkgd_good:"\
+	"start_month:start_day:start_hour:start_min:start_sec:start_time_sec:"\
+	"stop_month:stop_day:stop_hour:stop_min:stop_sec:stop_time_sec:run_time_sec:run_time_ms:tot_liveTime_us:tot_runTime_us:"\
+	"n_scaler_hits_B_dEa:n_scaler_hits_B_dEb:n_scaler_hits_B_E:"\
+	"n_scaler_hits_L_dEa:n_scaler_hits_L_dEb:n_scaler_hits_L_E:"\
+	"n_scaler_hits_R_mcp:n_scaler_hits_R_ge:"\
+	"n_scaler_hits_T_mcp:n_scaler_hits_T_ge:"\
+	"n_tdc_hits_B_dEa:n_tdc_hits_B_dEb:n_tdc_hits_B_E:"\
+	"n_tdc_hits_L_dEa:n_tdc_hits_L_dEb:n_tdc_hits_L_E:"\
+	"n_tdc_hits_R_mcp:n_tdc_hits_R_ge:"\
+	"n_tdc_hits_T_mcp:n_tdc_hits_T_ge:"\
+	"n_adc_hits_B_dEa:n_adc_hits_B_dEb:n_adc_hits_B_E:"\
+	"n_adc_hits_L_dEa:n_adc_hits_L_dEb:n_adc_hits_L_E:"\
+	"n_adc_hits_R_mcpA:n_adc_hits_R_mcpB:n_adc_hits_R_mcpC:n_adc_hits_R_mcpD:n_adc_hits_R_mcpE:n_adc_hits_R_ge:n_adc_hits_R_ge_highE:"\
+	"n_adc_hits_T_mcpA:n_adc_hits_T_mcpB:n_adc_hits_T_mcpC:n_adc_hits_T_mcpD:n_adc_hits_T_mcpE:n_adc_hits_T_ge:n_adc_hits_T_ge_highE:"\
+	"n_missing_adc_hits_R_mcpA:n_missing_adc_hits_R_mcpB:n_missing_adc_hits_R_mcpC:n_missing_adc_hits_R_mcpD:n_missing_adc_hits_R_mcpE:"\
+	"n_missing_adc_hits_T_mcpA:n_missing_adc_hits_T_mcpB:n_missing_adc_hits_T_mcpC:n_missing_adc_hits_T_mcpD:n_missing_adc_hits_T_mcpE:"\
+	"comp_events:comp_meta:comp_file:n_threads:"\
+	"tof_R_fast_lo/F:tof_R_fast_hi:tof_T_fast_lo:tof_T_fast_hi:tof_R_slow_lo:tof_R_slow_hi:tof_T_slow_lo:tof_T_slow_hi:"\
+	"nZeroTOFCount[4]/F:nLowTOFCount[4]:nFastCount[4]:nSlowCount[4]:nOopsCount[4]:"\
+	"nNetZeroTOFCount[4]:nNetLowTOFCount[4]:nNetFastCount[4]:nNetSlowCount[4]:"\
+	"nZeroTOFBkgdCount[4]:nLowTOFBkgdCount[4]:nFastBkgdCount[4]:nSlowBkgdCount[4]:nOopsBkgdCount[4]:"\
+	"nNetZeroTOFBkgdCount[4]:nNetLowTOFBkgdCount[4]:nNetFastBkgdCount[4]:nNetSlowBkgdCount[4]:"\
+	"nZeroTOFIntegral[4]:nLowTOFIntegral[4]:nFastIntegral[4]:nSlowIntegral[4]:nOopsIntegral[4]:"\
+	"nNetZeroTOFIntegral[4]:nNetLowTOFIntegral[4]:nNetFastIntegral[4]:nNetSlowIntegral[4]:"\
+	"nZeroTOFBkgdIntegral[4]:nLowTOFBkgdIntegral[4]:nFastBkgdIntegral[4]:nSlowBkgdIntegral[4]:nOopsBkgdIntegral[4]:"\
+	"nNetZeroTOFBkgdIntegral[4]:nNetLowTOFBkgdIntegral[4]:nNetFastBkgdIntegral[4]:nNetSlowBkgdIntegral[4]:"\
+	"n_cycles:sort_realTime_s:sort_cpuTime_s");
+return tree;
+
+}
+
+// The per-event trees, each with a "bdn" branch except tree_bkgd_BR (tree_BR is booked twice above)
+static const unsigned nEventTrees = 12;
+static void get_event_trees(TTree *eventTrees[nEventTrees])
+{
+
+TTree *trees[nEventTrees] = {bdn_Tree, tree_LT, tree_LR, tree_BT, tree_BR, tree_bkgd_LT, tree_bkgd_LR, tree_bkgd_BT, tree_bkgd_BR, \
+	zero_time_Tree, beta_recoil_tree, beta_gamma_tree};
+for (unsigned i = 0; i < nEventTrees; i++) eventTrees[i] = trees[i];
+
+}
+
+// Compression per tree (see outputSettings_t in bdnTrees.h); call after book_trees()
+void set_tree_compression(outputSettings_t stOutput)
+{
+
+TTree *eventTrees[nEventTrees];
+TBranch *branch;
+get_event_trees(eventTrees);
+for (unsigned i = 0; i < nEventTrees; i++) {
+	branch = eventTrees[i]->GetBranch("bdn");
+	if (branch) branch->SetCompressionSettings(stOutput.iCompressEvents);
+}
+metadata_Tree->GetBranch("metadata")->SetCompressionSettings(stOutput.iCompressMeta);
+cycle_Tree->GetBranch("cycle")->SetCompressionSettings(stOutput.iCompressMeta);
+
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Writer thread -- TTree::Fill(), ie. copying into baskets, compressing full baskets and writing them to
+// the file, is done by one thread while the sort thread decodes the next events. The sort thread copies
+// bdn or cycle into a block of fills; full blocks go through a queue to the writer, which copies each
+// entry into bdnOut or cycleOut (where the branches point while it runs) and calls Fill().
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifdef BDN_WRITER_THREAD
+static const unsigned nWriterBlock		= 4096;	// fills per block, so the lock is taken once per block
+static const unsigned nWriterMaxBlocks	= 16;	// the sort thread waits when the writer is this far behind
+
+struct treeFillBlock_t
+{
+	std::vector<TTree*>		vTree;	// in the order of the fill_tree() calls
+	std::vector<bdnEvent_t>	vBdn;	// one per fill of an event tree
+	std::vector<bdnCycle_t>	vCycle;	// one per fill of cycle_Tree
+};
+
+static std::thread					thWriter;
+static std::mutex					mtxWriter;
+static std::condition_variable		cvWriter;
+static std::deque<treeFillBlock_t*>	dqWriterBlocks;
+static treeFillBlock_t				*pWriterBlock	= 0;	// being filled by the sort thread
+static bool							bWriterOn		= false;
+static bool							bWriterStop		= false;
+static bdnEvent_t					bdnOut;
+static bdnCycle_t					cycleOut;
+
+// Point the "bdn" and "cycle" branches at pBdn and pCycle
+static void set_fill_addresses(bdnEvent_t *pBdn, bdnCycle_t *pCycle)
+{
+
+TTree *eventTrees[nEventTrees];
+TBranch *branch;
+get_event_trees(eventTrees);
+for (unsigned i = 0; i < nEventTrees; i++) {
+	branch = eventTrees[i]->GetBranch("bdn");
+	if (branch) branch->SetAddress(pBdn);
+}
+cycle_Tree->GetBranch("cycle")->SetAddress(pCycle);
+
+}
+
+static void tree_writer()
+{
+
+treeFillBlock_t *pBlock;
+unsigned i, iBdn, iCycle;
+for (;;) {
+	{
+		std::unique_lock<std::mutex> lock(mtxWriter);
+		cvWriter.wait(lock, [] {return bWriterStop || !dqWriterBlocks.empty();});
+		if (dqWriterBlocks.empty()) return; // stopped and drained
+		pBlock = dqWriterBlocks.front();
+		dqWriterBlocks.pop_front();
+	}
+	cvWriter.notify_all(); // room in the queue
+	iBdn = iCycle = 0;
+	for (i = 0; i < pBlock->vTree.size(); i++) {
+		if (pBlock->vTree[i] == cycle_Tree)	cycleOut	= pBlock->vCycle[iCycle++];
+		else								bdnOut		= pBlock->vBdn[iBdn++];
+		pBlock->vTree[i]->Fill();
+	}
+	delete pBlock;
+}
+
+}
+
+static void queue_writer_block()
+{
+
+std::unique_lock<std::mutex> lock(mtxWriter);
+cvWriter.wait(lock, [] {return dqWriterBlocks.size() < nWriterMaxBlocks;});
+dqWriterBlocks.push_back(pWriterBlock);
+pWriterBlock = 0;
+lock.unlock();
+cvWriter.notify_all();
+
+}
+#endif
+
+// Call after book_trees() and set_tree_compression(); returns the number of writer threads started (0 or 1)
+Int_t start_tree_writer()
+{
+
+#ifdef BDN_WRITER_THREAD
+if (bWriterOn) return 1;
+ROOT::EnableThreadSafety();
+set_fill_addresses(&bdnOut, &cycleOut);
+bWriterStop	= false;
+bWriterOn	= true;
+thWriter	= std::thread(tree_writer);
+return 1;
+#else
+return 0;
+#endif
+
+}
+
+void fill_tree(TTree *tree)
+{
+
+#ifdef BDN_WRITER_THREAD
+if (bWriterOn) {
+	if (!pWriterBlock) {
+		pWriterBlock = new treeFillBlock_t;
+		pWriterBlock->vTree.reserve(nWriterBlock);
+		pWriterBlock->vBdn.reserve(nWriterBlock);
+	}
+	pWriterBlock->vTree.push_back(tree);
+	if (tree == cycle_Tree)	pWriterBlock->vCycle.push_back(cycle);
+	else					pWriterBlock->vBdn.push_back(bdn);
+	if (pWriterBlock->vTree.size() >= nWriterBlock) queue_writer_block();
+	return;
+}
+#endif
+tree->Fill();
+
+}
+
+// Waits for the writer to fill everything queued, so call before reading or writing the trees
+void stop_tree_writer()
+{
+
+#ifdef BDN_WRITER_THREAD
+if (!bWriterOn) return;
+if (pWriterBlock) queue_writer_block();
+{
+	std::lock_guard<std::mutex> lock(mtxWriter);
+	bWriterStop = true;
+}
+cvWriter.notify_all();
+thWriter.join();
+bWriterOn = false;
+set_fill_addresses(&bdn, &cycle);
+#endif
+
+}
@@ -13,6 +13,28 @@
 #endif
 
 void book_trees();
+TTree* book_metadata_tree();
+
+// Output settings for bdnSort.
+// Compression uses the ROOT convention 100*algorithm + level, with algorithm 1 = zlib, 2 = LZMA,
+// 4 = LZ4 (ROOT >= 6.12); 0 = no compression, 101 = the ROOT default.
+struct outputSettings_t
+{
+	Int_t iCompressEvents;	// bdn_Tree and the other per-event trees
+	Int_t iCompressMeta;	// metadata_Tree and cycle_Tree
+	Int_t iCompressFile;	// everything else in the file, ie. the histograms
+	Int_t nThreads;			// 1 = the event trees and cycle_Tree are filled (and their baskets compressed and
+							// written) on a writer thread while the sort thread decodes; 0 = off
+};
+static const outputSettings_t stDefaultOutputSettings = {101, 209, 101, 0};
+void set_tree_compression(outputSettings_t);
+
+// Tree filling for bdnSort. Between start_tree_writer() and stop_tree_writer(), fill_tree() copies bdn
+// (or cycle, for cycle_Tree) into a queue and a writer thread calls Fill(); otherwise it calls Fill() directly.
+// The writer thread needs ROOT >= 6.06; start_tree_writer() returns 0 if there is none.
+Int_t start_tree_writer();
+void fill_tree(TTree*);
+void stop_tree_writer();
 
 //TEventList *list_LT;
 
@@ -33,7 +55,8 @@ struct fileMetadata_t
 	n_adc_hits_R_mcpA, n_adc_hits_R_mcpB, n_adc_hits_R_mcpC, n_adc_hits_R_mcpD, n_adc_hits_R_mcpE, n_adc_hits_R_ge, n_adc_hits_R_ge_highE, \
 	n_adc_hits_T_mcpA, n_adc_hits_T_mcpB, n_adc_hits_T_mcpC, n_adc_hits_T_mcpD, n_adc_hits_T_mcpE, n_adc_hits_T_ge, n_adc_hits_T_ge_highE, \
 	n_missing_adc_hits_R_mcpA, n_missing_adc_hits_R_mcpB, n_missing_adc_hits_R_mcpC, n_missing_adc_hits_R_mcpD, n_missing_adc_hits_R_mcpE, \
-	n_missing_adc_hits_T_mcpA, n_missing_adc_hits_T_mcpB, n_missing_adc_hits_T_mcpC, n_missing_adc_hits_T_mcpD, n_missing_adc_hits_T_mcpE; \
+	n_missing_adc_hits_T_mcpA, n_missing_adc_hits_T_mcpB, n_missing_adc_hits_T_mcpC, n_missing_adc_hits_T_mcpD, n_missing_adc_hits_T_mcpE, \
+	comp_events, comp_meta, comp_file, n_threads; \
 	Float_t	tof_R_fast_lo, tof_R_fast_hi, tof_T_fast_lo, tof_T_fast_hi, \
 			tof_R_slow_lo, tof_R_slow_hi, tof_T_slow_lo, tof_T_slow_hi; \
 	Float_t	nZeroTOFCount[4],			nLowTOFCount[4],			nFastCount[4],				nSlowCount[4],			nOopsCount[4], \
@@ -44,7 +67,7 @@ struct fileMetadata_t
 			nNetZeroTOFIntegral[4],		nNetLowTOFIntegral[4],		nNetFastIntegral[4],		nNetSlowIntegral[4], \
 			nZeroTOFBkgdIntegral[4],	nLowTOFBkgdIntegral[4],		nFastBkgdIntegral[4],		nSlowBkgdIntegral[4],	nOopsBkgdIntegral[4], \
 			nNetZeroTOFBkgdIntegral[4],	nNetLowTOFBkgdIntegral[4],	nNetFastBkgdIntegral[4],	nNetSlowBkgdIntegral[4], \
-			n_cycles;
+			n_cycles, sort_realTime_s, sort_cpuTime_s;
 } __attribute__((packed));
 /*
 struct fileMetadata_t
@@ -88,8 +111,20 @@ struct bdnEvent_t
 	t_B_dE, t_L_dE, tof_LT, tof_LR, tof_BT, tof_BR, v_LT, v_LR, v_BT, v_BR, En_LT, En_LR, En_BT, En_BR, rf_phase;
 } __attribute__((packed));
 
+// One entry per trap cycle, filled by bdnSort alongside bdn_Tree.
+// Entries first_entry..last_entry of bdn_Tree belong to cycle n_cycle, so cycle-resolved
+// selections and vetoes can use bdn_Tree->GetEntry() on that range instead of scanning the tree.
+// complete = 0 for the partial cycles at the start and end of a run.
+struct bdnCycle_t
+{
+	Int_t n_cycle, run, complete, first_entry, last_entry, n_entries, first_ms, last_ms, \
+	n_capt, n_state_changes, ms_trap_empty, liveTime_us, runTime_us; \
+	Float_t nZeroTOF[4], nLowTOF[4], nFast[4], nSlow[4], nOops[4];
+} __attribute__((packed));
+
 EXTERNAL fileMetadata_t		metadata;
 EXTERNAL bdnEvent_t			bdn;
+EXTERNAL bdnCycle_t			cycle;
 
 EXTERNAL TEventList *list_LT;
 EXTERNAL TEventList *list_LR;
@@ -109,6 +144,7 @@ EXTERNAL TTree *tree_bkgd_BT;
 EXTERNAL TTree *tree_bkgd_BR;
 EXTERNAL TTree *bdn_Tree;
 EXTERNAL TTree *metadata_Tree;
+EXTERNAL TTree *cycle_Tree;
 EXTERNAL TTree *zero_time_Tree;
 EXTERNAL TTree *beta_recoil_tree;
 EXTERNAL TTree *beta_gamma_tree;
@@ -21,6 +21,7 @@
  - a _post histogram showing the map with just the pedestals cut out of each post
 
 2014-04-21 Promoting this version to mcp_cal.cxx
+2015-05-06 Pedestal subtraction now goes through the ADC calibration tables in bdnCalibration.h (built by book_calibrations()).
   
 Histogram names:
 h_ = it's a histogram
@@ -43,6 +44,7 @@ _n = sum signal > 200*n
 #include "TRandom3.h"
 #include "TMath.h"
 #include "bdn.h"
+#include "bdnCalibration.h"
 
 void mcp_cal_pedSubtract (const char*);
 
@@ -79,6 +81,7 @@ void mcp_cal_pedSubtract (const char *filename) {
 	char *dir_cycle = "mcp_cal_pedSubtract;1"; // results will be placed in this subdirectory of the root file
 	
 	TRandom3 *randgen = new TRandom3(1);
+	book_calibrations();
 	
 	Int_t printReconstructionMessage = 0;
 	
@@ -453,14 +456,10 @@ void mcp_cal_pedSubtract (const char *filename) {
 		
 		tree->GetEntry(i);
 		
-		rA = (Double_t)tree->GetLeaf("a_R_mcpA")->GetValue() - ped_R_mcpA;
-		rB = (Double_t)tree->GetLeaf("a_R_mcpB")->GetValue() - ped_R_mcpB;
-		rC = (Double_t)tree->GetLeaf("a_R_mcpC")->GetValue() - ped_R_mcpC;
-		rD = (Double_t)tree->GetLeaf("a_R_mcpD")->GetValue() - ped_R_mcpD;
-		rA += randgen->Rndm();
-		rB += randgen->Rndm();
-		rC += randgen->Rndm();
-		rD += randgen->Rndm();
+		rA = adcCalibrateAny (&stCal_R_mcpA, tree->GetLeaf("a_R_mcpA")->GetValue(), randgen->Rndm());
+		rB = adcCalibrateAny (&stCal_R_mcpB, tree->GetLeaf("a_R_mcpB")->GetValue(), randgen->Rndm());
+		rC = adcCalibrateAny (&stCal_R_mcpC, tree->GetLeaf("a_R_mcpC")->GetValue(), randgen->Rndm());
+		rD = adcCalibrateAny (&stCal_R_mcpD, tree->GetLeaf("a_R_mcpD")->GetValue(), randgen->Rndm());
 		rSum = rA + rB + rC + rD;
 		rX = (rC + rD - rA - rB) / rSum;
 		rY = (rA + rD - rC - rB) / rSum;
@@ -469,14 +468,10 @@ void mcp_cal_pedSubtract (const char *filename) {
 //		rX = 25.0 * (rC + rD - rA - rB + randgen->Rndm()) / (rSum + randgen->Rndm());
 //		rY = 25.0 * (rA + rD - rC - rB + randgen->Rndm()) / (rSum + randgen->Rndm());
 		
-		tA = (Double_t)tree->GetLeaf("a_T_mcpA")->GetValue() - ped_T_mcpA;
-		tB = (Double_t)tree->GetLeaf("a_T_mcpB")->GetValue() - ped_T_mcpB;
-		tC = (Double_t)tree->GetLeaf("a_T_mcpC")->GetValue() - ped_T_mcpC;
-		tD = (Double_t)tree->GetLeaf("a_T_mcpD")->GetValue() - ped_T_mcpD;
-		tA += randgen->Rndm();
-		tB += randgen->Rndm();
-		tC += randgen->Rndm();
-		tD += randgen->Rndm();
+		tA = adcCalibrateAny (&stCal_T_mcpA, tree->GetLeaf("a_T_mcpA")->GetValue(), randgen->Rndm());
+		tB = adcCalibrateAny (&stCal_T_mcpB, tree->GetLeaf("a_T_mcpB")->GetValue(), randgen->Rndm());
+		tC = adcCalibrateAny (&stCal_T_mcpC, tree->GetLeaf("a_T_mcpC")->GetValue(), randgen->Rndm());
+		tD = adcCalibrateAny (&stCal_T_mcpD, tree->GetLeaf("a_T_mcpD")->GetValue(), randgen->Rndm());
 		tSum = tA + tB + tC + tD;
 		tX = (tC + tD - tA - tB) / tSum;
 		tY = (tA + tD - tC - tB) / tSum;